@@ -117,6 +117,21 @@ contains(USE_IPV6, -) {
     DEFINES += USE_IPV6=$$USE_IPV6
 }
 
+# use: qmake "USE_SECP256K1=1" to sign and verify with libsecp256k1 instead of OpenSSL
+#  (libsecp256k1 must be configured with --enable-module-recovery)
+contains(USE_SECP256K1, 1) {
+    message(Building with libsecp256k1 ECDSA)
+    DEFINES += USE_SECP256K1
+    INCLUDEPATH += $$SECP256K1_INCLUDE_PATH
+    LIBS += $$join(SECP256K1_LIB_PATH,,-L,) -lsecp256k1
+}
+
+# use: qmake "USE_LOCKPROFILE=1" to count wait and hold time per LOCK() site (getlockstats RPC)
+contains(USE_LOCKPROFILE, 1) {
+    message(Building with lock profiling)
+    DEFINES += DEBUG_LOCKPROFILE
+}
+
 contains(BITCOIN_NEED_QT_PLUGINS, 1) {
     DEFINES += BITCOIN_NEED_QT_PLUGINS
     QTPLUGIN += qcncodecs qjpcodecs qtwcodecs qkrcodecs qtaccessiblewidgets
@@ -186,7 +201,9 @@ HEADERS += \
     src/compat.h \
     src/crypter.h \
     src/db.h \
+    src/explorer.h \
     src/hash.h \
+    src/metrics.h \
     src/init.h \
     src/key.h \
     src/keystore.h \
@@ -204,14 +221,17 @@ HEADERS += \
     src/serialize.h \
     src/strlcpy.h \
     src/sync.h \
+    src/logger.h \
     src/threadsafety.h \
     src/txdb-leveldb.h \
     src/uint256.h \
+    src/arith_uint256.h \
     src/ui_interface.h \
     src/util.h \
     src/version.h \
     src/wallet.h \
     src/walletdb.h \
+    src/walletlog.h \
 #
     src/qt/aboutdialog.h \
     src/qt/addressbookpage.h \
@@ -266,7 +286,9 @@ SOURCES += \
     src/checkpoints.cpp \
     src/crypter.cpp \
     src/db.cpp \
+    src/explorer.cpp \
     src/hash.cpp \
+    src/metrics.cpp \
     src/init.cpp \
     src/key.cpp \
     src/keystore.cpp \
@@ -287,9 +309,12 @@ SOURCES += \
     src/script.cpp \
     src/scrypt_mine.cpp \
     src/sync.cpp \
+    src/logger.cpp \
     src/util.cpp \
+    src/arith_uint256.cpp \
     src/version.cpp \
     src/walletdb.cpp \
+    src/walletlog.cpp \
     src/wallet.cpp \
 #
     src/qt/transactionfilterproxy.cpp \
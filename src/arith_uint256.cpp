@@ -0,0 +1,234 @@
+// Copyright (c) 2016 The ECCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "arith_uint256.h"
+#include "uint256.h"
+
+#include <ctype.h>
+
+// 64x64 -> 128 bit multiply, returns the low half and stores the high half
+static inline uint64_t MulWide(uint64_t a, uint64_t b, uint64_t& nHigh)
+{
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 r = (unsigned __int128)a * b;
+    nHigh = (uint64_t)(r >> 64);
+    return (uint64_t)r;
+#else
+    uint64_t aLo = (uint32_t)a, aHi = a >> 32;
+    uint64_t bLo = (uint32_t)b, bHi = b >> 32;
+    uint64_t p0 = aLo * bLo;
+    uint64_t p1 = aLo * bHi;
+    uint64_t p2 = aHi * bLo;
+    uint64_t p3 = aHi * bHi;
+    uint64_t nMid = (p0 >> 32) + (uint32_t)p1 + (uint32_t)p2;
+    nHigh = p3 + (p1 >> 32) + (p2 >> 32) + (nMid >> 32);
+    return (nMid << 32) | (uint32_t)p0;
+#endif
+}
+
+arith_uint256& arith_uint256::operator<<=(unsigned int shift)
+{
+    arith_uint256 a(*this);
+    for (int i = 0; i < WIDTH; i++)
+        pn[i] = 0;
+    int k = shift / 64;
+    shift = shift % 64;
+    for (int i = 0; i < WIDTH; i++)
+    {
+        if (i + k + 1 < WIDTH && shift != 0)
+            pn[i + k + 1] |= (a.pn[i] >> (64 - shift));
+        if (i + k < WIDTH)
+            pn[i + k] |= (a.pn[i] << shift);
+    }
+    return *this;
+}
+
+arith_uint256& arith_uint256::operator>>=(unsigned int shift)
+{
+    arith_uint256 a(*this);
+    for (int i = 0; i < WIDTH; i++)
+        pn[i] = 0;
+    int k = shift / 64;
+    shift = shift % 64;
+    for (int i = 0; i < WIDTH; i++)
+    {
+        if (i - k - 1 >= 0 && shift != 0)
+            pn[i - k - 1] |= (a.pn[i] << (64 - shift));
+        if (i - k >= 0)
+            pn[i - k] |= (a.pn[i] >> shift);
+    }
+    return *this;
+}
+
+arith_uint256& arith_uint256::operator*=(uint64_t b)
+{
+    uint64_t carry = 0;
+    for (int i = 0; i < WIDTH; i++)
+    {
+        uint64_t nHigh;
+        uint64_t nLow = MulWide(pn[i], b, nHigh);
+        pn[i] = nLow + carry;
+        carry = nHigh + (pn[i] < nLow);
+    }
+    return *this;
+}
+
+arith_uint256& arith_uint256::operator*=(const arith_uint256& b)
+{
+    arith_uint256 a;
+    for (int j = 0; j < WIDTH; j++)
+    {
+        uint64_t carry = 0;
+        for (int i = 0; i + j < WIDTH; i++)
+        {
+            uint64_t nHigh;
+            uint64_t nLow = MulWide(pn[j], b.pn[i], nHigh);
+            nLow += carry;
+            nHigh += (nLow < carry);
+            a.pn[i + j] += nLow;
+            nHigh += (a.pn[i + j] < nLow);
+            carry = nHigh;
+        }
+    }
+    *this = a;
+    return *this;
+}
+
+arith_uint256& arith_uint256::operator/=(const arith_uint256& b)
+{
+    arith_uint256 div = b;     // make a copy, so we can shift.
+    arith_uint256 num = *this; // make a copy, so we can subtract.
+    *this = 0;                 // the quotient.
+    int num_bits = num.bits();
+    int div_bits = div.bits();
+    if (div_bits == 0)
+        throw uint_error("Division by zero");
+    if (div_bits > num_bits) // the result is certainly 0.
+        return *this;
+    int shift = num_bits - div_bits;
+    div <<= shift; // shift so that div and num align.
+    while (shift >= 0)
+    {
+        if (num >= div)
+        {
+            num -= div;
+            pn[shift / 64] |= ((uint64_t)1 << (shift % 64)); // set a bit of the result.
+        }
+        div >>= 1; // shift back.
+        shift--;
+    }
+    // num now contains the remainder of the division.
+    return *this;
+}
+
+unsigned int arith_uint256::bits() const
+{
+    for (int pos = WIDTH - 1; pos >= 0; pos--)
+    {
+        if (pn[pos])
+        {
+            for (int nbits = 63; nbits > 0; nbits--)
+            {
+                if (pn[pos] & ((uint64_t)1 << nbits))
+                    return 64 * pos + nbits + 1;
+            }
+            return 64 * pos + 1;
+        }
+    }
+    return 0;
+}
+
+double arith_uint256::getdouble() const
+{
+    double ret = 0.0;
+    double fact = 1.0;
+    for (int i = 0; i < WIDTH; i++)
+    {
+        ret += fact * pn[i];
+        fact *= 18446744073709551616.0;
+    }
+    return ret;
+}
+
+std::string arith_uint256::GetHex() const
+{
+    return ArithToUint256(*this).GetHex();
+}
+
+void arith_uint256::SetHex(const char* psz)
+{
+    *this = UintToArith256(uint256(psz));
+}
+
+arith_uint256& arith_uint256::SetCompact(uint32_t nCompact, bool* pfNegative, bool* pfOverflow)
+{
+    int nSize = nCompact >> 24;
+    uint32_t nWord = nCompact & 0x007fffff;
+    if (nSize <= 3)
+    {
+        nWord >>= 8 * (3 - nSize);
+        *this = nWord;
+    }
+    else
+    {
+        *this = nWord;
+        *this <<= 8 * (nSize - 3);
+    }
+    if (pfNegative)
+        *pfNegative = nWord != 0 && (nCompact & 0x00800000) != 0;
+    if (pfOverflow)
+        *pfOverflow = nWord != 0 && ((nSize > 34) ||
+                                     (nWord > 0xff && nSize > 33) ||
+                                     (nWord > 0xffff && nSize > 32));
+    return *this;
+}
+
+uint32_t arith_uint256::GetCompact(bool fNegative) const
+{
+    int nSize = (bits() + 7) / 8;
+    uint32_t nCompact = 0;
+    if (nSize <= 3)
+    {
+        nCompact = GetLow64() << 8 * (3 - nSize);
+    }
+    else
+    {
+        arith_uint256 bn = *this >> 8 * (nSize - 3);
+        nCompact = bn.GetLow64();
+    }
+    // The 0x00800000 bit denotes the sign.
+    // Thus, if it is already set, divide the mantissa by 256 and increase the exponent.
+    if (nCompact & 0x00800000)
+    {
+        nCompact >>= 8;
+        nSize++;
+    }
+    nCompact |= nSize << 24;
+    nCompact |= (fNegative && (nCompact & 0x007fffff) ? 0x00800000 : 0);
+    return nCompact;
+}
+
+uint256 ArithToUint256(const arith_uint256& a)
+{
+    uint256 b;
+    unsigned char* p = b.begin();
+    for (int i = 0; i < arith_uint256::WIDTH; i++)
+        for (int j = 0; j < 8; j++)
+            p[8 * i + j] = (unsigned char)(a.pn[i] >> (8 * j));
+    return b;
+}
+
+arith_uint256 UintToArith256(const uint256& a)
+{
+    arith_uint256 b;
+    const unsigned char* p = a.begin();
+    for (int i = 0; i < arith_uint256::WIDTH; i++)
+    {
+        uint64_t n = 0;
+        for (int j = 0; j < 8; j++)
+            n |= (uint64_t)p[8 * i + j] << (8 * j);
+        b.pn[i] = n;
+    }
+    return b;
+}
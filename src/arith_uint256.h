@@ -0,0 +1,215 @@
+// Copyright (c) 2016 The ECCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_ARITH_UINT256_H
+#define BITCOIN_ARITH_UINT256_H
+
+#include <stdexcept>
+#include <string>
+
+#include <stdint.h>
+#include <string.h>
+
+class uint256;
+
+class uint_error : public std::runtime_error
+{
+public:
+    explicit uint_error(const std::string& str) : std::runtime_error(str) {}
+};
+
+/** Unsigned 256-bit integer for target and chain trust arithmetic.
+ * Unlike uint256 (a 32-bit word blob used for hashes) this keeps four 64-bit
+ * limbs and implements full multiplication, division and the compact
+ * "nBits" encoding, so consensus code does not need CBigNum temporaries.
+ * Arithmetic wraps modulo 2^256.
+ */
+class arith_uint256
+{
+protected:
+    enum { WIDTH = 4 };
+    uint64_t pn[WIDTH];
+
+public:
+    arith_uint256()
+    {
+        for (int i = 0; i < WIDTH; i++)
+            pn[i] = 0;
+    }
+
+    arith_uint256(uint64_t b)
+    {
+        pn[0] = b;
+        for (int i = 1; i < WIDTH; i++)
+            pn[i] = 0;
+    }
+
+    explicit arith_uint256(const std::string& str)
+    {
+        SetHex(str);
+    }
+
+    bool operator!() const
+    {
+        return (pn[0] | pn[1] | pn[2] | pn[3]) == 0;
+    }
+
+    const arith_uint256 operator~() const
+    {
+        arith_uint256 ret;
+        for (int i = 0; i < WIDTH; i++)
+            ret.pn[i] = ~pn[i];
+        return ret;
+    }
+
+    const arith_uint256 operator-() const
+    {
+        arith_uint256 ret = ~(*this);
+        ++ret;
+        return ret;
+    }
+
+    arith_uint256& operator^=(const arith_uint256& b)
+    {
+        for (int i = 0; i < WIDTH; i++)
+            pn[i] ^= b.pn[i];
+        return *this;
+    }
+
+    arith_uint256& operator&=(const arith_uint256& b)
+    {
+        for (int i = 0; i < WIDTH; i++)
+            pn[i] &= b.pn[i];
+        return *this;
+    }
+
+    arith_uint256& operator|=(const arith_uint256& b)
+    {
+        for (int i = 0; i < WIDTH; i++)
+            pn[i] |= b.pn[i];
+        return *this;
+    }
+
+    arith_uint256& operator<<=(unsigned int shift);
+    arith_uint256& operator>>=(unsigned int shift);
+
+    arith_uint256& operator+=(const arith_uint256& b)
+    {
+        uint64_t carry = 0;
+        for (int i = 0; i < WIDTH; i++)
+        {
+            uint64_t n = pn[i] + carry;
+            carry = (n < carry);
+            pn[i] = n + b.pn[i];
+            carry += (pn[i] < n);
+        }
+        return *this;
+    }
+
+    arith_uint256& operator-=(const arith_uint256& b)
+    {
+        uint64_t borrow = 0;
+        for (int i = 0; i < WIDTH; i++)
+        {
+            uint64_t n = pn[i] - b.pn[i];
+            uint64_t nBorrow = (pn[i] < b.pn[i]);
+            pn[i] = n - borrow;
+            borrow = nBorrow | (n < borrow);
+        }
+        return *this;
+    }
+
+    arith_uint256& operator+=(uint64_t b) { return *this += arith_uint256(b); }
+    arith_uint256& operator-=(uint64_t b) { return *this -= arith_uint256(b); }
+
+    arith_uint256& operator*=(uint64_t b);
+    arith_uint256& operator*=(const arith_uint256& b);
+    arith_uint256& operator/=(const arith_uint256& b);
+
+    arith_uint256& operator++()
+    {
+        int i = 0;
+        while (i < WIDTH && ++pn[i] == 0)
+            i++;
+        return *this;
+    }
+
+    const arith_uint256 operator++(int)
+    {
+        const arith_uint256 ret = *this;
+        ++(*this);
+        return ret;
+    }
+
+    arith_uint256& operator--()
+    {
+        int i = 0;
+        while (i < WIDTH && --pn[i] == (uint64_t)-1)
+            i++;
+        return *this;
+    }
+
+    const arith_uint256 operator--(int)
+    {
+        const arith_uint256 ret = *this;
+        --(*this);
+        return ret;
+    }
+
+    int CompareTo(const arith_uint256& b) const
+    {
+        for (int i = WIDTH - 1; i >= 0; i--)
+        {
+            if (pn[i] < b.pn[i])
+                return -1;
+            if (pn[i] > b.pn[i])
+                return 1;
+        }
+        return 0;
+    }
+
+    friend inline const arith_uint256 operator+(const arith_uint256& a, const arith_uint256& b) { return arith_uint256(a) += b; }
+    friend inline const arith_uint256 operator-(const arith_uint256& a, const arith_uint256& b) { return arith_uint256(a) -= b; }
+    friend inline const arith_uint256 operator*(const arith_uint256& a, const arith_uint256& b) { return arith_uint256(a) *= b; }
+    friend inline const arith_uint256 operator/(const arith_uint256& a, const arith_uint256& b) { return arith_uint256(a) /= b; }
+    friend inline const arith_uint256 operator|(const arith_uint256& a, const arith_uint256& b) { return arith_uint256(a) |= b; }
+    friend inline const arith_uint256 operator&(const arith_uint256& a, const arith_uint256& b) { return arith_uint256(a) &= b; }
+    friend inline const arith_uint256 operator^(const arith_uint256& a, const arith_uint256& b) { return arith_uint256(a) ^= b; }
+    friend inline const arith_uint256 operator*(const arith_uint256& a, uint64_t b) { return arith_uint256(a) *= b; }
+    friend inline const arith_uint256 operator>>(const arith_uint256& a, unsigned int shift) { return arith_uint256(a) >>= shift; }
+    friend inline const arith_uint256 operator<<(const arith_uint256& a, unsigned int shift) { return arith_uint256(a) <<= shift; }
+    friend inline bool operator==(const arith_uint256& a, const arith_uint256& b) { return a.CompareTo(b) == 0; }
+    friend inline bool operator!=(const arith_uint256& a, const arith_uint256& b) { return a.CompareTo(b) != 0; }
+    friend inline bool operator>(const arith_uint256& a, const arith_uint256& b) { return a.CompareTo(b) > 0; }
+    friend inline bool operator<(const arith_uint256& a, const arith_uint256& b) { return a.CompareTo(b) < 0; }
+    friend inline bool operator>=(const arith_uint256& a, const arith_uint256& b) { return a.CompareTo(b) >= 0; }
+    friend inline bool operator<=(const arith_uint256& a, const arith_uint256& b) { return a.CompareTo(b) <= 0; }
+
+    /** Position of the highest set bit plus one, 0 for zero */
+    unsigned int bits() const;
+
+    uint64_t GetLow64() const { return pn[0]; }
+    double getdouble() const;
+
+    std::string GetHex() const;
+    void SetHex(const char* psz);
+    void SetHex(const std::string& str) { SetHex(str.c_str()); }
+    std::string ToString() const { return GetHex(); }
+
+    /** The compact form ("nBits") is a base 256 floating point number: the top
+     * byte is the size in bytes, the low 23 bits the mantissa and bit 23 the
+     * sign. It decodes exactly like CBigNum::SetCompact; pfNegative is set for
+     * a negative non-zero value and pfOverflow when the value does not fit in
+     * 256 bits, and the result is then meaningless.
+     */
+    arith_uint256& SetCompact(uint32_t nCompact, bool* pfNegative = NULL, bool* pfOverflow = NULL);
+    uint32_t GetCompact(bool fNegative = false) const;
+
+    friend uint256 ArithToUint256(const arith_uint256& a);
+    friend arith_uint256 UintToArith256(const uint256& a);
+};
+
+uint256 ArithToUint256(const arith_uint256& a);
+arith_uint256 UintToArith256(const uint256& a);
+
+#endif
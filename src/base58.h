@@ -23,44 +23,98 @@
 
 static const char* pszBase58 = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
 
+// The codec works on machine words instead of CBigNum: encoding keeps the
+// number in base 58^5 limbs, decoding in base 2^32 limbs, and each pass
+// folds several input digits into the limbs at once. Buffers for inputs of
+// up to BASE58_STACK_BYTES bytes live on the stack.
+static const uint32_t BASE58_POW5 = 656356768; // 58^5
+static const size_t BASE58_STACK_BYTES = 128;
+
+// Value of each base58 character, -1 for characters outside the alphabet
+static const int8_t mapBase58[256] = {
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1, 0, 1, 2, 3, 4, 5, 6,  7, 8,-1,-1,-1,-1,-1,-1,
+    -1, 9,10,11,12,13,14,15, 16,-1,17,18,19,20,21,-1,
+    22,23,24,25,26,27,28,29, 30,31,32,-1,-1,-1,-1,-1,
+    -1,33,34,35,36,37,38,39, 40,41,42,43,-1,44,45,46,
+    47,48,49,50,51,52,53,54, 55,56,57,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+};
+
 // Encode a byte sequence as a base58-encoded string
 inline std::string EncodeBase58(const unsigned char* pbegin, const unsigned char* pend)
 {
-    CAutoBN_CTX pctx;
-    CBigNum bn58 = 58;
-    CBigNum bn0 = 0;
-
-    // Convert big endian data to little endian
-    // Extra zero at the end make sure bignum will interpret as a positive number
-    std::vector<unsigned char> vchTmp(pend-pbegin+1, 0);
-    reverse_copy(pbegin, pend, vchTmp.begin());
-
-    // Convert little endian data to bignum
-    CBigNum bn;
-    bn.setvch(vchTmp);
-
-    // Convert bignum to std::string
-    std::string str;
-    // Expected size increase from base58 conversion is approximately 137%
-    // use 138% to be safe
-    str.reserve((pend - pbegin) * 138 / 100 + 1);
-    CBigNum dv;
-    CBigNum rem;
-    while (bn > bn0)
-    {
-        if (!BN_div(&dv, &rem, &bn, &bn58, pctx))
-            throw bignum_error("EncodeBase58 : BN_div failed");
-        bn = dv;
-        unsigned int c = rem.getulong();
-        str += pszBase58[c];
+    // Leading zeroes encoded as base58 zeros
+    size_t nZeroes = 0;
+    while (pbegin != pend && *pbegin == 0)
+    {
+        pbegin++;
+        nZeroes++;
     }
 
-    // Leading zeroes encoded as base58 zeros
-    for (const unsigned char* p = pbegin; p < pend && *p == 0; p++)
-        str += pszBase58[0];
+    // Each base 58^5 limb holds a little over 29 bits
+    size_t nMaxLimbs = (pend - pbegin) * 8 / 29 + 1;
+    uint32_t limbsStack[BASE58_STACK_BYTES * 8 / 29 + 1];
+    std::vector<uint32_t> limbsHeap;
+    uint32_t* limbs = limbsStack;
+    if (nMaxLimbs > sizeof(limbsStack) / sizeof(limbsStack[0]))
+    {
+        limbsHeap.resize(nMaxLimbs);
+        limbs = &limbsHeap[0];
+    }
 
-    // Convert little endian std::string to big endian
-    reverse(str.begin(), str.end());
+    // Multiply in up to 4 input bytes per pass; limb * 2^32 + carry stays below 2^63
+    size_t nLimbs = 0;
+    while (pbegin != pend)
+    {
+        uint64_t nMul = 1;
+        uint64_t carry = 0;
+        for (int i = 0; i < 4 && pbegin != pend; i++)
+        {
+            carry = (carry << 8) | *pbegin++;
+            nMul <<= 8;
+        }
+        for (size_t j = 0; j < nLimbs; j++)
+        {
+            carry += (uint64_t)limbs[j] * nMul;
+            limbs[j] = (uint32_t)(carry % BASE58_POW5);
+            carry /= BASE58_POW5;
+        }
+        while (carry > 0)
+        {
+            limbs[nLimbs++] = (uint32_t)(carry % BASE58_POW5);
+            carry /= BASE58_POW5;
+        }
+    }
+
+    // Five digits per limb, without leading zeroes in the most significant one
+    size_t nDigits = 0;
+    if (nLimbs > 0)
+    {
+        nDigits = (nLimbs - 1) * 5;
+        for (uint32_t n = limbs[nLimbs - 1]; n > 0; n /= 58)
+            nDigits++;
+    }
+    std::string str(nZeroes + nDigits, pszBase58[0]);
+    char* pch = &str[0] + str.size();
+    for (size_t j = 0; j < nLimbs; j++)
+    {
+        uint32_t n = limbs[j];
+        for (int k = 0; k < 5 && pch > &str[0] + nZeroes; k++)
+        {
+            *--pch = pszBase58[n % 58];
+            n /= 58;
+        }
+    }
     return str;
 }
 
@@ -74,47 +128,77 @@ inline std::string EncodeBase58(const std::vector<unsigned char>& vch)
 // returns true if decoding is successful
 inline bool DecodeBase58(const char* psz, std::vector<unsigned char>& vchRet)
 {
-    CAutoBN_CTX pctx;
     vchRet.clear();
-    CBigNum bn58 = 58;
-    CBigNum bn = 0;
-    CBigNum bnChar;
     while (isspace(*psz))
         psz++;
 
-    // Convert big endian string to bignum
-    for (const char* p = psz; *p; p++)
+    // Leading base58 zeros restore leading zero bytes
+    size_t nZeroes = 0;
+    while (*psz == pszBase58[0])
     {
-        const char* p1 = strchr(pszBase58, *p);
-        if (p1 == NULL)
-        {
-            while (isspace(*p))
-                p++;
-            if (*p != '\0')
-                return false;
-            break;
-        }
-        bnChar.setulong(p1 - pszBase58);
-        if (!BN_mul(&bn, &bn, &bn58, pctx))
-            throw bignum_error("DecodeBase58 : BN_mul failed");
-        bn += bnChar;
+        psz++;
+        nZeroes++;
     }
 
-    // Get bignum as little endian data
-    std::vector<unsigned char> vchTmp = bn.getvch();
+    // Validate and find the end of the digits; only whitespace may follow them
+    const char* pend = psz;
+    while (mapBase58[(unsigned char)*pend] != -1)
+        pend++;
+    for (const char* p = pend; *p; p++)
+        if (!isspace(*p))
+            return false;
 
-    // Trim off sign byte if present
-    if (vchTmp.size() >= 2 && vchTmp.end()[-1] == 0 && vchTmp.end()[-2] >= 0x80)
-        vchTmp.erase(vchTmp.end()-1);
+    // Each base 2^32 limb takes at least 5 digits
+    size_t nMaxLimbs = (pend - psz) / 5 + 1;
+    uint32_t limbsStack[BASE58_STACK_BYTES / 4];
+    std::vector<uint32_t> limbsHeap;
+    uint32_t* limbs = limbsStack;
+    if (nMaxLimbs > sizeof(limbsStack) / sizeof(limbsStack[0]))
+    {
+        limbsHeap.resize(nMaxLimbs);
+        limbs = &limbsHeap[0];
+    }
 
-    // Restore leading zeros
-    int nLeadingZeros = 0;
-    for (const char* p = psz; *p == pszBase58[0]; p++)
-        nLeadingZeros++;
-    vchRet.assign(nLeadingZeros + vchTmp.size(), 0);
+    // Multiply in up to 5 digits per pass; limb * 58^5 + carry fits in 64 bits
+    size_t nLimbs = 0;
+    while (psz != pend)
+    {
+        uint64_t nMul = 1;
+        uint64_t carry = 0;
+        for (int i = 0; i < 5 && psz != pend; i++)
+        {
+            carry = carry * 58 + mapBase58[(unsigned char)*psz++];
+            nMul *= 58;
+        }
+        for (size_t j = 0; j < nLimbs; j++)
+        {
+            carry += (uint64_t)limbs[j] * nMul;
+            limbs[j] = (uint32_t)carry;
+            carry >>= 32;
+        }
+        if (carry > 0)
+            limbs[nLimbs++] = (uint32_t)carry;
+    }
 
-    // Convert little endian data to big endian
-    reverse_copy(vchTmp.begin(), vchTmp.end(), vchRet.end() - vchTmp.size());
+    // Big endian bytes, without leading zeroes from the most significant limb
+    size_t nBytes = 0;
+    if (nLimbs > 0)
+    {
+        nBytes = (nLimbs - 1) * 4;
+        for (uint32_t n = limbs[nLimbs - 1]; n > 0; n >>= 8)
+            nBytes++;
+    }
+    vchRet.assign(nZeroes + nBytes, 0);
+    unsigned char* pch = vchRet.empty() ? NULL : &vchRet[0] + vchRet.size();
+    for (size_t j = 0; j < nLimbs; j++)
+    {
+        uint32_t n = limbs[j];
+        for (int k = 0; k < 4 && pch > &vchRet[0] + nZeroes; k++)
+        {
+            *--pch = (unsigned char)n;
+            n >>= 8;
+        }
+    }
     return true;
 }
 
@@ -0,0 +1,57 @@
+// Copyright (c) 2016 The ECCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "base58.h"
+#include "hash.h"
+
+#include <stdexcept>
+#include <vector>
+
+static void Base58Encode(benchmark::State& state)
+{
+    unsigned char buff[32] = {
+        17, 79, 8, 99, 150, 189, 208, 162, 22, 23, 203, 163, 36, 58, 147,
+        227, 139, 2, 215, 100, 91, 38, 11, 141, 253, 40, 117, 21, 16, 90,
+        200, 24
+    };
+    while (state.KeepRunning())
+        EncodeBase58(buff, buff + sizeof(buff));
+}
+
+static void Base58CheckEncode(benchmark::State& state)
+{
+    std::vector<unsigned char> vch(21, 0x33);
+    while (state.KeepRunning())
+        EncodeBase58Check(vch);
+}
+
+static void Base58Decode(benchmark::State& state)
+{
+    const char* addr = "17VZNX1SN5NtKa8UQFxwQbFeFc3iqRYhem";
+    std::vector<unsigned char> vch;
+    while (state.KeepRunning())
+    {
+        if (!DecodeBase58(addr, vch))
+            throw std::runtime_error("Base58Decode: decode failed");
+    }
+}
+
+static void Base58AddressRoundTrip(benchmark::State& state)
+{
+    CBitcoinAddress addr(CKeyID(Hash160(std::vector<unsigned char>(33, 0x02))));
+    std::string str = addr.ToString();
+    while (state.KeepRunning())
+    {
+        CBitcoinAddress addr2(str);
+        if (!addr2.IsValid() || addr2.ToString() != str)
+            throw std::runtime_error("Base58AddressRoundTrip: round trip failed");
+    }
+}
+
+BENCHMARK(Base58Encode);
+BENCHMARK(Base58CheckEncode);
+BENCHMARK(Base58Decode);
+BENCHMARK(Base58AddressRoundTrip);
@@ -0,0 +1,143 @@
+// Copyright (c) 2016 The ECCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include <algorithm>
+#include <iostream>
+#include <new>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <boost/atomic.hpp>
+#include <boost/chrono/chrono.hpp>
+
+// Count allocations by replacing the global operator new; the array and
+// nothrow forms forward to this one in the standard library.
+static boost::atomic<uint64_t> nAllocations(0);
+
+void* operator new(size_t size)
+{
+    nAllocations.fetch_add(1, boost::memory_order_relaxed);
+    void* p = malloc(size ? size : 1);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) throw()
+{
+    free(p);
+}
+
+namespace benchmark {
+
+// A batch must run at least this long before its time is used as a sample
+static const int64_t MIN_BATCH_NANOS = 20000;
+
+int64_t GetTimeNanos()
+{
+    return boost::chrono::duration_cast<boost::chrono::nanoseconds>(
+        boost::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t GetAllocations()
+{
+    return nAllocations.load(boost::memory_order_relaxed);
+}
+
+BenchRunner::BenchmarkMap& BenchRunner::benchmarks()
+{
+    static BenchmarkMap benchmarks_map;
+    return benchmarks_map;
+}
+
+BenchRunner::BenchRunner(const std::string& name, BenchFunction func)
+{
+    benchmarks().insert(std::make_pair(name, func));
+}
+
+void BenchRunner::RunAll(double elapsedTimeForOne, const std::string& strFilter)
+{
+    std::cout << "# Benchmark, iterations, ns/op, allocs/op, p50 ns/op, p95 ns/op, p99 ns/op" << std::endl;
+
+    for (BenchmarkMap::iterator it = benchmarks().begin(); it != benchmarks().end(); ++it)
+    {
+        if (!strFilter.empty() && it->first.find(strFilter) == std::string::npos)
+            continue;
+        State state(it->first, elapsedTimeForOne);
+        it->second(state);
+    }
+}
+
+State::State(const std::string& nameIn, double maxElapsedIn) :
+    name(nameIn), maxElapsed(maxElapsedIn), nBeginTime(0), nBatchBegin(0), nAllocBegin(0),
+    nCount(0), nBatchEnd(0), nBatchSize(1), nMeasuredCount(0), nMeasuredAllocs(0), nMeasuredNanos(0)
+{
+}
+
+bool State::KeepRunning()
+{
+    if (nCount < nBatchEnd)
+    {
+        ++nCount;
+        return true;
+    }
+
+    int64_t nNow = GetTimeNanos();
+    uint64_t nAllocs = GetAllocations();
+    if (nBatchEnd == 0)
+    {
+        // first call, nothing has run yet
+        nBeginTime = nNow;
+    }
+    else
+    {
+        int64_t nBatchNanos = nNow - nBatchBegin;
+        if (nBatchNanos >= MIN_BATCH_NANOS)
+        {
+            vSamples.push_back((double)nBatchNanos / nBatchSize);
+            nMeasuredCount += nBatchSize;
+            nMeasuredNanos += nBatchNanos;
+            nMeasuredAllocs += nAllocs - nAllocBegin;
+        }
+        else
+            nBatchSize *= 2;
+
+        if (nNow - nBeginTime >= (int64_t)(maxElapsed * 1e9) && !vSamples.empty())
+        {
+            Report();
+            return false;
+        }
+    }
+
+    nBatchEnd = nCount + nBatchSize;
+    ++nCount;
+    nAllocBegin = GetAllocations();
+    nBatchBegin = GetTimeNanos();
+    return true;
+}
+
+static double Percentile(const std::vector<double>& vSorted, double dPercentile)
+{
+    size_t n = std::min((size_t)(dPercentile * vSorted.size()), vSorted.size() - 1);
+    return vSorted[n];
+}
+
+void State::Report() const
+{
+    std::vector<double> vSorted(vSamples);
+    std::sort(vSorted.begin(), vSorted.end());
+
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s, %llu, %.1f, %.2f, %.1f, %.1f, %.1f", name.c_str(),
+             (unsigned long long)nMeasuredCount,
+             (double)nMeasuredNanos / nMeasuredCount,
+             (double)nMeasuredAllocs / nMeasuredCount,
+             Percentile(vSorted, 0.50), Percentile(vSorted, 0.95), Percentile(vSorted, 0.99));
+    std::cout << buf << std::endl;
+}
+
+}
@@ -0,0 +1,85 @@
+// Copyright (c) 2016 The ECCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_BENCH_BENCH_H
+#define BITCOIN_BENCH_BENCH_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include <boost/preprocessor/cat.hpp>
+#include <boost/preprocessor/stringize.hpp>
+
+// Simple micro-benchmarking framework; API mostly matches a subset of the
+// Google Benchmark framework (see https://github.com/google/benchmark)
+// Why not use the Google Benchmark framework? Because adding another
+// dependency (that uses cmake as its build system and has lots of features
+// we don't need) isn't worth it.
+//
+// Usage:
+//
+// static void CODE_TO_TIME(benchmark::State& state)
+// {
+//     ... do any setup needed...
+//     while (state.KeepRunning()) {
+//        ... do stuff you want to time...
+//     }
+//     ... do any cleanup needed...
+// }
+//
+// BENCHMARK(CODE_TO_TIME);
+
+namespace benchmark {
+
+    /** Nanoseconds on a monotonic clock */
+    int64_t GetTimeNanos();
+
+    /** Number of operator new calls made so far by this process */
+    uint64_t GetAllocations();
+
+    /** Iterations are timed in batches whose size doubles until a batch
+     * takes long enough to be measured reliably; each such batch gives one
+     * ns/op sample for the percentiles. */
+    class State {
+        std::string name;
+        double maxElapsed;
+        int64_t nBeginTime;
+        int64_t nBatchBegin;
+        uint64_t nAllocBegin;
+        uint64_t nCount;
+        uint64_t nBatchEnd;
+        uint64_t nBatchSize;
+        uint64_t nMeasuredCount;
+        uint64_t nMeasuredAllocs;
+        int64_t nMeasuredNanos;
+        std::vector<double> vSamples;
+
+        void Report() const;
+
+    public:
+        State(const std::string& nameIn, double maxElapsedIn);
+        bool KeepRunning();
+    };
+
+    typedef void (*BenchFunction)(State&);
+
+    class BenchRunner
+    {
+        typedef std::map<std::string, BenchFunction> BenchmarkMap;
+        static BenchmarkMap& benchmarks();
+
+    public:
+        BenchRunner(const std::string& name, BenchFunction func);
+
+        static void RunAll(double elapsedTimeForOne = 1.0, const std::string& strFilter = "");
+    };
+}
+
+// BENCHMARK(foo) expands to:  benchmark::BenchRunner bench_11foo("foo", foo);
+#define BENCHMARK(n) \
+    benchmark::BenchRunner BOOST_PP_CAT(bench_, BOOST_PP_CAT(__LINE__, n))(BOOST_PP_STRINGIZE(n), n);
+
+#endif // BITCOIN_BENCH_BENCH_H
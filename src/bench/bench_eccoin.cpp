@@ -0,0 +1,61 @@
+// Copyright (c) 2016 The ECCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "checkpoints.h"
+#include "main.h"
+#include "ui_interface.h"
+#include "util.h"
+#include "wallet.h"
+
+#include <boost/filesystem.hpp>
+
+// Globals otherwise defined in init.cpp, which is not linked in
+CWallet* pwalletMain;
+CClientUIInterface uiInterface;
+std::string strWalletFileName;
+bool fConfChange;
+bool fEnforceCanonical;
+unsigned int nNodeLifespan;
+unsigned int nDerivationMethodIndex;
+unsigned int nMinerSleep;
+bool fUseFastIndex;
+enum Checkpoints::CPMode CheckpointsMode;
+
+extern void noui_connect();
+
+void Shutdown(void* parg)
+{
+    exit(0);
+}
+
+void StartShutdown()
+{
+    exit(0);
+}
+
+int main(int argc, char** argv)
+{
+    ParseParameters(argc, argv);
+    if (mapArgs.count("-?") || mapArgs.count("--help"))
+    {
+        fprintf(stdout, "Usage: bench_eccoin [-filter=<substring>] [-time=<seconds per benchmark>]\n");
+        return 0;
+    }
+
+    // no debug.log, databases go to a scratch data directory
+    fPrintToDebugger = true;
+    noui_connect();
+    boost::filesystem::path pathTemp = boost::filesystem::temp_directory_path() / strprintf("bench_eccoin_%lu", (unsigned long)GetTime());
+    boost::filesystem::create_directories(pathTemp);
+    mapArgs["-datadir"] = pathTemp.string();
+
+    double dTime = atof(GetArg("-time", "1").c_str());
+    benchmark::BenchRunner::RunAll(dTime > 0 ? dTime : 1.0, GetArg("-filter", ""));
+
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(pathTemp, ec);
+    return 0;
+}
@@ -0,0 +1,83 @@
+// Copyright (c) 2016 The ECCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "hash.h"
+#include "main.h"
+#include "scrypt_mine.h"
+
+#include <vector>
+
+/* Number of bytes to hash per iteration */
+static const uint64_t BUFFER_SIZE = 1000*1000;
+
+static void SHA256D_64Bytes(benchmark::State& state)
+{
+    std::vector<unsigned char> in(64, 0);
+    uint256 hash;
+    while (state.KeepRunning())
+        hash = Hash(in.begin(), in.end());
+}
+
+static void SHA256D_1MB(benchmark::State& state)
+{
+    std::vector<unsigned char> in(BUFFER_SIZE, 0);
+    uint256 hash;
+    while (state.KeepRunning())
+        hash = Hash(in.begin(), in.end());
+}
+
+static CBlock MakeHeader()
+{
+    CBlock block;
+    block.nVersion = 3;
+    block.hashPrevBlock = GetRandHash();
+    block.hashMerkleRoot = GetRandHash();
+    block.nTime = 1400000000;
+    block.nBits = 0x1e0fffff;
+    block.nNonce = 0;
+    return block;
+}
+
+// CBlock::GetHash(), including its scratchpad allocation
+static void ScryptBlockHash(benchmark::State& state)
+{
+    CBlock block = MakeHeader();
+    uint256 hash;
+    while (state.KeepRunning())
+    {
+        hash = block.GetHash();
+        block.nNonce++;
+    }
+}
+
+// One scanhash_scrypt() call trying 16 nonces, as the miner does
+static void ScanhashScrypt16(benchmark::State& state)
+{
+    CBlock block = MakeHeader();
+    block_header header;
+    header.version = block.nVersion;
+    header.prev_block = block.hashPrevBlock;
+    header.merkle_root = block.hashMerkleRoot;
+    header.timestamp = block.nTime;
+    header.bits = block.nBits;
+    header.nonce = 0;
+
+    void *scratchbuf = scrypt_buffer_alloc();
+    uint256 result;
+    block_header res_header;
+    uint32_t nHashesDone = 0;
+    while (state.KeepRunning())
+    {
+        scanhash_scrypt(&header, scratchbuf, 16, nHashesDone, &result, &res_header);
+        header.timestamp++;
+    }
+    scrypt_buffer_free(scratchbuf);
+}
+
+BENCHMARK(SHA256D_64Bytes);
+BENCHMARK(SHA256D_1MB);
+BENCHMARK(ScryptBlockHash);
+BENCHMARK(ScanhashScrypt16);
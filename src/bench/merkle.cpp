@@ -0,0 +1,38 @@
+// Copyright (c) 2016 The ECCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "main.h"
+
+static void BuildMerkleTree(benchmark::State& state, unsigned int nTx)
+{
+    CBlock block;
+    block.vtx.resize(nTx);
+    for (unsigned int i = 0; i < nTx; i++)
+    {
+        block.vtx[i].nTime = 1400000000 + i;
+        block.vtx[i].vin.resize(1);
+        block.vtx[i].vin[0].prevout = COutPoint(GetRandHash(), 0);
+        block.vtx[i].vout.resize(1);
+        block.vtx[i].vout[0].nValue = i;
+    }
+
+    uint256 hash;
+    while (state.KeepRunning())
+        hash = block.BuildMerkleTree();
+}
+
+static void MerkleTree_100Tx(benchmark::State& state)
+{
+    BuildMerkleTree(state, 100);
+}
+
+static void MerkleTree_2000Tx(benchmark::State& state)
+{
+    BuildMerkleTree(state, 2000);
+}
+
+BENCHMARK(MerkleTree_100Tx);
+BENCHMARK(MerkleTree_2000Tx);
@@ -0,0 +1,83 @@
+// Copyright (c) 2016 The ECCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "main.h"
+#include "serialize.h"
+
+static CTransaction MakeTransaction(unsigned int nSeed)
+{
+    CTransaction tx;
+    tx.nTime = 1400000000 + nSeed;
+    tx.vin.resize(2);
+    tx.vout.resize(2);
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        tx.vin[i].prevout = COutPoint(GetRandHash(), i);
+        tx.vin[i].scriptSig = CScript() << std::vector<unsigned char>(72, nSeed) << std::vector<unsigned char>(33, i);
+        tx.vout[i].nValue = (nSeed + 1) * COIN;
+        tx.vout[i].scriptPubKey = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, i) << OP_EQUALVERIFY << OP_CHECKSIG;
+    }
+    return tx;
+}
+
+static CBlock MakeBlock(unsigned int nTx)
+{
+    CBlock block;
+    block.nTime = 1400000000;
+    for (unsigned int i = 0; i < nTx; i++)
+        block.vtx.push_back(MakeTransaction(i));
+    block.hashMerkleRoot = block.BuildMerkleTree();
+    return block;
+}
+
+static void SerializeTransaction(benchmark::State& state)
+{
+    CTransaction tx = MakeTransaction(1);
+    while (state.KeepRunning())
+    {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << tx;
+    }
+}
+
+static void DeserializeTransaction(benchmark::State& state)
+{
+    CDataStream ssTx(SER_NETWORK, PROTOCOL_VERSION);
+    ssTx << MakeTransaction(1);
+    while (state.KeepRunning())
+    {
+        CDataStream ss(ssTx.begin(), ssTx.end(), SER_NETWORK, PROTOCOL_VERSION);
+        CTransaction tx;
+        ss >> tx;
+    }
+}
+
+static void SerializeBlock500Tx(benchmark::State& state)
+{
+    CBlock block = MakeBlock(500);
+    while (state.KeepRunning())
+    {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << block;
+    }
+}
+
+static void DeserializeBlock500Tx(benchmark::State& state)
+{
+    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+    ssBlock << MakeBlock(500);
+    while (state.KeepRunning())
+    {
+        CDataStream ss(ssBlock.begin(), ssBlock.end(), SER_NETWORK, PROTOCOL_VERSION);
+        CBlock block;
+        ss >> block;
+    }
+}
+
+BENCHMARK(SerializeTransaction);
+BENCHMARK(DeserializeTransaction);
+BENCHMARK(SerializeBlock500Tx);
+BENCHMARK(DeserializeBlock500Tx);
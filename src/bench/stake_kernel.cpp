@@ -0,0 +1,98 @@
+// Copyright (c) 2016 The ECCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "kernel.h"
+#include "main.h"
+
+#include <stdexcept>
+
+static const int KERNEL_CHAIN_LENGTH = 600;
+static const unsigned int KERNEL_BLOCK_SPACING = 60 * 60;
+
+// A synthetic chain: the block holding the staked output, followed by enough
+// hourly blocks (one in six regenerating the stake modifier) to cover the
+// modifier selection interval.
+class CKernelBenchChain
+{
+public:
+    CBlock blockFrom;
+    std::vector<uint256> vHashes;
+    std::vector<CBlockIndex> vIndex;
+    CTransaction txPrev;
+    COutPoint prevout;
+
+    CKernelBenchChain() : vHashes(KERNEL_CHAIN_LENGTH), vIndex(KERNEL_CHAIN_LENGTH)
+    {
+        blockFrom.nVersion = 3;
+        blockFrom.hashPrevBlock = GetRandHash();
+        blockFrom.hashMerkleRoot = GetRandHash();
+        blockFrom.nTime = 1400000000;
+        blockFrom.nBits = 0x1e0fffff;
+
+        vHashes[0] = blockFrom.GetHash();
+        for (int i = 0; i < KERNEL_CHAIN_LENGTH; i++)
+        {
+            if (i > 0)
+                vHashes[i] = GetRandHash();
+            CBlockIndex& index = vIndex[i];
+            index.nHeight = 100000 + i;
+            index.nTime = blockFrom.nTime + i * KERNEL_BLOCK_SPACING;
+            index.pprev = i > 0 ? &vIndex[i - 1] : NULL;
+            index.pnext = i + 1 < KERNEL_CHAIN_LENGTH ? &vIndex[i + 1] : NULL;
+            index.SetStakeModifier(0x1234567890abcdefULL + i, i % 6 == 0);
+            index.phashBlock = &mapBlockIndex.insert(std::make_pair(vHashes[i], &index)).first->first;
+        }
+
+        txPrev.nTime = blockFrom.nTime;
+        txPrev.vin.resize(1);
+        txPrev.vout.resize(1);
+        txPrev.vout[0].nValue = 1000 * COIN;
+        prevout = COutPoint(txPrev.GetHash(), 0);
+    }
+
+    ~CKernelBenchChain()
+    {
+        for (int i = 0; i < KERNEL_CHAIN_LENGTH; i++)
+            mapBlockIndex.erase(vHashes[i]);
+    }
+};
+
+// CheckStakeKernelHash() one timestamp at a time
+static void CheckStakeKernelHashBench(benchmark::State& state)
+{
+    CKernelBenchChain chain;
+    unsigned int nTimeTx = chain.blockFrom.nTime + 30 * 24 * 60 * 60;
+
+    uint256 hashProofOfStake;
+    while (state.KeepRunning())
+    {
+        CheckStakeKernelHash(chain.blockFrom.nBits, chain.blockFrom, 81, chain.txPrev, chain.prevout, nTimeTx, hashProofOfStake);
+        nTimeTx += 16;
+    }
+    if (hashProofOfStake == 0)
+        throw std::runtime_error("CheckStakeKernelHashBench: kernel hash was never computed");
+}
+
+// The 60 timestamps CreateCoinStake tries for a coin, with CStakeKernelSearch;
+// the target is out of reach so every one of them is hashed
+static void StakeKernelSearch60Bench(benchmark::State& state)
+{
+    CKernelBenchChain chain;
+    unsigned int nTimeTx = chain.blockFrom.nTime + 30 * 24 * 60 * 60;
+
+    unsigned int nTimeKernel;
+    uint256 hashProofOfStake;
+    while (state.KeepRunning())
+    {
+        CStakeKernelSearch kernelSearch(0x03000001, chain.blockFrom, 81, chain.txPrev, chain.prevout);
+        if (kernelSearch.Search(nTimeTx, 60, nTimeKernel, hashProofOfStake))
+            throw std::runtime_error("StakeKernelSearch60Bench: kernel found below an unreachable target");
+        nTimeTx += 60;
+    }
+}
+
+BENCHMARK(CheckStakeKernelHashBench);
+BENCHMARK(StakeKernelSearch60Bench);
@@ -0,0 +1,57 @@
+// Copyright (c) 2016 The ECCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "kernel.h"
+#include "main.h"
+
+#include <stdexcept>
+
+static const int MODIFIER_CHAIN_LENGTH = 20000;
+
+// Recompute every stake modifier of a synthetic chain from its genesis, as
+// AddToBlockIndex does block by block: 45 second blocks, two thirds of them
+// proof-of-stake, with the timestamps jittered out of order.
+static void ComputeStakeModifiersBench(benchmark::State& state)
+{
+    std::vector<uint256> vHashes(MODIFIER_CHAIN_LENGTH);
+    std::vector<CBlockIndex> vIndex(MODIFIER_CHAIN_LENGTH);
+    for (int i = 0; i < MODIFIER_CHAIN_LENGTH; i++)
+    {
+        CBlockIndex& index = vIndex[i];
+        vHashes[i] = GetRandHash();
+        index.phashBlock = &vHashes[i];
+        index.pprev = i > 0 ? &vIndex[i - 1] : NULL;
+        index.nHeight = i;
+        index.nTime = 1400000000 + i * 45 + GetRandInt(60) - 30;
+        if (i % 3 != 0)
+        {
+            index.SetProofOfStake();
+            index.hashProofOfStake = GetRandHash();
+        }
+        index.SetStakeEntropyBit(GetRandInt(2));
+        index.BuildSkip();
+    }
+
+    int nGenerated = 0;
+    while (state.KeepRunning())
+    {
+        ClearStakeModifierWindow();
+        for (int i = 0; i < MODIFIER_CHAIN_LENGTH; i++)
+        {
+            uint64_t nStakeModifier;
+            bool fGenerated;
+            if (!ComputeNextStakeModifier(vIndex[i].pprev, nStakeModifier, fGenerated))
+                throw std::runtime_error("ComputeStakeModifiersBench: ComputeNextStakeModifier failed");
+            vIndex[i].SetStakeModifier(nStakeModifier, fGenerated);
+            nGenerated += fGenerated;
+        }
+    }
+    ClearStakeModifierWindow();
+    if (nGenerated == 0)
+        throw std::runtime_error("ComputeStakeModifiersBench: no modifier was generated");
+}
+
+BENCHMARK(ComputeStakeModifiersBench);
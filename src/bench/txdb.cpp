@@ -0,0 +1,104 @@
+// Copyright (c) 2016 The ECCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "main.h"
+#include "txdb-leveldb.h"
+
+#include <stdexcept>
+#include <vector>
+
+static const unsigned int TXDB_KEYS = 20000;
+
+static CTxIndex MakeTxIndex(unsigned int n)
+{
+    // a transaction with two outputs, one of them spent
+    CTxIndex txindex(CDiskTxPos(1, n * 1000, n * 1000 + 81), 2);
+    txindex.vSpent[0] = CDiskTxPos(1, n * 1000 + 5000, n * 1000 + 5100);
+    return txindex;
+}
+
+// Fills the transaction index with TXDB_KEYS entries on first use
+static const std::vector<uint256>& TxDBKeys()
+{
+    static std::vector<uint256> vHashes;
+    if (vHashes.empty())
+    {
+        CTxDB txdb("cr+");
+        txdb.TxnBegin();
+        for (unsigned int i = 0; i < TXDB_KEYS; i++)
+        {
+            vHashes.push_back(GetRandHash());
+            txdb.UpdateTxIndex(vHashes.back(), MakeTxIndex(i));
+        }
+        if (!txdb.TxnCommit())
+            throw std::runtime_error("TxDBKeys: commit failed");
+    }
+    return vHashes;
+}
+
+static void TxDBReadTxIndex(benchmark::State& state)
+{
+    const std::vector<uint256>& vHashes = TxDBKeys();
+    CTxDB txdb("r");
+    CTxIndex txindex;
+    unsigned int n = 0;
+    while (state.KeepRunning())
+    {
+        if (!txdb.ReadTxIndex(vHashes[n++ % vHashes.size()], txindex))
+            throw std::runtime_error("TxDBReadTxIndex: read failed");
+    }
+}
+
+static void TxDBReadTxIndexMissing(benchmark::State& state)
+{
+    TxDBKeys();
+    CTxDB txdb("r");
+    CTxIndex txindex;
+    uint256 hash = GetRandHash();
+    while (state.KeepRunning())
+    {
+        ++hash;
+        txdb.ReadTxIndex(hash, txindex);
+    }
+}
+
+// Unbatched writes, each one a LevelDB Put
+static void TxDBWriteTxIndex(benchmark::State& state)
+{
+    const std::vector<uint256>& vHashes = TxDBKeys();
+    CTxDB txdb("r+");
+    unsigned int n = 0;
+    while (state.KeepRunning())
+    {
+        if (!txdb.UpdateTxIndex(vHashes[n % vHashes.size()], MakeTxIndex(n)))
+            throw std::runtime_error("TxDBWriteTxIndex: write failed");
+        n++;
+    }
+}
+
+// Writes collected in a batch and committed every 1000, as ConnectBlock does
+static void TxDBWriteTxIndexBatch(benchmark::State& state)
+{
+    const std::vector<uint256>& vHashes = TxDBKeys();
+    CTxDB txdb("r+");
+    unsigned int n = 0;
+    txdb.TxnBegin();
+    while (state.KeepRunning())
+    {
+        txdb.UpdateTxIndex(vHashes[n % vHashes.size()], MakeTxIndex(n));
+        if (++n % 1000 == 0)
+        {
+            txdb.TxnCommit();
+            txdb.TxnBegin();
+        }
+    }
+    txdb.TxnCommit();
+}
+
+BENCHMARK(TxDBReadTxIndex);
+BENCHMARK(TxDBReadTxIndexMissing);
+BENCHMARK(TxDBWriteTxIndex);
+BENCHMARK(TxDBWriteTxIndexBatch);
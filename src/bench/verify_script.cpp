@@ -0,0 +1,77 @@
+// Copyright (c) 2016 The ECCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "key.h"
+#include "keystore.h"
+#include "main.h"
+#include "script.h"
+#include "util.h"
+
+#include <stdexcept>
+
+// A pay-to-pubkey-hash output and a signed transaction spending it
+static void MakeSpend(CTransaction& txFrom, CTransaction& txTo)
+{
+    CBasicKeyStore keystore;
+    CKey key;
+    key.MakeNewKey(true);
+    keystore.AddKey(key);
+
+    txFrom.vin.resize(1);
+    txFrom.vout.resize(1);
+    txFrom.vout[0].nValue = 10 * COIN;
+    txFrom.vout[0].scriptPubKey.SetDestination(key.GetPubKey().GetID());
+
+    txTo.vin.resize(1);
+    txTo.vout.resize(1);
+    txTo.vin[0].prevout = COutPoint(txFrom.GetHash(), 0);
+    txTo.vout[0].nValue = 10 * COIN;
+    txTo.vout[0].scriptPubKey = txFrom.vout[0].scriptPubKey;
+    if (!SignSignature(keystore, txFrom, txTo, 0))
+        throw std::runtime_error("MakeSpend(): SignSignature failed");
+}
+
+// Full input check: EvalScript of scriptSig and scriptPubKey with one ECDSA verify
+static void VerifySignatureP2PKH(benchmark::State& state)
+{
+    // every iteration must do the ECDSA work, not hit the signature cache;
+    // signing verifies too, so the cache is off before the spend is made
+    std::string strOldCacheSize = mapArgs["-maxsigcachesize"];
+    mapArgs["-maxsigcachesize"] = "0";
+
+    CTransaction txFrom, txTo;
+    MakeSpend(txFrom, txTo);
+    while (state.KeepRunning())
+    {
+        if (!VerifySignature(txFrom, txTo, 0, true, 0))
+            throw std::runtime_error("VerifySignatureP2PKH: verification failed");
+    }
+    mapArgs["-maxsigcachesize"] = strOldCacheSize;
+}
+
+// Interpreter overhead without signature checks: stack, hashing and arithmetic opcodes
+static void EvalScriptNoSig(benchmark::State& state)
+{
+    CTransaction txTo;
+    txTo.vin.resize(1);
+    txTo.vout.resize(1);
+
+    CScript script;
+    script << std::vector<unsigned char>(32, 0x5a);
+    for (int i = 0; i < 20; i++)
+        script << OP_DUP << OP_HASH160 << OP_DROP << OP_SHA256;
+    script << OP_DROP << OP_1 << OP_2 << OP_ADD << OP_3 << OP_EQUAL;
+
+    while (state.KeepRunning())
+    {
+        std::vector<std::vector<unsigned char> > stack;
+        if (!EvalScript(stack, script, txTo, 0, 0))
+            throw std::runtime_error("EvalScriptNoSig: script failed");
+    }
+}
+
+BENCHMARK(VerifySignatureP2PKH);
+BENCHMARK(EvalScriptNoSig);
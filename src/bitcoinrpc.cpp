@@ -10,6 +10,8 @@
 #include "base58.h"
 #include "bitcoinrpc.h"
 #include "db.h"
+#include "metrics.h"
+#include "walletlog.h"
 
 #undef printf
 #include <boost/asio.hpp>
@@ -232,17 +234,156 @@ Value stop(const Array& params, bool fHelp)
 }
 
 
+Value logging(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() > 2)
+        throw runtime_error(
+            "logging [category] [enable]\n"
+            "Turn a debug log category on or off (default: on) without restarting.\n"
+            "Categories: all, none, " + ListLogCategories() + "\n"
+            "Returns the categories that are enabled afterwards.");
+
+    if (params.size() > 0)
+    {
+        uint32_t nCategory;
+        if (!GetLogCategory(params[0].get_str(), nCategory))
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "unknown logging category " + params[0].get_str());
+
+        bool fEnable = (params.size() > 1 ? params[1].get_bool() : true);
+        if (nCategory == LOG_NONE)
+            nLogCategories = LOG_NONE;
+        else if (fEnable)
+            nLogCategories |= nCategory;
+        else
+            nLogCategories &= ~nCategory;
+    }
+
+    Object ret;
+    uint32_t nCategories = nLogCategories;
+    for (int i = 0; i < 32; i++)
+    {
+        string strName = LogCategoriesToString(1 << i);
+        if (!strName.empty())
+            ret.push_back(Pair(strName, (nCategories & (1 << i)) != 0));
+    }
+    return ret;
+}
+
+
+static bool CompareLockStats(const CLockSiteStats& a, const CLockSiteStats& b, const string& strSort)
+{
+    if (strSort == "wait")
+        return a.nWaitMicros > b.nWaitMicros;
+    if (strSort == "contention")
+        return a.nContended > b.nContended;
+    return a.nHoldMicros > b.nHoldMicros;
+}
+
+Value getlockstats(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() > 2)
+        throw runtime_error(
+            "getlockstats [count=20] [sortby=hold]\n"
+            "Returns the <count> busiest LOCK() call sites, sorted by total hold time,\n"
+            "wait time or number of contended acquisitions (sortby: hold, wait, contention).\n"
+            "Requires a build with USE_LOCKPROFILE=1.");
+
+    unsigned int nCount = 20;
+    if (params.size() > 0)
+    {
+        if (params[0].get_int64() < 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "count must be non-negative");
+        nCount = params[0].get_int64();
+    }
+    string strSort = (params.size() > 1 ? params[1].get_str() : "hold");
+    if (strSort != "hold" && strSort != "wait" && strSort != "contention")
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "unknown sort key " + strSort);
+
+    vector<CLockSiteStats> vStats;
+    if (!GetLockStats(vStats))
+        throw JSONRPCError(RPC_MISC_ERROR, "lock profiling is not compiled in (rebuild with USE_LOCKPROFILE=1)");
+    sort(vStats.begin(), vStats.end(), boost::bind(CompareLockStats, _1, _2, strSort));
+
+    Array ret;
+    for (unsigned int i = 0; i < vStats.size() && i < nCount; i++)
+    {
+        const CLockSiteStats& stats = vStats[i];
+        Object obj;
+        obj.push_back(Pair("lock", stats.strName));
+        obj.push_back(Pair("site", strprintf("%s:%d", stats.strFile.c_str(), stats.nLine)));
+        obj.push_back(Pair("locks", (boost::int64_t)stats.nLocks));
+        obj.push_back(Pair("contended", (boost::int64_t)stats.nContended));
+        obj.push_back(Pair("waitus", (boost::int64_t)stats.nWaitMicros));
+        obj.push_back(Pair("holdus", (boost::int64_t)stats.nHoldMicros));
+        obj.push_back(Pair("maxholdus", (boost::int64_t)stats.nMaxHoldMicros));
+        ret.push_back(obj);
+    }
+    return ret;
+}
+
+
+static string MetricKey(const CMetric& metric)
+{
+    if (metric.strLabelKey.empty())
+        return metric.strName;
+    return metric.strName + "{" + metric.GetLabels() + "}";
+}
+
+Value getmetrics(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getmetrics\n"
+            "Returns the node's performance counters, and for each timed operation the\n"
+            "number of calls, total and average time and the 50th/99th percentile bucket\n"
+            "(milliseconds, -1 = above 10s). With -rpcmetrics the same data is served in\n"
+            "Prometheus text format on GET /metrics of the RPC port.");
+
+    vector<const CMetricCounter*> vCounters;
+    vector<const CMetricLatency*> vLatencies;
+    ListMetrics(vCounters, vLatencies);
+
+    Object counters;
+    BOOST_FOREACH(const CMetricCounter* pcounter, vCounters)
+        counters.push_back(Pair(MetricKey(*pcounter), (boost::int64_t)pcounter->nValue.load()));
+
+    Object latencies;
+    BOOST_FOREACH(const CMetricLatency* platency, vLatencies)
+    {
+        boost::int64_t nCount = platency->nCount.load();
+        boost::int64_t nSumMicros = platency->nSumMicros.load();
+        int64_t nP50 = platency->GetQuantileMicros(0.5);
+        int64_t nP99 = platency->GetQuantileMicros(0.99);
+        Object obj;
+        obj.push_back(Pair("count", nCount));
+        obj.push_back(Pair("totalms", nSumMicros / 1000.0));
+        obj.push_back(Pair("avgms", nCount ? nSumMicros / 1000.0 / nCount : 0.0));
+        obj.push_back(Pair("p50ms", nP50 < 0 ? -1.0 : nP50 / 1000.0));
+        obj.push_back(Pair("p99ms", nP99 < 0 ? -1.0 : nP99 / 1000.0));
+        latencies.push_back(Pair(MetricKey(*platency), obj));
+    }
+
+    Object ret;
+    ret.push_back(Pair("counters", counters));
+    ret.push_back(Pair("latencies", latencies));
+    return ret;
+}
+
+
 
 //
 // Call Table
 //
 
 
-static const CRPCCommand vRPCCommands[] =
+static CRPCCommand vRPCCommands[] =
 { //  name                      function                 safemd  unlocked
   //  ------------------------  -----------------------  ------  --------
     { "help",                   &help,                   true,   true },
     { "stop",                   &stop,                   true,   true },
+    { "logging",                &logging,                true,   true },
+    { "getlockstats",           &getlockstats,           true,   true },
+    { "getmetrics",             &getmetrics,             true,   true },
     { "getbestblockhash",       &getbestblockhash,       true,   false },
     { "getblockcount",          &getblockcount,          true,   false },
     { "getconnectioncount",     &getconnectioncount,     true,   false },
@@ -262,7 +403,7 @@ static const CRPCCommand vRPCCommands[] =
     { "getreceivedbyaccount",   &getreceivedbyaccount,   false,  false },
     { "listreceivedbyaddress",  &listreceivedbyaddress,  false,  false },
     { "listreceivedbyaccount",  &listreceivedbyaccount,  false,  false },
-    { "keypoolrefill",          &keypoolrefill,          true,   false },
+    { "keypoolrefill",          &keypoolrefill,          true,   true },
     { "walletpassphrase",       &walletpassphrase,       true,   false },
     { "walletpassphrasechange", &walletpassphrasechange, false,  false },
     { "walletlock",             &walletlock,             true,   false },
@@ -278,6 +419,8 @@ static const CRPCCommand vRPCCommands[] =
     { "getrawmempool",          &getrawmempool,          true,   false },
     { "getblock",               &getblock,               false,  false },
     { "getblockbynumber",       &getblockbynumber,       false,  false },
+    { "getblockstats",          &getblockstats,          false,  false },
+    { "getchaintxstats",        &getchaintxstats,        false,  false },
     { "getblockhash",           &getblockhash,           false,  false },
     { "gettransaction",         &gettransaction,         false,  false },
     { "listtransactions",       &listtransactions,       false,  false },
@@ -297,6 +440,10 @@ static const CRPCCommand vRPCCommands[] =
     { "importprivkey",          &importprivkey,          false,  false },
     { "listunspent",            &listunspent,            false,  false },
     { "getrawtransaction",      &getrawtransaction,      false,  false },
+    { "getaddresshistory",      &getaddresshistory,      true,   false },
+    { "getaddressbalance",      &getaddressbalance,      true,   false },
+    { "getaddressutxos",        &getaddressutxos,        true,   false },
+    { "getspentinfo",           &getspentinfo,           true,   false },
     { "createrawtransaction",   &createrawtransaction,   false,  false },
     { "decoderawtransaction",   &decoderawtransaction,   false,  false },
     { "decodescript",           &decodescript,           false,  false },
@@ -314,9 +461,10 @@ CRPCTable::CRPCTable()
     unsigned int vcidx;
     for (vcidx = 0; vcidx < (sizeof(vRPCCommands) / sizeof(vRPCCommands[0])); vcidx++)
     {
-        const CRPCCommand *pcmd;
+        CRPCCommand *pcmd;
 
         pcmd = &vRPCCommands[vcidx];
+        pcmd->pmetric = &GetMetricLatency("eccoin_rpc_seconds", "Time to execute an RPC call", "method", pcmd->name);
         mapCommands[pcmd->name] = pcmd;
     }
 }
@@ -366,7 +514,7 @@ string rfc1123Time()
     return string(buffer);
 }
 
-static string HTTPReply(int nStatus, const string& strMsg, bool keepalive)
+static string HTTPReply(int nStatus, const string& strMsg, bool keepalive, const char* pszContentType = "application/json")
 {
     if (nStatus == HTTP_UNAUTHORIZED)
         return strprintf("HTTP/1.0 401 Authorization Required\r\n"
@@ -397,7 +545,7 @@ static string HTTPReply(int nStatus, const string& strMsg, bool keepalive)
             "Date: %s\r\n"
             "Connection: %s\r\n"
             "Content-Length: %" PRIszu "\r\n"
-            "Content-Type: application/json\r\n"
+            "Content-Type: %s\r\n"
             "Server: ECCoin-json-rpc/%s\r\n"
             "\r\n"
             "%s",
@@ -406,6 +554,7 @@ static string HTTPReply(int nStatus, const string& strMsg, bool keepalive)
         rfc1123Time().c_str(),
         keepalive ? "keep-alive" : "close",
         strMsg.size(),
+        pszContentType,
         FormatFullVersion().c_str(),
         strMsg.c_str());
 }
@@ -450,15 +599,28 @@ int ReadHTTPHeader(std::basic_istream<char>& stream, map<string, string>& mapHea
     return nLen;
 }
 
-int ReadHTTP(std::basic_istream<char>& stream, map<string, string>& mapHeadersRet, string& strMessageRet)
+int ReadHTTPRequestLine(std::basic_istream<char>& stream, int &proto, string& strVerbRet, string& strPathRet)
+{
+    string str;
+    getline(stream, str);
+    vector<string> vWords;
+    boost::split(vWords, str, boost::is_any_of(" "));
+    if (vWords.size() < 2)
+        return HTTP_BAD_REQUEST;
+    strVerbRet = vWords[0];
+    strPathRet = vWords[1];
+    proto = 0;
+    const char *ver = strstr(str.c_str(), "HTTP/1.");
+    if (ver != NULL)
+        proto = atoi(ver+7);
+    return HTTP_OK;
+}
+
+int ReadHTTPMessage(std::basic_istream<char>& stream, map<string, string>& mapHeadersRet, string& strMessageRet, int nProto)
 {
     mapHeadersRet.clear();
     strMessageRet = "";
 
-    // Read status
-    int nProto = 0;
-    int nStatus = ReadHTTPStatus(stream, nProto);
-
     // Read header
     int nLen = ReadHTTPHeader(stream, mapHeadersRet);
     if (nLen < 0 || nLen > (int)MAX_SIZE)
@@ -482,6 +644,20 @@ int ReadHTTP(std::basic_istream<char>& stream, map<string, string>& mapHeadersRe
             mapHeadersRet["connection"] = "close";
     }
 
+    return HTTP_OK;
+}
+
+int ReadHTTP(std::basic_istream<char>& stream, map<string, string>& mapHeadersRet, string& strMessageRet)
+{
+    // Read status
+    int nProto = 0;
+    int nStatus = ReadHTTPStatus(stream, nProto);
+
+    // Read header and message
+    int nRet = ReadHTTPMessage(stream, mapHeadersRet, strMessageRet, nProto);
+    if (nRet != HTTP_OK)
+        return nRet;
+
     return nStatus;
 }
 
@@ -996,8 +1172,15 @@ void ThreadRPCServer3(void* parg)
         }
         map<string, string> mapHeaders;
         string strRequest;
+        string strVerb, strPath;
+        int nProto = 0;
 
-        ReadHTTP(conn->stream(), mapHeaders, strRequest);
+        if (ReadHTTPRequestLine(conn->stream(), nProto, strVerb, strPath) != HTTP_OK)
+        {
+            conn->stream() << HTTPReply(HTTP_BAD_REQUEST, "", false) << std::flush;
+            break;
+        }
+        ReadHTTPMessage(conn->stream(), mapHeaders, strRequest, nProto);
 
         // Check authorization
         if (mapHeaders.count("authorization") == 0)
@@ -1020,6 +1203,13 @@ void ThreadRPCServer3(void* parg)
         if (mapHeaders["connection"] == "close")
             fRun = false;
 
+        // Prometheus scrape, behind the same authorization as JSON-RPC
+        if (strVerb == "GET" && strPath == "/metrics" && GetBoolArg("-rpcmetrics"))
+        {
+            conn->stream() << HTTPReply(HTTP_OK, MetricsToPrometheus(), fRun, "text/plain; version=0.0.4") << std::flush;
+            continue;
+        }
+
         JSONRequest jreq;
         try
         {
@@ -1081,12 +1271,16 @@ json_spirit::Value CRPCTable::execute(const std::string &strMethod, const json_s
 
     try
     {
+        CMetricTimer timer(*pcmd->pmetric);
+
         // Execute
         Value result;
         {
             if (pcmd->unlocked)
                 result = pcmd->actor(params, false);
             else {
+                // the wallet log is synced once the locks are let go
+                CWalletLogGroupCommit groupCommit;
                 LOCK2(cs_main, pwalletMain->cs_wallet);
                 result = pcmd->actor(params, false);
             }
@@ -1188,6 +1382,8 @@ Array RPCConvertValues(const std::string &strMethod, const std::vector<std::stri
     // Special case non-string parameter types
     //
     if (strMethod == "stop"                   && n > 0) ConvertTo<bool>(params[0]);
+    if (strMethod == "logging"                && n > 1) ConvertTo<bool>(params[1]);
+    if (strMethod == "getlockstats"           && n > 0) ConvertTo<boost::int64_t>(params[0]);
     if (strMethod == "sendtoaddress"          && n > 1) ConvertTo<double>(params[1]);
     if (strMethod == "settxfee"               && n > 0) ConvertTo<double>(params[0]);
     if (strMethod == "getreceivedbyaddress"   && n > 1) ConvertTo<boost::int64_t>(params[1]);
@@ -1200,6 +1396,9 @@ Array RPCConvertValues(const std::string &strMethod, const std::vector<std::stri
     if (strMethod == "getblock"               && n > 1) ConvertTo<bool>(params[1]);
     if (strMethod == "getblockbynumber"       && n > 0) ConvertTo<boost::int64_t>(params[0]);
     if (strMethod == "getblockbynumber"       && n > 1) ConvertTo<bool>(params[1]);
+    if (strMethod == "getblockstats"          && n > 0) ConvertTo<boost::int64_t>(params[0]);
+    if (strMethod == "getblockstats"          && n > 1) ConvertTo<boost::int64_t>(params[1]);
+    if (strMethod == "getchaintxstats"        && n > 0) ConvertTo<boost::int64_t>(params[0]);
     if (strMethod == "getblockhash"           && n > 0) ConvertTo<boost::int64_t>(params[0]);
     if (strMethod == "move"                   && n > 2) ConvertTo<double>(params[2]);
     if (strMethod == "move"                   && n > 3) ConvertTo<boost::int64_t>(params[3]);
@@ -1223,6 +1422,11 @@ Array RPCConvertValues(const std::string &strMethod, const std::vector<std::stri
     if (strMethod == "listunspent"            && n > 1) ConvertTo<boost::int64_t>(params[1]);
     if (strMethod == "listunspent"            && n > 2) ConvertTo<Array>(params[2]);
     if (strMethod == "getrawtransaction"      && n > 1) ConvertTo<boost::int64_t>(params[1]);
+    if (strMethod == "getaddresshistory"      && n > 1) ConvertTo<boost::int64_t>(params[1]);
+    if (strMethod == "getaddresshistory"      && n > 2) ConvertTo<boost::int64_t>(params[2]);
+    if (strMethod == "getaddressutxos"        && n > 1) ConvertTo<boost::int64_t>(params[1]);
+    if (strMethod == "getaddressutxos"        && n > 2) ConvertTo<boost::int64_t>(params[2]);
+    if (strMethod == "getspentinfo"           && n > 1) ConvertTo<boost::int64_t>(params[1]);
     if (strMethod == "createrawtransaction"   && n > 0) ConvertTo<Array>(params[0]);
     if (strMethod == "createrawtransaction"   && n > 1) ConvertTo<Object>(params[1]);
     if (strMethod == "signrawtransaction"     && n > 1) ConvertTo<Array>(params[1], true);
@@ -231,7 +231,7 @@ void CDBEnv::CheckpointLSN(std::string strFile)
 
 
 CDB::CDB(const char *pszFile, const char* pszMode) :
-    pdb(NULL), activeTxn(NULL)
+    pdb(NULL), activeTxn(NULL), plog(NULL), plogTxn(NULL)
 {
     int ret;
     if (pszFile == NULL)
@@ -243,6 +243,22 @@ CDB::CDB(const char *pszFile, const char* pszMode) :
     if (fCreate)
         nFlags |= DB_CREATE;
 
+    if (fWalletLog)
+    {
+        strFile = pszFile;
+        plog = OpenWalletLog(strFile, fCreate);
+        if (!plog)
+            throw runtime_error(strprintf("CDB() : can't open wallet log %s", GetWalletLogPath(strFile).string().c_str()));
+        if (fCreate && !Exists(string("version")))
+        {
+            bool fTmp = fReadOnly;
+            fReadOnly = false;
+            WriteVersion(CLIENT_VERSION);
+            fReadOnly = fTmp;
+        }
+        return;
+    }
+
     {
         LOCK(bitdb.cs_db);
         if (!bitdb.Open(GetDataDir()))
@@ -303,6 +319,16 @@ static bool IsChainFile(std::string strFile)
 
 void CDB::Close()
 {
+    if (plog)
+    {
+        // the log is shared and stays open, each commit is already on disk
+        if (plogTxn)
+            plog->Abort(*plogTxn);
+        delete plogTxn;
+        plogTxn = NULL;
+        plog = NULL;
+        return;
+    }
     if (!pdb)
         return;
     if (activeTxn)
@@ -353,6 +379,12 @@ bool CDBEnv::RemoveDb(const string& strFile)
 
 bool CDB::Rewrite(const string& strFile, const char* pszSkip)
 {
+    if (fWalletLog)
+    {
+        CWalletLog* plog = OpenWalletLog(strFile, false);
+        return plog && plog->Compact(pszSkip);
+    }
+
     while (!fShutdown)
     {
         {
@@ -383,7 +415,7 @@ bool CDB::Rewrite(const string& strFile, const char* pszSkip)
                         fSuccess = false;
                     }
 
-                    Dbc* pcursor = db.GetCursor();
+                    CDBCursor* pcursor = db.GetCursor();
                     if (pcursor)
                         while (fSuccess)
                         {
@@ -451,6 +483,8 @@ void CDBEnv::Flush(bool fShutdown)
     // Flush log data to the actual data file
     //  on all files that are not in use
     printf("Flush(%s)%s\n", fShutdown ? "true" : "false", fDbEnvInit ? "" : " db not started");
+    if (fShutdown)
+        CloseWalletLogs();
     if (!fDbEnvInit)
         return;
     {
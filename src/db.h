@@ -6,6 +6,7 @@
 #define BITCOIN_DB_H
 
 #include "main.h"
+#include "walletlog.h"
 
 #include <map>
 #include <string>
@@ -92,7 +93,31 @@ public:
 extern CDBEnv bitdb;
 
 
-/** RAII class that provides access to a Berkeley database */
+/** Cursor over a database file: a Berkeley DB cursor, or a walk through the
+ * records of a wallet log in key order */
+class CDBCursor
+{
+public:
+    Dbc* pcursor;
+    CWalletLog* plog;
+    CWalletLogBytes vchKey;     // last key returned from the log
+    bool fStarted;
+
+    explicit CDBCursor(Dbc* pcursorIn) : pcursor(pcursorIn), plog(NULL), fStarted(false) {}
+    explicit CDBCursor(CWalletLog* plogIn) : pcursor(NULL), plog(plogIn), fStarted(false) {}
+
+    /** Close and free the cursor, like Dbc::close */
+    void close()
+    {
+        if (pcursor)
+            pcursor->close();
+        delete this;
+    }
+};
+
+
+/** RAII class that provides access to a Berkeley database, or to a wallet log
+ * when -walletlog is set */
 class CDB
 {
 protected:
@@ -100,6 +125,8 @@ protected:
     std::string strFile;
     DbTxn *activeTxn;
     bool fReadOnly;
+    CWalletLog* plog;
+    CWalletLogTxn* plogTxn;
 
     explicit CDB(const char* pszFile, const char* pszMode="r+");
     ~CDB() { Close(); }
@@ -113,13 +140,28 @@ protected:
     template<typename K, typename T>
     bool Read(const K& key, T& value)
     {
-        if (!pdb)
+        if (!pdb && !plog)
             return false;
 
         // Key
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+
+        if (plog)
+        {
+            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+            if (!plog->Read(ssKey, ssValue))
+                return false;
+            try {
+                ssValue >> value;
+            }
+            catch (std::exception &e) {
+                return false;
+            }
+            return true;
+        }
+
         Dbt datKey(&ssKey[0], ssKey.size());
 
         // Read
@@ -148,7 +190,7 @@ protected:
     template<typename K, typename T>
     bool Write(const K& key, const T& value, bool fOverwrite=true)
     {
-        if (!pdb)
+        if (!pdb && !plog)
             return false;
         if (fReadOnly)
             assert(!"Write called on database in read-only mode");
@@ -163,6 +205,8 @@ protected:
         CDataStream ssValue(SER_DISK, CLIENT_VERSION);
         ssValue.reserve(10000);
         ssValue << value;
+        if (plog)
+            return plog->Write(ssKey, ssValue, fOverwrite, plogTxn);
         Dbt datValue(&ssValue[0], ssValue.size());
 
         // Write
@@ -177,7 +221,7 @@ protected:
     template<typename K>
     bool Erase(const K& key)
     {
-        if (!pdb)
+        if (!pdb && !plog)
             return false;
         if (fReadOnly)
             assert(!"Erase called on database in read-only mode");
@@ -186,6 +230,8 @@ protected:
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+        if (plog)
+            return plog->Erase(ssKey, plogTxn);
         Dbt datKey(&ssKey[0], ssKey.size());
 
         // Erase
@@ -199,13 +245,15 @@ protected:
     template<typename K>
     bool Exists(const K& key)
     {
-        if (!pdb)
+        if (!pdb && !plog)
             return false;
 
         // Key
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+        if (plog)
+            return plog->Exists(ssKey);
         Dbt datKey(&ssKey[0], ssKey.size());
 
         // Exists
@@ -216,19 +264,24 @@ protected:
         return (ret == 0);
     }
 
-    Dbc* GetCursor()
+    CDBCursor* GetCursor()
     {
+        if (plog)
+            return new CDBCursor(plog);
         if (!pdb)
             return NULL;
         Dbc* pcursor = NULL;
         int ret = pdb->cursor(NULL, &pcursor, 0);
         if (ret != 0)
             return NULL;
-        return pcursor;
+        return new CDBCursor(pcursor);
     }
 
-    int ReadAtCursor(Dbc* pcursor, CDataStream& ssKey, CDataStream& ssValue, unsigned int fFlags=DB_NEXT)
+    int ReadAtCursor(CDBCursor* pcursor, CDataStream& ssKey, CDataStream& ssValue, unsigned int fFlags=DB_NEXT)
     {
+        if (pcursor->plog)
+            return ReadAtLogCursor(pcursor, ssKey, ssValue, fFlags);
+
         // Read at cursor
         Dbt datKey;
         if (fFlags == DB_SET || fFlags == DB_SET_RANGE || fFlags == DB_GET_BOTH || fFlags == DB_GET_BOTH_RANGE)
@@ -244,7 +297,7 @@ protected:
         }
         datKey.set_flags(DB_DBT_MALLOC);
         datValue.set_flags(DB_DBT_MALLOC);
-        int ret = pcursor->get(&datKey, &datValue, fFlags);
+        int ret = pcursor->pcursor->get(&datKey, &datValue, fFlags);
         if (ret != 0)
             return ret;
         else if (datKey.get_data() == NULL || datValue.get_data() == NULL)
@@ -266,9 +319,41 @@ protected:
         return 0;
     }
 
+    int ReadAtLogCursor(CDBCursor* pcursor, CDataStream& ssKey, CDataStream& ssValue, unsigned int fFlags)
+    {
+        CWalletLogBytes vchKey, vchValue;
+        bool fFound;
+        if (fFlags == DB_SET_RANGE)
+            fFound = pcursor->plog->Seek(CWalletLogBytes(ssKey.begin(), ssKey.end()), false, vchKey, vchValue);
+        else if (fFlags == DB_NEXT)
+            fFound = pcursor->plog->Seek(pcursor->vchKey, pcursor->fStarted, vchKey, vchValue);
+        else
+            return 99999;
+        if (!fFound)
+            return DB_NOTFOUND;
+        pcursor->vchKey = vchKey;
+        pcursor->fStarted = true;
+
+        ssKey.SetType(SER_DISK);
+        ssKey.clear();
+        ssKey.write(&vchKey[0], vchKey.size());
+        ssValue.SetType(SER_DISK);
+        ssValue.clear();
+        if (!vchValue.empty())
+            ssValue.write(&vchValue[0], vchValue.size());
+        return 0;
+    }
+
 public:
     bool TxnBegin()
     {
+        if (plog)
+        {
+            if (plogTxn)
+                return false;
+            plogTxn = new CWalletLogTxn();
+            return true;
+        }
         if (!pdb || activeTxn)
             return false;
         DbTxn* ptxn = bitdb.TxnBegin();
@@ -280,6 +365,15 @@ public:
 
     bool TxnCommit()
     {
+        if (plog)
+        {
+            if (!plogTxn)
+                return false;
+            bool fOk = plog->Commit(*plogTxn);
+            delete plogTxn;
+            plogTxn = NULL;
+            return fOk;
+        }
         if (!pdb || !activeTxn)
             return false;
         int ret = activeTxn->commit(0);
@@ -289,6 +383,15 @@ public:
 
     bool TxnAbort()
     {
+        if (plog)
+        {
+            if (!plogTxn)
+                return false;
+            plog->Abort(*plogTxn);
+            delete plogTxn;
+            plogTxn = NULL;
+            return true;
+        }
         if (!pdb || !activeTxn)
             return false;
         int ret = activeTxn->abort();
@@ -0,0 +1,230 @@
+// Copyright (c) 2016 The ECCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "explorer.h"
+#include "bitcoinrpc.h"
+
+#include <deque>
+#include <map>
+
+#include <boost/thread.hpp>
+
+using namespace std;
+
+static const unsigned int MAX_BLOCK_SUMMARIES = 5000;
+static const unsigned int MAX_EXPLORER_TXS = 1000;
+
+/** Bounded map from hash to value that forgets the oldest entry first */
+template <typename T>
+class CExplorerCache
+{
+private:
+    map<uint256, T> mapEntries;
+    deque<uint256> dequeOrder;
+    unsigned int nMaxSize;
+
+public:
+    CExplorerCache(unsigned int nMaxSizeIn) : nMaxSize(nMaxSizeIn) {}
+
+    bool Get(const uint256& hash, T& value) const
+    {
+        typename map<uint256, T>::const_iterator mi = mapEntries.find(hash);
+        if (mi == mapEntries.end())
+            return false;
+        value = mi->second;
+        return true;
+    }
+
+    void Put(const uint256& hash, const T& value)
+    {
+        pair<typename map<uint256, T>::iterator, bool> ret = mapEntries.insert(make_pair(hash, value));
+        if (!ret.second)
+        {
+            ret.first->second = value;
+            return;
+        }
+        dequeOrder.push_back(hash);
+        if (dequeOrder.size() > nMaxSize)
+        {
+            mapEntries.erase(dequeOrder.front());
+            dequeOrder.pop_front();
+        }
+    }
+};
+
+static boost::mutex csExplorerCache;
+static CExplorerCache<CBlockSummary> cacheBlockSummaries(MAX_BLOCK_SUMMARIES);
+static CExplorerCache<CExplorerTx> cacheExplorerTxs(MAX_EXPLORER_TXS);
+
+static boost::mutex csExplorerQueue;
+static boost::condition_variable condExplorerQueue;
+static deque<pair<uint256, ExplorerTxCallback> > dequeExplorerQueue;
+static bool fExplorerRunning = false;
+static bool fExplorerStop = false;
+
+bool CExplorerTx::HasAllInputs() const
+{
+    if (tx.IsCoinBase())
+        return false;
+    BOOST_FOREACH(const CTxOut& txout, vPrevOut)
+        if (txout.IsNull())
+            return false;
+    return true;
+}
+
+int64_t CExplorerTx::GetValueIn() const
+{
+    int64_t nValueIn = 0;
+    BOOST_FOREACH(const CTxOut& txout, vPrevOut)
+        if (!txout.IsNull())
+            nValueIn += txout.nValue;
+    return nValueIn;
+}
+
+int64_t CExplorerTx::GetFee() const
+{
+    if (!HasAllInputs())
+        return 0;
+    return GetValueIn() - tx.GetValueOut();
+}
+
+bool GetBlockSummary(int nHeight, CBlockSummary& summary)
+{
+    CBlockIndex* pindex;
+    {
+        LOCK(cs_main);
+        pindex = FindBlockByHeight(nHeight);
+    }
+    if (pindex == NULL)
+        return false;
+
+    uint256 hash = pindex->GetBlockHash();
+    {
+        boost::mutex::scoped_lock lock(csExplorerCache);
+        if (cacheBlockSummaries.Get(hash, summary))
+            return true;
+    }
+
+    // Block index entries are never freed or moved, so the read needs no lock
+    CBlock block;
+    if (!block.ReadFromDisk(pindex, true))
+        return error("GetBlockSummary() : ReadFromDisk failed for block %s", hash.ToString().c_str());
+
+    CBlockSummary summaryNew;
+    summaryNew.hash = hash;
+    summaryNew.hashMerkleRoot = pindex->hashMerkleRoot;
+    summaryNew.nHeight = pindex->nHeight;
+    summaryNew.nTime = pindex->GetBlockTime();
+    summaryNew.nBits = pindex->nBits;
+    summaryNew.nNonce = pindex->nNonce;
+    summaryNew.dDifficulty = GetDifficulty(pindex);
+    summaryNew.fProofOfStake = pindex->IsProofOfStake();
+    summaryNew.nMint = pindex->nMint;
+    summaryNew.nMoneySupply = pindex->nMoneySupply;
+    summaryNew.nTx = block.vtx.size();
+    summaryNew.nSize = ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_FOREACH(const CTransaction& tx, block.vtx)
+        summaryNew.nValueOut += tx.GetValueOut();
+
+    {
+        boost::mutex::scoped_lock lock(csExplorerCache);
+        cacheBlockSummaries.Put(hash, summaryNew);
+    }
+    summary = summaryNew;
+    return true;
+}
+
+bool GetCachedExplorerTx(const uint256& hash, CExplorerTx& etx)
+{
+    boost::mutex::scoped_lock lock(csExplorerCache);
+    return cacheExplorerTxs.Get(hash, etx);
+}
+
+bool GetExplorerTx(const uint256& hash, CExplorerTx& etx)
+{
+    // A memory pool transaction is looked up again so that it picks up its block
+    if (GetCachedExplorerTx(hash, etx) && etx.hashBlock != 0)
+        return true;
+
+    CExplorerTx etxNew;
+    if (!GetTransaction(hash, etxNew.tx, etxNew.hashBlock))
+        return false;
+
+    // Inputs often spend several outputs of the same transaction
+    etxNew.vPrevOut.resize(etxNew.tx.vin.size());
+    map<uint256, CTransaction> mapPrev;
+    for (unsigned int i = 0; i < etxNew.tx.vin.size() && !etxNew.tx.IsCoinBase(); i++)
+    {
+        const COutPoint& prevout = etxNew.tx.vin[i].prevout;
+        map<uint256, CTransaction>::iterator mi = mapPrev.find(prevout.hash);
+        if (mi == mapPrev.end())
+        {
+            CTransaction txPrev;
+            uint256 hashBlockPrev = 0;
+            if (!GetTransaction(prevout.hash, txPrev, hashBlockPrev))
+                continue;
+            mi = mapPrev.insert(make_pair(prevout.hash, txPrev)).first;
+        }
+        if (prevout.n < mi->second.vout.size())
+            etxNew.vPrevOut[i] = mi->second.vout[prevout.n];
+    }
+
+    {
+        boost::mutex::scoped_lock lock(csExplorerCache);
+        cacheExplorerTxs.Put(hash, etxNew);
+    }
+    etx = etxNew;
+    return true;
+}
+
+static void ThreadExplorer(void* parg)
+{
+    RenameThread("ECCoin-explorer");
+
+    boost::unique_lock<boost::mutex> lock(csExplorerQueue);
+    while (true)
+    {
+        while (!fExplorerStop && dequeExplorerQueue.empty())
+            condExplorerQueue.wait(lock);
+        if (fExplorerStop)
+            break;
+        pair<uint256, ExplorerTxCallback> item = dequeExplorerQueue.front();
+        dequeExplorerQueue.pop_front();
+        lock.unlock();
+        CExplorerTx etx;
+        bool fFound = GetExplorerTx(item.first, etx);
+        item.second(item.first, fFound);
+        lock.lock();
+    }
+    fExplorerRunning = false;
+    condExplorerQueue.notify_all();
+}
+
+void ResolveExplorerTx(const uint256& hash, const ExplorerTxCallback& callback)
+{
+    boost::unique_lock<boost::mutex> lock(csExplorerQueue);
+    if (fExplorerStop)
+        return;
+    if (!fExplorerRunning)
+    {
+        if (!NewThread(ThreadExplorer, NULL))
+        {
+            printf("Error: NewThread(ThreadExplorer) failed\n");
+            return;
+        }
+        fExplorerRunning = true;
+    }
+    dequeExplorerQueue.push_back(make_pair(hash, callback));
+    condExplorerQueue.notify_one();
+}
+
+void StopExplorer()
+{
+    boost::unique_lock<boost::mutex> lock(csExplorerQueue);
+    fExplorerStop = true;
+    dequeExplorerQueue.clear();
+    condExplorerQueue.notify_all();
+    while (fExplorerRunning)
+        condExplorerQueue.wait(lock);
+}
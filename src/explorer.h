@@ -0,0 +1,81 @@
+// Copyright (c) 2016 The ECCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_EXPLORER_H
+#define BITCOIN_EXPLORER_H
+
+#include "main.h"
+
+#include <vector>
+
+#include <boost/function.hpp>
+
+/** Header fields and totals of a best-chain block, as shown by explorer views */
+class CBlockSummary
+{
+public:
+    uint256 hash;
+    uint256 hashMerkleRoot;
+    int nHeight;
+    int64_t nTime;
+    unsigned int nBits;
+    unsigned int nNonce;
+    double dDifficulty;
+    bool fProofOfStake;
+    int64_t nMint;
+    int64_t nMoneySupply;
+    unsigned int nTx;
+    unsigned int nSize;
+    int64_t nValueOut;
+
+    CBlockSummary()
+    {
+        nHeight = -1;
+        nTime = 0;
+        nBits = 0;
+        nNonce = 0;
+        dDifficulty = 0;
+        fProofOfStake = false;
+        nMint = 0;
+        nMoneySupply = 0;
+        nTx = 0;
+        nSize = 0;
+        nValueOut = 0;
+    }
+};
+
+/** A transaction together with the outputs spent by its inputs */
+class CExplorerTx
+{
+public:
+    CTransaction tx;
+    uint256 hashBlock;
+    /** One per input; null for coinbase inputs and previous outputs that could not be read */
+    std::vector<CTxOut> vPrevOut;
+
+    bool HasAllInputs() const;
+    int64_t GetValueIn() const;
+    /** Inputs minus outputs; zero unless every input was resolved */
+    int64_t GetFee() const;
+};
+
+/** Called on the explorer thread once a transaction has been looked up */
+typedef boost::function<void (const uint256& hash, bool fFound)> ExplorerTxCallback;
+
+/** Summary of the best-chain block at nHeight. The block is read from disk
+ * once and the summary cached by block hash, so it stays right across a
+ * reorganisation. */
+bool GetBlockSummary(int nHeight, CBlockSummary& summary);
+
+/** Look up a transaction and its previous outputs on the calling thread */
+bool GetExplorerTx(const uint256& hash, CExplorerTx& etx);
+/** Only answer from the cache; never touches the disk */
+bool GetCachedExplorerTx(const uint256& hash, CExplorerTx& etx);
+/** Queue a lookup on the explorer thread, for callers that must not block
+ * (the GUI). The callback runs on that thread; on success the result is
+ * waiting in the cache. */
+void ResolveExplorerTx(const uint256& hash, const ExplorerTxCallback& callback);
+
+void StopExplorer();
+
+#endif
@@ -1,5 +1,68 @@
 #include "hash.h"
 
+static inline void WriteBE32(unsigned char* p, uint32_t x)
+{
+    p[0] = x >> 24;
+    p[1] = x >> 16;
+    p[2] = x >> 8;
+    p[3] = x;
+}
+
+void CHashWriter::WriteBlocks(const unsigned char* pch, size_t size)
+{
+    nBytes += size;
+    if (nBuf)
+    {
+        // complete the staged block first
+        size_t nFill = sizeof(buf) - nBuf;
+        memcpy(buf + nBuf, pch, nFill);
+        SHA256_Transform(&ctx, buf);
+        pch += nFill;
+        size -= nFill;
+        nBuf = 0;
+    }
+    while (size >= sizeof(buf))
+    {
+        SHA256_Transform(&ctx, pch);
+        pch += sizeof(buf);
+        size -= sizeof(buf);
+    }
+    memcpy(buf, pch, size);
+    nBuf = size;
+}
+
+uint256 CHashWriter::GetHash()
+{
+    // SHA256 padding: 0x80, zeros, then the message length in bits
+    uint64_t nBits = nBytes << 3;
+    buf[nBuf++] = 0x80;
+    if (nBuf > 56)
+    {
+        memset(buf + nBuf, 0, sizeof(buf) - nBuf);
+        SHA256_Transform(&ctx, buf);
+        nBuf = 0;
+    }
+    memset(buf + nBuf, 0, 56 - nBuf);
+    WriteBE32(buf + 56, nBits >> 32);
+    WriteBE32(buf + 60, nBits);
+    SHA256_Transform(&ctx, buf);
+
+    // the second pass over the 32 byte digest is always exactly one block
+    for (int i = 0; i < 8; i++)
+        WriteBE32(buf + 4 * i, ctx.h[i]);
+    memset(buf + 32, 0, 32);
+    buf[32] = 0x80;
+    buf[62] = 0x01; // 256 bits
+    SHA256_Init(&ctx);
+    SHA256_Transform(&ctx, buf);
+
+    uint256 hash;
+    for (int i = 0; i < 8; i++)
+        WriteBE32((unsigned char*)&hash + 4 * i, ctx.h[i]);
+    nBuf = 0;
+    return hash;
+}
+
 inline uint32_t ROTL32 ( uint32_t x, int8_t r )
 {
     return (x << r) | (x >> (32 - r));
@@ -12,114 +12,113 @@
 #include <openssl/ripemd.h>
 #include <vector>
 
-//template<typename T1>
-//inline uint256 Hash(const T1 pbegin, const T1 pend)
-//{
-//    static unsigned char pblank[1];
-//    uint256 hash1;
-//    SHA256((pbegin == pend ? pblank : (unsigned char*)&pbegin[0]), (pend - pbegin) * sizeof(pbegin[0]), (unsigned char*)&hash1);
-//    uint256 hash2;
-//    SHA256((unsigned char*)&hash1, sizeof(hash1), (unsigned char*)&hash2);
-//    return hash2;
-//}
-
-//class CHashWriter
-//{
-//private:
-//    SHA256_CTX ctx;
-
-//public:
-//    int nType;
-//    int nVersion;
-
-//    void Init() {
-//        SHA256_Init(&ctx);
-//    }
-
-//    CHashWriter(int nTypeIn, int nVersionIn) : nType(nTypeIn), nVersion(nVersionIn) {
-//        Init();
-//    }
-
-//    CHashWriter& write(const char *pch, size_t size) {
-//        SHA256_Update(&ctx, pch, size);
-//        return (*this);
-//    }
-
-//    // invalidates the object
-//    uint256 GetHash() {
-//        uint256 hash1;
-//        SHA256_Final((unsigned char*)&hash1, &ctx);
-//        uint256 hash2;
-//        SHA256((unsigned char*)&hash1, sizeof(hash1), (unsigned char*)&hash2);
-//        return hash2;
-//    }
-
-//    template<typename T>
-//    CHashWriter& operator<<(const T& obj) {
-//        // Serialize to this stream
-//        ::Serialize(*this, obj, nType, nVersion);
-//        return (*this);
-//    }
-//};
-
-
-//template<typename T1, typename T2>
-//inline uint256 Hash(const T1 p1begin, const T1 p1end,
-//                    const T2 p2begin, const T2 p2end)
-//{
-//    static unsigned char pblank[1];
-//    uint256 hash1;
-//    SHA256_CTX ctx;
-//    SHA256_Init(&ctx);
-//    SHA256_Update(&ctx, (p1begin == p1end ? pblank : (unsigned char*)&p1begin[0]), (p1end - p1begin) * sizeof(p1begin[0]));
-//    SHA256_Update(&ctx, (p2begin == p2end ? pblank : (unsigned char*)&p2begin[0]), (p2end - p2begin) * sizeof(p2begin[0]));
-//    SHA256_Final((unsigned char*)&hash1, &ctx);
-//    uint256 hash2;
-//    SHA256((unsigned char*)&hash1, sizeof(hash1), (unsigned char*)&hash2);
-//    return hash2;
-//}
-
-//template<typename T1, typename T2, typename T3>
-//inline uint256 Hash(const T1 p1begin, const T1 p1end,
-//                    const T2 p2begin, const T2 p2end,
-//                    const T3 p3begin, const T3 p3end)
-//{
-//    static unsigned char pblank[1];
-//    uint256 hash1;
-//    SHA256_CTX ctx;
-//    SHA256_Init(&ctx);
-//    SHA256_Update(&ctx, (p1begin == p1end ? pblank : (unsigned char*)&p1begin[0]), (p1end - p1begin) * sizeof(p1begin[0]));
-//    SHA256_Update(&ctx, (p2begin == p2end ? pblank : (unsigned char*)&p2begin[0]), (p2end - p2begin) * sizeof(p2begin[0]));
-//    SHA256_Update(&ctx, (p3begin == p3end ? pblank : (unsigned char*)&p3begin[0]), (p3end - p3begin) * sizeof(p3begin[0]));
-//    SHA256_Final((unsigned char*)&hash1, &ctx);
-//    uint256 hash2;
-//    SHA256((unsigned char*)&hash1, sizeof(hash1), (unsigned char*)&hash2);
-//    return hash2;
-//}
-
-//template<typename T>
-//uint256 SerializeHash(const T& obj, int nType=SER_GETHASH, int nVersion=PROTOCOL_VERSION)
-//{
-//    CHashWriter ss(nType, nVersion);
-//    ss << obj;
-//    return ss.GetHash();
-//}
-
-//template<typename T1>
-//inline uint160 Hash160(const T1 pbegin, const T1 pend)
-//{
-//    static unsigned char pblank[1];
-//    uint256 hash1;
-//    SHA256((pbegin == pend ? pblank : (unsigned char*)&pbegin[0]), (pend - pbegin) * sizeof(pbegin[0]), (unsigned char*)&hash1);
-//    uint160 hash2;
-//    RIPEMD160((unsigned char*)&hash1, sizeof(hash1), (unsigned char*)&hash2);
-//    return hash2;
-//}
-
-//inline uint160 Hash160(const std::vector<unsigned char>& vch)
-//{
-//    return Hash160(vch.begin(), vch.end());
-//}
+/** Double-SHA256 stream for serialized data.
+ *
+ * Serializing an object issues many small writes (4 and 8 byte integers,
+ * compact sizes). They are staged in a 64 byte block which goes straight to
+ * the SHA256 compression function once full, so objects are hashed without
+ * being materialized in a CDataStream and without per-write SHA256_Update
+ * overhead.
+ */
+class CHashWriter
+{
+private:
+    SHA256_CTX ctx;
+    unsigned char buf[64];
+    unsigned int nBuf;
+    uint64_t nBytes;
+
+    void WriteBlocks(const unsigned char* pch, size_t size);
+
+public:
+    int nType;
+    int nVersion;
+
+    void Init() {
+        SHA256_Init(&ctx);
+        nBuf = 0;
+        nBytes = 0;
+    }
+
+    CHashWriter(int nTypeIn, int nVersionIn) : nType(nTypeIn), nVersion(nVersionIn) {
+        Init();
+    }
+
+    CHashWriter& write(const char *pch, size_t size) {
+        if (nBuf + size < sizeof(buf))
+        {
+            memcpy(buf + nBuf, pch, size);
+            nBuf += size;
+            nBytes += size;
+        }
+        else
+            WriteBlocks((const unsigned char*)pch, size);
+        return (*this);
+    }
+
+    // invalidates the object
+    uint256 GetHash();
+
+    template<typename T>
+    CHashWriter& operator<<(const T& obj) {
+        // Serialize to this stream
+        ::Serialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
+template<typename T1>
+inline uint256 Hash(const T1 pbegin, const T1 pend)
+{
+    CHashWriter ss(SER_GETHASH, 0);
+    if (pbegin != pend)
+        ss.write((const char*)&pbegin[0], (pend - pbegin) * sizeof(pbegin[0]));
+    return ss.GetHash();
+}
+
+template<typename T1, typename T2>
+inline uint256 Hash(const T1 p1begin, const T1 p1end,
+                    const T2 p2begin, const T2 p2end)
+{
+    CHashWriter ss(SER_GETHASH, 0);
+    if (p1begin != p1end)
+        ss.write((const char*)&p1begin[0], (p1end - p1begin) * sizeof(p1begin[0]));
+    if (p2begin != p2end)
+        ss.write((const char*)&p2begin[0], (p2end - p2begin) * sizeof(p2begin[0]));
+    return ss.GetHash();
+}
+
+template<typename T1, typename T2, typename T3>
+inline uint256 Hash(const T1 p1begin, const T1 p1end,
+                    const T2 p2begin, const T2 p2end,
+                    const T3 p3begin, const T3 p3end)
+{
+    CHashWriter ss(SER_GETHASH, 0);
+    if (p1begin != p1end)
+        ss.write((const char*)&p1begin[0], (p1end - p1begin) * sizeof(p1begin[0]));
+    if (p2begin != p2end)
+        ss.write((const char*)&p2begin[0], (p2end - p2begin) * sizeof(p2begin[0]));
+    if (p3begin != p3end)
+        ss.write((const char*)&p3begin[0], (p3end - p3begin) * sizeof(p3begin[0]));
+    return ss.GetHash();
+}
+
+template<typename T>
+uint256 SerializeHash(const T& obj, int nType=SER_GETHASH, int nVersion=PROTOCOL_VERSION)
+{
+    CHashWriter ss(nType, nVersion);
+    ss << obj;
+    return ss.GetHash();
+}
+
+inline uint160 Hash160(const std::vector<unsigned char>& vch)
+{
+    uint256 hash1;
+    SHA256(&vch[0], vch.size(), (unsigned char*)&hash1);
+    uint160 hash2;
+    RIPEMD160((unsigned char*)&hash1, sizeof(hash1), (unsigned char*)&hash2);
+    return hash2;
+}
 
 unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char>& vDataToHash);
 
@@ -5,6 +5,7 @@
 
 #include "bitcoinrpc.h"
 #include "checkpoints.h"
+#include "explorer.h"
 #include "init.h"
 #include "net.h"
 #include "txdb-leveldb.h"
@@ -95,6 +96,8 @@ void Shutdown(void* parg)
         CTxDB().Close();
         bitdb.Flush(false);
         StopNode();
+        StopScriptCheckThreads();
+        StopExplorer();
         bitdb.Flush(true);
         boost::filesystem::remove(GetPidFile());
         UnregisterWallet(pwalletMain);
@@ -102,6 +105,7 @@ void Shutdown(void* parg)
         NewThread(ExitTimeout, NULL);
         MilliSleep(50);
         printf("ECCoin exited\n\n");
+        StopLogWriter();
         fExit = true;
 #ifndef QT_GUI
         // ensure non-UI client gets exited here, but let Bitcoin-Qt reach 'return 0;' in bitcoin.cpp
@@ -283,8 +287,13 @@ std::string HelpMessage()
 #endif
         "  -testnet               " + _("Use the test network") + "\n" +
         "  -debug                 " + _("Output extra debugging information. Implies all other -debug* options") + "\n" +
+        "  -debug=<category>      " + _("Output debugging information for <category> only:") + " " + ListLogCategories() + "\n" +
         "  -debugnet              " + _("Output extra network debugging information") + "\n" +
         "  -logtimestamps         " + _("Prepend debug output with timestamp") + "\n" +
+        "  -asynclog              " + _("Write debug.log from a background thread (default: 1)") + "\n" +
+#ifdef DEBUG_LOCKPROFILE
+        "  -lockstatsinterval=<n> " + _("Write the busiest lock sites to debug.log every <n> seconds (default: 0, off)") + "\n" +
+#endif
         "  -shrinkdebugfile       " + _("Shrink debug.log file on client startup (default: 1 when no -debug)") + "\n" +
         "  -messagedebug          " + _("Print messaging debug statements to log file (default: 0 (will not do it unless it is enabled)") + "\n" +
         "  -printtoconsole        " + _("Send trace/debug info to console instead of debug.log file") + "\n" +
@@ -295,6 +304,7 @@ std::string HelpMessage()
         "  -rpcpassword=<pw>      " + _("Password for JSON-RPC connections") + "\n" +
         "  -rpcport=<port>        " + _("Listen for JSON-RPC connections on <port> (default: 52015 or testnet: 52017)") + "\n" +
         "  -rpcallowip=<ip>       " + _("Allow JSON-RPC connections from specified IP address") + "\n" +
+        "  -rpcmetrics            " + _("Serve performance metrics in Prometheus text format on GET /metrics of the RPC port") + "\n" +
         "  -rpcconnect=<ip>       " + _("Send commands to node running on <ip> (default: 127.0.0.1)") + "\n" +
         "  -blocknotify=<cmd>     " + _("Execute command when the best block changes (%s in cmd is replaced by block hash)") + "\n" +
         "  -walletnotify=<cmd>    " + _("Execute command when a wallet transaction changes (%s in cmd is replaced by TxID)") + "\n" +
@@ -305,14 +315,24 @@ std::string HelpMessage()
         "  -keypool=<n>           " + _("Set key pool size to <n> (default: 100)") + "\n" +
         "  -rescan                " + _("Rescan the block chain for missing wallet transactions") + "\n" +
         "  -salvagewallet         " + _("Attempt to recover private keys from a corrupt wallet.dat") + "\n" +
+        "  -walletlog             " + _("Store the wallet in an append-only log (<wallet>.log) instead of Berkeley DB") + "\n" +
+        "  -convertwallet         " + _("Copy wallet.dat into a new wallet log (with -walletlog) or the wallet log into a new wallet.dat, then exit") + "\n" +
+        "  -walletloadthreads=<n> " + _("Set the number of threads decoding wallet records at startup (1-16, 0 = one per core, default: 0)") + "\n" +
         "  -checkblocks=<n>       " + _("How many blocks to check at startup (default: 2500, 0 = all)") + "\n" +
         "  -checklevel=<n>        " + _("How thorough the block verification is (0-6, default: 1)") + "\n" +
+        "  -trustmodifiercheckpoints\n" +
+        "                         " + _("Skip the stake modifier checksums below the last stake modifier checkpoint at startup; getblock then shows modifierchecksum 00000000 for the skipped blocks (default: 0)") + "\n" +
+        "  -par=<n>               " + _("Set the number of script verification threads (1-16, 0 = one per core, default: 0)") + "\n" +
         "  -loadblock=<file>      " + _("Imports blocks from external blk000?.dat file") + "\n" +
+        "  -addressindex          " + _("Maintain an index of the outputs and spends of every address, for the getaddress* calls (default: 0)") + "\n" +
+        "  -spentindex            " + _("Maintain an index of the input spending every output, for getspentinfo (default: 0)") + "\n" +
+        "  -blockstatsindex       " + _("Maintain the totals of every block, for getblockstats and getchaintxstats (default: 0)") + "\n" +
 
         "\n" + _("Block creation options:") + "\n" +
         "  -blockminsize=<n>      "   + _("Set minimum block size in bytes (default: 0)") + "\n" +
         "  -blockmaxsize=<n>      "   + _("Set maximum block size in bytes (default: 250000)") + "\n" +
         "  -blockprioritysize=<n> "   + _("Set maximum size of high-priority/low-fee transactions in bytes (default: 27000)") + "\n" +
+        "  -stakethreads=<n>      "   + _("Set the number of threads searching coins for a stake kernel (1-16, 0 = one per core, default: 0)") + "\n" +
 
         "\n" + _("SSL options: (see the Bitcoin Wiki for SSL setup instructions)") + "\n" +
         "  -rpcssl                                  " + _("Use OpenSSL (https) for JSON-RPC connections") + "\n" +
@@ -433,11 +453,23 @@ bool AppInit2()
 
     fDebug = GetBoolArg("-debug");
 
-    // -debug implies fDebug*
-    if (fDebug)
-        fDebugNet = true;
-    else
-        fDebugNet = GetBoolArg("-debugnet");
+    // -debug enables every log category, -debug=<category> selects individual ones
+    if (mapArgs.count("-debug"))
+    {
+        uint32_t nCategories = LOG_NONE;
+        BOOST_FOREACH(const string& strCategory, mapMultiArgs["-debug"])
+        {
+            uint32_t nCategory = LOG_NONE;
+            if (!GetLogCategory(strCategory, nCategory))
+                InitWarning(strprintf(_("Unsupported logging category -debug=%s."), strCategory.c_str()));
+            nCategories |= nCategory;
+        }
+        nLogCategories = nCategories;
+    }
+    if (GetBoolArg("-debugnet"))
+        nLogCategories |= LOG_NET;
+    if (GetBoolArg("-messagedebug"))
+        nLogCategories |= LOG_MESSAGES;
 
     bitdb.SetDetach(GetBoolArg("-detachdb", false));
 
@@ -529,16 +561,31 @@ bool AppInit2()
     printf("\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n");
     printf("ECCoin version %s (%s)\n", FormatFullVersion().c_str(), CLIENT_DATE.c_str());
     printf("Using OpenSSL version %s\n", SSLeay_version(SSLEAY_VERSION));
+    printf("Using %s for ECDSA\n", GetECDSABackendName());
     if (!fLogTimestamps)
         printf("Startup time: %s\n", DateTimeStrFormat("%x %H:%M:%S", GetTime()).c_str());
     printf("Default data directory %s\n", GetDefaultDataDir().string().c_str());
     printf("Used data directory %s\n", strDataDir.c_str());
 
-    if (GetBoolArg("-messagedebug", false))
-    {
-        printf("messageDebug Enabled \n");
-        messageDebug = true;
-    }
+    if (nLogCategories != LOG_NONE)
+        printf("Debug log categories: %s\n", LogCategoriesToString(nLogCategories).c_str());
+
+    // From here on debug.log is written by a background thread
+    if (!fPrintToConsole && GetBoolArg("-asynclog", true))
+        NewThread(ThreadLogWriter, NULL);
+
+#ifdef DEBUG_LOCKPROFILE
+    if (GetArg("-lockstatsinterval", 0) > 0)
+        NewThread(ThreadLockStatsDump, NULL);
+#endif
+
+    // Script verification threads; the thread connecting a block is one of them
+    int nScriptCheckThreads = GetArg("-par", 0);
+    if (nScriptCheckThreads <= 0)
+        nScriptCheckThreads = boost::thread::hardware_concurrency();
+    nScriptCheckThreads = std::max(1, std::min(nScriptCheckThreads, 16));
+    printf("Using %d threads for script verification\n", nScriptCheckThreads);
+    StartScriptCheckThreads(nScriptCheckThreads - 1);
 
     std::ostringstream strErrors;
 
@@ -559,14 +606,34 @@ bool AppInit2()
         return InitError(msg);
     }
 
-    if (GetBoolArg("-salvagewallet"))
+    bool fUseWalletLog = GetBoolArg("-walletlog");
+    if (GetBoolArg("-convertwallet"))
+    {
+        // Offline conversion, the node does not start
+        if (fUseWalletLog ? !CWalletDB::ConvertToLog(strWalletFileName) : !CWalletDB::ConvertFromLog(strWalletFileName))
+            return InitError(_("Wallet conversion failed, see debug.log for details."));
+        string msg = strprintf(_("Wallet converted. The original file was left in place; restart %s -walletlog."),
+                               fUseWalletLog ? _("with") : _("without"));
+        uiInterface.ThreadSafeMessageBox(msg, _("ECCoin"), CClientUIInterface::OK | CClientUIInterface::ICON_INFORMATION | CClientUIInterface::MODAL);
+        return false;
+    }
+
+    bool fWalletDatExists = filesystem::exists(GetDataDir() / strWalletFileName);
+    bool fWalletLogExists = filesystem::exists(GetWalletLogPath(strWalletFileName));
+    if (fUseWalletLog && fWalletDatExists && !fWalletLogExists)
+        return InitError(_("-walletlog is set but the wallet is in wallet.dat. Convert it first with -walletlog -convertwallet."));
+    if (!fUseWalletLog && fWalletLogExists && !fWalletDatExists)
+        return InitError(_("The wallet is in a wallet log. Start with -walletlog, or convert it back with -convertwallet."));
+    fWalletLog = fUseWalletLog;
+
+    if (GetBoolArg("-salvagewallet") && !fWalletLog)
     {
         // Recover readable keypairs:
         if (!CWalletDB::Recover(bitdb, strWalletFileName, true))
             return false;
     }
 
-    if (filesystem::exists(GetDataDir() / strWalletFileName))
+    if (fWalletDatExists && !fWalletLog)
     {
         CDBEnv::VerifyResult r = bitdb.Verify(strWalletFileName, CWalletDB::Recover);
         if (r == CDBEnv::RECOVER_OK)
@@ -757,6 +824,22 @@ bool AppInit2()
         return false;
     }
 
+    // Built from the block files the first time they are switched on
+    fAddressIndex = GetBoolArg("-addressindex");
+    if (!SyncAddressIndex())
+        return InitError(_("Error building the address index"));
+    fSpentIndex = GetBoolArg("-spentindex");
+    if (!SyncSpentIndex())
+        return InitError(_("Error building the spent index"));
+    fBlockStatsIndex = GetBoolArg("-blockstatsindex");
+    if (!SyncBlockStatsIndex())
+        return InitError(_("Error building the block stats index"));
+    if (fRequestShutdown)
+    {
+        printf("Shutdown requested. Exiting.\n");
+        return false;
+    }
+
     // ********************************************************* Step 8: load wallet
 
     uiInterface.InitMessage(_("Loading wallet..."));
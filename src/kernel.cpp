@@ -11,6 +11,12 @@
 #include "script.h"
 #include "scrypt_mine.h"
 
+#include <deque>
+
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
 using namespace std;
 
 extern int nBestHeight;
@@ -58,53 +64,116 @@ static int64_t GetStakeModifierSelectionInterval(int height)
     return nSelectionInterval;
 }
 
+// A block of the selection interval. Candidates sort by timestamp, then by
+// block hash, which is the order the selection rounds walk them in.
+struct CModifierCandidate
+{
+    int64_t nTime;
+    uint256 hashBlock;
+    const CBlockIndex* pindex;
+    uint256 hashSelection;
+    bool fSelected;
+
+    bool operator<(const CModifierCandidate& other) const
+    {
+        return nTime < other.nTime || (nTime == other.nTime && hashBlock < other.hashBlock);
+    }
+};
+
+// compute the selection hash by hashing the block's proof-hash and the
+// previous stake modifier
+static uint256 GetSelectionHash(const CBlockIndex* pindex, uint64_t nStakeModifierPrev)
+{
+    uint256 hashProof = pindex->IsProofOfStake()? pindex->hashProofOfStake : pindex->GetBlockHash();
+    // laid out as serialized: the hash, then the modifier little-endian
+    unsigned char pchSelection[32 + 8];
+    memcpy(pchSelection, hashProof.begin(), 32);
+    for (int i = 0; i < 8; i++)
+        pchSelection[32 + i] = (unsigned char)(nStakeModifierPrev >> (8 * i));
+    uint256 hashSelection = Hash(pchSelection, pchSelection + sizeof(pchSelection));
+    // the selection hash is divided by 2**32 so that proof-of-stake block
+    // is always favored over proof-of-work block. this is to preserve
+    // the energy efficiency property
+    if (pindex->IsProofOfStake())
+        hashSelection >>= 32;
+    return hashSelection;
+}
+
 // select a block from the candidate blocks in vSortedByTimestamp, excluding
-// already selected blocks in vSelectedBlocks, and with timestamp up to
-// nSelectionIntervalStop.
-static bool SelectBlockFromCandidates(
-    vector<pair<int64_t, uint256> >& vSortedByTimestamp,
-    map<uint256, const CBlockIndex*>& mapSelectedBlocks,
-    int64_t nSelectionIntervalStop, uint64_t nStakeModifierPrev,
-    const CBlockIndex** pindexSelected)
+// already selected blocks, and with timestamp up to nSelectionIntervalStop.
+// The selection hashes only depend on the previous modifier, so they are
+// computed once for all rounds.
+static CModifierCandidate* SelectBlockFromCandidates(vector<CModifierCandidate>& vSortedByTimestamp, int64_t nSelectionIntervalStop)
 {
-    bool fSelected = false;
-    uint256 hashBest = 0;
-    *pindexSelected = (const CBlockIndex*) 0;
-    BOOST_FOREACH(const PAIRTYPE(int64_t, uint256)& item, vSortedByTimestamp)
+    CModifierCandidate* pcandidateBest = NULL;
+    for (unsigned int i = 0; i < vSortedByTimestamp.size(); i++)
     {
-        if (!mapBlockIndex.count(item.second))
-            return error("SelectBlockFromCandidates: failed to find block index for candidate block %s", item.second.ToString().c_str());
-        const CBlockIndex* pindex = mapBlockIndex[item.second];
-        if (fSelected && pindex->GetBlockTime() > nSelectionIntervalStop)
+        CModifierCandidate& candidate = vSortedByTimestamp[i];
+        if (pcandidateBest && candidate.nTime > nSelectionIntervalStop)
             break;
-        if (mapSelectedBlocks.count(pindex->GetBlockHash()) > 0)
+        if (candidate.fSelected)
             continue;
-        // compute the selection hash by hashing its proof-hash and the
-        // previous proof-of-stake modifier
-        uint256 hashProof = pindex->IsProofOfStake()? pindex->hashProofOfStake : pindex->GetBlockHash();
-        CDataStream ss(SER_GETHASH, 0);
-        ss << hashProof << nStakeModifierPrev;
-        uint256 hashSelection = Hash(ss.begin(), ss.end());
-        // the selection hash is divided by 2**32 so that proof-of-stake block
-        // is always favored over proof-of-work block. this is to preserve
-        // the energy efficiency property
-        if (pindex->IsProofOfStake())
-            hashSelection >>= 32;
-        if (fSelected && hashSelection < hashBest)
+        if (!pcandidateBest || candidate.hashSelection < pcandidateBest->hashSelection)
+            pcandidateBest = &candidate;
+    }
+    if (pcandidateBest && fDebug && GetBoolArg("-printstakemodifier"))
+        printf("SelectBlockFromCandidates: selection hash=%s\n", pcandidateBest->hashSelection.ToString().c_str());
+    return pcandidateBest;
+}
+
+// The blocks of the last selection interval, in chain order. Consecutive
+// modifiers share most of their interval, so the window is moved along the
+// chain rather than collected again from pindexPrev.
+static CCriticalSection cs_modifierWindow;
+static deque<const CBlockIndex*> dequeModifierWindow;
+
+void ClearStakeModifierWindow()
+{
+    LOCK(cs_modifierWindow);
+    dequeModifierWindow.clear();
+}
+
+// Make the window the longest run of blocks ending at pindexPrev whose
+// timestamps are all at or after nSelectionIntervalStart
+static void UpdateModifierWindow(const CBlockIndex* pindexPrev, int64_t nSelectionIntervalStart)
+{
+    deque<const CBlockIndex*>& window = dequeModifierWindow;
+
+    // drop blocks that are not on pindexPrev's chain, after a reorganisation
+    while (!window.empty() && pindexPrev->GetAncestor(window.back()->nHeight) != window.back())
+        window.pop_back();
+
+    // append the new blocks, unless one of them is too old and starts the window afresh
+    const CBlockIndex* pindexLast = window.empty() ? NULL : window.back();
+    vector<const CBlockIndex*> vNew;
+    bool fRestart = false;
+    for (const CBlockIndex* pindex = pindexPrev; pindex != pindexLast; pindex = pindex->pprev)
+    {
+        if (pindex->GetBlockTime() < nSelectionIntervalStart)
         {
-            hashBest = hashSelection;
-            *pindexSelected = (const CBlockIndex*) pindex;
+            fRestart = true;
+            break;
         }
-        else if (!fSelected)
+        vNew.push_back(pindex);
+    }
+    if (fRestart)
+        window.clear();
+    window.insert(window.end(), vNew.rbegin(), vNew.rend());
+    if (fRestart)
+        return;
+
+    // the interval start moves with pindexPrev's timestamp, either way
+    for (int i = (int)window.size() - 1; i >= 0; i--)
+    {
+        if (window[i]->GetBlockTime() < nSelectionIntervalStart)
         {
-            fSelected = true;
-            hashBest = hashSelection;
-            *pindexSelected = (const CBlockIndex*) pindex;
+            window.erase(window.begin(), window.begin() + i + 1);
+            return;
         }
     }
-    if (fDebug && GetBoolArg("-printstakemodifier"))
-        printf("SelectBlockFromCandidates: selection hash=%s\n", hashBest.ToString().c_str());
-    return fSelected;
+    for (const CBlockIndex* pindex = window.empty() ? NULL : window.front()->pprev;
+         pindex && pindex->GetBlockTime() >= nSelectionIntervalStart; pindex = pindex->pprev)
+        window.push_front(pindex);
 }
 
 // Stake Modifier (hash modifier of proof-of-stake):
@@ -150,15 +219,6 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeMod
     }
 
     // Sort candidate blocks by timestamp
-    vector<pair<int64_t, uint256> > vSortedByTimestamp;
-    if(pindexPrev->nHeight >= 1005000)
-    {
-        vSortedByTimestamp.reserve(64 * nModifierIntervalSecond / nStakeTargetSpacing);
-    }
-    else
-    {
-        vSortedByTimestamp.reserve(64 * nModifierInterval / nStakeTargetSpacing);
-    }
     int64_t nSelectionInterval = GetStakeModifierSelectionInterval(pindexPrev->nHeight);
     int64_t nSelectionIntervalStart = 0;
     if(pindexPrev->nHeight >= 1005000)
@@ -169,31 +229,42 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeMod
     {
         nSelectionIntervalStart = (pindexPrev->GetBlockTime() / nModifierInterval) * nModifierInterval - nSelectionInterval;
     }
-    const CBlockIndex* pindex = pindexPrev;
-    while (pindex && pindex->GetBlockTime() >= nSelectionIntervalStart)
+    vector<CModifierCandidate> vSortedByTimestamp;
     {
-        vSortedByTimestamp.push_back(make_pair(pindex->GetBlockTime(), pindex->GetBlockHash()));
-        pindex = pindex->pprev;
+        LOCK(cs_modifierWindow);
+        UpdateModifierWindow(pindexPrev, nSelectionIntervalStart);
+        vSortedByTimestamp.resize(dequeModifierWindow.size());
+        for (unsigned int i = 0; i < dequeModifierWindow.size(); i++)
+        {
+            CModifierCandidate& candidate = vSortedByTimestamp[i];
+            candidate.pindex = dequeModifierWindow[i];
+            candidate.nTime = candidate.pindex->GetBlockTime();
+            candidate.hashBlock = candidate.pindex->GetBlockHash();
+            candidate.hashSelection = GetSelectionHash(candidate.pindex, nStakeModifier);
+            candidate.fSelected = false;
+        }
     }
-    int nHeightFirstCandidate = pindex ? (pindex->nHeight + 1) : 0;
-    reverse(vSortedByTimestamp.begin(), vSortedByTimestamp.end());
+    int nHeightFirstCandidate = vSortedByTimestamp.empty() ? pindexPrev->nHeight + 1 : vSortedByTimestamp[0].pindex->nHeight;
     sort(vSortedByTimestamp.begin(), vSortedByTimestamp.end());
 
     // Select 64 blocks from candidate blocks to generate stake modifier
     uint64_t nStakeModifierNew = 0;
     int64_t nSelectionIntervalStop = nSelectionIntervalStart;
-    map<uint256, const CBlockIndex*> mapSelectedBlocks;
+    vector<const CBlockIndex*> vSelectedBlocks;
     for (int nRound=0; nRound<min(64, (int)vSortedByTimestamp.size()); nRound++)
     {
         // add an interval section to the current selection round
         nSelectionIntervalStop += GetStakeModifierSelectionIntervalSection(nRound, pindexPrev->nHeight);
         // select a block from the candidates of current round
-        if (!SelectBlockFromCandidates(vSortedByTimestamp, mapSelectedBlocks, nSelectionIntervalStop, nStakeModifier, &pindex))
+        CModifierCandidate* pcandidate = SelectBlockFromCandidates(vSortedByTimestamp, nSelectionIntervalStop);
+        if (!pcandidate)
             return error("ComputeNextStakeModifier: unable to select block at round %d", nRound);
+        const CBlockIndex* pindex = pcandidate->pindex;
         // write the entropy bit of the selected block
         nStakeModifierNew |= (((uint64_t)pindex->GetStakeEntropyBit()) << nRound);
         // add the selected block from candidates to selected list
-        mapSelectedBlocks.insert(make_pair(pindex->GetBlockHash(), pindex));
+        pcandidate->fSelected = true;
+        vSelectedBlocks.push_back(pindex);
         if (fDebug && GetBoolArg("-printstakemodifier"))
             printf("ComputeNextStakeModifier: selected round %d stop=%s height=%d bit=%d\n",
                 nRound, DateTimeStrFormat(nSelectionIntervalStop).c_str(), pindex->nHeight, pindex->GetStakeEntropyBit());
@@ -205,19 +276,17 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeMod
         string strSelectionMap = "";
         // '-' indicates proof-of-work blocks not selected
         strSelectionMap.insert(0, pindexPrev->nHeight - nHeightFirstCandidate + 1, '-');
-        pindex = pindexPrev;
-        while (pindex && pindex->nHeight >= nHeightFirstCandidate)
+        for (const CBlockIndex* pindex = pindexPrev; pindex && pindex->nHeight >= nHeightFirstCandidate; pindex = pindex->pprev)
         {
             // '=' indicates proof-of-stake blocks not selected
             if (pindex->IsProofOfStake())
                 strSelectionMap.replace(pindex->nHeight - nHeightFirstCandidate, 1, "=");
-            pindex = pindex->pprev;
         }
-        BOOST_FOREACH(const PAIRTYPE(uint256, const CBlockIndex*)& item, mapSelectedBlocks)
+        BOOST_FOREACH(const CBlockIndex* pindex, vSelectedBlocks)
         {
             // 'S' indicates selected proof-of-stake blocks
             // 'W' indicates selected proof-of-work blocks
-            strSelectionMap.replace(item.second->nHeight - nHeightFirstCandidate, 1, item.second->IsProofOfStake()? "S" : "W");
+            strSelectionMap.replace(pindex->nHeight - nHeightFirstCandidate, 1, pindex->IsProofOfStake()? "S" : "W");
         }
         printf("ComputeNextStakeModifier: selection height [%d, %d] map %s\n", nHeightFirstCandidate, pindexPrev->nHeight, strSelectionMap.c_str());
     }
@@ -270,6 +339,41 @@ static bool GetKernelStakeModifier(uint256 hashBlockFrom, uint64_t& nStakeModifi
     return true;
 }
 
+// Kernel target bnTarget * nCoinDayWeight in 256 bits, where
+// nCoinDayWeight = nValueIn * nTimeWeight / COIN / (24 * 60 * 60); false
+// when it is signed or does not fit
+static bool GetStakeKernelTarget(unsigned int nBits, int64_t nValueIn, int64_t nTimeWeight, arith_uint256& bnTarget)
+{
+    bool fNegative, fOverflow;
+    arith_uint256 bnTargetPerCoinDay;
+    bnTargetPerCoinDay.SetCompact(nBits, &fNegative, &fOverflow);
+    if (fNegative || fOverflow || nValueIn < 0 || nTimeWeight < 0)
+        return false;
+
+    // both factors are below 2^63 so the product always fits
+    arith_uint256 bnCoinDayWeight = arith_uint256((uint64_t)nValueIn) * (uint64_t)nTimeWeight;
+    bnCoinDayWeight /= arith_uint256((uint64_t)COIN);
+    bnCoinDayWeight /= arith_uint256(24 * 60 * 60);
+    if (bnCoinDayWeight.bits() + bnTargetPerCoinDay.bits() > 256)
+        return false;
+    bnTarget = bnCoinDayWeight * bnTargetPerCoinDay;
+    return true;
+}
+
+// Kernel target test: hash <= bnTarget * nCoinDayWeight
+bool CheckStakeKernelTarget(const uint256& hashProofOfStake, unsigned int nBits, int64_t nValueIn, int64_t nTimeWeight)
+{
+    arith_uint256 bnTarget;
+    if (GetStakeKernelTarget(nBits, nValueIn, nTimeWeight, bnTarget))
+        return UintToArith256(hashProofOfStake) <= bnTarget;
+
+    // signed or wider than 256 bits: use the original bignum computation
+    CBigNum bnTargetBig;
+    bnTargetBig.SetCompact(nBits);
+    CBigNum bnCoinDayWeight = CBigNum(nValueIn) * nTimeWeight / COIN / (24 * 60 * 60);
+    return CBigNum(hashProofOfStake) <= bnCoinDayWeight * bnTargetBig;
+}
+
 // ppcoin kernel protocol
 // coinstake must meet hash target according to the protocol:
 // kernel (input 0) must meet the formula
@@ -302,19 +406,16 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlock& blockFrom, unsigned
     if (nTimeBlockFrom + nStakeMinAge > nTimeTx) // Min age requirement
         return error("CheckStakeKernelHash() : min age violation");
 
-    CBigNum bnTargetPerCoinDay;
-    bnTargetPerCoinDay.SetCompact(nBits);
     int64_t nValueIn = txPrev.vout[prevout.n].nValue;
 
     // v0.3 protocol kernel hash weight starts from 0 at the min age
     // this change increases active coins participating the hash and helps
     // to secure the network when proof-of-stake difficulty is low
     int64_t nTimeWeight = min((int64_t)nTimeTx - txPrev.nTime, (int64_t)nStakeMaxAge) - nStakeMinAge;
-    CBigNum bnCoinDayWeight = CBigNum(nValueIn) * nTimeWeight / COIN / (24 * 60 * 60);
 
     // printf(">>> CheckStakeKernelHash: nTimeWeight = %"PRI64d"\n", nTimeWeight);
     // Calculate hash
-    CDataStream ss(SER_GETHASH, 0);
+    CHashWriter ss(SER_GETHASH, 0);
     uint64_t nStakeModifier = 0;
     int nStakeModifierHeight = 0;
     int64_t nStakeModifierTime = 0;
@@ -328,7 +429,7 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlock& blockFrom, unsigned
     ss << nStakeModifier;
 
     ss << nTimeBlockFrom << nTxPrevOffset << txPrev.nTime << prevout.n << nTimeTx;
-    hashProofOfStake = Hash(ss.begin(), ss.end());
+    hashProofOfStake = ss.GetHash();
     if (fPrintProofOfStake)
     {
         printf("CheckStakI64xlHash() : using modifier 0x%016I64x at height=%d timestamp=%s for block from height=%d timestamp=%s\n",
@@ -348,10 +449,8 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlock& blockFrom, unsigned
     }
 
     // Now check if proof-of-stake hash meets target protocol
-    if (CBigNum(hashProofOfStake) > bnCoinDayWeight * bnTargetPerCoinDay)
+    if (!CheckStakeKernelTarget(hashProofOfStake, nBits, nValueIn, nTimeWeight))
     {
-        // printf(">>> bnCoinDayWeight = %s, bnTargetPerCoinDay=%s\n",
-        //	bnCoinDayWeight.ToString().c_str(), bnTargetPerCoinDay.ToString().c_str());
         // printf(">>> CheckStakeKernelHash - hashProofOfStake too much\n");
         return false;
     }
@@ -374,6 +473,130 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlock& blockFrom, unsigned
     return true;
 }
 
+CStakeKernelSearch::CStakeKernelSearch(unsigned int nBitsIn, uint64_t nStakeModifier, unsigned int nTimeBlockFromIn,
+                                       unsigned int nTxPrevOffset, unsigned int nTimeTxPrevIn, unsigned int nPrevout, int64_t nValueInIn)
+{
+    fValid = true;
+    Init(nBitsIn, nStakeModifier, nTimeBlockFromIn, nTxPrevOffset, nTimeTxPrevIn, nPrevout, nValueInIn);
+}
+
+CStakeKernelSearch::CStakeKernelSearch(unsigned int nBitsIn, const CBlock& blockFrom, unsigned int nTxPrevOffset,
+                                       const CTransaction& txPrev, const COutPoint& prevout)
+{
+    uint64_t nStakeModifier = 0;
+    int nStakeModifierHeight = 0;
+    int64_t nStakeModifierTime = 0;
+    uint256 hashBlockFrom = blockFrom.GetHash();
+    {
+        LOCK(cs_main);
+        fValid = GetKernelStakeModifier(hashBlockFrom, nStakeModifier, nStakeModifierHeight, nStakeModifierTime, false) &&
+                 prevout.n < txPrev.vout.size();
+    }
+    Init(nBitsIn, nStakeModifier, blockFrom.GetBlockTime(), nTxPrevOffset, txPrev.nTime, prevout.n,
+         fValid ? txPrev.vout[prevout.n].nValue : 0);
+}
+
+static inline void WriteLE32(unsigned char* pch, uint32_t n)
+{
+    for (int i = 0; i < 4; i++)
+        pch[i] = (unsigned char)(n >> (8 * i));
+}
+
+void CStakeKernelSearch::Init(unsigned int nBitsIn, uint64_t nStakeModifier, unsigned int nTimeBlockFromIn,
+                              unsigned int nTxPrevOffset, unsigned int nTimeTxPrevIn, unsigned int nPrevout, int64_t nValueInIn)
+{
+    nBits = nBitsIn;
+    nTimeBlockFrom = nTimeBlockFromIn;
+    nTimeTxPrev = nTimeTxPrevIn;
+    nValueIn = nValueInIn;
+
+    // the 28 byte kernel as CheckStakeKernelHash serializes it, nTimeTx last,
+    // padded to one SHA256 block
+    memset(pchKernel, 0, sizeof(pchKernel));
+    WriteLE32(&pchKernel[0], (uint32_t)nStakeModifier);
+    WriteLE32(&pchKernel[4], (uint32_t)(nStakeModifier >> 32));
+    WriteLE32(&pchKernel[8], nTimeBlockFrom);
+    WriteLE32(&pchKernel[12], nTxPrevOffset);
+    WriteLE32(&pchKernel[16], nTimeTxPrev);
+    WriteLE32(&pchKernel[20], nPrevout);
+    pchKernel[28] = 0x80;
+    pchKernel[62] = (28 * 8) >> 8;
+    pchKernel[63] = (28 * 8) & 0xff;
+}
+
+uint256 CStakeKernelSearch::GetKernelHash(unsigned int nTimeTx) const
+{
+    unsigned char pchBlock[64];
+    memcpy(pchBlock, pchKernel, sizeof(pchBlock));
+    WriteLE32(&pchBlock[24], nTimeTx);
+
+    // both rounds are a single compression of a block padded in advance
+    SHA256_CTX ctx;
+    SHA256_Init(&ctx);
+    SHA256_Update(&ctx, pchBlock, sizeof(pchBlock));
+    memset(pchBlock, 0, sizeof(pchBlock));
+    for (int i = 0; i < 8; i++)
+        for (int j = 0; j < 4; j++)
+            pchBlock[4 * i + j] = (unsigned char)(ctx.h[i] >> (24 - 8 * j));
+    pchBlock[32] = 0x80;
+    pchBlock[62] = (32 * 8) >> 8;
+
+    SHA256_Init(&ctx);
+    SHA256_Update(&ctx, pchBlock, sizeof(pchBlock));
+    uint256 hash;
+    unsigned char* pchHash = hash.begin();
+    for (int i = 0; i < 8; i++)
+        for (int j = 0; j < 4; j++)
+            pchHash[4 * i + j] = (unsigned char)(ctx.h[i] >> (24 - 8 * j));
+    return hash;
+}
+
+double CStakeKernelSearch::GetKernelProbability(unsigned int nTimeTx) const
+{
+    if (!fValid || nTimeTx < nTimeTxPrev || nTimeBlockFrom + nStakeMinAge > nTimeTx)
+        return 0;
+    int64_t nTimeWeight = min((int64_t)nTimeTx - nTimeTxPrev, (int64_t)nStakeMaxAge) - nStakeMinAge;
+    arith_uint256 bnTarget;
+    if (!GetStakeKernelTarget(nBits, nValueIn, nTimeWeight, bnTarget))
+        return nValueIn > 0 && nTimeWeight > 0 ? 1 : 0; // wider than 256 bits
+    return min(1.0, (bnTarget.getdouble() + 1) / ldexp(1.0, 256));
+}
+
+bool CStakeKernelSearch::Search(unsigned int nTimeTxStart, unsigned int nCount, unsigned int& nTimeTxRet, uint256& hashProofOfStake, unsigned int* pnHashes) const
+{
+    if (!fValid)
+        return false;
+
+    // the target only changes with the time weight, which stays at its
+    // maximum for coins older than nStakeMaxAge
+    int64_t nTimeWeightTarget = -1;
+    arith_uint256 bnTarget;
+    bool fTarget = false;
+    for (unsigned int n = 0; n < nCount && n <= nTimeTxStart; n++)
+    {
+        unsigned int nTimeTx = nTimeTxStart - n;
+        if (nTimeTx < nTimeTxPrev || nTimeBlockFrom + nStakeMinAge > nTimeTx)
+            continue;
+        int64_t nTimeWeight = min((int64_t)nTimeTx - nTimeTxPrev, (int64_t)nStakeMaxAge) - nStakeMinAge;
+        if (nTimeWeight != nTimeWeightTarget)
+        {
+            nTimeWeightTarget = nTimeWeight;
+            fTarget = GetStakeKernelTarget(nBits, nValueIn, nTimeWeight, bnTarget);
+        }
+
+        uint256 hash = GetKernelHash(nTimeTx);
+        if (pnHashes)
+            (*pnHashes)++;
+        if (fTarget ? UintToArith256(hash) <= bnTarget : CheckStakeKernelTarget(hash, nBits, nValueIn, nTimeWeight))
+        {
+            nTimeTxRet = nTimeTx;
+            hashProofOfStake = hash;
+            return true;
+        }
+    }
+    return false;
+}
+
 // Check kernel hash target and coinstake signature
 bool CheckProofOfStake(const CTransaction& tx, unsigned int nBits, uint256& hashProofOfStake)
 {
@@ -411,21 +634,110 @@ bool CheckCoinStakeTimestamp(int64_t nTimeBlock, int64_t nTimeTx)
     return (nTimeBlock == nTimeTx);
 }
 
+// Hash previous checksum with flags, hashProofOfStake and nStakeModifier;
+// pnChecksumPrev is NULL for the genesis block
+static unsigned int StakeModifierChecksum(const CBlockIndex* pindex, const unsigned int* pnChecksumPrev)
+{
+    // laid out as serialized, integers little-endian
+    unsigned char pchChecksum[4 + 4 + 32 + 8];
+    unsigned char* pch = pchChecksum;
+    if (pnChecksumPrev)
+    {
+        for (int i = 0; i < 4; i++)
+            *pch++ = (unsigned char)(*pnChecksumPrev >> (8 * i));
+    }
+    for (int i = 0; i < 4; i++)
+        *pch++ = (unsigned char)(pindex->nFlags >> (8 * i));
+    memcpy(pch, pindex->hashProofOfStake.begin(), 32);
+    pch += 32;
+    for (int i = 0; i < 8; i++)
+        *pch++ = (unsigned char)(pindex->nStakeModifier >> (8 * i));
+    uint256 hashChecksum = Hash(pchChecksum, pch);
+    hashChecksum >>= (256 - 32);
+    return hashChecksum.Get64();
+}
+
 // Get stake modifier checksum
 unsigned int GetStakeModifierChecksum(const CBlockIndex* pindex)
 {
     assert (pindex->pprev || pindex->GetBlockHash() == (!fTestNet ? hashGenesisBlock : hashGenesisBlockTestNet));
-    // Hash previous checksum with flags, hashProofOfStake and nStakeModifier
+    return StakeModifierChecksum(pindex, pindex->pprev ? &pindex->pprev->nStakeModifierChecksum : NULL);
+}
+
+// A run of vSortedByHeight that can be chained without the runs before it:
+// it starts right after a checkpoint height held by a single block, whose
+// checksum is taken to be the checkpoint's until the earlier run confirms it
+struct CChecksumSegment
+{
+    size_t nBegin;
+    size_t nEnd;
+    const CBlockIndex* pindexSeed;
+    unsigned int nChecksumSeed;
+};
+
+static void ChainStakeModifierChecksums(const vector<pair<int, CBlockIndex*> >* pvSortedByHeight,
+                                        const vector<CChecksumSegment>* pvSegments, boost::atomic<unsigned int>* pnNext)
+{
+    while (true)
+    {
+        unsigned int n = pnNext->fetch_add(1, boost::memory_order_relaxed);
+        if (n >= pvSegments->size())
+            return;
+        const CChecksumSegment& segment = (*pvSegments)[n];
+        for (size_t i = segment.nBegin; i < segment.nEnd; i++)
+        {
+            CBlockIndex* pindex = (*pvSortedByHeight)[i].second;
+            if (pindex->pprev && pindex->pprev == segment.pindexSeed)
+                pindex->nStakeModifierChecksum = StakeModifierChecksum(pindex, &segment.nChecksumSeed);
+            else
+                pindex->nStakeModifierChecksum = StakeModifierChecksum(pindex, pindex->pprev ? &pindex->pprev->nStakeModifierChecksum : NULL);
+        }
+    }
+}
 
+size_t ComputeStakeModifierChecksums(const vector<pair<int, CBlockIndex*> >& vSortedByHeight,
+                                     const map<int, unsigned int>& mapCheckpoints, bool fTrustCheckpoints)
+{
+    vector<CChecksumSegment> vSegments;
+    CChecksumSegment segment;
+    segment.nBegin = 0;
+    segment.pindexSeed = NULL;
+    segment.nChecksumSeed = 0;
+    for (map<int, unsigned int>::const_iterator mi = mapCheckpoints.begin(); mi != mapCheckpoints.end(); ++mi)
+    {
+        vector<pair<int, CBlockIndex*> >::const_iterator itLow =
+            lower_bound(vSortedByHeight.begin(), vSortedByHeight.end(), make_pair(mi->first, (CBlockIndex*)NULL));
+        vector<pair<int, CBlockIndex*> >::const_iterator itHigh = itLow;
+        while (itHigh != vSortedByHeight.end() && itHigh->first == mi->first)
+            ++itHigh;
+        if (itHigh - itLow != 1)
+            continue;
 
-    CDataStream ss(SER_GETHASH, 0);
-    if (pindex->pprev)
-        ss << pindex->pprev->nStakeModifierChecksum;
-    ss << pindex->nFlags << pindex->hashProofOfStake << pindex->nStakeModifier;
-    uint256 hashChecksum = Hash(ss.begin(), ss.end());
-    hashChecksum >>= (256 - 32);
-    uint64_t hash64u= hashChecksum.Get64();
-    return hash64u;
+        // Trusted, the runs below the checkpoint are never chained or checked
+        if (fTrustCheckpoints)
+            itLow->second->nStakeModifierChecksum = mi->second;
+        else
+        {
+            segment.nEnd = itHigh - vSortedByHeight.begin();
+            vSegments.push_back(segment);
+        }
+        segment.nBegin = itHigh - vSortedByHeight.begin();
+        segment.pindexSeed = itLow->second;
+        segment.nChecksumSeed = mi->second;
+    }
+    segment.nEnd = vSortedByHeight.size();
+    vSegments.push_back(segment);
+
+    int nThreads = boost::thread::hardware_concurrency();
+    nThreads = std::max(1, std::min(std::min(nThreads, 16), (int)vSegments.size()));
+    boost::atomic<unsigned int> nNext(0);
+    boost::thread_group chainers;
+    for (int i = 1; i < nThreads; i++)
+        chainers.create_thread(boost::bind(&ChainStakeModifierChecksums, &vSortedByHeight, &vSegments, &nNext));
+    ChainStakeModifierChecksums(&vSortedByHeight, &vSegments, &nNext);
+    chainers.join_all();
+
+    return vSegments[0].nBegin;
 }
 
 // Check stake modifier hard checkpoints
@@ -40,11 +40,60 @@ static const int MODIFIER_INTERVAL_RATIO = 3;
 
 // Compute the hash modifier for proof-of-stake
 bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t & nStakeModifier, bool& fGeneratedStakeModifier);
+// Forget the candidate window ComputeNextStakeModifier keeps between calls,
+// before freeing block index entries it may point to
+void ClearStakeModifierWindow();
 
 // Check whether stake kernel meets hash target
 // Sets hashProofOfStake on success return
 bool CheckStakeKernelHash(unsigned int nBits, const CBlock& blockFrom, unsigned int nTxPrevOffset, const CTransaction& txPrev, const COutPoint& prevout, unsigned int nTimeTx, uint256& hashProofOfStake, bool fPrintProofOfStake=false);
 
+// Check whether a kernel hash is below the coin day weighted target
+bool CheckStakeKernelTarget(const uint256& hashProofOfStake, unsigned int nBits, int64_t nValueIn, int64_t nTimeWeight);
+
+/** Stake kernel search of one coin over a run of timestamps.
+ *
+ * CheckStakeKernelHash looks up the stake modifier and serializes the
+ * kernel on every call. Here the modifier and the 24 bytes that do not
+ * depend on the timestamp are prepared once, padded into the single
+ * SHA256 block the kernel fits in, and the target is only recomputed when
+ * the time weight changes.
+ */
+class CStakeKernelSearch
+{
+private:
+    bool fValid;
+    unsigned int nBits;
+    unsigned int nTimeBlockFrom;
+    unsigned int nTimeTxPrev;
+    int64_t nValueIn;
+    unsigned char pchKernel[64];
+
+    void Init(unsigned int nBitsIn, uint64_t nStakeModifier, unsigned int nTimeBlockFromIn,
+              unsigned int nTxPrevOffset, unsigned int nTimeTxPrevIn, unsigned int nPrevout, int64_t nValueInIn);
+
+public:
+    CStakeKernelSearch(unsigned int nBitsIn, const CBlock& blockFrom, unsigned int nTxPrevOffset,
+                       const CTransaction& txPrev, const COutPoint& prevout);
+    CStakeKernelSearch(unsigned int nBitsIn, uint64_t nStakeModifier, unsigned int nTimeBlockFromIn,
+                       unsigned int nTxPrevOffset, unsigned int nTimeTxPrevIn, unsigned int nPrevout, int64_t nValueInIn);
+
+    // false when the coin's stake modifier is not known yet
+    bool IsValid() const { return fValid; }
+
+    // hash(nStakeModifier + txPrev.block.nTime + txPrev.offset + txPrev.nTime + txPrev.vout.n + nTimeTx)
+    uint256 GetKernelHash(unsigned int nTimeTx) const;
+
+    // Chance that the kernel at nTimeTx meets the target
+    double GetKernelProbability(unsigned int nTimeTx) const;
+
+    // Try nTimeTxStart and the nCount - 1 seconds before it, latest first,
+    // skipping those the coin is too young for; sets the timestamp and
+    // hashProofOfStake of the first kernel meeting the target, and adds the
+    // number of kernels hashed to *pnHashes
+    bool Search(unsigned int nTimeTxStart, unsigned int nCount, unsigned int& nTimeTxRet, uint256& hashProofOfStake, unsigned int* pnHashes=NULL) const;
+};
+
 // Check kernel hash target and coinstake signature
 // Sets hashProofOfStake on success return
 bool CheckProofOfStake(const CTransaction& tx, unsigned int nBits, uint256& hashProofOfStake);
@@ -55,6 +104,15 @@ bool CheckCoinStakeTimestamp(int64_t nTimeBlock, int64_t nTimeTx);
 // Get stake modifier checksum
 unsigned int GetStakeModifierChecksum(const CBlockIndex* pindex);
 
+// Set nStakeModifierChecksum for every block of vSortedByHeight (sorted by
+// height). The runs between stake modifier checkpoints held by a single block
+// are chained in parallel, each assuming the checkpoint below it; the caller
+// must check every checkpoint from the returned position on, which confirms
+// those assumptions. With fTrustCheckpoints the blocks below the highest such
+// checkpoint are skipped and the returned position is above it.
+size_t ComputeStakeModifierChecksums(const std::vector<std::pair<int, CBlockIndex*> >& vSortedByHeight,
+                                     const std::map<int, unsigned int>& mapCheckpoints, bool fTrustCheckpoints);
+
 // Check stake modifier hard checkpoints
 bool CheckStakeModifierCheckpoints(int nHeight, CBlockIndex *pindexNew);
 
@@ -6,9 +6,189 @@
 
 #include <openssl/ecdsa.h>
 #include <openssl/obj_mac.h>
+#include <openssl/rand.h>
+
+#ifdef USE_SECP256K1
+#include <boost/thread/once.hpp>
+#include <secp256k1.h>
+#include <secp256k1_recovery.h>
+#endif
 
 #include "key.h"
 
+#ifdef USE_SECP256K1
+// One context with the signing and verification tables precomputed, built on
+// first use and shared read-only by all threads.
+static secp256k1_context* secp256k1_context_shared = NULL;
+static boost::once_flag secp256k1_context_once = BOOST_ONCE_INIT;
+
+static void CreateSecp256k1Context()
+{
+    secp256k1_context* ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
+    if (ctx == NULL)
+        throw key_error("CreateSecp256k1Context() : secp256k1_context_create failed");
+    // Blind the signing tables against side channels
+    unsigned char vchSeed[32];
+    if (RAND_bytes(vchSeed, sizeof(vchSeed)) == 1)
+        secp256k1_context_randomize(ctx, vchSeed);
+    OPENSSL_cleanse(vchSeed, sizeof(vchSeed));
+    secp256k1_context_shared = ctx;
+}
+
+static const secp256k1_context* GetSecp256k1Context()
+{
+    boost::call_once(CreateSecp256k1Context, secp256k1_context_once);
+    return secp256k1_context_shared;
+}
+
+// Parse a DER signature as leniently as OpenSSL does: the block chain contains
+// signatures with excess padding and odd length encodings that strict DER
+// parsing (secp256k1_ecdsa_signature_parse_der) rejects.
+static bool ParseSignatureLax(const secp256k1_context* ctx, secp256k1_ecdsa_signature* sig, const unsigned char* input, size_t inputlen)
+{
+    size_t rpos, rlen, spos, slen;
+    size_t pos = 0;
+    size_t lenbyte;
+    unsigned char tmpsig[64] = {0};
+    int overflow = 0;
+
+    // Hack to initialize sig with a correctly-parsed but invalid signature
+    secp256k1_ecdsa_signature_parse_compact(ctx, sig, tmpsig);
+
+    // Sequence tag byte
+    if (pos == inputlen || input[pos] != 0x30)
+        return false;
+    pos++;
+
+    // Sequence length bytes
+    if (pos == inputlen)
+        return false;
+    lenbyte = input[pos++];
+    if (lenbyte & 0x80)
+    {
+        lenbyte -= 0x80;
+        if (lenbyte > inputlen - pos)
+            return false;
+        pos += lenbyte;
+    }
+
+    // Integer tag byte for R
+    if (pos == inputlen || input[pos] != 0x02)
+        return false;
+    pos++;
+
+    // Integer length for R
+    if (pos == inputlen)
+        return false;
+    lenbyte = input[pos++];
+    if (lenbyte & 0x80)
+    {
+        lenbyte -= 0x80;
+        if (lenbyte > inputlen - pos)
+            return false;
+        while (lenbyte > 0 && input[pos] == 0)
+        {
+            pos++;
+            lenbyte--;
+        }
+        if (lenbyte >= sizeof(size_t))
+            return false;
+        rlen = 0;
+        while (lenbyte > 0)
+        {
+            rlen = (rlen << 8) + input[pos];
+            pos++;
+            lenbyte--;
+        }
+    }
+    else
+        rlen = lenbyte;
+    if (rlen > inputlen - pos)
+        return false;
+    rpos = pos;
+    pos += rlen;
+
+    // Integer tag byte for S
+    if (pos == inputlen || input[pos] != 0x02)
+        return false;
+    pos++;
+
+    // Integer length for S
+    if (pos == inputlen)
+        return false;
+    lenbyte = input[pos++];
+    if (lenbyte & 0x80)
+    {
+        lenbyte -= 0x80;
+        if (lenbyte > inputlen - pos)
+            return false;
+        while (lenbyte > 0 && input[pos] == 0)
+        {
+            pos++;
+            lenbyte--;
+        }
+        if (lenbyte >= sizeof(size_t))
+            return false;
+        slen = 0;
+        while (lenbyte > 0)
+        {
+            slen = (slen << 8) + input[pos];
+            pos++;
+            lenbyte--;
+        }
+    }
+    else
+        slen = lenbyte;
+    if (slen > inputlen - pos)
+        return false;
+    spos = pos;
+
+    // Ignore leading zeroes in R
+    while (rlen > 0 && input[rpos] == 0)
+    {
+        rlen--;
+        rpos++;
+    }
+    // Copy R value
+    if (rlen > 32)
+        overflow = 1;
+    else
+        memcpy(tmpsig + 32 - rlen, input + rpos, rlen);
+
+    // Ignore leading zeroes in S
+    while (slen > 0 && input[spos] == 0)
+    {
+        slen--;
+        spos++;
+    }
+    // Copy S value
+    if (slen > 32)
+        overflow = 1;
+    else
+        memcpy(tmpsig + 64 - slen, input + spos, slen);
+
+    if (!overflow)
+        overflow = !secp256k1_ecdsa_signature_parse_compact(ctx, sig, tmpsig);
+    if (overflow)
+    {
+        // Overwrite the result again with a correctly-parsed but invalid
+        // signature if parsing failed.
+        memset(tmpsig, 0, 64);
+        secp256k1_ecdsa_signature_parse_compact(ctx, sig, tmpsig);
+    }
+    return true;
+}
+#endif
+
+const char* GetECDSABackendName()
+{
+#ifdef USE_SECP256K1
+    return "libsecp256k1";
+#else
+    return "OpenSSL";
+#endif
+}
+
 // Generate a private key from just the secret parameter
 int EC_KEY_regenerate_key(EC_KEY *eckey, BIGNUM *priv_key)
 {
@@ -234,9 +414,9 @@ CSecret CKey::GetSecret(bool &fCompressed) const
     CSecret vchRet;
     vchRet.resize(32);
     const BIGNUM *bn = EC_KEY_get0_private_key(pkey);
-    int nBytes = BN_num_bytes(bn);
     if (bn == NULL)
         throw key_error("CKey::GetSecret() : EC_KEY_get0_private_key failed");
+    int nBytes = BN_num_bytes(bn);
     int n=BN_bn2bin(bn,&vchRet[32 - nBytes]);
     if (n != nBytes)
         throw key_error("CKey::GetSecret(): BN_bn2bin failed");
@@ -286,6 +466,27 @@ CPubKey CKey::GetPubKey() const
 bool CKey::Sign(uint256 hash, std::vector<unsigned char>& vchSig)
 {
     vchSig.clear();
+#ifdef USE_SECP256K1
+    {
+        // RFC6979 nonces; libsecp256k1 always produces low S values
+        // A key with only a public part cannot sign
+        if (IsNull() || EC_KEY_get0_private_key(pkey) == NULL)
+            return false;
+        bool fCompr;
+        CSecret vchSecret = GetSecret(fCompr);
+        if (vchSecret.size() != 32)
+            return false;
+        const secp256k1_context* ctx = GetSecp256k1Context();
+        secp256k1_ecdsa_signature sig;
+        if (!secp256k1_ecdsa_sign(ctx, &sig, (const unsigned char*)&hash, &vchSecret[0], NULL, NULL))
+            return false;
+        size_t nSize = 72;
+        vchSig.resize(nSize);
+        secp256k1_ecdsa_signature_serialize_der(ctx, &vchSig[0], &nSize, &sig);
+        vchSig.resize(nSize);
+        return true;
+    }
+#endif
     ECDSA_SIG *sig = ECDSA_do_sign((unsigned char*)&hash, sizeof(hash), pkey);
     if (sig == NULL)
         return false;
@@ -317,6 +518,26 @@ bool CKey::Sign(uint256 hash, std::vector<unsigned char>& vchSig)
 //                  0x1D = second key with even y, 0x1E = second key with odd y
 bool CKey::SignCompact(uint256 hash, std::vector<unsigned char>& vchSig)
 {
+#ifdef USE_SECP256K1
+    {
+        if (IsNull() || EC_KEY_get0_private_key(pkey) == NULL)
+            return false;
+        bool fCompr;
+        CSecret vchSecret = GetSecret(fCompr);
+        if (vchSecret.size() != 32)
+            return false;
+        const secp256k1_context* ctx = GetSecp256k1Context();
+        secp256k1_ecdsa_recoverable_signature sig;
+        if (!secp256k1_ecdsa_sign_recoverable(ctx, &sig, (const unsigned char*)&hash, &vchSecret[0], NULL, NULL))
+            return false;
+        int nRecId = -1;
+        vchSig.clear();
+        vchSig.resize(65, 0);
+        secp256k1_ecdsa_recoverable_signature_serialize_compact(ctx, &vchSig[1], &nRecId, &sig);
+        vchSig[0] = nRecId+27+(fCompressedPubKey ? 4 : 0);
+        return true;
+    }
+#endif
     bool fOk = false;
     ECDSA_SIG *sig = ECDSA_do_sign((unsigned char*)&hash, sizeof(hash), pkey);
     if (sig==NULL)
@@ -368,6 +589,14 @@ bool CKey::SetCompactSignature(uint256 hash, const std::vector<unsigned char>& v
     int nV = vchSig[0];
     if (nV<27 || nV>=35)
         return false;
+#ifdef USE_SECP256K1
+    {
+        CPubKey pubkey;
+        if (!pubkey.RecoverCompact(hash, vchSig))
+            return false;
+        return SetPubKey(pubkey);
+    }
+#endif
     ECDSA_SIG *sig = ECDSA_SIG_new();
     BN_bin2bn(&vchSig[1],32,sig->r);
     BN_bin2bn(&vchSig[33],32,sig->s);
@@ -391,6 +620,9 @@ bool CKey::SetCompactSignature(uint256 hash, const std::vector<unsigned char>& v
 
 bool CKey::Verify(uint256 hash, const std::vector<unsigned char>& vchSig)
 {
+#ifdef USE_SECP256K1
+    return GetPubKey().Verify(hash, vchSig);
+#endif
     // -1 = error, 0 = bad sig, 1 = good
     if (ECDSA_verify(0, (unsigned char*)&hash, sizeof(hash), &vchSig[0], vchSig.size(), pkey) != 1)
         return false;
@@ -423,3 +655,61 @@ bool CKey::IsValid()
     key2.SetSecret(secret, fCompr);
     return GetPubKey() == key2.GetPubKey();
 }
+
+bool CPubKey::Verify(const uint256 &hash, const std::vector<unsigned char>& vchSig) const
+{
+    if (!IsValid() || vchSig.empty())
+        return false;
+#ifdef USE_SECP256K1
+    const secp256k1_context* ctx = GetSecp256k1Context();
+    secp256k1_pubkey pubkey;
+    secp256k1_ecdsa_signature sig;
+    if (!secp256k1_ec_pubkey_parse(ctx, &pubkey, &vchPubKey[0], vchPubKey.size()))
+        return false;
+    if (!ParseSignatureLax(ctx, &sig, &vchSig[0], vchSig.size()))
+        return false;
+    // OpenSSL accepts high S values, libsecp256k1 only verifies the lower form
+    secp256k1_ecdsa_signature_normalize(ctx, &sig, &sig);
+    return secp256k1_ecdsa_verify(ctx, &sig, (const unsigned char*)&hash, &pubkey) == 1;
+#else
+    CKey key;
+    if (!key.SetPubKey(*this))
+        return false;
+    return key.Verify(hash, vchSig);
+#endif
+}
+
+bool CPubKey::RecoverCompact(const uint256 &hash, const std::vector<unsigned char>& vchSig)
+{
+    if (vchSig.size() != 65)
+        return false;
+    int nV = vchSig[0];
+    if (nV<27 || nV>=35)
+        return false;
+#ifdef USE_SECP256K1
+    bool fCompressed = false;
+    if (nV >= 31)
+    {
+        fCompressed = true;
+        nV -= 4;
+    }
+    const secp256k1_context* ctx = GetSecp256k1Context();
+    secp256k1_pubkey pubkey;
+    secp256k1_ecdsa_recoverable_signature sig;
+    if (!secp256k1_ecdsa_recoverable_signature_parse_compact(ctx, &sig, &vchSig[1], nV - 27))
+        return false;
+    if (!secp256k1_ecdsa_recover(ctx, &pubkey, &sig, (const unsigned char*)&hash))
+        return false;
+    size_t nSize = 65;
+    vchPubKey.resize(nSize);
+    secp256k1_ec_pubkey_serialize(ctx, &vchPubKey[0], &nSize, &pubkey, fCompressed ? SECP256K1_EC_COMPRESSED : SECP256K1_EC_UNCOMPRESSED);
+    vchPubKey.resize(nSize);
+    return true;
+#else
+    CKey key;
+    if (!key.SetCompactSignature(hash, vchSig))
+        return false;
+    *this = key.GetPubKey();
+    return true;
+#endif
+}
@@ -96,8 +96,18 @@ public:
     std::vector<unsigned char> Raw() const {
         return vchPubKey;
     }
+
+    // Check a DER encoded signature of hash against this public key.
+    // Does not need a CKey, so verifiers can skip the OpenSSL EC_KEY setup.
+    bool Verify(const uint256 &hash, const std::vector<unsigned char>& vchSig) const;
+
+    // Recover the public key from a compact signature (see CKey::SignCompact)
+    bool RecoverCompact(const uint256 &hash, const std::vector<unsigned char>& vchSig);
 };
 
+// Name of the ECDSA implementation selected at build time (USE_SECP256K1)
+const char* GetECDSABackendName();
+
 
 // secure_allocator is defined in allocators.h
 // CPrivKey is a serialized private key, with all parameters included (279 bytes)
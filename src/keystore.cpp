@@ -117,6 +117,15 @@ bool CCryptoKeyStore::Unlock(const CKeyingMaterial& vMasterKeyIn)
     return true;
 }
 
+bool CCryptoKeyStore::GetMasterKey(CKeyingMaterial& vMasterKeyOut) const
+{
+    LOCK(cs_KeyStore);
+    if (!IsCrypted() || vMasterKey.empty())
+        return false;
+    vMasterKeyOut = vMasterKey;
+    return true;
+}
+
 bool CCryptoKeyStore::AddKey(const CKey& key)
 {
     {
@@ -121,6 +121,9 @@ protected:
 
     bool Unlock(const CKeyingMaterial& vMasterKeyIn);
 
+    // copy of the master key, for encrypting new keys without holding cs_KeyStore
+    bool GetMasterKey(CKeyingMaterial& vMasterKeyOut) const;
+
 public:
     CCryptoKeyStore() : fUseCrypto(false)
     {
@@ -0,0 +1,402 @@
+// Copyright (c) 2016 The ECCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "logger.h"
+#include "strlcpy.h"
+#include "util.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/foreach.hpp>
+#include <boost/thread.hpp>
+
+using namespace std;
+
+boost::atomic<uint32_t> nLogCategories(LOG_NONE);
+
+struct CLogCategoryName
+{
+    uint32_t nCategory;
+    const char* pszName;
+};
+
+static const CLogCategoryName vLogCategoryNames[] =
+{
+    { LOG_NET,      "net" },
+    { LOG_MESSAGES, "messages" },
+    { LOG_MEMPOOL,  "mempool" },
+    { LOG_CHAIN,    "chain" },
+    { LOG_STAKE,    "stake" },
+    { LOG_COINAGE,  "coinage" },
+    { LOG_WALLET,   "wallet" },
+    { LOG_KEYPOOL,  "keypool" },
+    { LOG_DB,       "db" },
+    { LOG_RPC,      "rpc" },
+    { LOG_LOCK,     "lock" },
+    { LOG_BENCH,    "bench" },
+};
+
+bool GetLogCategory(const std::string& strName, uint32_t& nCategoryRet)
+{
+    if (strName == "" || strName == "1" || strName == "all")
+    {
+        nCategoryRet = LOG_ALL;
+        return true;
+    }
+    if (strName == "0" || strName == "none")
+    {
+        nCategoryRet = LOG_NONE;
+        return true;
+    }
+    for (unsigned int i = 0; i < ARRAYLEN(vLogCategoryNames); i++)
+    {
+        if (strName == vLogCategoryNames[i].pszName)
+        {
+            nCategoryRet = vLogCategoryNames[i].nCategory;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string ListLogCategories()
+{
+    return LogCategoriesToString(LOG_ALL);
+}
+
+std::string LogCategoriesToString(uint32_t nCategories)
+{
+    std::string str;
+    for (unsigned int i = 0; i < ARRAYLEN(vLogCategoryNames); i++)
+    {
+        if (!(nCategories & vLogCategoryNames[i].nCategory))
+            continue;
+        if (!str.empty())
+            str += ",";
+        str += vLogCategoryNames[i].pszName;
+    }
+    return str;
+}
+
+bool CLogRateLimiter::Allow(int64_t nSeconds, unsigned int nBurst)
+{
+    int64_t nNow = GetTime();
+    int64_t nStart = nWindowStart.load(boost::memory_order_relaxed);
+    if (nNow - nStart >= nSeconds && nWindowStart.compare_exchange_strong(nStart, nNow))
+    {
+        nCount.store(0);
+        unsigned int nSkipped = nSuppressed.exchange(0);
+        if (nSkipped > 0)
+            printf("(%u similar log lines suppressed)\n", nSkipped);
+    }
+    if (nCount.fetch_add(1, boost::memory_order_relaxed) < nBurst)
+        return true;
+    nSuppressed.fetch_add(1, boost::memory_order_relaxed);
+    return false;
+}
+
+
+//
+// Synchronous writes. Used before the writer thread starts, after it stops
+// and by the writer thread itself.
+//
+
+static FILE* fileout = NULL;
+static bool fStartedNewLine = true;
+
+static boost::mutex& DebugLogMutex()
+{
+    // This routine may be called by global destructors during shutdown.
+    // Since the order of destruction of static/global objects is undefined,
+    // allocate the mutex on the heap the first time it is needed.
+    static boost::mutex* pmutexDebugLog = new boost::mutex();
+    return *pmutexDebugLog;
+}
+
+// requires DebugLogMutex()
+static void WriteDebugLogLocked(const char* pch, size_t nLen, int64_t nTime, bool fLineStart)
+{
+    if (!fileout)
+    {
+        boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
+        fileout = fopen(pathDebug.string().c_str(), "a");
+        if (!fileout)
+            return;
+    }
+
+    // reopen the log file, if requested
+    if (fReopenDebugLog)
+    {
+        fReopenDebugLog = false;
+        boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
+        if (freopen(pathDebug.string().c_str(), "a", fileout) == NULL)
+        {
+            fileout = NULL;
+            return;
+        }
+    }
+
+    // Formatting the timestamp dominates short lines, so only redo it when the second changes
+    if (fLogTimestamps && fLineStart)
+    {
+        static int64_t nLastTime = -1;
+        static char pszTime[64];
+        if (nTime != nLastTime)
+        {
+            strlcpy(pszTime, DateTimeStrFormat("%x %H:%M:%S ", nTime).c_str(), sizeof(pszTime));
+            nLastTime = nTime;
+        }
+        fputs(pszTime, fileout);
+    }
+    fwrite(pch, 1, nLen, fileout);
+}
+
+
+//
+// Asynchronous writes: every thread owns a single-producer ring that only the
+// writer thread consumes, so logging from validation or networking threads
+// costs a vsnprintf and a memcpy. The writer merges the rings by sequence
+// number to keep the lines of different threads in order.
+//
+
+struct CLogRecordHeader
+{
+    uint64_t nSeq;
+    int64_t nTime;
+    uint32_t nLen;
+    uint32_t fLineStart;
+};
+
+class CLogRing
+{
+public:
+    enum { RING_SIZE = 1 << 16 };
+    enum { MAX_RECORD = RING_SIZE / 4 };
+
+    char pchBuf[RING_SIZE];
+    boost::atomic<uint64_t> nHead;      // advanced by the owning thread
+    boost::atomic<uint64_t> nTail;      // advanced by the writer thread
+    boost::atomic<unsigned int> nDropped;
+    boost::atomic<bool> fOrphaned;      // owning thread exited, free once drained
+    bool fStartedNewLine;               // owning thread only
+    bool fDroppingLine;                 // owning thread only
+
+    CLogRing() : nHead(0), nTail(0), nDropped(0), fOrphaned(false), fStartedNewLine(true), fDroppingLine(false) {}
+
+    uint64_t Used() const
+    {
+        return nHead.load(boost::memory_order_acquire) - nTail.load(boost::memory_order_acquire);
+    }
+
+    void CopyIn(uint64_t nPos, const void* p, size_t n)
+    {
+        size_t nOffset = nPos & (RING_SIZE - 1);
+        size_t n1 = std::min(n, (size_t)RING_SIZE - nOffset);
+        memcpy(pchBuf + nOffset, p, n1);
+        memcpy(pchBuf, (const char*)p + n1, n - n1);
+    }
+
+    void CopyOut(uint64_t nPos, void* p, size_t n) const
+    {
+        size_t nOffset = nPos & (RING_SIZE - 1);
+        size_t n1 = std::min(n, (size_t)RING_SIZE - nOffset);
+        memcpy(p, pchBuf + nOffset, n1);
+        memcpy((char*)p + n1, pchBuf, n - n1);
+    }
+
+    bool Push(const CLogRecordHeader& hdr, const char* pch)
+    {
+        uint64_t nNeed = sizeof(hdr) + hdr.nLen;
+        uint64_t nPos = nHead.load(boost::memory_order_relaxed);
+        if (nNeed > RING_SIZE - (nPos - nTail.load(boost::memory_order_acquire)))
+        {
+            nDropped.fetch_add(1, boost::memory_order_relaxed);
+            return false;
+        }
+        CopyIn(nPos, &hdr, sizeof(hdr));
+        CopyIn(nPos + sizeof(hdr), pch, hdr.nLen);
+        nHead.store(nPos + nNeed, boost::memory_order_release);
+        return true;
+    }
+};
+
+static boost::atomic<bool> fLogAsync(false);
+static boost::atomic<bool> fLogWriterRunning(false);
+static boost::atomic<uint64_t> nLogSequence(0);
+
+static boost::mutex cs_vLogRings;
+static std::vector<CLogRing*> vLogRings;
+
+static boost::mutex csLogWake;
+static boost::condition_variable condLogWake;
+
+static void OrphanLogRing(CLogRing* pring)
+{
+    // Called on thread exit; the writer frees the ring after draining it
+    pring->fOrphaned.store(true, boost::memory_order_release);
+}
+
+static boost::thread_specific_ptr<CLogRing> pThreadLogRing(OrphanLogRing);
+
+static CLogRing* GetThreadLogRing()
+{
+    CLogRing* pring = pThreadLogRing.get();
+    if (pring == NULL)
+    {
+        pring = new CLogRing();
+        pThreadLogRing.reset(pring);
+        boost::mutex::scoped_lock lock(cs_vLogRings);
+        vLogRings.push_back(pring);
+    }
+    return pring;
+}
+
+struct CLogRecordRef
+{
+    CLogRecordHeader hdr;
+    size_t nOffset;
+
+    bool operator<(const CLogRecordRef& b) const { return hdr.nSeq < b.hdr.nSeq; }
+};
+
+static void DrainLogRings()
+{
+    static std::vector<char> vchData;
+    static std::vector<CLogRecordRef> vRecords;
+    vchData.clear();
+    vRecords.clear();
+    unsigned int nDropped = 0;
+
+    {
+        boost::mutex::scoped_lock lock(cs_vLogRings);
+        for (std::vector<CLogRing*>::iterator it = vLogRings.begin(); it != vLogRings.end();)
+        {
+            CLogRing* pring = *it;
+            bool fOrphaned = pring->fOrphaned.load(boost::memory_order_acquire);
+            uint64_t nPos = pring->nTail.load(boost::memory_order_relaxed);
+            uint64_t nEnd = pring->nHead.load(boost::memory_order_acquire);
+            while (nPos < nEnd)
+            {
+                CLogRecordRef ref;
+                pring->CopyOut(nPos, &ref.hdr, sizeof(ref.hdr));
+                ref.nOffset = vchData.size();
+                vchData.resize(ref.nOffset + ref.hdr.nLen);
+                if (ref.hdr.nLen > 0)
+                    pring->CopyOut(nPos + sizeof(ref.hdr), &vchData[ref.nOffset], ref.hdr.nLen);
+                vRecords.push_back(ref);
+                nPos += sizeof(ref.hdr) + ref.hdr.nLen;
+            }
+            pring->nTail.store(nPos, boost::memory_order_release);
+            nDropped += pring->nDropped.exchange(0);
+
+            if (fOrphaned)
+            {
+                delete pring;
+                it = vLogRings.erase(it);
+            }
+            else
+                ++it;
+        }
+    }
+
+    if (vRecords.empty() && nDropped == 0)
+        return;
+
+    std::sort(vRecords.begin(), vRecords.end());
+
+    boost::mutex::scoped_lock lock(DebugLogMutex());
+    BOOST_FOREACH(const CLogRecordRef& ref, vRecords)
+        WriteDebugLogLocked(ref.hdr.nLen ? &vchData[ref.nOffset] : "", ref.hdr.nLen, ref.hdr.nTime, ref.hdr.fLineStart);
+    if (nDropped > 0 && fileout)
+        fprintf(fileout, "\n(%u debug log lines dropped, log writer fell behind)\n", nDropped);
+    if (fileout)
+        fflush(fileout);
+}
+
+int LogWriteDebugLog(const char* pszFormat, va_list ap)
+{
+    char pszBuffer[1024];
+    std::string strLong;
+    const char* pch = pszBuffer;
+
+    va_list arg_ptr;
+    va_copy(arg_ptr, ap);
+    int nLen = vsnprintf(pszBuffer, sizeof(pszBuffer), pszFormat, arg_ptr);
+    va_end(arg_ptr);
+    if (nLen < 0 || nLen >= (int)sizeof(pszBuffer))
+    {
+        strLong = vstrprintf(pszFormat, ap);
+        pch = strLong.data();
+        nLen = strLong.size();
+    }
+    if (nLen == 0)
+        return 0;
+
+    int64_t nTime = GetTime();
+    bool fLineEnd = (pch[nLen - 1] == '\n');
+
+    if (fLogAsync.load(boost::memory_order_acquire))
+    {
+        CLogRing* pring = GetThreadLogRing();
+        CLogRecordHeader hdr;
+        hdr.nSeq = nLogSequence.fetch_add(1, boost::memory_order_relaxed);
+        hdr.nTime = nTime;
+        hdr.nLen = std::min(nLen, (int)CLogRing::MAX_RECORD);
+        // A cut record still ends its line, as fStartedNewLine says it does
+        std::string strTruncated;
+        if (nLen > (int)CLogRing::MAX_RECORD && fLineEnd)
+        {
+            strTruncated.assign(pch, CLogRing::MAX_RECORD - 1);
+            strTruncated += '\n';
+            pch = strTruncated.data();
+        }
+        hdr.fLineStart = pring->fStartedNewLine;
+        pring->fStartedNewLine = fLineEnd;
+        // Once part of a line is dropped, drop the rest of it too
+        if (!pring->fDroppingLine || hdr.fLineStart)
+            pring->fDroppingLine = !pring->Push(hdr, pch);
+        if (pring->Used() > CLogRing::RING_SIZE / 2)
+            condLogWake.notify_one();
+        return nLen;
+    }
+
+    boost::mutex::scoped_lock lock(DebugLogMutex());
+    WriteDebugLogLocked(pch, nLen, nTime, fStartedNewLine);
+    fStartedNewLine = fLineEnd;
+    if (fileout)
+        fflush(fileout);
+    return nLen;
+}
+
+void ThreadLogWriter(void* parg)
+{
+    // Make this thread recognisable as the log writer thread
+    RenameThread("ECCoin-logwriter");
+
+    fLogWriterRunning = true;
+    fLogAsync = true;
+    while (fLogAsync)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(csLogWake);
+            condLogWake.timed_wait(lock, boost::posix_time::milliseconds(100));
+        }
+        DrainLogRings();
+    }
+
+    // Pick up lines from threads that were mid-write when the writer was stopped
+    MilliSleep(10);
+    DrainLogRings();
+    fLogWriterRunning = false;
+}
+
+void StopLogWriter()
+{
+    if (!fLogAsync.exchange(false))
+        return;
+    condLogWake.notify_one();
+    for (int i = 0; i < 200 && fLogWriterRunning; i++)
+        MilliSleep(10);
+}
@@ -0,0 +1,82 @@
+// Copyright (c) 2016 The ECCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_LOGGER_H
+#define BITCOIN_LOGGER_H
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <string>
+
+#include <boost/atomic.hpp>
+
+/** Debug log categories. Enabled at startup with -debug=<category> (repeatable,
+ * plain -debug enables all of them) and at runtime with the "logging" RPC call.
+ */
+enum LogCategory
+{
+    LOG_NONE     = 0,
+    LOG_NET      = (1 << 0),
+    LOG_MESSAGES = (1 << 1),
+    LOG_MEMPOOL  = (1 << 2),
+    LOG_CHAIN    = (1 << 3),
+    LOG_STAKE    = (1 << 4),
+    LOG_COINAGE  = (1 << 5),
+    LOG_WALLET   = (1 << 6),
+    LOG_KEYPOOL  = (1 << 7),
+    LOG_DB       = (1 << 8),
+    LOG_RPC      = (1 << 9),
+    LOG_LOCK     = (1 << 10),
+    LOG_BENCH    = (1 << 11),
+    LOG_ALL      = 0xffffffff,
+};
+
+extern boost::atomic<uint32_t> nLogCategories;
+
+inline bool LogAcceptCategory(uint32_t nCategory)
+{
+    return (nLogCategories.load(boost::memory_order_relaxed) & nCategory) != 0;
+}
+
+/** Look up a category by name ("all" and "1" select every category) */
+bool GetLogCategory(const std::string& strName, uint32_t& nCategoryRet);
+/** Comma separated names of all known categories */
+std::string ListLogCategories();
+/** Names of the categories in nCategories */
+std::string LogCategoriesToString(uint32_t nCategories);
+
+/** Print only when the category is enabled. The arguments are not evaluated otherwise. */
+#define LogPrint(category, ...) \
+    do { if (LogAcceptCategory(category)) printf(__VA_ARGS__); } while (0)
+
+/** Per call site rate limiter: lets at most nBurst lines through every
+ * nSeconds and reports how many were suppressed when the window rolls over.
+ */
+class CLogRateLimiter
+{
+private:
+    boost::atomic<int64_t> nWindowStart;
+    boost::atomic<unsigned int> nCount;
+    boost::atomic<unsigned int> nSuppressed;
+
+public:
+    CLogRateLimiter() : nWindowStart(0), nCount(0), nSuppressed(0) {}
+
+    bool Allow(int64_t nSeconds, unsigned int nBurst);
+};
+
+#define LogPrintLimited(nSeconds, nBurst, ...) \
+    do { static CLogRateLimiter limiter; if (limiter.Allow(nSeconds, nBurst)) printf(__VA_ARGS__); } while (0)
+
+/** Append formatted output to debug.log. Once the writer thread is running this
+ * only copies the text into a per-thread ring buffer and never blocks on I/O;
+ * lines that do not fit in a full ring are dropped and counted.
+ */
+int LogWriteDebugLog(const char* pszFormat, va_list ap);
+
+/** Background thread that drains the per-thread rings into debug.log */
+void ThreadLogWriter(void* parg);
+/** Drain all pending lines and return to synchronous writes (used at shutdown) */
+void StopLogWriter();
+
+#endif
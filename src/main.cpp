@@ -11,6 +11,7 @@
 #include "init.h"
 #include "ui_interface.h"
 #include "kernel.h"
+#include "metrics.h"
 #include "scrypt_mine.h"
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/random/mersenne_twister.hpp>
@@ -42,10 +43,10 @@ multimap<uint256, CBlock*> mapOrphanBlocksByPrev;
 set<pair<COutPoint, unsigned int> > setStakeSeenOrphan;
 set<pair<COutPoint, unsigned int> > setStakeSeen;
 
-CBigNum bnProofOfWorkLimit(~uint256(0) >> 20);
-CBigNum bnProofOfStakeLimit(~uint256(0) >> 20);
-CBigNum bnProofOfWorkLimitTestNet(~uint256(0) >> 20);
-CBigNum bnProofOfStakeLimitTestNet(~uint256(0) >> 20);
+arith_uint256 bnProofOfWorkLimit(~arith_uint256(0) >> 20);
+arith_uint256 bnProofOfStakeLimit(~arith_uint256(0) >> 20);
+arith_uint256 bnProofOfWorkLimitTestNet(~arith_uint256(0) >> 20);
+arith_uint256 bnProofOfStakeLimitTestNet(~arith_uint256(0) >> 20);
 
 static const int64_t nTargetTimespan = 30 * 45;
 unsigned int nStakeTargetSpacing = 45;
@@ -70,6 +71,10 @@ uint256 hashBestChain = 0;
 CBlockIndex* pindexBest = NULL;
 int nBestCheckpointHeight = 0;
 
+bool fAddressIndex = false;
+bool fSpentIndex = false;
+bool fBlockStatsIndex = false;
+
 CMedianFilter<int> cPeerBlockCounts(12, 0); // Amount of blocks that other nodes claim to have
 
 // Constant stuff for coinbase transactions we create:
@@ -559,6 +564,9 @@ int64_t CTransaction::GetMinFee(unsigned int nBlockSize, enum GetMinFee_mode mod
 bool CTxMemPool::accept(CTxDB& txdb, CTransaction &tx, bool fCheckInputs,
                         bool* pfMissingInputs)
 {
+    static CMetricLatency& metric = GetMetricLatency("eccoin_mempool_accept_seconds", "Time to validate a loose transaction for the memory pool");
+    CMetricTimer timer(metric);
+
     if (pfMissingInputs)
         *pfMissingInputs = false;
 
@@ -679,10 +687,14 @@ bool CTxMemPool::accept(CTxDB& txdb, CTransaction &tx, bool fCheckInputs,
 
         // Check against previous transactions
         // This is done last to help prevent CPU exhaustion denial-of-service attacks.
-        if (!tx.ConnectInputs(txdb, mapInputs, mapUnused, CDiskTxPos(1,1,1), pindexBest, false, false))
+        vector<CScriptCheck> vChecks;
+        unsigned int nFailed;
+        if (!tx.ConnectInputs(txdb, mapInputs, mapUnused, CDiskTxPos(1,1,1), pindexBest, false, false, &vChecks))
         {
             return error("CTxMemPool::accept() : ConnectInputs failed %s", hash.ToString().substr(0,10).c_str());
         }
+        if (!VerifyScriptChecks(vChecks, nFailed))
+            return tx.DoS(100, error("CTxMemPool::accept() : %s input %u VerifySignature failed", hash.ToString().substr(0,10).c_str(), vChecks[nFailed].GetIn()));
     }
 
     // Store transaction in memory
@@ -930,32 +942,22 @@ bool GetTransaction(const uint256 &hash, CTransaction &tx, uint256 &hashBlock)
 // CBlock and CBlockIndex
 //
 
-static CBlockIndex* pblockindexFBBHLast;
+// Best chain by height, kept in step with pindexBest under cs_main
+static std::vector<CBlockIndex*> vBlockByHeight;
+
+void SetBlockByHeight(CBlockIndex* pindexNew)
+{
+    vBlockByHeight.resize(pindexNew->nHeight + 1);
+    // Only the blocks above the fork point change on a reorganisation
+    for (CBlockIndex* pindex = pindexNew; pindex && vBlockByHeight[pindex->nHeight] != pindex; pindex = pindex->pprev)
+        vBlockByHeight[pindex->nHeight] = pindex;
+}
+
 CBlockIndex* FindBlockByHeight(int nHeight)
 {
-    CBlockIndex *pblockindex;
-    if (nHeight < nBestHeight / 2)
-    {
-        pblockindex = pindexGenesisBlock;
-    }
-    else
-    {
-        pblockindex = pindexBest;
-    }
-    if (pblockindexFBBHLast && abs(nHeight - pblockindex->nHeight) > abs(nHeight - pblockindexFBBHLast->nHeight))
-    {
-        pblockindex = pblockindexFBBHLast;
-    }
-    while (pblockindex->nHeight > nHeight)
-    {
-        pblockindex = pblockindex->pprev;
-    }
-    while (pblockindex->nHeight < nHeight)
-    {
-        pblockindex = pblockindex->pnext;
-    }
-    pblockindexFBBHLast = pblockindex;
-    return pblockindex;
+    if (nHeight < 0 || nHeight >= (int)vBlockByHeight.size())
+        return NULL;
+    return vBlockByHeight[nHeight];
 }
 
 bool CBlock::ReadFromDisk(const CBlockIndex* pindex, bool fReadTransactions)
@@ -1066,15 +1068,33 @@ int64_t GetProofOfStakeReward(int64_t nCoinAge, int nHeight)
 //
 // maximum nBits value could possible be required nTime after
 //
-unsigned int ComputeMaxBits(CBigNum bnTargetLimit, unsigned int nBase, int64_t nTime)
+unsigned int ComputeMaxBits(const arith_uint256& bnTargetLimit, unsigned int nBase, int64_t nTime)
 {
-    CBigNum bnResult;
-    bnResult.SetCompact(nBase);
-    bnResult *= 2;
+    bool fNegative, fOverflow;
+    arith_uint256 bnResult;
+    bnResult.SetCompact(nBase, &fNegative, &fOverflow);
+    if (fNegative)
+    {
+        // never produced by GetNextTargetRequired, keep the historical result
+        CBigNum bnNegative;
+        bnNegative.SetCompact(nBase);
+        bnNegative *= 2;
+        while (nTime > 0)
+        {
+            bnNegative *= 2;
+            nTime -= 24 * 60 * 60;
+        }
+        return bnNegative.GetCompact();
+    }
+    if (fOverflow || bnResult.bits() >= 256)
+        return bnTargetLimit.GetCompact();
+    bnResult <<= 1;
     while (nTime > 0 && bnResult < bnTargetLimit)
     {
         // Maximum 200% adjustment per day...
-        bnResult *= 2;
+        if (bnResult.bits() >= 256)
+            return bnTargetLimit.GetCompact();
+        bnResult <<= 1;
         nTime -= 24 * 60 * 60;
     }
     if (bnResult > bnTargetLimit)
@@ -1104,6 +1124,12 @@ unsigned int ComputeMinStake(unsigned int nBase, int64_t nTime, unsigned int nBl
 // ppcoin: find last block index up to pindex
 const CBlockIndex* GetLastBlockIndex(const CBlockIndex* pindex, bool fProofOfStake)
 {
+    if (pindex && pindex->pindexLastPoW)
+    {
+        // Without a block of that type the walk below would stop at the genesis block
+        const CBlockIndex* pindexLast = fProofOfStake ? pindex->pindexLastPoS : pindex->pindexLastPoW;
+        return pindexLast ? pindexLast : pindex->GetAncestor(0);
+    }
     while (pindex && pindex->pprev && (pindex->IsProofOfStake() != fProofOfStake))
         pindex = pindex->pprev;
     return pindex;
@@ -1111,7 +1137,7 @@ const CBlockIndex* GetLastBlockIndex(const CBlockIndex* pindex, bool fProofOfSta
 
 unsigned int GetNextTargetRequired(const CBlockIndex* pindexLast, bool fProofOfStake)
 {
-        CBigNum bnTargetLimit = bnProofOfWorkLimit;
+        arith_uint256 bnTargetLimit = bnProofOfWorkLimit;
 
         if(fProofOfStake)
         {
@@ -1141,8 +1167,6 @@ unsigned int GetNextTargetRequired(const CBlockIndex* pindexLast, bool fProofOfS
 
         // ppcoin: target change every block
         // ppcoin: retarget with exponential moving toward target spacing
-        CBigNum bnNew;
-        bnNew.SetCompact(pindexPrev->nBits);
         int64_t spacing;
         if (fProofOfStake)
         {
@@ -1154,8 +1178,26 @@ unsigned int GetNextTargetRequired(const CBlockIndex* pindexLast, bool fProofOfS
         }
         int64_t nTargetSpacing = spacing;
         int64_t nInterval = nTargetTimespan / nTargetSpacing;
-        bnNew *= ((nInterval - 1) * nTargetSpacing + nActualSpacing + nActualSpacing);
-        bnNew /= ((nInterval + 1) * nTargetSpacing);
+        int64_t nNumerator = (nInterval - 1) * nTargetSpacing + nActualSpacing + nActualSpacing;
+        int64_t nDenominator = (nInterval + 1) * nTargetSpacing;
+
+        bool fNegative, fOverflow;
+        arith_uint256 bnNew;
+        bnNew.SetCompact(pindexPrev->nBits, &fNegative, &fOverflow);
+        if (fNegative || fOverflow || nNumerator < 0 || bnNew.bits() + arith_uint256(nNumerator).bits() > 256)
+        {
+            // out of 256 bit range, only reachable with a bogus nBits
+            CBigNum bnWide;
+            bnWide.SetCompact(pindexPrev->nBits);
+            bnWide *= nNumerator;
+            bnWide /= nDenominator;
+            if (bnWide > CBigNum(ArithToUint256(bnTargetLimit)))
+                return bnTargetLimit.GetCompact();
+            return bnWide.GetCompact();
+        }
+
+        bnNew *= (uint64_t)nNumerator;
+        bnNew /= (uint64_t)nDenominator;
 
         if (bnNew > bnTargetLimit)
         {
@@ -1172,15 +1214,16 @@ bool CheckProofOfWork(uint256 hash, unsigned int nBits)
     {
         return true;
     }
-    CBigNum bnTarget;
-    bnTarget.SetCompact(nBits);
+    bool fNegative, fOverflow;
+    arith_uint256 bnTarget;
+    bnTarget.SetCompact(nBits, &fNegative, &fOverflow);
 
     // Check range
-    if (bnTarget <= 0 || bnTarget > bnProofOfWorkLimit)
+    if (fNegative || fOverflow || bnTarget == 0 || bnTarget > bnProofOfWorkLimit)
         return error("CheckProofOfWork() : nBits below minimum work");
 
     //Check proof of work matches claimed amount
-    if (hash > bnTarget.getuint256())
+    if (UintToArith256(hash) > bnTarget)
         return error("CheckProofOfWork() : hash doesn't match nBits");
 
     return true;
@@ -1268,6 +1311,9 @@ bool CTransaction::DisconnectInputs(CTxDB& txdb)
             // Write back
             if (!txdb.UpdateTxIndex(prevout.hash, txindex))
                 return error("DisconnectInputs() : UpdateTxIndex failed");
+
+            if (fSpentIndex && !txdb.EraseSpentIndex(prevout))
+                return error("DisconnectInputs() : EraseSpentIndex failed");
         }
     }
 
@@ -1398,7 +1444,7 @@ unsigned int CTransaction::GetP2SHSigOpCount(const MapPrevTx& inputs) const
     return nSigOps;
 }
 
-bool CTransaction::ConnectInputs(CTxDB& txdb, MapPrevTx inputs, map<uint256, CTxIndex>& mapTestPool, const CDiskTxPos& posThisTx, const CBlockIndex* pindexBlock, bool fBlock, bool fMiner)
+bool CTransaction::ConnectInputs(CTxDB& txdb, MapPrevTx inputs, map<uint256, CTxIndex>& mapTestPool, const CDiskTxPos& posThisTx, const CBlockIndex* pindexBlock, bool fBlock, bool fMiner, vector<CScriptCheck>* pvChecks)
 {
     // Take over previous transactions' spent pointers
     // fBlock is true when this is called from AcceptBlock when a new best-block is added to the blockchain
@@ -1457,7 +1503,9 @@ bool CTransaction::ConnectInputs(CTxDB& txdb, MapPrevTx inputs, map<uint256, CTx
             if (!(fBlock && (nBestHeight < Checkpoints::GetTotalBlocksEstimate())))
             {
                 // Verify signature
-                if (!VerifySignature(txPrev, *this, i, 0))
+                if (pvChecks)
+                    pvChecks->push_back(CScriptCheck(txPrev.vout[prevout.n].scriptPubKey, *this, i, 0));
+                else if (!VerifySignature(txPrev, *this, i, 0))
                 {
                     return DoS(100,error("ConnectInputs() : %s VerifySignature failed", GetHash().ToString().substr(0,10).c_str()));
                 }
@@ -1505,7 +1553,7 @@ bool CTransaction::ConnectInputs(CTxDB& txdb, MapPrevTx inputs, map<uint256, CTx
                 return DoS(100, error("ConnectInputs() : %s stake reward exceeded", GetHash().ToString().substr(0,10).c_str()));
 
             }
-            printf("END: nStakeReward = %" PRId64 " , CoinAge = %" PRIu64 " \n", nStakeReward, nCoinAge);
+            LogPrint(LOG_STAKE, "END: nStakeReward = %" PRId64 " , CoinAge = %" PRIu64 " \n", nStakeReward, nCoinAge);
         }
     }
     return true;
@@ -1561,12 +1609,301 @@ bool CTransaction::ClientConnectInputs()
 
 
 
+bool GetAddressIndexKey(const CTxDestination& dest, unsigned char& nAddressType, uint160& hashAddress)
+{
+    if (const CKeyID* pkeyID = boost::get<CKeyID>(&dest))
+    {
+        nAddressType = ADDRESS_TYPE_PUBKEYHASH;
+        hashAddress = *pkeyID;
+        return true;
+    }
+    if (const CScriptID* pscriptID = boost::get<CScriptID>(&dest))
+    {
+        nAddressType = ADDRESS_TYPE_SCRIPTHASH;
+        hashAddress = *pscriptID;
+        return true;
+    }
+    return false;
+}
+
+bool GetAddressIndexKey(const CScript& scriptPubKey, unsigned char& nAddressType, uint160& hashAddress)
+{
+    // Pay-to-pubkey outputs, as in coinstakes, are filed under the key's address
+    CTxDestination dest;
+    if (!ExtractDestination(scriptPubKey, dest))
+        return false;
+    return GetAddressIndexKey(dest, nAddressType, hashAddress);
+}
+
+// Address index: an entry for every output paid to an address and every input
+// spending from one, plus the outputs that are still unspent
+bool ConnectAddressIndex(CTxDB& txdb, const CTransaction& tx, const MapPrevTx& inputs, int nHeight)
+{
+    uint256 hashTx = tx.GetHash();
+    unsigned char nAddressType;
+    uint160 hashAddress;
+
+    if (!tx.IsCoinBase())
+    {
+        for (unsigned int i = 0; i < tx.vin.size(); i++)
+        {
+            const COutPoint& prevout = tx.vin[i].prevout;
+            MapPrevTx::const_iterator mi = inputs.find(prevout.hash);
+            if (mi == inputs.end() || prevout.n >= mi->second.second.vout.size())
+                return error("ConnectAddressIndex() : %s input %u not fetched", hashTx.ToString().c_str(), i);
+            const CTxOut& txoutPrev = mi->second.second.vout[prevout.n];
+            if (!GetAddressIndexKey(txoutPrev.scriptPubKey, nAddressType, hashAddress))
+                continue;
+
+            CAddressUnspentKey keyUnspent(nAddressType, hashAddress, prevout.hash, prevout.n);
+            CAddressIndexValue value(txoutPrev.nValue, -1);
+            txdb.ReadAddressUnspent(keyUnspent, value);
+            if (!txdb.EraseAddressUnspent(keyUnspent) ||
+                !txdb.WriteAddressIndex(CAddressIndexKey(nAddressType, hashAddress, nHeight, hashTx, i, true), value))
+                return error("ConnectAddressIndex() : write failed for %s", hashTx.ToString().c_str());
+        }
+    }
+
+    for (unsigned int i = 0; i < tx.vout.size(); i++)
+    {
+        if (!GetAddressIndexKey(tx.vout[i].scriptPubKey, nAddressType, hashAddress))
+            continue;
+
+        CAddressIndexValue value(tx.vout[i].nValue, nHeight);
+        if (!txdb.WriteAddressIndex(CAddressIndexKey(nAddressType, hashAddress, nHeight, hashTx, i, false), value) ||
+            !txdb.WriteAddressUnspent(CAddressUnspentKey(nAddressType, hashAddress, hashTx, i), value))
+            return error("ConnectAddressIndex() : write failed for %s", hashTx.ToString().c_str());
+    }
+    return true;
+}
+
+bool DisconnectAddressIndex(CTxDB& txdb, const CTransaction& tx, const MapPrevTx& inputs, int nHeight)
+{
+    uint256 hashTx = tx.GetHash();
+    unsigned char nAddressType;
+    uint160 hashAddress;
+
+    for (unsigned int i = 0; i < tx.vout.size(); i++)
+    {
+        if (!GetAddressIndexKey(tx.vout[i].scriptPubKey, nAddressType, hashAddress))
+            continue;
+
+        if (!txdb.EraseAddressIndex(CAddressIndexKey(nAddressType, hashAddress, nHeight, hashTx, i, false)) ||
+            !txdb.EraseAddressUnspent(CAddressUnspentKey(nAddressType, hashAddress, hashTx, i)))
+            return error("DisconnectAddressIndex() : erase failed for %s", hashTx.ToString().c_str());
+    }
+
+    if (tx.IsCoinBase())
+        return true;
+
+    // The spending entries hold what is needed to put the spent outputs back
+    for (unsigned int i = 0; i < tx.vin.size(); i++)
+    {
+        const COutPoint& prevout = tx.vin[i].prevout;
+        MapPrevTx::const_iterator mi = inputs.find(prevout.hash);
+        if (mi == inputs.end() || prevout.n >= mi->second.second.vout.size())
+            return error("DisconnectAddressIndex() : %s input %u not fetched", hashTx.ToString().c_str(), i);
+        const CTxOut& txoutPrev = mi->second.second.vout[prevout.n];
+        if (!GetAddressIndexKey(txoutPrev.scriptPubKey, nAddressType, hashAddress))
+            continue;
+
+        CAddressIndexKey key(nAddressType, hashAddress, nHeight, hashTx, i, true);
+        CAddressIndexValue value(txoutPrev.nValue, -1);
+        txdb.ReadAddressIndex(key, value);
+        if (!txdb.EraseAddressIndex(key) ||
+            !txdb.WriteAddressUnspent(CAddressUnspentKey(nAddressType, hashAddress, prevout.hash, prevout.n), value))
+            return error("DisconnectAddressIndex() : write failed for %s", hashTx.ToString().c_str());
+    }
+    return true;
+}
+
+// Hands every best-chain block from nFirstHeight up to pfnBlock, committing
+// what it writes in one batch per block
+static bool ReplayBestChain(CTxDB& txdb, const char* pszName, int nFirstHeight,
+                            bool (*pfnBlock)(CTxDB& txdb, const CBlock& block, CBlockIndex* pindex))
+{
+    printf("Building the %s from block %d to %d\n", pszName, nFirstHeight, nBestHeight);
+    int64_t nStart = GetTimeMillis();
+
+    LOCK(cs_main);
+    for (int nHeight = nFirstHeight; nHeight <= nBestHeight; nHeight++)
+    {
+        if (fRequestShutdown)
+            return true;
+        CBlockIndex* pindex = FindBlockByHeight(nHeight);
+        CBlock block;
+        if (!block.ReadFromDisk(pindex))
+            return error("ReplayBestChain() : ReadFromDisk failed at height %d", nHeight);
+
+        if (!txdb.TxnBegin())
+            return error("ReplayBestChain() : TxnBegin failed");
+        if (!pfnBlock(txdb, block, pindex))
+        {
+            txdb.TxnAbort();
+            return error("ReplayBestChain() : building the %s failed at height %d", pszName, nHeight);
+        }
+        if (!txdb.TxnCommit())
+            return error("ReplayBestChain() : TxnCommit failed");
+
+        if (nHeight > 0 && nHeight % 10000 == 0)
+            printf("Building the %s, at height %d\n", pszName, nHeight);
+    }
+
+    printf("Built the %s in %" PRId64 " ms\n", pszName, GetTimeMillis() - nStart);
+    return true;
+}
+
+static bool ReplayAddressIndex(CTxDB& txdb, const CBlock& block, CBlockIndex* pindex)
+{
+    BOOST_FOREACH(const CTransaction& tx, block.vtx)
+    {
+        MapPrevTx mapInputs;
+        map<uint256, CTxIndex> mapUnused;
+        bool fInvalid;
+        if (!tx.IsCoinBase() && !tx.FetchInputs(txdb, mapUnused, true, false, mapInputs, fInvalid))
+            return error("ReplayAddressIndex() : FetchInputs failed for %s", tx.GetHash().ToString().c_str());
+        if (!ConnectAddressIndex(txdb, tx, mapInputs, pindex->nHeight))
+            return false;
+    }
+    return true;
+}
+
+bool SyncAddressIndex()
+{
+    CTxDB txdb;
+    bool fBuilt = false;
+    txdb.ReadAddressIndexFlag(fBuilt);
+    if (fBuilt == fAddressIndex)
+        return true;
+
+    // Switched off, the records are dropped; switched on, built from scratch
+    if (!txdb.WipeAddressIndex())
+        return error("SyncAddressIndex() : WipeAddressIndex failed");
+    if (!fAddressIndex)
+        return txdb.WriteAddressIndexFlag(false);
+
+    uiInterface.InitMessage(_("Building address index..."));
+    // The genesis block is never connected, so its outputs are not indexed
+    if (!ReplayBestChain(txdb, "address index", 1, ReplayAddressIndex))
+        return false;
+    if (fRequestShutdown)
+        return true;
+    return txdb.WriteAddressIndexFlag(true);
+}
+
+static bool ConnectSpentIndex(CTxDB& txdb, const CBlock& block, CBlockIndex* pindex)
+{
+    // Only the spending inputs are needed, so the previous transactions are not read
+    BOOST_FOREACH(const CTransaction& tx, block.vtx)
+    {
+        if (tx.IsCoinBase())
+            continue;
+        uint256 hashTx = tx.GetHash();
+        for (unsigned int i = 0; i < tx.vin.size(); i++)
+            if (!txdb.WriteSpentIndex(tx.vin[i].prevout, CSpentIndexValue(hashTx, i, pindex->nHeight)))
+                return error("ConnectSpentIndex() : WriteSpentIndex failed for %s", hashTx.ToString().c_str());
+    }
+    return true;
+}
+
+bool SyncSpentIndex()
+{
+    CTxDB txdb;
+    bool fBuilt = false;
+    txdb.ReadSpentIndexFlag(fBuilt);
+    if (fBuilt == fSpentIndex)
+        return true;
+
+    // Switched off, the records are dropped; switched on, built from scratch
+    if (!txdb.WipeSpentIndex())
+        return error("SyncSpentIndex() : WipeSpentIndex failed");
+    if (!fSpentIndex)
+        return txdb.WriteSpentIndexFlag(false);
+
+    uiInterface.InitMessage(_("Building spent index..."));
+    if (!ReplayBestChain(txdb, "spent index", 1, ConnectSpentIndex))
+        return false;
+    if (fRequestShutdown)
+        return true;
+    return txdb.WriteSpentIndexFlag(true);
+}
+
+// Completes the running total of transactions from the parent's record and
+// stores the stats under the block hash. Records are never erased: a block
+// that is disconnected keeps its stats, which stay right for that block.
+static bool WriteBlockStats(CTxDB& txdb, CBlockStats& stats, const CBlockIndex* pindex)
+{
+    stats.nChainTx = stats.nTx;
+    if (pindex->pprev)
+    {
+        CBlockStats statsPrev;
+        if (!txdb.ReadBlockStats(pindex->pprev->GetBlockHash(), statsPrev))
+            return error("WriteBlockStats() : no stats for block %s", pindex->pprev->GetBlockHash().ToString().c_str());
+        stats.nChainTx += statsPrev.nChainTx;
+    }
+    if (!txdb.WriteBlockStats(pindex->GetBlockHash(), stats))
+        return error("WriteBlockStats() : WriteBlockStats failed");
+    return true;
+}
+
+static bool ReplayBlockStats(CTxDB& txdb, const CBlock& block, CBlockIndex* pindex)
+{
+    CBlockStats stats;
+    stats.nSize = ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_FOREACH(const CTransaction& tx, block.vtx)
+    {
+        MapPrevTx mapInputs;
+        map<uint256, CTxIndex> mapUnused;
+        bool fInvalid;
+        // Outputs spent within the same block are already in the transaction index
+        if (!tx.IsCoinBase() && !tx.FetchInputs(txdb, mapUnused, true, false, mapInputs, fInvalid))
+            return error("ReplayBlockStats() : FetchInputs failed for %s", tx.GetHash().ToString().c_str());
+        stats.AddTx(tx, tx.GetValueIn(mapInputs));
+    }
+    return WriteBlockStats(txdb, stats, pindex);
+}
+
+bool SyncBlockStatsIndex()
+{
+    CTxDB txdb;
+    bool fBuilt = false;
+    txdb.ReadBlockStatsFlag(fBuilt);
+    if (fBuilt == fBlockStatsIndex)
+        return true;
+
+    // Switched off, the records are dropped; switched on, built from scratch
+    if (!txdb.WipeBlockStats())
+        return error("SyncBlockStatsIndex() : WipeBlockStats failed");
+    if (!fBlockStatsIndex)
+        return txdb.WriteBlockStatsFlag(false);
+
+    uiInterface.InitMessage(_("Building block stats index..."));
+    // The genesis block gets a record too, as the start of the running total
+    if (!ReplayBestChain(txdb, "block stats index", 0, ReplayBlockStats))
+        return false;
+    if (fRequestShutdown)
+        return true;
+    return txdb.WriteBlockStatsFlag(true);
+}
+
 bool CBlock::DisconnectBlock(CTxDB& txdb, CBlockIndex* pindex)
 {
     // Disconnect in reverse order
     for (int i = vtx.size()-1; i >= 0; i--)
+    {
+        if (fAddressIndex)
+        {
+            MapPrevTx mapInputs;
+            map<uint256, CTxIndex> mapUnused;
+            bool fInvalid;
+            if (!vtx[i].IsCoinBase() && !vtx[i].FetchInputs(txdb, mapUnused, true, false, mapInputs, fInvalid))
+                return error("DisconnectBlock() : FetchInputs failed for %s", vtx[i].GetHash().ToString().c_str());
+            if (!DisconnectAddressIndex(txdb, vtx[i], mapInputs, pindex->nHeight))
+                return false;
+        }
         if (!vtx[i].DisconnectInputs(txdb))
             return false;
+    }
 
     // Update block index on disk without changing it in memory.
     // The memory index structure will be changed after the db commits.
@@ -1587,6 +1924,9 @@ bool CBlock::DisconnectBlock(CTxDB& txdb, CBlockIndex* pindex)
 
 bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fJustCheck)
 {
+    static CMetricLatency& metric = GetMetricLatency("eccoin_connectblock_seconds", "Time to connect a block to the chain state");
+    CMetricTimer timer(metric);
+
     // Check it again in case a previous version let a bad block in, but skip BlockSig checking
     if (!CheckBlock(!fJustCheck, !fJustCheck, false))
         return false;
@@ -1605,6 +1945,8 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fJustCheck)
     int64_t nValueIn = 0;
     int64_t nValueOut = 0;
     unsigned int nSigOps = 0;
+    vector<CScriptCheck> vChecks;
+    CBlockStats stats;
     BOOST_FOREACH(CTransaction& tx, vtx)
     {
         uint256 hashTx = tx.GetHash();
@@ -1638,7 +1980,10 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fJustCheck)
 
         MapPrevTx mapInputs;
         if (tx.IsCoinBase())
+        {
             nValueOut += tx.GetValueOut();
+            stats.AddTx(tx, 0);
+        }
         else
         {
             bool fInvalid;
@@ -1658,14 +2003,28 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fJustCheck)
             nValueOut += nTxValueOut;
             if (!tx.IsCoinStake())
                 nFees += nTxValueIn - nTxValueOut;
+            stats.AddTx(tx, nTxValueIn);
 
-            if (!tx.ConnectInputs(txdb, mapInputs, mapQueuedChanges, posThisTx, pindex, true, false))
+            if (!tx.ConnectInputs(txdb, mapInputs, mapQueuedChanges, posThisTx, pindex, true, false, &vChecks))
                 return false;
         }
 
+        // Written into the caller's batch, which is dropped if the block fails
+        if (fAddressIndex && !fJustCheck && !ConnectAddressIndex(txdb, tx, mapInputs, pindex->nHeight))
+            return false;
+
         mapQueuedChanges[hashTx] = CTxIndex(posThisTx, tx.vout.size());
     }
 
+    // Signatures of every input in the block, verified together
+    unsigned int nFailed;
+    if (!VerifyScriptChecks(vChecks, nFailed))
+    {
+        const CScriptCheck& check = vChecks[nFailed];
+        return DoS(100, error("ConnectBlock() : %s input %u VerifySignature failed",
+                              check.GetTx().GetHash().ToString().substr(0,10).c_str(), check.GetIn()));
+    }
+
     uint256 prevHash = 0;
     if(pindex->pprev)
     {
@@ -1682,6 +2041,23 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fJustCheck)
     if (fJustCheck)
         return true;
 
+    // Goes into the block's batch together with the txindex changes
+    if (fSpentIndex && !ConnectSpentIndex(txdb, *this, pindex))
+        return false;
+
+    if (fBlockStatsIndex)
+    {
+        stats.nSize = ::GetSerializeSize(*this, SER_NETWORK, PROTOCOL_VERSION);
+        // The stats index is local bookkeeping and must not reject a valid
+        // block: drop it, and -blockstatsindex rebuilds it at next start
+        if (!WriteBlockStats(txdb, stats, pindex))
+        {
+            printf("ConnectBlock() : block stats index disabled until restart\n");
+            fBlockStatsIndex = false;
+            CTxDB().WriteBlockStatsFlag(false);
+        }
+    }
+
     // Write queued txindex changes
     for (map<uint256, CTxIndex>::iterator mi = mapQueuedChanges.begin(); mi != mapQueuedChanges.end(); ++mi)
     {
@@ -1907,7 +2283,7 @@ bool CBlock::SetBestChain(CTxDB& txdb, CBlockIndex* pindexNew)
     // New best block
     hashBestChain = hash;
     pindexBest = pindexNew;
-    pblockindexFBBHLast = NULL;
+    SetBlockByHeight(pindexNew);
     nBestHeight = pindexBest->nHeight;
     nBestChainTrust = pindexNew->nChainTrust;
     nBestTimeReceived = GetTime();
@@ -1915,12 +2291,14 @@ bool CBlock::SetBestChain(CTxDB& txdb, CBlockIndex* pindexNew)
 
     uint256 nBestBlockTrust = pindexBest->nHeight != 0 ? (pindexBest->nChainTrust - pindexBest->pprev->nChainTrust) : pindexBest->nChainTrust;
 
-
-    printf("SetBestChain: new best=%s  height=%d  trust=%s  blocktrust=%" PRId64 "  date=%s\n",
-      hashBestChain.ToString().substr(0,20).c_str(), nBestHeight,
-      CBigNum(nBestChainTrust).ToString().c_str(),
-      nBestBlockTrust.Get64(),
-      DateTimeStrFormat("%x %H:%M:%S", pindexBest->GetBlockTime()).c_str());
+    // During initial download report progress every few seconds rather than for every block
+    static CLogRateLimiter limiterBestChain;
+    if (!fIsInitialDownload || LogAcceptCategory(LOG_CHAIN) || limiterBestChain.Allow(5, 1))
+        printf("SetBestChain: new best=%s  height=%d  trust=%s  blocktrust=%" PRId64 "  date=%s\n",
+          hashBestChain.ToString().substr(0,20).c_str(), nBestHeight,
+          CBigNum(nBestChainTrust).ToString().c_str(),
+          nBestBlockTrust.Get64(),
+          DateTimeStrFormat("%x %H:%M:%S", pindexBest->GetBlockTime()).c_str());
 
 
     // Check the version of the last 100 blocks to see if we need to upgrade:
@@ -2080,6 +2458,7 @@ bool CBlock::AddToBlockIndex(unsigned int nFile, unsigned int nBlockPos, const u
         pindexNew->pprev = (*miPrev).second;
         pindexNew->nHeight = pindexNew->pprev->nHeight + 1;
     }
+    pindexNew->BuildSkip();
 
     // ppcoin: compute chain trust score
     pindexNew->nChainTrust = (pindexNew->pprev ? pindexNew->pprev->nChainTrust : 0) + pindexNew->GetBlockTrust();
@@ -2378,13 +2757,79 @@ bool CBlock::AcceptBlock(CBlock* pblock)
 
 uint256 CBlockIndex::GetBlockTrust() const
 {
-    CBigNum bnTarget;
-    bnTarget.SetCompact(nBits);
+    bool fNegative, fOverflow;
+    arith_uint256 bnTarget;
+    bnTarget.SetCompact(nBits, &fNegative, &fOverflow);
 
-    if (bnTarget <= 0)
+    if (fNegative || fOverflow || bnTarget == 0)
         return 0;
 
-    return ((CBigNum(1)<<256) / (bnTarget+1)).getuint256();
+    // 2**256 / (bnTarget+1) does not fit in 256 bits, but it is equal to
+    // (~bnTarget / (bnTarget+1)) + 1
+    if (bnTarget == ~arith_uint256(0))
+        return 1;
+    return ArithToUint256((~bnTarget / (bnTarget + 1)) + 1);
+}
+
+// Turn the lowest set bit off
+static inline int InvertLowestOne(int n)
+{
+    return n & (n - 1);
+}
+
+// Height pskip points to; every height is reachable from any descendant in
+// O(log n) jumps
+static inline int GetSkipHeight(int nHeight)
+{
+    if (nHeight < 2)
+        return 0;
+    // Odd heights jump less far than even ones, so that a walk that skipped
+    // past its target is not left with only pprev steps
+    return (nHeight & 1) ? InvertLowestOne(InvertLowestOne(nHeight - 1)) + 1 : InvertLowestOne(nHeight);
+}
+
+void CBlockIndex::BuildSkip()
+{
+    pskip = pprev ? pprev->GetAncestor(GetSkipHeight(nHeight)) : NULL;
+    pindexLastPoW = pprev ? pprev->pindexLastPoW : NULL;
+    pindexLastPoS = pprev ? pprev->pindexLastPoS : NULL;
+    if (IsProofOfStake())
+        pindexLastPoS = this;
+    else
+        pindexLastPoW = this;
+}
+
+CBlockIndex* CBlockIndex::GetAncestor(int nHeightIn)
+{
+    if (nHeightIn > nHeight || nHeightIn < 0)
+        return NULL;
+
+    CBlockIndex* pindexWalk = this;
+    int nHeightWalk = nHeight;
+    while (nHeightWalk > nHeightIn)
+    {
+        int nHeightSkip = GetSkipHeight(nHeightWalk);
+        int nHeightSkipPrev = GetSkipHeight(nHeightWalk - 1);
+        // Take the jump unless pprev's jump gets closer without overshooting
+        if (pindexWalk->pskip != NULL &&
+            (nHeightSkip == nHeightIn ||
+             (nHeightSkip > nHeightIn && !(nHeightSkipPrev < nHeightSkip - 2 && nHeightSkipPrev >= nHeightIn))))
+        {
+            pindexWalk = pindexWalk->pskip;
+            nHeightWalk = nHeightSkip;
+        }
+        else
+        {
+            pindexWalk = pindexWalk->pprev;
+            nHeightWalk--;
+        }
+    }
+    return pindexWalk;
+}
+
+const CBlockIndex* CBlockIndex::GetAncestor(int nHeightIn) const
+{
+    return const_cast<CBlockIndex*>(this)->GetAncestor(nHeightIn);
 }
 
 bool CBlockIndex::IsSuperMajority(int minVersion, const CBlockIndex* pstart, unsigned int nRequired, unsigned int nToCheck)
@@ -2401,6 +2846,9 @@ bool CBlockIndex::IsSuperMajority(int minVersion, const CBlockIndex* pstart, uns
 
 bool ProcessBlock(CNode* pfrom, CBlock* pblock)
 {
+    static CMetricLatency& metric = GetMetricLatency("eccoin_processblock_seconds", "Time to process a received or generated block");
+    CMetricTimer timer(metric);
+
     // Check for duplicate
     uint256 hash = pblock->GetHash();
     if (mapBlockIndex.count(hash))
@@ -2595,12 +3043,9 @@ bool CBlock::CheckBlockSignature() const
             if (whichType == TX_PUBKEY)
             {
                 valtype& vchPubKey = vSolutions[0];
-                CKey key;
-                if (!key.SetPubKey(vchPubKey))
-                    return false;
                 if (vchBlockSig.empty())
                     return false;
-                return key.Verify(GetHash(), vchBlockSig);
+                return CPubKey(vchPubKey).Verify(GetHash(), vchBlockSig);
             }
         }
         else
@@ -2616,12 +3061,9 @@ bool CBlock::CheckBlockSignature() const
                 {
                     // Verify
                     valtype& vchPubKey = vSolutions[0];
-                    CKey key;
-                    if (!key.SetPubKey(vchPubKey))
-                        continue;
                     if (vchBlockSig.empty())
                         continue;
-                    if(!key.Verify(GetHash(), vchBlockSig))
+                    if(!CPubKey(vchPubKey).Verify(GetHash(), vchBlockSig))
                         continue;
 
                     return true;
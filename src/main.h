@@ -6,6 +6,7 @@
 #define BITCOIN_MAIN_H
 
 #include "bignum.h"
+#include "arith_uint256.h"
 #include "sync.h"
 #include "net.h"
 #include "script.h"
@@ -32,10 +33,10 @@ class CNode;
 
 static const int LAST_POW_BLOCK = 86400;
 
-extern CBigNum bnProofOfWorkLimit;
-extern CBigNum bnProofOfStakeLimit;
-extern CBigNum bnProofOfWorkLimitTestNet;
-extern CBigNum bnProofOfStakeLimitTestNet;
+extern arith_uint256 bnProofOfWorkLimit;
+extern arith_uint256 bnProofOfStakeLimit;
+extern arith_uint256 bnProofOfWorkLimitTestNet;
+extern arith_uint256 bnProofOfStakeLimitTestNet;
 
 static const unsigned int MAX_BLOCK_SIZE = 1000000;
 static const unsigned int MAX_BLOCK_SIZE_GEN = MAX_BLOCK_SIZE/2;
@@ -110,6 +111,9 @@ extern bool fUseFastIndex;
 extern unsigned int nDerivationMethodIndex;
 
 extern bool fEnforceCanonical;
+extern bool fAddressIndex;
+extern bool fSpentIndex;
+extern bool fBlockStatsIndex;
 
 // Minimum disk space required - used in CheckDiskSpace()
 static const uint64_t nMinDiskSpace = 52428800;
@@ -127,13 +131,16 @@ FILE* OpenBlockFile(unsigned int nFile, unsigned int nBlockPos, const char* pszM
 FILE* AppendBlockFile(unsigned int& nFileRet);
 bool LoadBlockIndex(bool fAllowNew=true);
 void PrintBlockTree();
+/** Block of the best chain at nHeight, or NULL when out of range (cs_main must be held) */
 CBlockIndex* FindBlockByHeight(int nHeight);
+void SetBlockByHeight(CBlockIndex* pindexNew);
 bool LoadExternalBlockFile(FILE* fileIn);
 
 bool CheckProofOfWork(uint256 hash, unsigned int nBits);
 unsigned int GetNextTargetRequired(const CBlockIndex* pindexLast, bool fProofOfStake);
 int64_t GetProofOfWorkReward(int64_t nFees, const int nHeight, uint256 prevHash);
 int64_t GetProofOfStakeReward(int64_t nCoinAge, int nHeight);
+unsigned int ComputeMaxBits(const arith_uint256& bnTargetLimit, unsigned int nBase, int64_t nTime);
 unsigned int ComputeMinWork(unsigned int nBase, int64_t nTime);
 unsigned int ComputeMinStake(unsigned int nBase, int64_t nTime, unsigned int nBlockTime);
 int GetNumBlocksOfPeers();
@@ -710,11 +717,14 @@ public:
         @param[in] pindexBlock
         @param[in] fBlock	true if called from ConnectBlock
         @param[in] fMiner	true if called from CreateNewBlock
+        @param[out] pvChecks	if given, script checks are appended here for the caller
+                                to run with VerifyScriptChecks instead of being run inline
         @return Returns true if all checks succeed
      */
     bool ConnectInputs(CTxDB& txdb, MapPrevTx inputs,
                        std::map<uint256, CTxIndex>& mapTestPool, const CDiskTxPos& posThisTx,
-                       const CBlockIndex* pindexBlock, bool fBlock, bool fMiner);
+                       const CBlockIndex* pindexBlock, bool fBlock, bool fMiner,
+                       std::vector<CScriptCheck>* pvChecks = NULL);
     bool ClientConnectInputs();
     bool CheckTransaction() const;
     bool AcceptToMemoryPool(CTxDB& txdb, bool fCheckInputs=true, bool* pfMissingInputs=NULL);
@@ -845,6 +855,246 @@ public:
 };
 
 
+/** Address index entry: an output paid to, or an input spending from, an
+ * address. The height is stored big-endian so that the entries of one
+ * address iterate in chain order.
+ */
+class CAddressIndexKey
+{
+public:
+    unsigned char nAddressType;
+    uint160 hashAddress;
+    int nHeight;
+    uint256 hashTx;
+    unsigned int nIndex;
+    bool fSpending;
+
+    CAddressIndexKey()
+    {
+        nAddressType = 0;
+        hashAddress = 0;
+        nHeight = 0;
+        hashTx = 0;
+        nIndex = 0;
+        fSpending = false;
+    }
+
+    CAddressIndexKey(unsigned char nAddressTypeIn, const uint160& hashAddressIn, int nHeightIn, const uint256& hashTxIn, unsigned int nIndexIn, bool fSpendingIn)
+    {
+        nAddressType = nAddressTypeIn;
+        hashAddress = hashAddressIn;
+        nHeight = nHeightIn;
+        hashTx = hashTxIn;
+        nIndex = nIndexIn;
+        fSpending = fSpendingIn;
+    }
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        return 1 + 20 + 4 + 32 + 4 + 1;
+    }
+
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        unsigned char pchHeight[4] = { (unsigned char)(nHeight >> 24), (unsigned char)(nHeight >> 16),
+                                       (unsigned char)(nHeight >> 8), (unsigned char)nHeight };
+        ::Serialize(s, nAddressType, nType, nVersion);
+        ::Serialize(s, hashAddress, nType, nVersion);
+        s.write((const char*)pchHeight, sizeof(pchHeight));
+        ::Serialize(s, hashTx, nType, nVersion);
+        ::Serialize(s, nIndex, nType, nVersion);
+        ::Serialize(s, fSpending, nType, nVersion);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        unsigned char pchHeight[4];
+        ::Unserialize(s, nAddressType, nType, nVersion);
+        ::Unserialize(s, hashAddress, nType, nVersion);
+        s.read((char*)pchHeight, sizeof(pchHeight));
+        nHeight = (pchHeight[0] << 24) | (pchHeight[1] << 16) | (pchHeight[2] << 8) | pchHeight[3];
+        ::Unserialize(s, hashTx, nType, nVersion);
+        ::Unserialize(s, nIndex, nType, nVersion);
+        ::Unserialize(s, fSpending, nType, nVersion);
+    }
+};
+
+/** An output of an address that is not spent yet */
+class CAddressUnspentKey
+{
+public:
+    unsigned char nAddressType;
+    uint160 hashAddress;
+    uint256 hashTx;
+    unsigned int nIndex;
+
+    CAddressUnspentKey()
+    {
+        nAddressType = 0;
+        hashAddress = 0;
+        hashTx = 0;
+        nIndex = 0;
+    }
+
+    CAddressUnspentKey(unsigned char nAddressTypeIn, const uint160& hashAddressIn, const uint256& hashTxIn, unsigned int nIndexIn)
+    {
+        nAddressType = nAddressTypeIn;
+        hashAddress = hashAddressIn;
+        hashTx = hashTxIn;
+        nIndex = nIndexIn;
+    }
+
+    IMPLEMENT_SERIALIZE
+    (
+        READWRITE(nAddressType);
+        READWRITE(hashAddress);
+        READWRITE(hashTx);
+        READWRITE(nIndex);
+    )
+};
+
+/** Value of an output. For a spending entry it is the output spent, with the
+ * height it was created at, so that disconnecting the block can restore it.
+ */
+class CAddressIndexValue
+{
+public:
+    int64_t nValue;
+    int nHeight;
+
+    CAddressIndexValue()
+    {
+        nValue = 0;
+        nHeight = -1;
+    }
+
+    CAddressIndexValue(int64_t nValueIn, int nHeightIn)
+    {
+        nValue = nValueIn;
+        nHeight = nHeightIn;
+    }
+
+    IMPLEMENT_SERIALIZE
+    (
+        READWRITE(nValue);
+        READWRITE(nHeight);
+    )
+};
+
+enum
+{
+    ADDRESS_TYPE_PUBKEYHASH = 1,
+    ADDRESS_TYPE_SCRIPTHASH = 2,
+};
+
+/** Address index key of a destination; false for outputs without an address */
+bool GetAddressIndexKey(const CTxDestination& dest, unsigned char& nAddressType, uint160& hashAddress);
+bool GetAddressIndexKey(const CScript& scriptPubKey, unsigned char& nAddressType, uint160& hashAddress);
+/** Add or remove the address index entries of a transaction, given its fetched inputs */
+bool ConnectAddressIndex(CTxDB& txdb, const CTransaction& tx, const MapPrevTx& inputs, int nHeight);
+bool DisconnectAddressIndex(CTxDB& txdb, const CTransaction& tx, const MapPrevTx& inputs, int nHeight);
+/** Build the address index from the block files when -addressindex is switched on, drop it when switched off */
+bool SyncAddressIndex();
+
+/** Spent index entry: the input that spends an outpoint, keyed by the outpoint */
+class CSpentIndexValue
+{
+public:
+    uint256 hashTx;
+    unsigned int nIndex;
+    int nHeight;
+
+    CSpentIndexValue()
+    {
+        hashTx = 0;
+        nIndex = 0;
+        nHeight = -1;
+    }
+
+    CSpentIndexValue(const uint256& hashTxIn, unsigned int nIndexIn, int nHeightIn)
+    {
+        hashTx = hashTxIn;
+        nIndex = nIndexIn;
+        nHeight = nHeightIn;
+    }
+
+    IMPLEMENT_SERIALIZE
+    (
+        READWRITE(hashTx);
+        READWRITE(nIndex);
+        READWRITE(nHeight);
+    )
+};
+
+/** Build the spent index from the block files when -spentindex is switched on, drop it when switched off */
+bool SyncSpentIndex();
+
+/** Totals of one block, kept by -blockstatsindex so that ranges of blocks can
+ * be summarised without reading the block files. Amounts are in satoshis; the
+ * mint and money supply are already in the block index.
+ */
+class CBlockStats
+{
+public:
+    unsigned int nTx;
+    unsigned int nSize;
+    unsigned int nInputs;
+    unsigned int nOutputs;
+    int64_t nValueOut;
+    /** Fees of the ordinary transactions */
+    int64_t nFees;
+    /** Outputs minus inputs of the coinstake */
+    int64_t nStakeReward;
+    /** Transactions in the chain up to and including this block */
+    int64_t nChainTx;
+
+    CBlockStats()
+    {
+        nTx = 0;
+        nSize = 0;
+        nInputs = 0;
+        nOutputs = 0;
+        nValueOut = 0;
+        nFees = 0;
+        nStakeReward = 0;
+        nChainTx = 0;
+    }
+
+    IMPLEMENT_SERIALIZE
+    (
+        READWRITE(nTx);
+        READWRITE(nSize);
+        READWRITE(nInputs);
+        READWRITE(nOutputs);
+        READWRITE(nValueOut);
+        READWRITE(nFees);
+        READWRITE(nStakeReward);
+        READWRITE(nChainTx);
+    )
+
+    /** Count a transaction of the block; nValueIn is zero for the coinbase */
+    void AddTx(const CTransaction& tx, int64_t nValueIn)
+    {
+        int64_t nTxValueOut = tx.GetValueOut();
+        nTx++;
+        nOutputs += tx.vout.size();
+        nValueOut += nTxValueOut;
+        if (tx.IsCoinBase())
+            return;
+        nInputs += tx.vin.size();
+        if (tx.IsCoinStake())
+            nStakeReward += nTxValueOut - nValueIn;
+        else
+            nFees += nValueIn - nTxValueOut;
+    }
+};
+
+/** Build the block stats index from the block files when -blockstatsindex is switched on, drop it when switched off */
+bool SyncBlockStatsIndex();
+
+
 
 
 
@@ -1173,6 +1423,12 @@ public:
     const uint256* phashBlock;
     CBlockIndex* pprev;
     CBlockIndex* pnext;
+    // in-memory only, set by BuildSkip(): an ancestor further back for
+    // GetAncestor(), and the last proof-of-work and proof-of-stake blocks up
+    // to and including this one
+    CBlockIndex* pskip;
+    CBlockIndex* pindexLastPoW;
+    CBlockIndex* pindexLastPoS;
     unsigned int nFile;
     unsigned int nBlockPos;
     uint256 nChainTrust; // ppcoin: trust score of block chain
@@ -1209,6 +1465,9 @@ public:
         phashBlock = NULL;
         pprev = NULL;
         pnext = NULL;
+        pskip = NULL;
+        pindexLastPoW = NULL;
+        pindexLastPoS = NULL;
         nFile = 0;
         nBlockPos = 0;
         nHeight = 0;
@@ -1234,6 +1493,9 @@ public:
         phashBlock = NULL;
         pprev = NULL;
         pnext = NULL;
+        pskip = NULL;
+        pindexLastPoW = NULL;
+        pindexLastPoS = NULL;
         nFile = nFileIn;
         nBlockPos = nBlockPosIn;
         nHeight = 0;
@@ -1288,6 +1550,12 @@ public:
 
     uint256 GetBlockTrust() const;
 
+    /** Set the pointers above once pprev and nHeight are known and pprev's are built */
+    void BuildSkip();
+    /** The ancestor at nHeightIn, in O(log n) steps; NULL if above this block */
+    CBlockIndex* GetAncestor(int nHeightIn);
+    const CBlockIndex* GetAncestor(int nHeightIn) const;
+
     bool IsInMainChain() const
     {
         return (pnext || this == pindexBest);
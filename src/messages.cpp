@@ -43,7 +43,7 @@ bool ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
 {
     static map<CService, CPubKey> mapReuseKey;
     RandAddSeedPerfmon();
-    if(messageDebug)
+    if (LogAcceptCategory(LOG_MESSAGES))
         printf("received: %s (%" PRIszu " bytes)\n", strCommand.c_str(), vRecv.size());
     if (mapArgs.count("-dropmessagestest") && GetRand(atoi(mapArgs["-dropmessagestest"])) == 0)
     {
@@ -143,7 +143,7 @@ bool ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
         // Ask a peer with more blocks than us for missing blocks
         if (pfrom->nStartingHeight > (nBestHeight - 144))
         {
-            if(messageDebug)
+            if (LogAcceptCategory(LOG_MESSAGES))
             {
                 printf("peer has more blocks than us \n");
             }
@@ -151,7 +151,7 @@ bool ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
         }
         else
         {
-            if(messageDebug)
+            if (LogAcceptCategory(LOG_MESSAGES))
                 printf("peer does not have more blocks than us \n");
         }
 
@@ -271,14 +271,14 @@ bool ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
         for (unsigned int nInv = 0; nInv < vInv.size(); nInv++)
         {
             const CInv &inv = vInv[nInv];
-            if(messageDebug)
+            if (LogAcceptCategory(LOG_MESSAGES))
             {
                 printf("inv hash type = %s \n", inv.GetCommand());
             }
             if (fShutdown)
                 return true;
             bool fAlreadyHave = AlreadyHave(txdb, inv);
-            if(messageDebug)
+            if (LogAcceptCategory(LOG_MESSAGES))
             {
                 printf("  got inventory: %s  %s\n", inv.ToString().c_str(), fAlreadyHave ? "have" : "new");
             }
@@ -297,7 +297,7 @@ bool ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
                 // the last block in an inv bundle sent in response to getblocks. Try to detect
                 // this situation and push another getblocks to continue.
                 pfrom->PushGetBlocks(mapBlockIndex[inv.hash], uint256(0));
-                if (messageDebug)
+                if (LogAcceptCategory(LOG_MESSAGES))
                 {
                     printf("force request: %s\n", inv.ToString().c_str());
                 }
@@ -324,10 +324,7 @@ bool ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
         {
             if (fShutdown)
                 return true;
-            if (messageDebug || (vInv.size() == 1))
-            {
-               printf("received getdata for: %s\n", inv.ToString().c_str());
-            }
+            LogPrint(LOG_NET | LOG_MESSAGES, "received getdata for: %s\n", inv.ToString().c_str());
 
             if (inv.type == MSG_BLOCK)
             {
@@ -385,7 +382,7 @@ bool ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
                 pindex = pindex->pnext;
             int nLimit = 500;
             bool hitSync = false;
-            if(messageDebug)
+            if (LogAcceptCategory(LOG_MESSAGES))
             {
                 printf("getblocks %d to %s limit %d\n", (pindex ? pindex->nHeight : -1), hashStop.ToString().substr(0,20).c_str(), nLimit);
             }
@@ -406,7 +403,7 @@ bool ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
                     {
                         // When this block is requested, we'll send an inv that'll make them
                         // getblocks the next batch of inventory.
-                        if(messageDebug)
+                        if (LogAcceptCategory(LOG_MESSAGES))
                         {
                             printf("getblocks stopping at limit %d %s\n", pindex->nHeight, pindex->GetBlockHash().ToString().substr(0,20).c_str());
                         }
@@ -489,7 +486,7 @@ bool ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
                     {
                         // invalid orphan
                         vEraseQueue.push_back(orphanTxHash);
-                        if(messageDebug)
+                        if (LogAcceptCategory(LOG_MESSAGES))
                         {
                             printf("   removed invalid orphan tx %s\n", orphanTxHash.ToString().substr(0,10).c_str());
                         }
@@ -669,12 +666,30 @@ bool ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
     return true;
 }
 
+// Known commands get their own latency metric, anything a peer makes up shares one
+static const char* vMetricCommands[] = { "addr", "askReady", "block", "checkorder", "checkpoint", "getaddr", "getblocks",
+                                         "getdata", "inv", "mempool", "noReady", "ping", "reply", "tx", "verack", "version",
+                                         "other" };
+static const unsigned int nMetricCommands = sizeof(vMetricCommands) / sizeof(vMetricCommands[0]);
+
+static CMetricLatency& GetMessageMetric(const string& strCommand)
+{
+    static CMetricLatency* vMetrics[nMetricCommands] = { NULL };
+    unsigned int i = 0;
+    while (i < nMetricCommands - 1 && strCommand != vMetricCommands[i])
+        i++;
+    // only ever called with cs_main held
+    if (vMetrics[i] == NULL)
+        vMetrics[i] = &GetMetricLatency("eccoin_message_seconds", "Time to process a network message", "command", vMetricCommands[i]);
+    return *vMetrics[i];
+}
+
 bool ProcessMessages(CNode* pfrom)
 {
     CDataStream& vRecv = pfrom->vRecv;
     if (vRecv.empty())
         return true;
-    if (messageDebug)
+    if (LogAcceptCategory(LOG_MESSAGES))
         printf("ProcessMessages(%u bytes)\n", vRecv.size());
 
     //
@@ -691,7 +706,7 @@ bool ProcessMessages(CNode* pfrom)
         // Don't bother if send buffer is too full to respond anyway
         if (pfrom->vSend.size() >= SendBufferSize())
         {
-            if(messageDebug)
+            if (LogAcceptCategory(LOG_MESSAGES))
                 printf("send buffer to full to respond, breaking \n");
             break;
         }
@@ -703,7 +718,7 @@ bool ProcessMessages(CNode* pfrom)
         {
             if ((int)vRecv.size() > nHeaderSize)
             {
-                if(messageDebug)
+                if (LogAcceptCategory(LOG_MESSAGES))
                     printf("\n\nPROCESSMESSAGE MESSAGESTART NOT FOUND\n\n");
                 vRecv.erase(vRecv.begin(), vRecv.end() - nHeaderSize);
             }
@@ -711,7 +726,7 @@ bool ProcessMessages(CNode* pfrom)
         }
         if (pstart - vRecv.begin() > 0)
         {
-            if(messageDebug)
+            if (LogAcceptCategory(LOG_MESSAGES))
                 printf("\n\nPROCESSMESSAGE SKIPPED %" PRIpdd " BYTES\n\n", pstart - vRecv.begin());
         }
         vRecv.erase(vRecv.begin(), pstart);
@@ -722,7 +737,7 @@ bool ProcessMessages(CNode* pfrom)
         vRecv >> hdr;
         if (!hdr.IsValid())
         {
-            if(messageDebug)
+            if (LogAcceptCategory(LOG_MESSAGES))
                 printf("\n\nPROCESSMESSAGE: ERRORS IN HEADER %s\n\n\n", hdr.GetCommand().c_str());
             continue;
         }
@@ -732,7 +747,7 @@ bool ProcessMessages(CNode* pfrom)
         unsigned int nMessageSize = hdr.nMessageSize;
         if (nMessageSize > MAX_SIZE)
         {
-            if(messageDebug)
+            if (LogAcceptCategory(LOG_MESSAGES))
                 printf("ProcessMessages(%s, %u bytes) : nMessageSize > MAX_SIZE\n", strCommand.c_str(), nMessageSize);
             continue;
         }
@@ -749,7 +764,7 @@ bool ProcessMessages(CNode* pfrom)
         memcpy(&nChecksum, &hash, sizeof(nChecksum));
         if (nChecksum != hdr.nChecksum)
         {
-            if(messageDebug)
+            if (LogAcceptCategory(LOG_MESSAGES))
             {
                 printf("ProcessMessages(%s, %u bytes) : CHECKSUM ERROR nChecksum=%08x hdr.nChecksum=%08x\n", strCommand.c_str(), nMessageSize, nChecksum, hdr.nChecksum);
             }
@@ -766,6 +781,7 @@ bool ProcessMessages(CNode* pfrom)
         {
             {
                 LOCK(cs_main);
+                CMetricTimer timer(GetMessageMetric(strCommand));
                 fRet = ProcessMessage(pfrom, strCommand, vMsg);
             }
             if (fShutdown)
@@ -776,13 +792,13 @@ bool ProcessMessages(CNode* pfrom)
             if (strstr(e.what(), "end of data"))
             {
                 // Allow exceptions from under-length message on vRecv
-                if(messageDebug)
+                if (LogAcceptCategory(LOG_MESSAGES))
                     printf("ProcessMessages(%s, %u bytes) : Exception '%s' caught, normally caused by a message being shorter than its stated length\n", strCommand.c_str(), nMessageSize, e.what());
             }
             else if (strstr(e.what(), "size too large"))
             {
                 // Allow exceptions from over-long size
-                if(messageDebug)
+                if (LogAcceptCategory(LOG_MESSAGES))
                     printf("ProcessMessages(%s, %u bytes) : Exception '%s' caught\n", strCommand.c_str(), nMessageSize, e.what());
             }
             else
@@ -798,7 +814,7 @@ bool ProcessMessages(CNode* pfrom)
 
         if (!fRet)
         {
-            if(messageDebug)
+            if (LogAcceptCategory(LOG_MESSAGES))
                 printf("ProcessMessage(%s, %u bytes) FAILED\n", strCommand.c_str(), nMessageSize);
         }
     }
@@ -892,7 +908,7 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
             const CInv& inv = (*pto->mapAskFor.begin()).second;
             if (!AlreadyHave(txdb, inv))
             {
-                if (messageDebug)
+                if (LogAcceptCategory(LOG_MESSAGES))
                     printf("sending getdata: %s\n", inv.ToString().c_str());
                 vGetData.push_back(inv);
                 if (vGetData.size() >= 1000)
@@ -912,7 +928,7 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
         {
             if(pto->hashContinue != 0 && pto->askedIfReady == false && pto->noReadyActive == false)
             {
-                if(messageDebug)
+                if (LogAcceptCategory(LOG_MESSAGES))
                     printf("sending askReady \n");
                 pto->PushMessage("askReady");
                 pto->askedIfReady = true;
@@ -921,7 +937,7 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
             {
                 if(pto->readyIn < GetTime())
                 {
-                    if(messageDebug)
+                    if (LogAcceptCategory(LOG_MESSAGES))
                         printf("sending askReady \n");
                     pto->PushMessage("askReady");
                     pto->askedIfReady = true;
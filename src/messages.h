@@ -7,6 +7,7 @@
 #include "init.h"
 #include "kernel.h"
 #include "main.h"
+#include "metrics.h"
 #include "net.h"
 #include "txdb-leveldb.h"
 #include "util.h"
@@ -0,0 +1,183 @@
+// Copyright (c) 2016 The ECCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "metrics.h"
+
+#include <map>
+
+#include <boost/foreach.hpp>
+#include <boost/thread/mutex.hpp>
+
+using namespace std;
+
+const int64_t CMetricLatency::vBucketMicros[CMetricLatency::BUCKETS] =
+    { 10, 50, 100, 500, 1000, 5000, 10000, 50000, 100000, 500000, 1000000, 5000000, 10000000 };
+
+string CMetric::GetLabels() const
+{
+    if (strLabelKey.empty())
+        return "";
+    return strLabelKey + "=\"" + strLabelValue + "\"";
+}
+
+CMetricLatency::CMetricLatency() : nCount(0), nSumMicros(0)
+{
+    for (int i = 0; i <= BUCKETS; i++)
+        vBuckets[i].store(0);
+}
+
+void CMetricLatency::Observe(int64_t nMicros)
+{
+    if (nMicros < 0)
+        nMicros = 0;
+    int i = 0;
+    while (i < BUCKETS && nMicros > vBucketMicros[i])
+        i++;
+    vBuckets[i].fetch_add(1, boost::memory_order_relaxed);
+    nSumMicros.fetch_add(nMicros, boost::memory_order_relaxed);
+    nCount.fetch_add(1, boost::memory_order_relaxed);
+}
+
+int64_t CMetricLatency::GetQuantileMicros(double dQuantile) const
+{
+    uint64_t vCounts[BUCKETS + 1];
+    uint64_t nTotal = 0;
+    for (int i = 0; i <= BUCKETS; i++)
+    {
+        vCounts[i] = vBuckets[i].load(boost::memory_order_relaxed);
+        nTotal += vCounts[i];
+    }
+    if (nTotal == 0)
+        return 0;
+
+    uint64_t nRank = (uint64_t)(dQuantile * nTotal);
+    uint64_t nSeen = 0;
+    for (int i = 0; i < BUCKETS; i++)
+    {
+        nSeen += vCounts[i];
+        if (nSeen > nRank)
+            return vBucketMicros[i];
+    }
+    return -1;
+}
+
+// Constructed on first use, metrics are created from static initializers too
+static boost::mutex& MetricsMutex()
+{
+    static boost::mutex cs;
+    return cs;
+}
+
+static map<string, CMetricCounter*>& MapCounters()
+{
+    static map<string, CMetricCounter*> mapCounters;
+    return mapCounters;
+}
+
+static map<string, CMetricLatency*>& MapLatencies()
+{
+    static map<string, CMetricLatency*> mapLatencies;
+    return mapLatencies;
+}
+
+template<typename T>
+static T& GetMetric(map<string, T*>& mapMetrics, const string& strName, const string& strHelp,
+                    const string& strLabelKey, const string& strLabelValue)
+{
+    // sorted by name, so the exporters emit each family in one run
+    string strKey = strName + "{" + strLabelKey + "=" + strLabelValue;
+    typename map<string, T*>::iterator mi = mapMetrics.find(strKey);
+    if (mi != mapMetrics.end())
+        return *mi->second;
+
+    T* pmetric = new T();
+    pmetric->strName = strName;
+    pmetric->strHelp = strHelp;
+    pmetric->strLabelKey = strLabelKey;
+    pmetric->strLabelValue = strLabelValue;
+    mapMetrics[strKey] = pmetric;
+    return *pmetric;
+}
+
+CMetricCounter& GetMetricCounter(const string& strName, const string& strHelp,
+                                 const string& strLabelKey, const string& strLabelValue)
+{
+    boost::mutex::scoped_lock lock(MetricsMutex());
+    return GetMetric(MapCounters(), strName, strHelp, strLabelKey, strLabelValue);
+}
+
+CMetricLatency& GetMetricLatency(const string& strName, const string& strHelp,
+                                 const string& strLabelKey, const string& strLabelValue)
+{
+    boost::mutex::scoped_lock lock(MetricsMutex());
+    return GetMetric(MapLatencies(), strName, strHelp, strLabelKey, strLabelValue);
+}
+
+void ListMetrics(vector<const CMetricCounter*>& vCounters, vector<const CMetricLatency*>& vLatencies)
+{
+    vCounters.clear();
+    vLatencies.clear();
+    boost::mutex::scoped_lock lock(MetricsMutex());
+    for (map<string, CMetricCounter*>::const_iterator mi = MapCounters().begin(); mi != MapCounters().end(); ++mi)
+        vCounters.push_back(mi->second);
+    for (map<string, CMetricLatency*>::const_iterator mi = MapLatencies().begin(); mi != MapLatencies().end(); ++mi)
+        vLatencies.push_back(mi->second);
+}
+
+static string PrometheusLabels(const string& strLabels, const string& strExtra = "")
+{
+    if (strLabels.empty() && strExtra.empty())
+        return "";
+    if (strLabels.empty() || strExtra.empty())
+        return "{" + strLabels + strExtra + "}";
+    return "{" + strLabels + "," + strExtra + "}";
+}
+
+string MetricsToPrometheus()
+{
+    vector<const CMetricCounter*> vCounters;
+    vector<const CMetricLatency*> vLatencies;
+    ListMetrics(vCounters, vLatencies);
+
+    string strRet;
+    string strLastName;
+    BOOST_FOREACH(const CMetricCounter* pcounter, vCounters)
+    {
+        if (pcounter->strName != strLastName)
+        {
+            strRet += strprintf("# HELP %s %s\n# TYPE %s counter\n", pcounter->strName.c_str(),
+                                pcounter->strHelp.c_str(), pcounter->strName.c_str());
+            strLastName = pcounter->strName;
+        }
+        strRet += strprintf("%s%s %" PRIu64 "\n", pcounter->strName.c_str(),
+                            PrometheusLabels(pcounter->GetLabels()).c_str(),
+                            (uint64_t)pcounter->nValue.load(boost::memory_order_relaxed));
+    }
+
+    strLastName = "";
+    BOOST_FOREACH(const CMetricLatency* platency, vLatencies)
+    {
+        if (platency->strName != strLastName)
+        {
+            strRet += strprintf("# HELP %s %s\n# TYPE %s histogram\n", platency->strName.c_str(),
+                                platency->strHelp.c_str(), platency->strName.c_str());
+            strLastName = platency->strName;
+        }
+        string strLabels = platency->GetLabels();
+        uint64_t nCumulative = 0;
+        for (int i = 0; i <= CMetricLatency::BUCKETS; i++)
+        {
+            nCumulative += platency->vBuckets[i].load(boost::memory_order_relaxed);
+            string strLe = (i < CMetricLatency::BUCKETS ?
+                            strprintf("le=\"%g\"", CMetricLatency::vBucketMicros[i] / 1000000.0) : string("le=\"+Inf\""));
+            strRet += strprintf("%s_bucket%s %" PRIu64 "\n", platency->strName.c_str(),
+                                PrometheusLabels(strLabels, strLe).c_str(), nCumulative);
+        }
+        strRet += strprintf("%s_sum%s %.6f\n", platency->strName.c_str(), PrometheusLabels(strLabels).c_str(),
+                            platency->nSumMicros.load(boost::memory_order_relaxed) / 1000000.0);
+        // from the buckets rather than nCount, so the snapshot is self-consistent
+        strRet += strprintf("%s_count%s %" PRIu64 "\n", platency->strName.c_str(), PrometheusLabels(strLabels).c_str(), nCumulative);
+    }
+    return strRet;
+}
@@ -0,0 +1,83 @@
+// Copyright (c) 2016 The ECCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_METRICS_H
+#define BITCOIN_METRICS_H
+
+#include "util.h"
+
+#include <string>
+#include <vector>
+
+#include <boost/atomic.hpp>
+
+/** Process-wide counters and latency histograms for the hot paths.
+ * Metrics are registered by name (plus an optional single label) on first
+ * use and live until exit, so call sites keep a reference in a function
+ * static and updating one is a relaxed atomic add.
+ */
+class CMetric
+{
+public:
+    std::string strName;
+    std::string strHelp;
+    std::string strLabelKey;
+    std::string strLabelValue;
+
+    std::string GetLabels() const;
+};
+
+/** Monotonically increasing count */
+class CMetricCounter : public CMetric
+{
+public:
+    boost::atomic<uint64_t> nValue;
+
+    CMetricCounter() : nValue(0) {}
+
+    void Add(uint64_t n = 1)
+    {
+        nValue.fetch_add(n, boost::memory_order_relaxed);
+    }
+};
+
+/** Latency distribution over fixed buckets from 10us to 10s */
+class CMetricLatency : public CMetric
+{
+public:
+    enum { BUCKETS = 13 };
+    static const int64_t vBucketMicros[BUCKETS];
+
+    boost::atomic<uint64_t> nCount;
+    boost::atomic<uint64_t> nSumMicros;
+    boost::atomic<uint64_t> vBuckets[BUCKETS + 1]; // not cumulative, the last one is +Inf
+
+    CMetricLatency();
+    void Observe(int64_t nMicros);
+    /** Upper bound of the bucket holding the given quantile, in microseconds (-1 when above the last bucket) */
+    int64_t GetQuantileMicros(double dQuantile) const;
+};
+
+/** Adds the lifetime of the scope to a latency metric */
+class CMetricTimer
+{
+private:
+    CMetricLatency& metric;
+    int64_t nStart;
+
+public:
+    CMetricTimer(CMetricLatency& metricIn) : metric(metricIn), nStart(GetTimeMicros()) {}
+    ~CMetricTimer() { metric.Observe(GetTimeMicros() - nStart); }
+};
+
+CMetricCounter& GetMetricCounter(const std::string& strName, const std::string& strHelp,
+                                 const std::string& strLabelKey = "", const std::string& strLabelValue = "");
+CMetricLatency& GetMetricLatency(const std::string& strName, const std::string& strHelp,
+                                 const std::string& strLabelKey = "", const std::string& strLabelValue = "");
+
+void ListMetrics(std::vector<const CMetricCounter*>& vCounters, std::vector<const CMetricLatency*>& vLatencies);
+
+/** All metrics in the Prometheus text exposition format */
+std::string MetricsToPrometheus();
+
+#endif
@@ -96,7 +96,7 @@ void CNode::PushGetBlocks(CBlockIndex* pindexBegin, uint256 hashEnd)
 {
     pindexLastGetBlocksBegin = pindexBegin;
     hashLastGetBlocksEnd = hashEnd;
-    if(messageDebug)
+    if (LogAcceptCategory(LOG_MESSAGES))
     {
         printf("sending new getBlocks request from %s to %s \n", pindexLastGetBlocksBegin->GetBlockHash().ToString().c_str(), hashLastGetBlocksEnd.ToString().c_str());
     }
@@ -487,7 +487,7 @@ CNode* ConnectNode(CAddress addrConnect, const char *pszDest)
 
 
     /// debug print
-    if(messageDebug)
+    if (LogAcceptCategory(LOG_MESSAGES))
         printf("trying connection %s lastseen=%.1fhrs\n", pszDest ? pszDest : addrConnect.ToString().c_str(), pszDest ? 0 : (double)(GetAdjustedTime() - addrConnect.nTime)/3600.0);
 
     // Connect
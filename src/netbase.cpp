@@ -374,7 +374,7 @@ bool static ConnectSocketDirectly(const CService &addrConnect, SOCKET& hSocketRe
             int nRet = select(hSocket + 1, NULL, &fdset, NULL, &timeout);
             if (nRet == 0)
             {
-                if(messageDebug)
+                if (LogAcceptCategory(LOG_MESSAGES))
                 {
                     printf("connection timeout\n");
                 }
@@ -726,6 +726,9 @@ void BitcoinGUI::incomingTransaction(const QModelIndex & parent, int start, int
     if(!walletModel || !clientModel)
         return;
     TransactionTableModel *ttm = walletModel->getTransactionTableModel();
+    // Rows added while the table is first built are not new
+    if(ttm->isLoading())
+        return;
     qint64 amount = ttm->index(start, TransactionTableModel::Amount, parent)
                     .data(Qt::EditRole).toULongLong();
     if(!clientModel->inInitialBlockDownload())
@@ -11,174 +11,46 @@
 #include <string>
 #include <QWidget>
 
-double getBlockHardness(int height)
-{
-    const CBlockIndex* blockindex = getBlockIndex(height);
-
-    int nShift = (blockindex->nBits >> 24) & 0xff;
+#include <boost/bind.hpp>
 
-    double dDiff =
-        (double)0x0000ffff / (double)(blockindex->nBits & 0x00ffffff);
-
-    while (nShift < 29)
-    {
-        dDiff *= 256.0;
-        nShift++;
-    }
-    while (nShift > 29)
-    {
-        dDiff /= 256.0;
-        nShift--;
-    }
-
-    return dDiff;
-}
-
-int getBlockHashrate(int height)
+int getBlockHashrate(const CBlockSummary& summary)
 {
-    int lookup = height;
-
-    double timeDiff = getBlockTime(height) - getBlockTime(1);
-    double timePerBlock = timeDiff / lookup;
-
-    return (boost::int64_t)(((double)getBlockHardness(height) * pow(2.0, 32)) / timePerBlock);
-}
-
-const CBlockIndex* getBlockIndex(int height)
-{
-    std::string hex = getBlockHash(height);
-    uint256 hash(hex);
-    return mapBlockIndex[hash];
-}
-
-std::string getBlockHash(int Height)
-{
-    if(Height > pindexBest->nHeight) { return "351c6703813172725c6d660aa539ee6a3d7a9fe784c87fae7f36582e3b797058"; }
-    if(Height < 0) { return "351c6703813172725c6d660aa539ee6a3d7a9fe784c87fae7f36582e3b797058"; }
-    int desiredheight;
-    desiredheight = Height;
-    if (desiredheight < 0 || desiredheight > nBestHeight)
+    CBlockSummary summaryFirst;
+    if (summary.nHeight <= 1 || !GetBlockSummary(1, summaryFirst))
         return 0;
 
-    CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hashBestChain];
-    while (pblockindex->nHeight > desiredheight)
-        pblockindex = pblockindex->pprev;
-    return pblockindex->phashBlock->GetHex();
-}
-
-int getBlockTime(int Height)
-{
-    std::string strHash = getBlockHash(Height);
-    uint256 hash(strHash);
-
-    if (mapBlockIndex.count(hash) == 0)
+    double timeDiff = summary.nTime - summaryFirst.nTime;
+    double timePerBlock = timeDiff / summary.nHeight;
+    if (timePerBlock <= 0)
         return 0;
 
-    CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
-    return pblockindex->nTime;
-}
-
-std::string getBlockMerkle(int Height)
-{
-    std::string strHash = getBlockHash(Height);
-    uint256 hash(strHash);
-
-    if (mapBlockIndex.count(hash) == 0)
-        return 0;
-
-    CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
-    return pblockindex->hashMerkleRoot.ToString().substr(0,10).c_str();
-}
-
-int getBlocknBits(int Height)
-{
-    std::string strHash = getBlockHash(Height);
-    uint256 hash(strHash);
-
-    if (mapBlockIndex.count(hash) == 0)
-        return 0;
-
-    CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
-    return pblockindex->nBits;
-}
-
-int getBlockNonce(int Height)
-{
-    std::string strHash = getBlockHash(Height);
-    uint256 hash(strHash);
-
-    if (mapBlockIndex.count(hash) == 0)
-        return 0;
-
-    CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
-    return pblockindex->nNonce;
-}
-
-std::string getBlockDebug(int Height)
-{
-    std::string strHash = getBlockHash(Height);
-    uint256 hash(strHash);
-
-    if (mapBlockIndex.count(hash) == 0)
-        return 0;
-
-    CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
-    return pblockindex->ToString();
+    return (boost::int64_t)((summary.dDifficulty * pow(2.0, 32)) / timePerBlock);
 }
 
 int blocksInPastHours(int hours)
 {
-    int wayback = hours * 3600;
-    bool check = true;
-    int height = pindexBest->nHeight;
-    int heightHour = pindexBest->nHeight;
-    int utime = (int)time(NULL);
-    int target = utime - wayback;
-
-    while(check)
+    int64_t target = GetTime() - hours * 3600;
+    int height;
     {
-        if(getBlockTime(heightHour) < target)
-        {
-            check = false;
-            return height - heightHour;
-        } else {
-            heightHour = heightHour - 1;
-        }
+        LOCK(cs_main);
+        height = nBestHeight;
     }
 
-    return 0;
-}
-
-double getTxTotalValue(std::string txid)
-{
-    uint256 hash;
-    hash.SetHex(txid);
-
-    CTransaction tx;
-    uint256 hashBlock = 0;
-    if (!GetTransaction(hash, tx, hashBlock))
-        return 1000;
-
-    CDataStream ssTx(SER_NETWORK, PROTOCOL_VERSION);
-    ssTx << tx;
-
-    double value = 0;
-    double buffer = 0;
-    for (unsigned int i = 0; i < tx.vout.size(); i++)
+    // Block times only roughly increase, so search on the index rather than reading blocks
+    int heightHour = height;
+    while (heightHour > 0)
     {
-        const CTxOut& txout = tx.vout[i];
-
-        buffer = value + convertCoins(txout.nValue);
-        value = buffer;
+        CBlockIndex* pindex;
+        {
+            LOCK(cs_main);
+            pindex = FindBlockByHeight(heightHour);
+        }
+        if (pindex == NULL || pindex->GetBlockTime() < target)
+            break;
+        heightHour--;
     }
 
-    return value;
+    return height - heightHour;
 }
 
 double convertCoins(int64_t amount)
@@ -186,139 +58,67 @@ double convertCoins(int64_t amount)
     return (double)amount / (double)COIN;
 }
 
-std::string getOutputs(std::string txid)
+static std::string FormatExplorerOutput(const CTxOut& txout)
 {
-    uint256 hash;
-    hash.SetHex(txid);
-
-    CTransaction tx;
-    uint256 hashBlock = 0;
-    if (!GetTransaction(hash, tx, hashBlock))
-        return "fail";
-
-    CDataStream ssTx(SER_NETWORK, PROTOCOL_VERSION);
-    ssTx << tx;
+    CTxDestination dest;
+    std::string str = ExtractDestination(txout.scriptPubKey, dest) ? CBitcoinAddress(dest).ToString() : "unknown";
+    str.append(": ");
+    str.append(boost::to_string(convertCoins(txout.nValue)));
+    str.append(" ECC\n");
+    return str;
+}
 
+std::string getOutputs(const CExplorerTx& etx)
+{
     std::string str = "";
-    for (unsigned int i = 0; i < tx.vout.size(); i++)
-    {
-        const CTxOut& txout = tx.vout[i];
-        CTxDestination source;
-        ExtractDestination(txout.scriptPubKey, source);
-        CBitcoinAddress addressSource(source);
-        std::string lol7 = addressSource.ToString();
-        double buffer = convertCoins(txout.nValue);
-        std::string amount = boost::to_string(buffer);
-        str.append(lol7);
-        str.append(": ");
-        str.append(amount);
-        str.append(" ECC");
-        str.append("\n");
-    }
-
+    BOOST_FOREACH(const CTxOut& txout, etx.tx.vout)
+        str.append(FormatExplorerOutput(txout));
     return str;
 }
 
-std::string getInputs(std::string txid)
+std::string getInputs(const CExplorerTx& etx)
 {
-    uint256 hash;
-    hash.SetHex(txid);
-
-    CTransaction tx;
-    uint256 hashBlock = 0;
-    if (!GetTransaction(hash, tx, hashBlock))
-        return "fail";
-
-    CDataStream ssTx(SER_NETWORK, PROTOCOL_VERSION);
-    ssTx << tx;
+    if (etx.tx.IsCoinBase())
+        return "coinbase\n";
 
     std::string str = "";
-    for (unsigned int i = 0; i < tx.vin.size(); i++)
+    BOOST_FOREACH(const CTxOut& txout, etx.vPrevOut)
     {
-        uint256 hash;
-        const CTxIn& vin = tx.vin[i];
-        hash.SetHex(vin.prevout.hash.ToString());
-        CTransaction wtxPrev;
-        uint256 hashBlock = 0;
-        if (!GetTransaction(hash, wtxPrev, hashBlock))
-             return "fail";
-
-        CDataStream ssTx(SER_NETWORK, PROTOCOL_VERSION);
-        ssTx << wtxPrev;
-
-        CTxDestination source;
-        ExtractDestination(wtxPrev.vout[vin.prevout.n].scriptPubKey, source);
-        CBitcoinAddress addressSource(source);
-        std::string lol6 = addressSource.ToString();
-        const CScript target = wtxPrev.vout[vin.prevout.n].scriptPubKey;
-        double buffer = convertCoins(getInputValue(wtxPrev, target));
-        std::string amount = boost::to_string(buffer);
-        str.append(lol6);
-        str.append(": ");
-        str.append(amount);
-        str.append("ECC");
-        str.append("\n");
+        if (txout.IsNull())
+            str.append("unknown\n");
+        else
+            str.append(FormatExplorerOutput(txout));
     }
-
     return str;
 }
 
-int64_t getInputValue(CTransaction tx, CScript target)
+static void NotifyTxResolved(BlockBrowserRelay* relay, int nRequest, const uint256& hash, bool fFound)
 {
-    for (unsigned int i = 0; i < tx.vin.size(); i++)
-    {
-        const CTxOut& txout = tx.vout[i];
-        if(txout.scriptPubKey == target)
-        {
-            return txout.nValue;
-        }
-    }
-    return 0;
+    // Called on the explorer thread
+    QMetaObject::invokeMethod(relay, "txResolved", Qt::QueuedConnection,
+                              Q_ARG(int, nRequest),
+                              Q_ARG(QString, QString::fromStdString(hash.GetHex())),
+                              Q_ARG(bool, fFound));
 }
 
-double getTxFees(std::string txid)
+BlockBrowserRelay* BlockBrowserRelay::instance()
 {
-    uint256 hash;
-    hash.SetHex(txid);
-
-
-    CTransaction tx;
-    uint256 hashBlock = 0;
-    if (!GetTransaction(hash, tx, hashBlock))
-        return 51;
-
-    CDataStream ssTx(SER_NETWORK, PROTOCOL_VERSION);
-    ssTx << tx;
-
-    double value = 0;
-    double buffer = 0;
-    for (unsigned int i = 0; i < tx.vout.size(); i++)
-    {
-        const CTxOut& txout = tx.vout[i];
-
-        buffer = value + convertCoins(txout.nValue);
-        value = buffer;
-    }
+    // Created on the GUI thread by the first lookup
+    static BlockBrowserRelay* relay = new BlockBrowserRelay();
+    return relay;
+}
 
-    double value0 = 0;
-    double buffer0 = 0;
-    for (unsigned int i = 0; i < tx.vin.size(); i++)
-    {
-        uint256 hash0;
-        const CTxIn& vin = tx.vin[i];
-        hash0.SetHex(vin.prevout.hash.ToString());
-        CTransaction wtxPrev;
-        uint256 hashBlock0 = 0;
-        if (!GetTransaction(hash0, wtxPrev, hashBlock0))
-             return 0;
-        CDataStream ssTx(SER_NETWORK, PROTOCOL_VERSION);
-        ssTx << wtxPrev;
-        const CScript target = wtxPrev.vout[vin.prevout.n].scriptPubKey;
-        buffer0 = value0 + convertCoins(getInputValue(wtxPrev, target));
-        value0 = buffer0;
-    }
+int BlockBrowserRelay::addRequest(BlockBrowser *browser)
+{
+    mapRequests.insert(nNextRequest, QPointer<BlockBrowser>(browser));
+    return nNextRequest++;
+}
 
-    return value0 - value;
+void BlockBrowserRelay::txResolved(int nRequest, QString txid, bool fFound)
+{
+    QPointer<BlockBrowser> browser = mapRequests.take(nRequest);
+    if (browser)
+        browser->txResolved(txid, fFound);
 }
 
 
@@ -355,27 +155,24 @@ void BlockBrowser::updateExplorer(bool block)
         ui->pawLabel->show();
         ui->pawBox->show();
         int height = ui->heightBox->value();
-        if (height > pindexBest->nHeight)
+        if (height > nBestHeight)
         {
-            ui->heightBox->setValue(pindexBest->nHeight);
-            height = pindexBest->nHeight;
+            ui->heightBox->setValue(nBestHeight);
+            height = nBestHeight;
         }
-        int Pawrate = getBlockHashrate(height);
+        CBlockSummary summary;
+        if (!GetBlockSummary(height, summary))
+            return;
+        int Pawrate = getBlockHashrate(summary);
         double Pawrate2 = 0.000;
         Pawrate2 = ((double)Pawrate / 1000);
-        std::string hash = getBlockHash(height);
-        std::string merkle = getBlockMerkle(height);
-        int nBits = getBlocknBits(height);
-        int nNonce = getBlockNonce(height);
-        int atime = getBlockTime(height);
-        double hardness = getBlockHardness(height);
         QString QHeight = QString::number(height);
-        QString QHash = QString::fromUtf8(hash.c_str());
-        QString QMerkle = QString::fromUtf8(merkle.c_str());
-        QString QBits = QString::number(nBits);
-        QString QNonce = QString::number(nNonce);
-        QString QTime = QString::number(atime);
-        QString QHardness = QString::number(hardness, 'f', 6);
+        QString QHash = QString::fromUtf8(summary.hash.GetHex().c_str());
+        QString QMerkle = QString::fromUtf8(summary.hashMerkleRoot.ToString().substr(0,10).c_str());
+        QString QBits = QString::number(summary.nBits);
+        QString QNonce = QString::number(summary.nNonce);
+        QString QTime = QString::number(summary.nTime);
+        QString QHardness = QString::number(summary.dDifficulty, 'f', 6);
         QString QPawrate = QString::number(Pawrate2, 'f', 3);
         ui->heightLabel->setText(QHeight);
         ui->hashBox->setText(QHash);
@@ -399,23 +196,49 @@ void BlockBrowser::updateExplorer(bool block)
         ui->feesLabel->show();
         ui->feesBox->show();
         std::string txid = ui->txBox->text().toUtf8().constData();
-        double value = getTxTotalValue(txid);
-        double fees = getTxFees(txid);
-        std::string outputs = getOutputs(txid);
-        std::string inputs = getInputs(txid);
-        QString QValue = QString::number(value, 'f', 6);
         QString QID = QString::fromUtf8(txid.c_str());
-        QString QOutputs = QString::fromUtf8(outputs.c_str());
-        QString QInputs = QString::fromUtf8(inputs.c_str());
-        QString QFees = QString::number(fees, 'f', 6);
-        ui->valueBox->setText(QValue + " ECC");
         ui->txID->setText(QID);
-        ui->outputBox->setText(QOutputs);
-        ui->inputBox->setText(QInputs);
-        ui->feesBox->setText(QFees + " ECC");
+
+        // Reading the transaction and its inputs can take a while; the
+        // explorer thread does it and txResolved fills in the fields
+        strPendingTx = txid;
+        CExplorerTx etx;
+        if (GetCachedExplorerTx(uint256(txid), etx))
+        {
+            txResolved(QID, true);
+            return;
+        }
+        ui->valueBox->setText(tr("Loading..."));
+        ui->outputBox->clear();
+        ui->inputBox->clear();
+        ui->feesBox->clear();
+        BlockBrowserRelay* relay = BlockBrowserRelay::instance();
+        ResolveExplorerTx(uint256(txid), boost::bind(NotifyTxResolved, relay, relay->addRequest(this), _1, _2));
     }
 }
 
+void BlockBrowser::txResolved(QString txid, bool fFound)
+{
+    // Drop answers for a transaction that is no longer shown
+    if (uint256(txid.toStdString()) != uint256(strPendingTx))
+        return;
+
+    CExplorerTx etx;
+    if (!fFound || !GetCachedExplorerTx(uint256(strPendingTx), etx))
+    {
+        ui->valueBox->setText(tr("Transaction not found"));
+        return;
+    }
+
+    QString QValue = QString::number(convertCoins(etx.tx.GetValueOut()), 'f', 6);
+    QString QOutputs = QString::fromUtf8(getOutputs(etx).c_str());
+    QString QInputs = QString::fromUtf8(getInputs(etx).c_str());
+    QString QFees = QString::number(convertCoins(etx.GetFee()), 'f', 6);
+    ui->valueBox->setText(QValue + " ECC");
+    ui->outputBox->setText(QOutputs);
+    ui->inputBox->setText(QInputs);
+    ui->feesBox->setText(QFees + " ECC");
+}
 
 void BlockBrowser::txClicked()
 {
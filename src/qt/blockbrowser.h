@@ -5,7 +5,9 @@
 #include "main.h"
 #include "wallet.h"
 #include "base58.h"
+#include "explorer.h"
 #include <QWidget>
+#include <QPointer>
 
 #include <QDir>
 #include <QFile>
@@ -18,22 +20,12 @@
 #include <QSlider>
 #include <QWidget>
 
-double getBlockHardness(int);
-double getTxTotalValue(std::string);
 double convertCoins(int64_t);
-double getTxFees(std::string);
-int getBlockTime(int);
-int getBlocknBits(int);
-int getBlockNonce(int);
 int blocksInPastHours(int);
-int getBlockHashrate(int);
-std::string getInputs(std::string);
-std::string getOutputs(std::string);
-std::string getBlockHash(int);
-std::string getBlockMerkle(int);
+int getBlockHashrate(const CBlockSummary&);
+std::string getInputs(const CExplorerTx&);
+std::string getOutputs(const CExplorerTx&);
 bool addnode(std::string);
-const CBlockIndex* getBlockIndex(int);
-int64_t getInputValue(CTransaction, CScript);
 
 
 namespace Ui {
@@ -58,11 +50,35 @@ public slots:
     void updateExplorer(bool);
 
 private slots:
+    void txResolved(QString txid, bool fFound);
 
 private:
     Ui::BlockBrowser *ui;
     ClientModel *model;
-    
+    std::string strPendingTx;
+
+    friend class BlockBrowserRelay;
+};
+
+/** Hands explorer lookups back to the GUI thread. The explorer thread only
+ * posts to this object, which is never destroyed; whether the browser that
+ * asked is still there is checked on the GUI thread. */
+class BlockBrowserRelay : public QObject
+{
+    Q_OBJECT
+
+public:
+    static BlockBrowserRelay* instance();
+    int addRequest(BlockBrowser *browser);
+
+private slots:
+    void txResolved(int nRequest, QString txid, bool fFound);
+
+private:
+    int nNextRequest;
+    QMap<int, QPointer<BlockBrowser> > mapRequests;
+
+    BlockBrowserRelay() : nNextRequest(0) {}
 };
 
 #endif // BLOCKBROWSER_H
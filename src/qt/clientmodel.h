@@ -2,6 +2,7 @@
 #define CLIENTMODEL_H
 
 #include <QObject>
+#include <QAtomicInt>
 
 class OptionsModel;
 class AddressTableModel;
@@ -52,6 +53,9 @@ private:
 
     int numBlocksAtStartup;
 
+    // Set while a block notification is queued to this model
+    QAtomicInt blocksChangedPending;
+
     QTimer *pollTimer;
 
     void subscribeToCoreSignals();
@@ -66,6 +70,7 @@ signals:
 public slots:
     void updateTimer();
     void updateNumConnections(int numConnections);
+    void updateBlocks();
 };
 
 #endif // CLIENTMODEL_H
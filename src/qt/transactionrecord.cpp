@@ -230,7 +230,22 @@ void TransactionRecord::updateStatus(const CWalletTx &wtx)
 
 bool TransactionRecord::statusUpdateNeeded()
 {
-    return status.cur_num_blocks != nBestHeight;
+    if (status.cur_num_blocks == nBestHeight)
+        return false;
+    if (statusSettled())
+    {
+        status.depth += nBestHeight - status.cur_num_blocks;
+        status.cur_num_blocks = nBestHeight;
+        return false;
+    }
+    return true;
+}
+
+bool TransactionRecord::statusSettled() const
+{
+    return status.cur_num_blocks != -1 &&
+           status.status == TransactionStatus::HaveConfirmations &&
+           status.maturity == TransactionStatus::Mature;
 }
 
 std::string TransactionRecord::getTxID()
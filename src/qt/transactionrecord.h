@@ -126,6 +126,11 @@ public:
     /** Return whether a status update is needed.
      */
     bool statusUpdateNeeded();
+
+    /** Return whether the status can only change by its depth, which is then
+        moved on with the chain instead of being read from the wallet again.
+     */
+    bool statusSettled() const;
 };
 
 #endif // TRANSACTIONRECORD_H
@@ -14,9 +14,10 @@
 #include <QLocale>
 #include <QList>
 #include <QColor>
-#include <QTimer>
 #include <QIcon>
 #include <QDateTime>
+#include <QMutex>
+#include <QThread>
 #include <QtAlgorithms>
 // Amount column is right-aligned it contains numbers
 static int column_alignments[] = {
@@ -44,13 +45,56 @@ struct TxLessThan
     }
 };
 
+// Number of wallet transactions the loader decomposes per cs_wallet lock
+static const int LOAD_CHUNK_SIZE = 250;
+
+// Wallet transactions decomposed by the loader thread, in hash order
+struct TransactionTableChunk
+{
+    QList<TransactionRecord> records;
+    uint256 last;
+    bool done;
+};
+
+class TransactionTablePriv;
+
+/* Builds the table off the GUI thread. The wallet is read in chunks, so that
+ * cs_wallet is released in between, and each chunk is handed to the model
+ * as it is ready.
+ */
+class TransactionTableLoader : public QThread
+{
+    Q_OBJECT
+public:
+    TransactionTableLoader(CWallet *wallet, TransactionTablePriv *priv):
+            wallet(wallet),
+            priv(priv)
+    {
+    }
+
+signals:
+    void chunkReady();
+
+protected:
+    void run();
+
+private:
+    CWallet *wallet;
+    TransactionTablePriv *priv;
+};
+
+#include "transactiontablemodel.moc"
+
 // Private implementation
 class TransactionTablePriv
 {
 public:
     TransactionTablePriv(CWallet *wallet, TransactionTableModel *parent):
             wallet(wallet),
-            parent(parent)
+            parent(parent),
+            loading(true),
+            loadedAny(false),
+            stopLoading(false)
     {
     }
     CWallet *wallet;
@@ -62,20 +106,51 @@ public:
      */
     QList<TransactionRecord> cachedWallet;
 
-    /* Query entire wallet anew from core.
+    /* While loading, the model holds the wallet transactions up to and
+     * including loadedUpTo. Updates for later transactions are kept until
+     * their chunk has been added.
      */
-    void refreshWallet()
+    bool loading;
+    bool loadedAny;
+    uint256 loadedUpTo;
+    QList<QPair<uint256, int> > deferredUpdates;
+
+    // Shared with the loader thread
+    QMutex loadMutex;
+    QList<TransactionTableChunk> loadQueue;
+    bool stopLoading;
+
+    /* Add the chunks the loader has finished to the model.
+     */
+    void appendLoaded()
     {
-        OutputDebugStringF("refreshWallet\n");
-        cachedWallet.clear();
+        QList<TransactionTableChunk> chunks;
         {
-            LOCK(wallet->cs_wallet);
-            for(std::map<uint256, CWalletTx>::iterator it = wallet->mapWallet.begin(); it != wallet->mapWallet.end(); ++it)
+            QMutexLocker locker(&loadMutex);
+            chunks = loadQueue;
+            loadQueue.clear();
+        }
+        foreach(const TransactionTableChunk &chunk, chunks)
+        {
+            if(!chunk.records.isEmpty())
             {
-                if(TransactionRecord::showTransaction(it->second))
-                    cachedWallet.append(TransactionRecord::decomposeTransaction(wallet, it->second));
+                parent->beginInsertRows(QModelIndex(), cachedWallet.size(), cachedWallet.size()+chunk.records.size()-1);
+                cachedWallet.append(chunk.records);
+                parent->endInsertRows();
+            }
+            loadedAny = true;
+            loadedUpTo = chunk.last;
+            if(chunk.done)
+            {
+                OutputDebugStringF("TransactionTableModel: loaded %d records\n", cachedWallet.size());
+                loading = false;
             }
         }
+
+        QList<QPair<uint256, int> > updates = deferredUpdates;
+        deferredUpdates.clear();
+        for(int i = 0; i < updates.size(); i++)
+            updateWallet(updates[i].first, updates[i].second);
     }
 
     /* Update our model of the wallet incrementally, to synchronize our model of the wallet
@@ -85,6 +160,11 @@ public:
     void updateWallet(const uint256 &hash, int status)
     {
         //OutputDebugStringF("updateWallet %s %i\n", hash.ToString().c_str(), status);
+        if(loading && (!loadedAny || loadedUpTo < hash))
+        {
+            deferredUpdates.append(qMakePair(hash, status));
+            return;
+        }
         {
             LOCK(wallet->cs_wallet);
 
@@ -213,6 +293,43 @@ public:
 
 };
 
+void TransactionTableLoader::run()
+{
+    uint256 hashLast = 0;
+    bool fFirst = true;
+    while(true)
+    {
+        TransactionTableChunk chunk;
+        {
+            LOCK(wallet->cs_wallet);
+            std::map<uint256, CWalletTx>::iterator it = fFirst ? wallet->mapWallet.begin() : wallet->mapWallet.upper_bound(hashLast);
+            for(int n = 0; n < LOAD_CHUNK_SIZE && it != wallet->mapWallet.end(); ++it, ++n)
+            {
+                if(TransactionRecord::showTransaction(it->second))
+                {
+                    QList<TransactionRecord> records = TransactionRecord::decomposeTransaction(wallet, it->second);
+                    for(int i = 0; i < records.size(); i++)
+                        records[i].updateStatus(it->second);
+                    chunk.records.append(records);
+                }
+                hashLast = it->first;
+            }
+            chunk.done = (it == wallet->mapWallet.end());
+        }
+        fFirst = false;
+        chunk.last = hashLast;
+        {
+            QMutexLocker locker(&priv->loadMutex);
+            if(priv->stopLoading)
+                return;
+            priv->loadQueue.append(chunk);
+        }
+        emit chunkReady();
+        if(chunk.done)
+            return;
+    }
+}
+
 TransactionTableModel::TransactionTableModel(CWallet* wallet, WalletModel *parent):
         QAbstractTableModel(parent),
         wallet(wallet),
@@ -222,20 +339,34 @@ TransactionTableModel::TransactionTableModel(CWallet* wallet, WalletModel *paren
 {
     columns << QString() << tr("Date") << tr("Type") << tr("Address") << tr("Amount");
 
-    priv->refreshWallet();
-
-    QTimer *timer = new QTimer(this);
-    connect(timer, SIGNAL(timeout()), this, SLOT(updateConfirmations()));
-    timer->start(MODEL_UPDATE_DELAY);
+    loader = new TransactionTableLoader(wallet, priv);
+    connect(loader, SIGNAL(chunkReady()), this, SLOT(loadChunk()));
+    loader->start();
 
     connect(walletModel->getOptionsModel(), SIGNAL(displayUnitChanged(int)), this, SLOT(updateDisplayUnit()));
 }
 
 TransactionTableModel::~TransactionTableModel()
 {
+    {
+        QMutexLocker locker(&priv->loadMutex);
+        priv->stopLoading = true;
+    }
+    loader->wait();
+    delete loader;
     delete priv;
 }
 
+void TransactionTableModel::loadChunk()
+{
+    priv->appendLoaded();
+}
+
+bool TransactionTableModel::isLoading() const
+{
+    return priv->loading;
+}
+
 void TransactionTableModel::updateTransaction(const QString &hash, int status)
 {
     uint256 updated;
@@ -250,11 +381,22 @@ void TransactionTableModel::updateConfirmations()
     {
         cachedNumBlocks = nBestHeight;
         // Blocks came in since last poll.
-        // Invalidate status (number of confirmations) and (possibly) description
-        //  for all rows. Qt is smart enough to only actually request the data for the
-        //  visible rows.
-        emit dataChanged(index(0, Status), index(priv->size()-1, Status));
-        emit dataChanged(index(0, ToAddress), index(priv->size()-1, ToAddress));
+        // Invalidate status and (possibly) description of the rows that can
+        //  still change. Rows with a settled status only move on in depth,
+        //  which is picked up when they are next drawn.
+        int start = -1;
+        for(int row = 0; row <= priv->size(); row++)
+        {
+            bool changed = row < priv->size() && !priv->cachedWallet[row].statusSettled();
+            if(changed && start < 0)
+                start = row;
+            else if(!changed && start >= 0)
+            {
+                emit dataChanged(index(start, Status), index(row-1, Status));
+                emit dataChanged(index(start, ToAddress), index(row-1, ToAddress));
+                start = -1;
+            }
+        }
     }
 }
 
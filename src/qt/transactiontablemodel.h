@@ -6,6 +6,7 @@
 
 class CWallet;
 class TransactionTablePriv;
+class TransactionTableLoader;
 class TransactionRecord;
 class WalletModel;
 
@@ -57,12 +58,14 @@ public:
     QVariant data(const QModelIndex &index, int role) const;
     QVariant headerData(int section, Qt::Orientation orientation, int role) const;
     QModelIndex index(int row, int column, const QModelIndex & parent = QModelIndex()) const;
-    void refreshWallet();
+    /** Whether the table is still being built from the wallet */
+    bool isLoading() const;
 private:
     CWallet* wallet;
     WalletModel *walletModel;
     QStringList columns;
     TransactionTablePriv *priv;
+    TransactionTableLoader *loader;
     int cachedNumBlocks;
 
     QString lookupAddress(const std::string &address, bool tooltip) const;
@@ -79,6 +82,7 @@ private:
 public slots:
     void updateTransaction(const QString &hash, int status);
     void updateConfirmations();
+    void loadChunk();
     void updateDisplayUnit();
 
     friend class TransactionTablePriv;
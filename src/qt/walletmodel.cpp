@@ -25,10 +25,16 @@ WalletModel::WalletModel(CWallet *wallet, OptionsModel *optionsModel, QObject *p
     addressTableModel = new AddressTableModel(wallet, this);
     transactionTableModel = new TransactionTableModel(wallet, this);
 
-    // This timer will be fired repeatedly to update the balance
+    // Balances are read again a moment after the wallet or the chain
+    // changes, so that a burst of notifications costs one pass over the wallet
     pollTimer = new QTimer(this);
+    pollTimer->setSingleShot(true);
+    pollTimer->setInterval(MODEL_UPDATE_DELAY);
     connect(pollTimer, SIGNAL(timeout()), this, SLOT(pollBalanceChanged()));
-    pollTimer->start(MODEL_UPDATE_DELAY);
+
+    cachedNumBlocks = nBestHeight;
+    cachedNumTransactions = getNumTransactions();
+    checkBalanceChanged();
 
     subscribeToCoreSignals(); 
 }
@@ -40,22 +46,22 @@ WalletModel::~WalletModel()
 
 qint64 WalletModel::getBalance() const
 {
-    return wallet->GetBalance();
+    return cachedBalance;
 }
 
 qint64 WalletModel::getUnconfirmedBalance() const
 {
-    return wallet->GetUnconfirmedBalance();
+    return cachedUnconfirmedBalance;
 }
 
 qint64 WalletModel::getStake() const
 {
-    return wallet->GetStake();
+    return cachedStake;
 }
 
 qint64 WalletModel::getImmatureBalance() const
 {
-    return wallet->GetImmatureBalance();
+    return cachedImmatureBalance;
 }
 
 int WalletModel::getNumTransactions() const
@@ -80,18 +86,33 @@ void WalletModel::pollBalanceChanged()
 {
     if(nBestHeight != cachedNumBlocks)
     {
-        // Balance and number of transactions might have changed
         cachedNumBlocks = nBestHeight;
-        checkBalanceChanged();
+        if(transactionTableModel)
+            transactionTableModel->updateConfirmations();
+    }
+
+    // Balance and number of transactions might have changed
+    checkBalanceChanged();
+
+    int newNumTransactions = getNumTransactions();
+    if(cachedNumTransactions != newNumTransactions)
+    {
+        cachedNumTransactions = newNumTransactions;
+        emit numTransactionsChanged(newNumTransactions);
     }
 }
 
+void WalletModel::updateBlocks()
+{
+    blocksChangedPending.fetchAndStoreOrdered(0);
+    if(!pollTimer->isActive())
+        pollTimer->start();
+}
+
 void WalletModel::checkBalanceChanged()
 {
-    qint64 newBalance = getBalance();
-    qint64 newStake = getStake();
-    qint64 newUnconfirmedBalance = getUnconfirmedBalance();
-    qint64 newImmatureBalance = getImmatureBalance();
+    int64_t newBalance, newStake, newUnconfirmedBalance, newImmatureBalance;
+    wallet->GetBalances(newBalance, newStake, newUnconfirmedBalance, newImmatureBalance);
 
     if(cachedBalance != newBalance || cachedStake != newStake || cachedUnconfirmedBalance != newUnconfirmedBalance || cachedImmatureBalance != newImmatureBalance)
     {
@@ -108,15 +129,8 @@ void WalletModel::updateTransaction(const QString &hash, int status)
     if(transactionTableModel)
         transactionTableModel->updateTransaction(hash, status);
 
-    // Balance and number of transactions might have changed
-    checkBalanceChanged();
-
-    int newNumTransactions = getNumTransactions();
-    if(cachedNumTransactions != newNumTransactions)
-    {
-        cachedNumTransactions = newNumTransactions;
-        emit numTransactionsChanged(newNumTransactions);
-    }
+    if(!pollTimer->isActive())
+        pollTimer->start();
 }
 
 void WalletModel::updateAddressBook(const QString &address, const QString &label, bool isMine, int status)
@@ -324,6 +338,13 @@ static void NotifyAddressBookChanged(WalletModel *walletmodel, CWallet *wallet,
                               Q_ARG(int, status));
 }
 
+static void NotifyBlocksChanged(WalletModel *walletmodel, QAtomicInt *pending)
+{
+    // Queue at most one update, however fast blocks come in
+    if(pending->fetchAndStoreOrdered(1) == 0)
+        QMetaObject::invokeMethod(walletmodel, "updateBlocks", Qt::QueuedConnection);
+}
+
 static void NotifyTransactionChanged(WalletModel *walletmodel, CWallet *wallet, const uint256 &hash, ChangeType status)
 {
     OutputDebugStringF("NotifyTransactionChanged %s status=%i\n", hash.GetHex().c_str(), status);
@@ -338,6 +359,7 @@ void WalletModel::subscribeToCoreSignals()
     wallet->NotifyStatusChanged.connect(boost::bind(&NotifyKeyStoreStatusChanged, this, _1));
     wallet->NotifyAddressBookChanged.connect(boost::bind(NotifyAddressBookChanged, this, _1, _2, _3, _4, _5));
     wallet->NotifyTransactionChanged.connect(boost::bind(NotifyTransactionChanged, this, _1, _2, _3));
+    uiInterface.NotifyBlocksChanged.connect(boost::bind(NotifyBlocksChanged, this, &blocksChangedPending));
 }
 
 void WalletModel::unsubscribeFromCoreSignals()
@@ -346,6 +368,7 @@ void WalletModel::unsubscribeFromCoreSignals()
     wallet->NotifyStatusChanged.disconnect(boost::bind(&NotifyKeyStoreStatusChanged, this, _1));
     wallet->NotifyAddressBookChanged.disconnect(boost::bind(NotifyAddressBookChanged, this, _1, _2, _3, _4, _5));
     wallet->NotifyTransactionChanged.disconnect(boost::bind(NotifyTransactionChanged, this, _1, _2, _3));
+    uiInterface.NotifyBlocksChanged.disconnect(boost::bind(NotifyBlocksChanged, this, &blocksChangedPending));
 }
 
 // WalletModel::UnlockContext implementation
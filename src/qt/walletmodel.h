@@ -2,6 +2,7 @@
 #define WALLETMODEL_H
 
 #include <QObject> 
+#include <QAtomicInt>
 #include <vector>
 #include <map>
 
@@ -144,6 +145,9 @@ private:
     EncryptionStatus cachedEncryptionStatus;
     int cachedNumBlocks;
 
+    // Set while a block notification is queued to this model
+    QAtomicInt blocksChangedPending;
+
     QTimer *pollTimer;
 
     void subscribeToCoreSignals();
@@ -160,6 +164,8 @@ public slots:
     void updateAddressBook(const QString &address, const QString &label, bool isMine, int status);
     /* Current, immature or unconfirmed balance might have changed - emit 'balanceChanged' if so */
     void pollBalanceChanged();
+    /* New best block */
+    void updateBlocks();
 
 signals:
     // Signal that balance in wallet changed
@@ -5,12 +5,14 @@
 
 #include "main.h"
 #include "bitcoinrpc.h"
+#include "txdb-leveldb.h"
 
 using namespace json_spirit;
 using namespace std;
 
 extern void TxToJSON(const CTransaction& tx, const uint256 hashBlock, json_spirit::Object& entry);
 extern enum Checkpoints::CPMode CheckpointsMode;
+extern unsigned int nTargetSpacing;
 
 double GetDifficulty(const CBlockIndex* blockindex)
 {
@@ -263,18 +265,112 @@ Value getblockbynumber(const Array& params, bool fHelp)
         throw runtime_error("Block number out of range.");
 
     CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hashBestChain];
-    while (pblockindex->nHeight > nHeight)
-        pblockindex = pblockindex->pprev;
-
-    uint256 hash = *pblockindex->phashBlock;
-
-    pblockindex = mapBlockIndex[hash];
+    CBlockIndex* pblockindex = FindBlockByHeight(nHeight);
     block.ReadFromDisk(pblockindex, true);
 
     return blockToJSON(block, pblockindex, params.size() > 1 ? params[1].get_bool() : false);
 }
 
+static CBlockStats ReadBlockStats(CTxDB& txdb, const CBlockIndex* pindex)
+{
+    CBlockStats stats;
+    if (!txdb.ReadBlockStats(pindex->GetBlockHash(), stats))
+        throw JSONRPCError(RPC_DATABASE_ERROR, strprintf("No stats for block %d", pindex->nHeight));
+    return stats;
+}
+
+Value getblockstats(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 2)
+        throw runtime_error(
+            "getblockstats <height> [count=1]\n"
+            "Returns the totals of <count> best-chain blocks starting at <height>:\n"
+            "{height, hash, time, proofofstake, txs, size, inputs, outputs, valueout,\n"
+            "fees, stakereward, mint, moneysupply, chaintxs}. Requires -blockstatsindex.");
+
+    if (!fBlockStatsIndex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Block stats index not enabled; restart with -blockstatsindex");
+    int nHeight = params[0].get_int();
+    if (nHeight < 0 || nHeight > nBestHeight)
+        throw runtime_error("Block number out of range.");
+    int nCount = params.size() > 1 ? params[1].get_int() : 1;
+    if (nCount < 1)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid count");
+    nCount = std::min(nCount, nBestHeight - nHeight + 1);
+
+    CTxDB txdb("r");
+    Array results;
+    for (int i = 0; i < nCount; i++)
+    {
+        const CBlockIndex* pindex = FindBlockByHeight(nHeight + i);
+        CBlockStats stats = ReadBlockStats(txdb, pindex);
+        Object entry;
+        entry.push_back(Pair("height", pindex->nHeight));
+        entry.push_back(Pair("hash", pindex->GetBlockHash().GetHex()));
+        entry.push_back(Pair("time", (boost::int64_t)pindex->GetBlockTime()));
+        entry.push_back(Pair("proofofstake", pindex->IsProofOfStake()));
+        entry.push_back(Pair("txs", (boost::int64_t)stats.nTx));
+        entry.push_back(Pair("size", (boost::int64_t)stats.nSize));
+        entry.push_back(Pair("inputs", (boost::int64_t)stats.nInputs));
+        entry.push_back(Pair("outputs", (boost::int64_t)stats.nOutputs));
+        entry.push_back(Pair("valueout", ValueFromAmount(stats.nValueOut)));
+        entry.push_back(Pair("fees", ValueFromAmount(stats.nFees)));
+        entry.push_back(Pair("stakereward", ValueFromAmount(stats.nStakeReward)));
+        entry.push_back(Pair("mint", ValueFromAmount(pindex->nMint)));
+        entry.push_back(Pair("moneysupply", ValueFromAmount(pindex->nMoneySupply)));
+        entry.push_back(Pair("chaintxs", stats.nChainTx));
+        results.push_back(entry);
+    }
+    return results;
+}
+
+Value getchaintxstats(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() > 2)
+        throw runtime_error(
+            "getchaintxstats [nblocks] [blockhash]\n"
+            "Returns the transaction rate over the <nblocks> blocks (default: one day's\n"
+            "worth) ending at <blockhash> (default: the best block).\n"
+            "Requires -blockstatsindex.");
+
+    if (!fBlockStatsIndex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Block stats index not enabled; restart with -blockstatsindex");
+
+    const CBlockIndex* pindex = pindexBest;
+    if (params.size() > 1)
+    {
+        uint256 hash = ParseHashV(params[1], "blockhash");
+        map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hash);
+        if (mi == mapBlockIndex.end())
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        pindex = mi->second;
+        if (!pindex->IsInMainChain())
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Block is not in the best chain");
+    }
+
+    int nBlocks = params.size() > 0 ? params[0].get_int() : (int)(24 * 60 * 60 / nTargetSpacing);
+    if (nBlocks < 1 || nBlocks > pindex->nHeight)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid block count: should be between 1 and the block's height");
+
+    const CBlockIndex* pindexStart = FindBlockByHeight(pindex->nHeight - nBlocks);
+    CTxDB txdb("r");
+    CBlockStats stats = ReadBlockStats(txdb, pindex);
+    CBlockStats statsStart = ReadBlockStats(txdb, pindexStart);
+    int64_t nTxs = stats.nChainTx - statsStart.nChainTx;
+    int64_t nInterval = pindex->GetBlockTime() - pindexStart->GetBlockTime();
+
+    Object result;
+    result.push_back(Pair("time", (boost::int64_t)pindex->GetBlockTime()));
+    result.push_back(Pair("txcount", stats.nChainTx));
+    result.push_back(Pair("window_final_block_hash", pindex->GetBlockHash().GetHex()));
+    result.push_back(Pair("window_block_count", nBlocks));
+    result.push_back(Pair("window_tx_count", nTxs));
+    result.push_back(Pair("window_interval", nInterval));
+    if (nInterval > 0)
+        result.push_back(Pair("txrate", (double)nTxs / nInterval));
+    return result;
+}
+
 // ppcoin: get information of sync-checkpoint
 Value getcheckpoint(const Array& params, bool fHelp)
 {
@@ -57,14 +57,34 @@ Value getstakinginfo(const Array& params, bool fHelp)
     if (fHelp || params.size() != 0)
         throw runtime_error(
             "getstakinginfo\n"
-            "Returns an object containing staking-related information.");
+            "Returns an object containing staking-related information.\n"
+            "stakevalue and stakecoins are the value and number of the coins the last search\n"
+            "tried. expectedtime, in seconds, comes from the last search that found no\n"
+            "kernel and is kept until the next such search.");
 
+    CStakeSearchStats stats;
+    {
+        LOCK(pwalletMain->cs_wallet);
+        stats = pwalletMain->stakeSearchStats;
+    }
     uint64_t nWeight = 0;
     //pwalletMain->GetStakeWeight(*pwalletMain, nMinWeight, nMaxWeight, nWeight);
 
     uint64_t nNetworkWeight = GetPoSKernelPS();
-    bool staking = nLastCoinStakeSearchInterval && nWeight;
-    int nExpectedTime = staking ? (nTargetSpacing * nNetworkWeight / nWeight) : -1;
+    bool staking = nLastCoinStakeSearchInterval && stats.nValue;
+    // one kernel per coin is tried every second
+    int nExpectedTime = -1;
+    if (staking && stats.dKernelsPerSecond > 0)
+        nExpectedTime = (int)std::min(1 / stats.dKernelsPerSecond, (double)std::numeric_limits<int>::max());
+
+    Array threads;
+    for (unsigned int i = 0; i < stats.vThreads.size(); i++)
+    {
+        Object thread;
+        thread.push_back(Pair("attempts", (uint64_t)stats.vThreads[i].first));
+        thread.push_back(Pair("attemptspersec", stats.vThreads[i].second ? stats.vThreads[i].first * 1000000.0 / stats.vThreads[i].second : 0.0));
+        threads.push_back(thread);
+    }
 
     Object obj;
 
@@ -83,6 +103,10 @@ Value getstakinginfo(const Array& params, bool fHelp)
     obj.push_back(Pair("netstakeweight", (uint64_t)nNetworkWeight));
 
     obj.push_back(Pair("expectedtime", nExpectedTime));
+    obj.push_back(Pair("stakevalue", ValueFromAmount(stats.nValue)));
+    obj.push_back(Pair("stakecoins", (uint64_t)stats.nCoins));
+    obj.push_back(Pair("lastsearch", stats.nTime));
+    obj.push_back(Pair("searchthreads", threads));
 
     return obj;
 }
@@ -137,6 +137,176 @@ Value getrawtransaction(const Array& params, bool fHelp)
     return result;
 }
 
+static void ParseAddressIndexKey(const Value& value, unsigned char& nAddressType, uint160& hashAddress)
+{
+    if (!fAddressIndex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Address index not enabled; restart with -addressindex");
+
+    CBitcoinAddress address(value.get_str());
+    if (!address.IsValid() || !GetAddressIndexKey(address.Get(), nAddressType, hashAddress))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, string("Invalid ECCoin address: ")+value.get_str());
+}
+
+static void ParsePage(const Array& params, unsigned int nFirst, unsigned int& nSkip, unsigned int& nCount)
+{
+    nSkip = 0;
+    nCount = 100;
+    if (params.size() > nFirst)
+    {
+        if (params[nFirst].get_int() < 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative skip");
+        nSkip = params[nFirst].get_int();
+    }
+    if (params.size() > nFirst + 1)
+    {
+        if (params[nFirst + 1].get_int() < 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative count");
+        nCount = params[nFirst + 1].get_int();
+    }
+}
+
+Value getaddresshistory(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 3)
+        throw runtime_error(
+            "getaddresshistory <address> [skip=0] [count=100]\n"
+            "Returns the outputs paid to and the inputs spending from <address>\n"
+            "in the best chain, oldest first. count=0 returns all of them.\n"
+            "Each entry is {txid, height, index, spending, amount, spent}; amount is\n"
+            "negative for spending entries and spent is only given for outputs.\n"
+            "Requires -addressindex.");
+
+    unsigned char nAddressType;
+    uint160 hashAddress;
+    ParseAddressIndexKey(params[0], nAddressType, hashAddress);
+    unsigned int nSkip, nCount;
+    ParsePage(params, 1, nSkip, nCount);
+
+    CTxDB txdb("r");
+    vector<pair<CAddressIndexKey, CAddressIndexValue> > vHistory;
+    if (!txdb.ReadAddressHistory(nAddressType, hashAddress, nSkip, nCount, vHistory))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Error reading the address index");
+
+    Array results;
+    for (unsigned int i = 0; i < vHistory.size(); i++)
+    {
+        const CAddressIndexKey& key = vHistory[i].first;
+        const CAddressIndexValue& value = vHistory[i].second;
+        Object entry;
+        entry.push_back(Pair("txid", key.hashTx.GetHex()));
+        entry.push_back(Pair("height", key.nHeight));
+        entry.push_back(Pair("index", (boost::int64_t)key.nIndex));
+        entry.push_back(Pair("spending", key.fSpending));
+        entry.push_back(Pair("amount", ValueFromAmount(key.fSpending ? -value.nValue : value.nValue)));
+        if (!key.fSpending)
+        {
+            CAddressIndexValue valueUnspent;
+            CAddressUnspentKey keyUnspent(nAddressType, hashAddress, key.hashTx, key.nIndex);
+            entry.push_back(Pair("spent", !txdb.ReadAddressUnspent(keyUnspent, valueUnspent)));
+        }
+        results.push_back(entry);
+    }
+    return results;
+}
+
+Value getaddressbalance(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "getaddressbalance <address>\n"
+            "Returns the balance of <address> in the best chain, with the totals\n"
+            "received and sent. Requires -addressindex.");
+
+    unsigned char nAddressType;
+    uint160 hashAddress;
+    ParseAddressIndexKey(params[0], nAddressType, hashAddress);
+
+    CTxDB txdb("r");
+    vector<pair<CAddressIndexKey, CAddressIndexValue> > vHistory;
+    if (!txdb.ReadAddressHistory(nAddressType, hashAddress, 0, 0, vHistory))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Error reading the address index");
+
+    int64_t nReceived = 0;
+    int64_t nSent = 0;
+    for (unsigned int i = 0; i < vHistory.size(); i++)
+    {
+        if (vHistory[i].first.fSpending)
+            nSent += vHistory[i].second.nValue;
+        else
+            nReceived += vHistory[i].second.nValue;
+    }
+
+    Object result;
+    result.push_back(Pair("balance", ValueFromAmount(nReceived - nSent)));
+    result.push_back(Pair("received", ValueFromAmount(nReceived)));
+    result.push_back(Pair("sent", ValueFromAmount(nSent)));
+    result.push_back(Pair("entries", (int)vHistory.size()));
+    return result;
+}
+
+Value getaddressutxos(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 3)
+        throw runtime_error(
+            "getaddressutxos <address> [skip=0] [count=100]\n"
+            "Returns the unspent outputs of <address> in the best chain.\n"
+            "count=0 returns all of them. Each entry is\n"
+            "{txid, vout, amount, height, confirmations}. Requires -addressindex.");
+
+    unsigned char nAddressType;
+    uint160 hashAddress;
+    ParseAddressIndexKey(params[0], nAddressType, hashAddress);
+    unsigned int nSkip, nCount;
+    ParsePage(params, 1, nSkip, nCount);
+
+    CTxDB txdb("r");
+    vector<pair<CAddressUnspentKey, CAddressIndexValue> > vUnspent;
+    if (!txdb.ReadAddressUnspents(nAddressType, hashAddress, nSkip, nCount, vUnspent))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Error reading the address index");
+
+    Array results;
+    for (unsigned int i = 0; i < vUnspent.size(); i++)
+    {
+        const CAddressUnspentKey& key = vUnspent[i].first;
+        const CAddressIndexValue& value = vUnspent[i].second;
+        Object entry;
+        entry.push_back(Pair("txid", key.hashTx.GetHex()));
+        entry.push_back(Pair("vout", (boost::int64_t)key.nIndex));
+        entry.push_back(Pair("amount", ValueFromAmount(value.nValue)));
+        entry.push_back(Pair("height", value.nHeight));
+        entry.push_back(Pair("confirmations", value.nHeight >= 0 ? nBestHeight - value.nHeight + 1 : 0));
+        results.push_back(entry);
+    }
+    return results;
+}
+
+Value getspentinfo(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 2)
+        throw runtime_error(
+            "getspentinfo <txid> <vout>\n"
+            "Returns the input spending output <vout> of <txid> in the best chain,\n"
+            "as {txid, vin, height}. Requires -spentindex.");
+
+    if (!fSpentIndex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Spent index not enabled; restart with -spentindex");
+    uint256 hash = ParseHashV(params[0], "txid");
+    if (params[1].get_int() < 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid parameter, vout must be positive");
+    COutPoint outpoint(hash, params[1].get_int());
+
+    CTxDB txdb("r");
+    CSpentIndexValue value;
+    if (!txdb.ReadSpentIndex(outpoint, value))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Output not spent in the best chain");
+
+    Object result;
+    result.push_back(Pair("txid", value.hashTx.GetHex()));
+    result.push_back(Pair("vin", (boost::int64_t)value.nIndex));
+    result.push_back(Pair("height", value.nHeight));
+    return result;
+}
+
 Value listunspent(const Array& params, bool fHelp)
 {
     if (fHelp || params.size() > 3)
@@ -1121,10 +1121,9 @@ uint256 SignatureHash(CScript scriptCode, const CTransaction& txTo, unsigned int
     }
 
     // Serialize and hash
-    CDataStream ss(SER_GETHASH, 0);
-    ss.reserve(10000);
+    CHashWriter ss(SER_GETHASH, 0);
     ss << txTmp << nHashType;
-    return Hash(ss.begin(), ss.end());
+    return ss.GetHash();
 }
 
 
@@ -1203,11 +1202,7 @@ bool CheckSig(vector<unsigned char> vchSig, vector<unsigned char> vchPubKey, CSc
     if (signatureCache.Get(sighash, vchSig, vchPubKey))
         return true;
 
-    CKey key;
-    if (!key.SetPubKey(vchPubKey))
-        return false;
-
-    if (!key.Verify(sighash, vchSig))
+    if (!CPubKey(vchPubKey).Verify(sighash, vchSig))
         return false;
 
     signatureCache.Set(sighash, vchSig, vchPubKey);
@@ -1757,6 +1752,136 @@ bool VerifySignature(const CTransaction& txFrom, const CTransaction& txTo, unsig
     return VerifyScript(txin.scriptSig, txout.scriptPubKey, txTo, nIn, fValidatePayToScriptHash, nHashType);
 }
 
+bool CScriptCheck::operator()() const
+{
+    return VerifyScript(ptxTo->vin[nIn].scriptSig, scriptPubKey, *ptxTo, nIn, nHashType);
+}
+
+//
+// Script check threads. One batch is in flight at a time; the workers and the
+// thread that submitted it pull chunks of checks off a shared index until the
+// batch is used up or a check fails.
+//
+static boost::mutex csScriptCheckBatch;     // serializes VerifyScriptChecks callers
+static boost::mutex csScriptCheck;
+static boost::condition_variable condScriptCheckWork;
+static boost::condition_variable condScriptCheckDone;
+static const vector<CScriptCheck>* pvScriptChecks = NULL;
+static uint64_t nScriptCheckBatch = 0;
+static int nScriptCheckBusy = 0;
+static int nScriptCheckWorkers = 0;
+static bool fScriptCheckStop = false;
+static boost::atomic<unsigned int> nScriptCheckNext(0);
+static boost::atomic<bool> fScriptCheckFailed(false);
+
+static const unsigned int SCRIPT_CHECK_CHUNK = 16;
+
+static void RunScriptChecks(const vector<CScriptCheck>& vChecks)
+{
+    while (!fScriptCheckFailed.load(boost::memory_order_relaxed))
+    {
+        unsigned int nBegin = nScriptCheckNext.fetch_add(SCRIPT_CHECK_CHUNK, boost::memory_order_relaxed);
+        if (nBegin >= vChecks.size())
+            return;
+        unsigned int nEnd = std::min((unsigned int)vChecks.size(), nBegin + SCRIPT_CHECK_CHUNK);
+        for (unsigned int i = nBegin; i < nEnd; i++)
+        {
+            if (!vChecks[i]())
+            {
+                fScriptCheckFailed.store(true, boost::memory_order_relaxed);
+                return;
+            }
+        }
+    }
+}
+
+static void ThreadScriptCheck(void* parg)
+{
+    RenameThread("ECCoin-scriptch");
+
+    uint64_t nLastBatch = 0;
+    boost::unique_lock<boost::mutex> lock(csScriptCheck);
+    while (true)
+    {
+        while (!fScriptCheckStop && (pvScriptChecks == NULL || nScriptCheckBatch == nLastBatch))
+            condScriptCheckWork.wait(lock);
+        if (fScriptCheckStop)
+            break;
+        nLastBatch = nScriptCheckBatch;
+        const vector<CScriptCheck>* pvChecks = pvScriptChecks;
+        nScriptCheckBusy++;
+        lock.unlock();
+        RunScriptChecks(*pvChecks);
+        lock.lock();
+        if (--nScriptCheckBusy == 0)
+            condScriptCheckDone.notify_all();
+    }
+    nScriptCheckWorkers--;
+    condScriptCheckDone.notify_all();
+}
+
+void StartScriptCheckThreads(int nThreads)
+{
+    boost::unique_lock<boost::mutex> lock(csScriptCheck);
+    // Counted here rather than by the threads, so that a stop right after
+    // this waits for all of them
+    fScriptCheckStop = false;
+    for (int i = 0; i < nThreads; i++)
+        if (NewThread(ThreadScriptCheck, NULL))
+            nScriptCheckWorkers++;
+}
+
+void StopScriptCheckThreads()
+{
+    boost::unique_lock<boost::mutex> lock(csScriptCheck);
+    fScriptCheckStop = true;
+    condScriptCheckWork.notify_all();
+    while (nScriptCheckWorkers > 0)
+        condScriptCheckDone.wait(lock);
+}
+
+bool VerifyScriptChecks(const vector<CScriptCheck>& vChecks, unsigned int& nFailedRet)
+{
+    bool fOk = true;
+    {
+        boost::mutex::scoped_lock lockBatch(csScriptCheckBatch);
+        {
+            boost::unique_lock<boost::mutex> lock(csScriptCheck);
+            nScriptCheckNext.store(0);
+            fScriptCheckFailed.store(false);
+            if (nScriptCheckWorkers > 0 && vChecks.size() > SCRIPT_CHECK_CHUNK)
+            {
+                pvScriptChecks = &vChecks;
+                nScriptCheckBatch++;
+                condScriptCheckWork.notify_all();
+            }
+        }
+        RunScriptChecks(vChecks);
+        {
+            boost::unique_lock<boost::mutex> lock(csScriptCheck);
+            pvScriptChecks = NULL;
+            while (nScriptCheckBusy > 0)
+                condScriptCheckDone.wait(lock);
+        }
+        fOk = !fScriptCheckFailed.load();
+    }
+    if (fOk)
+        return true;
+
+    // Find the bad input. Checks that passed above are answered from the
+    // signature cache, so this costs little more than the failing check.
+    nFailedRet = 0;
+    for (unsigned int i = 0; i < vChecks.size(); i++)
+    {
+        if (!vChecks[i]())
+        {
+            nFailedRet = i;
+            break;
+        }
+    }
+    return false;
+}
+
 static CScript PushAll(const vector<valtype>& values)
 {
     CScript result;
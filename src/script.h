@@ -606,6 +606,36 @@ bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, const C
 bool VerifySignature(const CTransaction& txFrom, const CTransaction& txTo, unsigned int nIn, int nHashType);
 bool VerifySignature(const CTransaction& txFrom, const CTransaction& txTo, unsigned int nIn, bool fValidatePayToScriptHash, int nHashType);
 
+/** Script verification of one transaction input, deferred so that all the
+ * inputs of a block or transaction can be checked together by
+ * VerifyScriptChecks. txTo must outlive the check. */
+class CScriptCheck
+{
+private:
+    CScript scriptPubKey;
+    const CTransaction* ptxTo;
+    unsigned int nIn;
+    int nHashType;
+
+public:
+    CScriptCheck() : ptxTo(NULL), nIn(0), nHashType(0) {}
+    CScriptCheck(const CScript& scriptPubKeyIn, const CTransaction& txToIn, unsigned int nInIn, int nHashTypeIn) :
+        scriptPubKey(scriptPubKeyIn), ptxTo(&txToIn), nIn(nInIn), nHashType(nHashTypeIn) {}
+
+    bool operator()() const;
+
+    const CTransaction& GetTx() const { return *ptxTo; }
+    unsigned int GetIn() const { return nIn; }
+};
+
+/** Run a batch of script checks on the script check threads (the calling
+ * thread helps). If any fails, the checks are re-run in order and
+ * nFailedRet is set to the index of the first bad one. */
+bool VerifyScriptChecks(const std::vector<CScriptCheck>& vChecks, unsigned int& nFailedRet);
+/** Start nThreads script check threads; they run until StopScriptCheckThreads */
+void StartScriptCheckThreads(int nThreads);
+void StopScriptCheckThreads();
+
 // Given two sets of signatures for scriptPubKey, possibly with OP_0 placeholders,
 // combine them intelligently and return the result.
 CScript CombineSignatures(CScript scriptPubKey, const CTransaction& txTo, unsigned int nIn, const CScript& scriptSig1, const CScript& scriptSig2);
@@ -33,6 +33,7 @@
 
 #include "scrypt_mine.h"
 #include "pbkdf2.h"
+#include "metrics.h"
 
 #include "util.h"
 #include "net.h"
@@ -162,8 +163,16 @@ void scrypt_buffer_free(void *scratchpad)
    r = 1, p = 1, N = 1024
  */
 
+static CMetricCounter& ScryptMetric()
+{
+    static CMetricCounter& metric = GetMetricCounter("eccoin_scrypt_hashes_total", "Scrypt hashes computed (block hashes, mining and wallet key derivation)");
+    return metric;
+}
+
 static void scrypt(const void* input, size_t inputlen, uint32_t *res, void *scratchpad)
 {
+    ScryptMetric().Add(1);
+
     uint32_t *V;
     uint32_t X[32];
     V = (uint32_t *)(((uintptr_t)(scratchpad) + 63) & ~ (uintptr_t)(63));
@@ -183,6 +192,7 @@ void scrypt_hash_mine(const void* input, size_t inputlen, uint32_t *res, void *s
 #ifdef SCRYPT_3WAY
 static void scrypt_2way(const void *input1, const void *input2, size_t input1len, size_t input2len, uint32_t *res1, uint32_t *res2, void *scratchpad)
 {
+    ScryptMetric().Add(2);
     uint32_t *V;
     uint32_t X[32], Y[32];
     V = (uint32_t *)(((uintptr_t)(scratchpad) + 63) & ~ (uintptr_t)(63));
@@ -200,6 +210,7 @@ static void scrypt_3way(const void *input1, const void *input2, const void *inpu
    size_t input1len, size_t input2len, size_t input3len, uint32_t *res1, uint32_t *res2, uint32_t *res3,
    void *scratchpad)
 {
+    ScryptMetric().Add(3);
     uint32_t *V;
     uint32_t X[32], Y[32], Z[32];
     V = (uint32_t *)(((uintptr_t)(scratchpad) + 63) & ~ (uintptr_t)(63));
@@ -295,6 +306,7 @@ unsigned int scanhash_scrypt(block_header *pdata, void *scratchbuf,
 
 uint256 scryptX(const void* data, size_t datalen, const void* salt, size_t saltlen, void *scratchpad)
 {
+    ScryptMetric().Add(1);
     unsigned int *V;
     unsigned int X[32];
     uint256 result = 0;
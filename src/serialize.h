@@ -8,6 +8,7 @@
 
 #include <string>
 #include <vector>
+#include <algorithm>
 #include <map>
 #include <set>
 #include <cassert>
@@ -1011,7 +1012,209 @@ public:
 };
 
 
+/** Non-owning read stream over a span of serialized bytes.
+ *
+ * Unserializes straight out of a buffer owned by someone else (a LevelDB
+ * slice, a std::string, a received message) without copying it into a
+ * CDataStream first. The buffer must outlive the stream.
+ */
+class CSpanStream
+{
+protected:
+    const char* pbegin;
+    const char* pend;
+    const char* pread;
+    short state;
+    short exceptmask;
+public:
+    int nType;
+    int nVersion;
+
+    CSpanStream(const char* pbeginIn, const char* pendIn, int nTypeIn, int nVersionIn)
+    {
+        pbegin = pread = pbeginIn;
+        pend = pendIn;
+        nType = nTypeIn;
+        nVersion = nVersionIn;
+        state = 0;
+        exceptmask = std::ios::badbit | std::ios::failbit;
+    }
+
+    const char* begin() const    { return pread; }
+    const char* end() const      { return pend; }
+    unsigned int size() const    { return pend - pread; }
+    bool empty() const           { return pread == pend; }
+
+    //
+    // Stream subset
+    //
+    void setstate(short bits, const char* psz)
+    {
+        state |= bits;
+        if (state & exceptmask)
+            THROW_WITH_STACKTRACE(std::ios_base::failure(psz));
+    }
+
+    bool eof() const             { return pread == pend; }
+    bool fail() const            { return state & (std::ios::badbit | std::ios::failbit); }
+    bool good() const            { return !eof() && (state == 0); }
+    void clear(short n)          { state = n; }
+    short exceptions()           { return exceptmask; }
+    short exceptions(short mask) { short prev = exceptmask; exceptmask = mask; setstate(0, "CSpanStream"); return prev; }
+
+    void SetType(int n)          { nType = n; }
+    int GetType()                { return nType; }
+    void SetVersion(int n)       { nVersion = n; }
+    int GetVersion()             { return nVersion; }
+    void ReadVersion()           { *this >> nVersion; }
+
+    CSpanStream& read(char* pch, int nSize)
+    {
+        assert(nSize >= 0);
+        if (nSize > pend - pread)
+        {
+            memset(pch, 0, nSize);
+            nSize = pend - pread;
+            memcpy(pch, pread, nSize);
+            pread = pend;
+            setstate(std::ios::failbit, "CSpanStream::read() : end of data");
+            return (*this);
+        }
+        memcpy(pch, pread, nSize);
+        pread += nSize;
+        return (*this);
+    }
+
+    CSpanStream& ignore(int nSize)
+    {
+        assert(nSize >= 0);
+        if (nSize > pend - pread)
+        {
+            pread = pend;
+            setstate(std::ios::failbit, "CSpanStream::ignore() : end of data");
+            return (*this);
+        }
+        pread += nSize;
+        return (*this);
+    }
+
+    template<typename T>
+    unsigned int GetSerializeSize(const T& obj)
+    {
+        // Tells the size of the object if serialized to this stream
+        return ::GetSerializeSize(obj, nType, nVersion);
+    }
+
+    template<typename T>
+    CSpanStream& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
+
+
+/** Append-only write stream that keeps the first N bytes inline.
+ *
+ * Meant for short-lived serializations of public data (database keys and
+ * values, hash preimages): small objects never touch the heap, and unlike
+ * CDataStream the memory is not wiped when it is released. Do not use it
+ * for private keys or other secrets.
+ */
+template<unsigned int N>
+class CSmallDataStream
+{
+protected:
+    char vchInline[N];
+    std::vector<char> vchHeap;
+    char* pdata;
+    unsigned int nSize;
+    unsigned int nCapacity;
+
+    void Grow(unsigned int nNeeded)
+    {
+        unsigned int nNewCapacity = std::max(nNeeded, 2 * nCapacity);
+        if (vchHeap.empty())
+        {
+            vchHeap.resize(nNewCapacity);
+            memcpy(&vchHeap[0], vchInline, nSize);
+        }
+        else
+            vchHeap.resize(nNewCapacity);
+        pdata = &vchHeap[0];
+        nCapacity = nNewCapacity;
+    }
+
+private:
+    // pdata may point into the object itself
+    CSmallDataStream(const CSmallDataStream&);
+    CSmallDataStream& operator=(const CSmallDataStream&);
+
+public:
+    int nType;
+    int nVersion;
+
+    CSmallDataStream(int nTypeIn, int nVersionIn)
+    {
+        pdata = vchInline;
+        nSize = 0;
+        nCapacity = N;
+        nType = nTypeIn;
+        nVersion = nVersionIn;
+    }
+
+    const char* begin() const    { return pdata; }
+    const char* end() const      { return pdata + nSize; }
+    unsigned int size() const    { return nSize; }
+    bool empty() const           { return nSize == 0; }
+    void clear()                 { nSize = 0; }
+    std::string str() const      { return std::string(begin(), end()); }
+    bool IsInline() const        { return pdata == vchInline; }
+
+    //
+    // Stream subset
+    //
+    void SetType(int n)          { nType = n; }
+    int GetType()                { return nType; }
+    void SetVersion(int n)       { nVersion = n; }
+    int GetVersion()             { return nVersion; }
+    void WriteVersion()          { *this << nVersion; }
 
+    CSmallDataStream& write(const char* pch, int nLen)
+    {
+        assert(nLen >= 0);
+        if (nSize + nLen > nCapacity)
+            Grow(nSize + nLen);
+        memcpy(pdata + nSize, pch, nLen);
+        nSize += nLen;
+        return (*this);
+    }
+
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        // Special case: stream << stream writes the raw bytes
+        if (nSize)
+            s.write(pdata, nSize);
+    }
+
+    template<typename T>
+    unsigned int GetSerializeSize(const T& obj)
+    {
+        // Tells the size of the object if serialized to this stream
+        return ::GetSerializeSize(obj, nType, nVersion);
+    }
+
+    template<typename T>
+    CSmallDataStream& operator<<(const T& obj)
+    {
+        // Serialize to this stream
+        ::Serialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
 
 
 
@@ -6,6 +6,9 @@
 #include "util.h"
 
 #include <boost/foreach.hpp>
+#include <boost/atomic.hpp>
+
+#include <algorithm>
 
 #ifdef DEBUG_LOCKCONTENTION
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine)
@@ -126,3 +129,256 @@ void LeaveCritical()
 }
 
 #endif /* DEBUG_LOCKORDER */
+
+#ifdef DEBUG_LOCKPROFILE
+//
+// Lock profiling.
+// Every LOCK() call site registers itself once and gets a slot number. Each
+// thread owns an array of counters indexed by slot; only that thread writes
+// them (plain load + store, no read-modify-write), readers just sum the
+// arrays of all threads. When a thread exits its array is added to the
+// retired totals and freed. Sites beyond MAX_LOCK_SITES are not counted.
+//
+
+static const int MAX_LOCK_SITES = 1024;
+
+struct CLockCounters
+{
+    boost::atomic<uint64_t> nLocks;
+    boost::atomic<uint64_t> nContended;
+    boost::atomic<uint64_t> nWaitMicros;
+    boost::atomic<uint64_t> nHoldMicros;
+    boost::atomic<uint64_t> nMaxHoldMicros;
+};
+
+// An ENTER_CRITICAL_SECTION() whose LEAVE_CRITICAL_SECTION() is still to come
+struct CLockHeldSection
+{
+    const CLockSite* psite;
+    void* cs;
+    int64_t nLockedSince;
+};
+
+struct CLockThreadCounters
+{
+    CLockCounters vSites[MAX_LOCK_SITES];
+    std::vector<CLockHeldSection> vHeld;
+
+    CLockThreadCounters()
+    {
+        for (int i = 0; i < MAX_LOCK_SITES; i++)
+        {
+            vSites[i].nLocks.store(0);
+            vSites[i].nContended.store(0);
+            vSites[i].nWaitMicros.store(0);
+            vSites[i].nHoldMicros.store(0);
+            vSites[i].nMaxHoldMicros.store(0);
+        }
+    }
+};
+
+// Constructed on first use, since LOCK() may run during static
+// initialization, and never destroyed, since threads can still exit while
+// static objects are destroyed
+static boost::mutex& LockProfileMutex()
+{
+    static boost::mutex* pcs = new boost::mutex;
+    return *pcs;
+}
+
+static std::vector<const CLockSite*>& LockSites()
+{
+    static std::vector<const CLockSite*>* pvSites = new std::vector<const CLockSite*>();
+    return *pvSites;
+}
+
+static std::vector<CLockThreadCounters*>& LockThreads()
+{
+    static std::vector<CLockThreadCounters*>* pvThreads = new std::vector<CLockThreadCounters*>();
+    return *pvThreads;
+}
+
+// Totals of the threads that have exited
+static CLockThreadCounters& RetiredLockThreadCounters()
+{
+    static CLockThreadCounters* pcounters = new CLockThreadCounters();
+    return *pcounters;
+}
+
+static inline void AddCounter(boost::atomic<uint64_t>& n, uint64_t nAdd)
+{
+    n.store(n.load(boost::memory_order_relaxed) + nAdd, boost::memory_order_relaxed);
+}
+
+// Called at thread exit: fold the thread's counters into the retired totals
+// and free them
+static void ReleaseLockThreadCounters(CLockThreadCounters* pcounters)
+{
+    boost::mutex::scoped_lock lock(LockProfileMutex());
+    std::vector<CLockThreadCounters*>& vThreads = LockThreads();
+    vThreads.erase(std::remove(vThreads.begin(), vThreads.end(), pcounters), vThreads.end());
+    CLockThreadCounters& retired = RetiredLockThreadCounters();
+    for (int i = 0; i < MAX_LOCK_SITES; i++)
+    {
+        const CLockCounters& counters = pcounters->vSites[i];
+        CLockCounters& total = retired.vSites[i];
+        AddCounter(total.nLocks, counters.nLocks.load(boost::memory_order_relaxed));
+        AddCounter(total.nContended, counters.nContended.load(boost::memory_order_relaxed));
+        AddCounter(total.nWaitMicros, counters.nWaitMicros.load(boost::memory_order_relaxed));
+        AddCounter(total.nHoldMicros, counters.nHoldMicros.load(boost::memory_order_relaxed));
+        if (counters.nMaxHoldMicros.load(boost::memory_order_relaxed) > total.nMaxHoldMicros.load(boost::memory_order_relaxed))
+            total.nMaxHoldMicros.store(counters.nMaxHoldMicros.load(boost::memory_order_relaxed), boost::memory_order_relaxed);
+    }
+    delete pcounters;
+}
+
+static CLockThreadCounters* GetLockThreadCounters()
+{
+    static boost::thread_specific_ptr<CLockThreadCounters> ptr(ReleaseLockThreadCounters);
+    CLockThreadCounters* pcounters = ptr.get();
+    if (pcounters == NULL)
+    {
+        pcounters = new CLockThreadCounters();
+        {
+            boost::mutex::scoped_lock lock(LockProfileMutex());
+            LockThreads().push_back(pcounters);
+        }
+        ptr.reset(pcounters);
+    }
+    return pcounters;
+}
+
+CLockSite::CLockSite(const char* pszNameIn, const char* pszFileIn, int nLineIn)
+{
+    pszName = pszNameIn;
+    pszFile = pszFileIn;
+    nLine = nLineIn;
+    boost::mutex::scoped_lock lock(LockProfileMutex());
+    nId = LockSites().size();
+    LockSites().push_back(this);
+}
+
+int64_t LockProfileMicros()
+{
+    return GetTimeMicros();
+}
+
+void LockProfileAcquired(const CLockSite* psite, bool fContended, int64_t nWaitMicros)
+{
+    if (psite == NULL || psite->nId >= MAX_LOCK_SITES)
+        return;
+    CLockCounters& counters = GetLockThreadCounters()->vSites[psite->nId];
+    AddCounter(counters.nLocks, 1);
+    if (fContended)
+        AddCounter(counters.nContended, 1);
+    AddCounter(counters.nWaitMicros, std::max(nWaitMicros, (int64_t)0));
+}
+
+void LockProfileReleased(const CLockSite* psite, int64_t nHoldMicros)
+{
+    if (psite == NULL || psite->nId >= MAX_LOCK_SITES)
+        return;
+    CLockCounters& counters = GetLockThreadCounters()->vSites[psite->nId];
+    uint64_t nHold = std::max(nHoldMicros, (int64_t)0);
+    AddCounter(counters.nHoldMicros, nHold);
+    if (nHold > counters.nMaxHoldMicros.load(boost::memory_order_relaxed))
+        counters.nMaxHoldMicros.store(nHold, boost::memory_order_relaxed);
+}
+
+void LockProfileEnterSection(const CLockSite* psite, void* cs, bool fContended, int64_t nWaitMicros)
+{
+    if (psite == NULL || psite->nId >= MAX_LOCK_SITES)
+        return;
+    LockProfileAcquired(psite, fContended, nWaitMicros);
+    CLockHeldSection held;
+    held.psite = psite;
+    held.cs = cs;
+    held.nLockedSince = LockProfileMicros();
+    GetLockThreadCounters()->vHeld.push_back(held);
+}
+
+void LockProfileLeaveSection(void* cs)
+{
+    // the latest entry of a recursive lock is the one being left
+    std::vector<CLockHeldSection>& vHeld = GetLockThreadCounters()->vHeld;
+    for (std::vector<CLockHeldSection>::reverse_iterator it = vHeld.rbegin(); it != vHeld.rend(); ++it)
+    {
+        if (it->cs == cs)
+        {
+            LockProfileReleased(it->psite, LockProfileMicros() - it->nLockedSince);
+            vHeld.erase(--(it.base()));
+            return;
+        }
+    }
+}
+
+bool GetLockStats(std::vector<CLockSiteStats>& vStats)
+{
+    vStats.clear();
+    boost::mutex::scoped_lock lock(LockProfileMutex());
+    const std::vector<const CLockSite*>& vSites = LockSites();
+    std::vector<const CLockThreadCounters*> vThreads(LockThreads().begin(), LockThreads().end());
+    vThreads.push_back(&RetiredLockThreadCounters());
+    for (unsigned int i = 0; i < vSites.size() && i < (unsigned int)MAX_LOCK_SITES; i++)
+    {
+        CLockSiteStats stats;
+        stats.strName = vSites[i]->pszName;
+        stats.strFile = vSites[i]->pszFile;
+        stats.nLine = vSites[i]->nLine;
+        stats.nLocks = stats.nContended = stats.nWaitMicros = stats.nHoldMicros = stats.nMaxHoldMicros = 0;
+        BOOST_FOREACH(const CLockThreadCounters* pcounters, vThreads)
+        {
+            const CLockCounters& counters = pcounters->vSites[i];
+            stats.nLocks += counters.nLocks.load(boost::memory_order_relaxed);
+            stats.nContended += counters.nContended.load(boost::memory_order_relaxed);
+            stats.nWaitMicros += counters.nWaitMicros.load(boost::memory_order_relaxed);
+            stats.nHoldMicros += counters.nHoldMicros.load(boost::memory_order_relaxed);
+            stats.nMaxHoldMicros = std::max(stats.nMaxHoldMicros, (uint64_t)counters.nMaxHoldMicros.load(boost::memory_order_relaxed));
+        }
+        if (stats.nLocks > 0)
+            vStats.push_back(stats);
+    }
+    return true;
+}
+
+static bool CompareHoldTime(const CLockSiteStats& a, const CLockSiteStats& b)
+{
+    return a.nHoldMicros > b.nHoldMicros;
+}
+
+void ThreadLockStatsDump(void* parg)
+{
+    RenameThread("ECCoin-lockstats");
+
+    int64_t nInterval = std::max(GetArg("-lockstatsinterval", 0), (int64_t)1);
+    int64_t nNextDump = GetTime() + nInterval;
+    while (!fShutdown)
+    {
+        MilliSleep(1000);
+        if (GetTime() < nNextDump)
+            continue;
+        nNextDump = GetTime() + nInterval;
+
+        std::vector<CLockSiteStats> vStats;
+        GetLockStats(vStats);
+        std::sort(vStats.begin(), vStats.end(), CompareHoldTime);
+        printf("Lock profile, %" PRIszu " sites, busiest by hold time:\n", vStats.size());
+        for (unsigned int i = 0; i < vStats.size() && i < 20; i++)
+        {
+            const CLockSiteStats& stats = vStats[i];
+            printf("  %s %s:%d locks=%" PRIu64 " contended=%" PRIu64 " wait=%" PRIu64 "us hold=%" PRIu64 "us maxhold=%" PRIu64 "us\n",
+                stats.strName.c_str(), stats.strFile.c_str(), stats.nLine, stats.nLocks, stats.nContended,
+                stats.nWaitMicros, stats.nHoldMicros, stats.nMaxHoldMicros);
+        }
+    }
+}
+
+#else
+
+bool GetLockStats(std::vector<CLockSiteStats>& vStats)
+{
+    vStats.clear();
+    return false;
+}
+
+#endif /* DEBUG_LOCKPROFILE */
@@ -10,6 +10,9 @@
 #include <boost/thread/locks.hpp>
 #include <boost/thread/condition_variable.hpp>
 
+#include <stdint.h>
+#include <string>
+#include <vector>
 
 
 
@@ -31,12 +34,59 @@ void static inline LeaveCritical() {}
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+/** Aggregated lock profile of one LOCK()/TRY_LOCK() call site */
+struct CLockSiteStats
+{
+    std::string strName;
+    std::string strFile;
+    int nLine;
+    uint64_t nLocks;
+    uint64_t nContended;
+    uint64_t nWaitMicros;
+    uint64_t nHoldMicros;
+    uint64_t nMaxHoldMicros;
+};
+
+/** Sum the per-thread lock counters. Returns false unless built with DEBUG_LOCKPROFILE. */
+bool GetLockStats(std::vector<CLockSiteStats>& vStats);
+
+#ifdef DEBUG_LOCKPROFILE
+/** A LOCK()/TRY_LOCK()/ENTER_CRITICAL_SECTION() call site, one static instance per macro expansion.
+ * Wait time, hold time and contention are counted per site in counters that
+ * only the locking thread writes, so profiling adds no shared cache lines.
+ */
+class CLockSite
+{
+public:
+    const char* pszName;
+    const char* pszFile;
+    int nLine;
+    int nId;
+
+    CLockSite(const char* pszNameIn, const char* pszFileIn, int nLineIn);
+};
+
+int64_t LockProfileMicros();
+void LockProfileAcquired(const CLockSite* psite, bool fContended, int64_t nWaitMicros);
+void LockProfileReleased(const CLockSite* psite, int64_t nHoldMicros);
+/** ENTER_CRITICAL_SECTION()/LEAVE_CRITICAL_SECTION(), which can be in different functions */
+void LockProfileEnterSection(const CLockSite* psite, void* cs, bool fContended, int64_t nWaitMicros);
+void LockProfileLeaveSection(void* cs);
+
+/** Write the busiest lock sites to debug.log every -lockstatsinterval seconds */
+void ThreadLockStatsDump(void* parg);
+#endif
+
 /** Wrapper around boost::unique_lock<Mutex> */
 template<typename Mutex>
 class CMutexLock
 {
 private:
     boost::unique_lock<Mutex> lock;
+#ifdef DEBUG_LOCKPROFILE
+    const CLockSite* psite;
+    int64_t nLockedSince;
+#endif
 public:
 
     void Enter(const char* pszName, const char* pszFile, int nLine)
@@ -44,14 +94,27 @@ public:
         if (!lock.owns_lock())
         {
             EnterCritical(pszName, pszFile, nLine, (void*)(lock.mutex()));
-#ifdef DEBUG_LOCKCONTENTION
+#ifdef DEBUG_LOCKPROFILE
+            int64_t nWaitStart = LockProfileMicros();
+            bool fContended = false;
+#endif
+#if defined(DEBUG_LOCKCONTENTION) || defined(DEBUG_LOCKPROFILE)
             if (!lock.try_lock())
             {
+#ifdef DEBUG_LOCKCONTENTION
                 PrintLockContention(pszName, pszFile, nLine);
+#endif
+#ifdef DEBUG_LOCKPROFILE
+                fContended = true;
+#endif
 #endif
             lock.lock();
-#ifdef DEBUG_LOCKCONTENTION
+#if defined(DEBUG_LOCKCONTENTION) || defined(DEBUG_LOCKPROFILE)
             }
+#endif
+#ifdef DEBUG_LOCKPROFILE
+            nLockedSince = LockProfileMicros();
+            LockProfileAcquired(psite, fContended, nLockedSince - nWaitStart);
 #endif
         }
     }
@@ -60,6 +123,9 @@ public:
     {
         if (lock.owns_lock())
         {
+#ifdef DEBUG_LOCKPROFILE
+            LockProfileReleased(psite, LockProfileMicros() - nLockedSince);
+#endif
             lock.unlock();
             LeaveCritical();
         }
@@ -73,11 +139,22 @@ public:
             lock.try_lock();
             if (!lock.owns_lock())
                 LeaveCritical();
+#ifdef DEBUG_LOCKPROFILE
+            else
+            {
+                nLockedSince = LockProfileMicros();
+                LockProfileAcquired(psite, false, 0);
+            }
+#endif
         }
         return lock.owns_lock();
     }
 
+#ifdef DEBUG_LOCKPROFILE
+    CMutexLock(Mutex& mutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false, const CLockSite* psiteIn = NULL) : lock(mutexIn, boost::defer_lock), psite(psiteIn), nLockedSince(0)
+#else
     CMutexLock(Mutex& mutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false) : lock(mutexIn, boost::defer_lock)
+#endif
     {
         if (fTry)
             TryEnter(pszName, pszFile, nLine);
@@ -88,7 +165,12 @@ public:
     ~CMutexLock()
     {
         if (lock.owns_lock())
+        {
+#ifdef DEBUG_LOCKPROFILE
+            LockProfileReleased(psite, LockProfileMicros() - nLockedSince);
+#endif
             LeaveCritical();
+        }
     }
 
     operator bool()
@@ -104,10 +186,35 @@ public:
 
 typedef CMutexLock<CCriticalSection> CCriticalBlock;
 
+#ifdef DEBUG_LOCKPROFILE
+#define LOCK(cs) static CLockSite criticalsite(#cs, __FILE__, __LINE__); CCriticalBlock criticalblock(cs, #cs, __FILE__, __LINE__, false, &criticalsite)
+#define LOCK2(cs1,cs2) static CLockSite criticalsite1(#cs1, __FILE__, __LINE__), criticalsite2(#cs2, __FILE__, __LINE__); CCriticalBlock criticalblock1(cs1, #cs1, __FILE__, __LINE__, false, &criticalsite1),criticalblock2(cs2, #cs2, __FILE__, __LINE__, false, &criticalsite2)
+#define TRY_LOCK(cs,name) static CLockSite name##site(#cs, __FILE__, __LINE__); CCriticalBlock name(cs, #cs, __FILE__, __LINE__, true, &name##site)
+#else
 #define LOCK(cs) CCriticalBlock criticalblock(cs, #cs, __FILE__, __LINE__)
 #define LOCK2(cs1,cs2) CCriticalBlock criticalblock1(cs1, #cs1, __FILE__, __LINE__),criticalblock2(cs2, #cs2, __FILE__, __LINE__)
 #define TRY_LOCK(cs,name) CCriticalBlock name(cs, #cs, __FILE__, __LINE__, true)
+#endif
 
+#ifdef DEBUG_LOCKPROFILE
+#define ENTER_CRITICAL_SECTION(cs) \
+    { \
+        static CLockSite criticalsite(#cs, __FILE__, __LINE__); \
+        EnterCritical(#cs, __FILE__, __LINE__, (void*)(&cs)); \
+        int64_t nWaitStart = LockProfileMicros(); \
+        bool fContended = !(cs).try_lock(); \
+        if (fContended) \
+            (cs).lock(); \
+        LockProfileEnterSection(&criticalsite, (void*)(&cs), fContended, LockProfileMicros() - nWaitStart); \
+    }
+
+#define LEAVE_CRITICAL_SECTION(cs) \
+    { \
+        LockProfileLeaveSection((void*)(&cs)); \
+        (cs).unlock(); \
+        LeaveCritical(); \
+    }
+#else
 #define ENTER_CRITICAL_SECTION(cs) \
     { \
         EnterCritical(#cs, __FILE__, __LINE__, (void*)(&cs)); \
@@ -119,6 +226,7 @@ typedef CMutexLock<CCriticalSection> CCriticalBlock;
         (cs).unlock(); \
         LeaveCritical(); \
     }
+#endif
 
 class CSemaphore
 {
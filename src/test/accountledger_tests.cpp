@@ -0,0 +1,233 @@
+#include <boost/test/unit_test.hpp>
+
+#include <boost/foreach.hpp>
+
+#include "main.h"
+#include "wallet.h"
+#include "walletdb.h"
+
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(accountledger_tests)
+
+static vector<CBlockIndex> vIndex(200);
+static vector<uint256> vHashes(200);
+
+static void SetBestHeight(int nHeight)
+{
+    for (int i = 0; i < (int)vIndex.size(); i++)
+        vIndex[i].pnext = i < nHeight ? &vIndex[i + 1] : NULL;
+    pindexBest = &vIndex[nHeight];
+    nBestHeight = nHeight;
+}
+
+static void AddTx(CWallet& wallet, const CTransaction& tx, int nHeight, const string& strFromAccount = "")
+{
+    CWalletTx wtx(&wallet, tx);
+    wtx.strFromAccount = strFromAccount;
+    wtx.hashBlock = vHashes[nHeight];
+    wtx.nIndex = 0;
+    vIndex[nHeight].hashMerkleRoot = tx.GetHash();
+    BOOST_CHECK(wallet.AddToWallet(wtx));
+}
+
+static CTransaction MakeTx(const COutPoint& prevout)
+{
+    CTransaction tx;
+    tx.vin.push_back(CTxIn(prevout));
+    return tx;
+}
+
+static void AddOutput(CTransaction& tx, const CTxDestination& address, int64_t nValue)
+{
+    CScript scriptPubKey;
+    scriptPubKey.SetDestination(address);
+    tx.vout.push_back(CTxOut(nValue, scriptPubKey));
+}
+
+// getbalance <account> and listaccounts as they were before the ledger, by a
+// scan of every wallet transaction and accounting entry
+static int64_t ScanAccountBalance(CWallet& wallet, const string& strAccount, int nMinDepth)
+{
+    int64_t nBalance = 0;
+    for (map<uint256, CWalletTx>::iterator it = wallet.mapWallet.begin(); it != wallet.mapWallet.end(); ++it)
+    {
+        const CWalletTx& wtx = (*it).second;
+        if (!wtx.IsFinal() || wtx.GetDepthInMainChain() < 0)
+            continue;
+
+        int64_t nReceived, nSent, nFee;
+        wtx.GetAccountAmounts(strAccount, nReceived, nSent, nFee);
+
+        if (nReceived != 0 && wtx.GetDepthInMainChain() >= nMinDepth && wtx.GetBlocksToMaturity() == 0)
+            nBalance += nReceived;
+        nBalance -= nSent + nFee;
+    }
+    return nBalance + CWalletDB(wallet.strWalletFile).GetAccountCreditDebit(strAccount);
+}
+
+static void ScanAccountBalances(CWallet& wallet, map<string, int64_t>& mapBalances, int nMinDepth)
+{
+    BOOST_FOREACH(const PAIRTYPE(CTxDestination, string)& entry, wallet.mapAddressBook)
+        if (IsMine(wallet, entry.first))
+            mapBalances[entry.second] = 0;
+
+    for (map<uint256, CWalletTx>::iterator it = wallet.mapWallet.begin(); it != wallet.mapWallet.end(); ++it)
+    {
+        const CWalletTx& wtx = (*it).second;
+        int64_t nFee;
+        string strSentAccount;
+        list<pair<CTxDestination, int64_t> > listReceived;
+        list<pair<CTxDestination, int64_t> > listSent;
+        int nDepth = wtx.GetDepthInMainChain();
+        if (nDepth < 0)
+            continue;
+        wtx.GetAmounts(listReceived, listSent, nFee, strSentAccount);
+        mapBalances[strSentAccount] -= nFee;
+        BOOST_FOREACH(const PAIRTYPE(CTxDestination, int64_t)& s, listSent)
+            mapBalances[strSentAccount] -= s.second;
+        if (nDepth >= nMinDepth && wtx.GetBlocksToMaturity() == 0)
+        {
+            BOOST_FOREACH(const PAIRTYPE(CTxDestination, int64_t)& r, listReceived)
+                if (wallet.mapAddressBook.count(r.first))
+                    mapBalances[wallet.mapAddressBook[r.first]] += r.second;
+                else
+                    mapBalances[""] += r.second;
+        }
+    }
+
+    list<CAccountingEntry> acentries;
+    CWalletDB(wallet.strWalletFile).ListAccountCreditDebit("*", acentries);
+    BOOST_FOREACH(const CAccountingEntry& entry, acentries)
+        mapBalances[entry.strAccount] += entry.nCreditDebit;
+}
+
+// the ledger must agree with the scan either side of the settled depth,
+// including for names that are no longer in use
+static void CheckAccountLedger(CWallet& wallet)
+{
+    int nSettledDepth = nCoinbaseMaturity + 20;
+    int vMinDepth[] = { 0, 1, 6, nSettledDepth - 1, nSettledDepth, nSettledDepth + 1 };
+    BOOST_FOREACH(int nMinDepth, vMinDepth)
+    {
+        map<string, int64_t> mapScan;
+        ScanAccountBalances(wallet, mapScan, nMinDepth);
+        map<string, int64_t> mapLedger;
+        wallet.GetAccountBalances(mapLedger, nMinDepth);
+        BOOST_CHECK(mapLedger == mapScan);
+
+        mapScan["alice"];
+        mapScan["nobody"];
+        BOOST_FOREACH(const PAIRTYPE(string, int64_t)& item, mapScan)
+            BOOST_CHECK_EQUAL(wallet.GetAccountBalance(item.first, nMinDepth), ScanAccountBalance(wallet, item.first, nMinDepth));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(accountledger_matches_scan)
+{
+    CBlockIndex* pindexBestSaved = pindexBest;
+    int nBestHeightSaved = nBestHeight;
+    for (unsigned int i = 0; i < vIndex.size(); i++)
+    {
+        vHashes[i] = GetRandHash();
+        vIndex[i].nHeight = i;
+        vIndex[i].pprev = i > 0 ? &vIndex[i - 1] : NULL;
+        vIndex[i].phashBlock = &mapBlockIndex.insert(make_pair(vHashes[i], &vIndex[i])).first->first;
+    }
+    SetBestHeight(10);
+
+    CWallet wallet("accountledger.dat");
+    bool fFirstRun;
+    wallet.LoadWallet(fFirstRun);
+
+    CKey key[5];
+    for (int i = 0; i < 5; i++)
+        key[i].MakeNewKey(true);
+    CKeyID alice = key[0].GetPubKey().GetID();
+    CKeyID bob = key[1].GetPubKey().GetID();
+    CKeyID change = key[2].GetPubKey().GetID();
+    CKeyID other = key[4].GetPubKey().GetID();
+    for (int i = 0; i < 4; i++)
+        wallet.AddKey(key[i]);
+    wallet.SetAddressBookName(alice, "alice");
+    wallet.SetAddressBookName(bob, "bob");
+    CScript redeemScript;
+    redeemScript << key[3].GetPubKey() << OP_CHECKSIG;
+
+    // receives, a receive to a script the wallet does not know yet, a send
+    // from alice with change, and a send whose input the wallet has not seen
+    CTransaction tx1 = MakeTx(COutPoint(GetRandHash(), 0));
+    AddOutput(tx1, alice, 100 * COIN);
+    AddOutput(tx1, bob, 50 * COIN);
+    AddTx(wallet, tx1, 1);
+    CTransaction tx2 = MakeTx(COutPoint(GetRandHash(), 0));
+    AddOutput(tx2, redeemScript.GetID(), 30 * COIN);
+    AddTx(wallet, tx2, 2);
+    CTransaction tx3 = MakeTx(COutPoint(tx1.GetHash(), 0));
+    AddOutput(tx3, other, 60 * COIN);
+    AddOutput(tx3, change, 39 * COIN);
+    AddTx(wallet, tx3, 3, "alice");
+    CTransaction tx4 = MakeTx(COutPoint(GetRandHash(), 0));
+    AddOutput(tx4, alice, 30 * COIN);
+    CTransaction tx5 = MakeTx(COutPoint(tx4.GetHash(), 0));
+    AddOutput(tx5, other, 25 * COIN);
+    AddTx(wallet, tx5, 5);
+    CheckAccountLedger(wallet);
+
+    // block by block past the depth at which each of them settles
+    for (int nHeight = 11; nHeight <= 70; nHeight++)
+    {
+        SetBestHeight(nHeight);
+        CheckAccountLedger(wallet);
+    }
+    CTransaction tx6 = MakeTx(COutPoint(GetRandHash(), 0));
+    AddOutput(tx6, alice, 20 * COIN);
+    AddOutput(tx6, change, 5 * COIN);
+    AddTx(wallet, tx6, 65);
+    CheckAccountLedger(wallet);
+
+    // rename, name delete and naming a change address
+    wallet.SetAddressBookName(alice, "carol");
+    CheckAccountLedger(wallet);
+    wallet.SetAddressBookName(bob, "dave");
+    CheckAccountLedger(wallet);
+    wallet.DelAddressBookName(bob);
+    CheckAccountLedger(wallet);
+    wallet.SetAddressBookName(change, "change");
+    CheckAccountLedger(wallet);
+
+    // the script turns a settled receive into the wallet's own
+    BOOST_CHECK(wallet.AddCScript(redeemScript));
+    CheckAccountLedger(wallet);
+
+    // move
+    CWalletDB walletdb(wallet.strWalletFile);
+    CAccountingEntry debit;
+    debit.strAccount = "carol";
+    debit.nCreditDebit = -10 * COIN;
+    debit.nTime = GetAdjustedTime();
+    debit.strOtherAccount = "savings";
+    BOOST_CHECK(wallet.AddAccountingEntry(debit, walletdb));
+    CAccountingEntry credit = debit;
+    credit.strAccount = "savings";
+    credit.nCreditDebit = 10 * COIN;
+    credit.strOtherAccount = "carol";
+    BOOST_CHECK(wallet.AddAccountingEntry(credit, walletdb));
+    CheckAccountLedger(wallet);
+
+    // a rescan that finds the input of a settled send
+    wallet.ScanForWalletTransactions(NULL);
+    AddTx(wallet, tx4, 4);
+    wallet.MarkDirty();
+    CheckAccountLedger(wallet);
+
+    SetBestHeight(150);
+    CheckAccountLedger(wallet);
+
+    for (unsigned int i = 0; i < vIndex.size(); i++)
+        mapBlockIndex.erase(vHashes[i]);
+    pindexBest = pindexBestSaved;
+    nBestHeight = nBestHeightSaved;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,138 @@
+#include <boost/test/unit_test.hpp>
+
+#include "main.h"
+#include "txdb-leveldb.h"
+#include "util.h"
+
+BOOST_AUTO_TEST_SUITE(addressindex_tests)
+
+static std::string KeyBytes(const CAddressIndexKey& key)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << std::make_pair(std::string("addr"), key);
+    return ss.str();
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_key_roundtrip)
+{
+    CAddressIndexKey key(ADDRESS_TYPE_SCRIPTHASH, uint160(12345), 0x01020304, GetRandHash(), 7, true);
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << key;
+    BOOST_CHECK(ss.size() == key.GetSerializeSize(SER_DISK, CLIENT_VERSION));
+
+    CAddressIndexKey keyRead;
+    ss >> keyRead;
+    BOOST_CHECK(keyRead.nAddressType == key.nAddressType);
+    BOOST_CHECK(keyRead.hashAddress == key.hashAddress);
+    BOOST_CHECK(keyRead.nHeight == key.nHeight);
+    BOOST_CHECK(keyRead.hashTx == key.hashTx);
+    BOOST_CHECK(keyRead.nIndex == key.nIndex);
+    BOOST_CHECK(keyRead.fSpending == key.fSpending);
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_key_order)
+{
+    // LevelDB compares keys as bytes: an address's entries must come out by height
+    const int vHeights[] = { 0, 1, 255, 256, 65535, 65536, 86400, 1000000, 16777216 };
+    uint160 hashAddress(42);
+    for (unsigned int i = 1; i < sizeof(vHeights) / sizeof(vHeights[0]); i++)
+    {
+        CAddressIndexKey keyLow(ADDRESS_TYPE_PUBKEYHASH, hashAddress, vHeights[i - 1], GetRandHash(), 9, true);
+        CAddressIndexKey keyHigh(ADDRESS_TYPE_PUBKEYHASH, hashAddress, vHeights[i], GetRandHash(), 0, false);
+        BOOST_CHECK(KeyBytes(keyLow) < KeyBytes(keyHigh));
+    }
+
+    // and sort as one run, apart from the entries of other addresses
+    CAddressIndexKey keySeek(ADDRESS_TYPE_PUBKEYHASH, hashAddress, 0, 0, 0, false);
+    CAddressIndexKey keyLast(ADDRESS_TYPE_PUBKEYHASH, hashAddress, 0x7fffffff, ~uint256(0), 0xffffffff, true);
+    CAddressIndexKey keyOther(ADDRESS_TYPE_PUBKEYHASH, uint160(43), 0, 0, 0, false);
+    CAddressIndexKey keyScript(ADDRESS_TYPE_SCRIPTHASH, hashAddress, 0, 0, 0, false);
+    BOOST_CHECK(KeyBytes(keySeek) < KeyBytes(keyLast));
+    BOOST_CHECK(KeyBytes(keyLast) < KeyBytes(keyOther));
+    BOOST_CHECK(KeyBytes(keyLast) < KeyBytes(keyScript));
+}
+
+// Everything the index holds for one address, history then unspent outputs
+static std::string AddressRecords(CTxDB& txdb, unsigned char nAddressType, const uint160& hashAddress)
+{
+    std::vector<std::pair<CAddressIndexKey, CAddressIndexValue> > vHistory;
+    std::vector<std::pair<CAddressUnspentKey, CAddressIndexValue> > vUnspent;
+    BOOST_CHECK(txdb.ReadAddressHistory(nAddressType, hashAddress, 0, 0, vHistory));
+    BOOST_CHECK(txdb.ReadAddressUnspents(nAddressType, hashAddress, 0, 0, vUnspent));
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << vHistory << vUnspent;
+    return ss.str();
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_connect_disconnect)
+{
+    CKey key[2];
+    key[0].MakeNewKey(true);
+    key[1].MakeNewKey(true);
+    CScript redeemScript;
+    redeemScript << key[0].GetPubKey() << OP_CHECKSIG;
+    CTxDestination vDest[] = { key[0].GetPubKey().GetID(), key[1].GetPubKey().GetID(), redeemScript.GetID() };
+    const unsigned int nDest = sizeof(vDest) / sizeof(vDest[0]);
+    unsigned char vAddressType[nDest];
+    uint160 vHashAddress[nDest];
+    for (unsigned int i = 0; i < nDest; i++)
+        BOOST_REQUIRE(GetAddressIndexKey(vDest[i], vAddressType[i], vHashAddress[i]));
+
+    // a coinbase paying to a key, a script and no address at all, then a
+    // spend of the first two back to both keys
+    CTransaction txPrev;
+    txPrev.vin.resize(1);
+    txPrev.vin[0].prevout.SetNull();
+    txPrev.vin[0].scriptSig << GetRandHash();
+    txPrev.vout.resize(3);
+    txPrev.vout[0].nValue = 10 * COIN;
+    txPrev.vout[0].scriptPubKey.SetDestination(vDest[0]);
+    txPrev.vout[1].nValue = 5 * COIN;
+    txPrev.vout[1].scriptPubKey.SetDestination(vDest[2]);
+    txPrev.vout[2].nValue = 1 * COIN;
+    txPrev.vout[2].scriptPubKey << OP_RETURN;
+    CTransaction tx;
+    tx.vin.push_back(CTxIn(COutPoint(txPrev.GetHash(), 0)));
+    tx.vin.push_back(CTxIn(COutPoint(txPrev.GetHash(), 1)));
+    tx.vout.resize(2);
+    tx.vout[0].nValue = 14 * COIN;
+    tx.vout[0].scriptPubKey.SetDestination(vDest[1]);
+    tx.vout[1].nValue = 1 * COIN;
+    tx.vout[1].scriptPubKey.SetDestination(vDest[0]);
+    MapPrevTx mapNone;
+    MapPrevTx mapInputs;
+    mapInputs[txPrev.GetHash()] = std::make_pair(CTxIndex(), txPrev);
+
+    CTxDB txdb("cr+");
+    std::string vBefore[nDest], vConnected[nDest];
+    for (unsigned int i = 0; i < nDest; i++)
+        vBefore[i] = AddressRecords(txdb, vAddressType[i], vHashAddress[i]);
+
+    BOOST_CHECK(ConnectAddressIndex(txdb, txPrev, mapNone, 1000));
+    for (unsigned int i = 0; i < nDest; i++)
+        vConnected[i] = AddressRecords(txdb, vAddressType[i], vHashAddress[i]);
+    BOOST_CHECK(ConnectAddressIndex(txdb, tx, mapInputs, 1001));
+
+    std::vector<std::pair<CAddressIndexKey, CAddressIndexValue> > vHistory;
+    std::vector<std::pair<CAddressUnspentKey, CAddressIndexValue> > vUnspent;
+    BOOST_CHECK(txdb.ReadAddressHistory(vAddressType[0], vHashAddress[0], 0, 0, vHistory));
+    BOOST_REQUIRE_EQUAL(vHistory.size(), 3U);
+    BOOST_CHECK(!vHistory[0].first.fSpending && vHistory[0].first.nHeight == 1000 && vHistory[0].second.nValue == 10 * COIN);
+    BOOST_CHECK(vHistory[1].first.fSpending || vHistory[2].first.fSpending);
+    BOOST_CHECK(txdb.ReadAddressUnspents(vAddressType[0], vHashAddress[0], 0, 0, vUnspent));
+    BOOST_REQUIRE_EQUAL(vUnspent.size(), 1U);
+    BOOST_CHECK(vUnspent[0].first.hashTx == tx.GetHash() && vUnspent[0].first.nIndex == 1);
+    vUnspent.clear();
+    BOOST_CHECK(txdb.ReadAddressUnspents(vAddressType[2], vHashAddress[2], 0, 0, vUnspent));
+    BOOST_CHECK(vUnspent.empty());
+
+    // each disconnect puts back exactly what was there before its connect
+    BOOST_CHECK(DisconnectAddressIndex(txdb, tx, mapInputs, 1001));
+    for (unsigned int i = 0; i < nDest; i++)
+        BOOST_CHECK(AddressRecords(txdb, vAddressType[i], vHashAddress[i]) == vConnected[i]);
+    BOOST_CHECK(DisconnectAddressIndex(txdb, txPrev, mapNone, 1000));
+    for (unsigned int i = 0; i < nDest; i++)
+        BOOST_CHECK(AddressRecords(txdb, vAddressType[i], vHashAddress[i]) == vBefore[i]);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,217 @@
+#include <boost/test/unit_test.hpp>
+#include <limits>
+
+#include "arith_uint256.h"
+#include "bignum.h"
+#include "kernel.h"
+#include "main.h"
+#include "util.h"
+
+extern unsigned int nStakeTargetSpacing;
+
+BOOST_AUTO_TEST_SUITE(arith_uint256_tests)
+
+static arith_uint256 RandArith()
+{
+    // random width so that small and large operands both get covered
+    uint256 n = GetRandHash();
+    return UintToArith256(n) >> (GetRand(256));
+}
+
+static CBigNum ToBigNum(const arith_uint256& a)
+{
+    return CBigNum(ArithToUint256(a));
+}
+
+// The CBigNum implementations these routines replaced, kept as reference
+static unsigned int ComputeMaxBitsBigNum(CBigNum bnTargetLimit, unsigned int nBase, int64_t nTime)
+{
+    CBigNum bnResult;
+    bnResult.SetCompact(nBase);
+    bnResult *= 2;
+    while (nTime > 0 && bnResult < bnTargetLimit)
+    {
+        bnResult *= 2;
+        nTime -= 24 * 60 * 60;
+    }
+    if (bnResult > bnTargetLimit)
+        bnResult = bnTargetLimit;
+    return bnResult.GetCompact();
+}
+
+static uint256 GetBlockTrustBigNum(unsigned int nBits)
+{
+    CBigNum bnTarget;
+    bnTarget.SetCompact(nBits);
+    if (bnTarget <= 0)
+        return 0;
+    return ((CBigNum(1)<<256) / (bnTarget+1)).getuint256();
+}
+
+static bool CheckStakeKernelTargetBigNum(const uint256& hash, unsigned int nBits, int64_t nValueIn, int64_t nTimeWeight)
+{
+    CBigNum bnTargetPerCoinDay;
+    bnTargetPerCoinDay.SetCompact(nBits);
+    CBigNum bnCoinDayWeight = CBigNum(nValueIn) * nTimeWeight / COIN / (24 * 60 * 60);
+    return !(CBigNum(hash) > bnCoinDayWeight * bnTargetPerCoinDay);
+}
+
+BOOST_AUTO_TEST_CASE(arith_uint256_basics)
+{
+    arith_uint256 zero;
+    arith_uint256 one(1);
+    arith_uint256 max = ~zero;
+    BOOST_CHECK(!zero);
+    BOOST_CHECK(one + max == zero);
+    BOOST_CHECK(zero - one == max);
+    BOOST_CHECK(-one == max);
+    BOOST_CHECK(max.bits() == 256);
+    BOOST_CHECK(one.bits() == 1);
+    BOOST_CHECK(zero.bits() == 0);
+    BOOST_CHECK((one << 255).bits() == 256);
+    BOOST_CHECK((one << 256) == zero);
+    BOOST_CHECK((max >> 255) == one);
+    BOOST_CHECK(arith_uint256(0x123456789abcdefULL) * arith_uint256(0x1000) == arith_uint256(0x123456789abcdefULL) << 12);
+    BOOST_CHECK(UintToArith256(uint256("0x00000fffff000000000000000000000000000000000000000000000000000000")) == (~arith_uint256(0) >> 20) - ((arith_uint256(1) << 216) - 1));
+    BOOST_CHECK(arith_uint256("0x1234").GetLow64() == 0x1234);
+    BOOST_CHECK(ArithToUint256(max) == ~uint256(0));
+    BOOST_CHECK_THROW(one / zero, uint_error);
+}
+
+BOOST_AUTO_TEST_CASE(arith_uint256_vs_bignum)
+{
+    for (int i = 0; i < 2000; i++)
+    {
+        arith_uint256 a = RandArith();
+        arith_uint256 b = RandArith();
+        uint64_t c = GetRand(std::numeric_limits<uint64_t>::max());
+        unsigned int nShift = GetRand(260);
+        CBigNum bnMod = CBigNum(1) << 256;
+
+        BOOST_CHECK(ToBigNum(a + b) == (ToBigNum(a) + ToBigNum(b)) % bnMod);
+        BOOST_CHECK(ToBigNum(a * b) == (ToBigNum(a) * ToBigNum(b)) % bnMod);
+        BOOST_CHECK(ToBigNum(a * c) == (ToBigNum(a) * CBigNum(ArithToUint256(arith_uint256(c)))) % bnMod);
+        BOOST_CHECK(ToBigNum(a << nShift) == (ToBigNum(a) << nShift) % bnMod);
+        BOOST_CHECK(ToBigNum(a >> nShift) == (ToBigNum(a) >> nShift));
+        BOOST_CHECK((a < b) == (ToBigNum(a) < ToBigNum(b)));
+        BOOST_CHECK(a.bits() == (unsigned int)ToBigNum(a).bitSize());
+        if (!!b)
+            BOOST_CHECK(ToBigNum(a / b) == ToBigNum(a) / ToBigNum(b));
+        BOOST_CHECK(a == a * arith_uint256(1));
+        BOOST_CHECK(a - b + b == a);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(arith_uint256_compact)
+{
+    // every size byte combined with mantissas that exercise the sign bit,
+    // byte boundaries and the 256 bit overflow edge
+    static const uint32_t vWords[] = { 0x000000, 0x000001, 0x00007f, 0x000080, 0x0000ff, 0x000100,
+                                       0x007fff, 0x008000, 0x00ffff, 0x010000, 0x123456, 0x7fffff };
+    for (unsigned int nSize = 0; nSize <= 40; nSize++)
+    {
+        for (unsigned int i = 0; i < sizeof(vWords) / sizeof(vWords[0]) + 16; i++)
+        {
+            uint32_t nWord = i < sizeof(vWords) / sizeof(vWords[0]) ? vWords[i] : GetRand(0x800000);
+            for (int fSign = 0; fSign < 2; fSign++)
+            {
+                uint32_t nCompact = (nSize << 24) | nWord | (fSign ? 0x00800000 : 0);
+                bool fNegative, fOverflow;
+                arith_uint256 a;
+                a.SetCompact(nCompact, &fNegative, &fOverflow);
+                CBigNum bn;
+                bn.SetCompact(nCompact);
+
+                if (fNegative)
+                {
+                    BOOST_CHECK(bn < 0);
+                    continue;
+                }
+                if (fOverflow)
+                {
+                    BOOST_CHECK(bn >= CBigNum(1) << 256);
+                    continue;
+                }
+                BOOST_CHECK(bn >= 0);
+                BOOST_CHECK(bn < CBigNum(1) << 256);
+                BOOST_CHECK(ToBigNum(a) == bn);
+                BOOST_CHECK(a.GetCompact() == bn.GetCompact());
+            }
+        }
+    }
+
+    for (int i = 0; i < 1000; i++)
+    {
+        arith_uint256 a = RandArith();
+        BOOST_CHECK(a.GetCompact() == ToBigNum(a).GetCompact());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(arith_uint256_consensus_ports)
+{
+    arith_uint256 bnLimit = ~arith_uint256(0) >> 20;
+    for (int i = 0; i < 2000; i++)
+    {
+        arith_uint256 a = RandArith();
+        unsigned int nBits = a.GetCompact();
+        if (i % 4 == 0)
+            nBits = (unsigned int)GetRand(0x100000000ULL); // includes negative and oversized targets
+
+        // chain trust
+        CBlockIndex index;
+        index.nBits = nBits;
+        BOOST_CHECK(index.GetBlockTrust() == GetBlockTrustBigNum(nBits));
+
+        // checkpoint minimum work
+        int64_t nTime = GetRand(40 * 24 * 60 * 60);
+        BOOST_CHECK(ComputeMaxBits(bnLimit, nBits, nTime) == ComputeMaxBitsBigNum(ToBigNum(bnLimit), nBits, nTime));
+
+        // stake kernel target, with weights up to the full coin supply
+        uint256 hash = GetRandHash();
+        int64_t nValueIn = GetRand(25000000000LL * COIN);
+        int64_t nTimeWeight = GetRand(90 * 24 * 60 * 60);
+        if (i % 16 == 0)
+            nTimeWeight = -nTimeWeight;
+        BOOST_CHECK(CheckStakeKernelTarget(hash, nBits, nValueIn, nTimeWeight) == CheckStakeKernelTargetBigNum(hash, nBits, nValueIn, nTimeWeight));
+    }
+
+    BOOST_CHECK(CBlockIndex().GetBlockTrust() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(arith_uint256_next_target)
+{
+    arith_uint256 bnLimit = ~arith_uint256(0) >> 20;
+    for (int i = 0; i < 500; i++)
+    {
+        // three proof-of-stake blocks: the retarget looks at the last two
+        CBlockIndex vIndex[3];
+        for (int n = 0; n < 3; n++)
+        {
+            vIndex[n].pprev = n ? &vIndex[n - 1] : NULL;
+            vIndex[n].nHeight = n;
+            vIndex[n].nTime = 1400000000 + n * GetRand(2000);
+            vIndex[n].SetProofOfStake();
+        }
+        arith_uint256 bnPrev = RandArith();
+        if (bnPrev > bnLimit)
+            bnPrev = bnLimit;
+        vIndex[2].nBits = bnPrev.GetCompact();
+
+        int64_t nActualSpacing = (int64_t)vIndex[2].nTime - vIndex[1].nTime;
+        if (nActualSpacing < 0)
+            nActualSpacing = 1;
+        else if (nActualSpacing > 30 * 45)
+            nActualSpacing = 30 * 45;
+        int64_t nInterval = (30 * 45) / nStakeTargetSpacing;
+        CBigNum bnNew;
+        bnNew.SetCompact(vIndex[2].nBits);
+        bnNew *= ((nInterval - 1) * nStakeTargetSpacing + nActualSpacing + nActualSpacing);
+        bnNew /= ((nInterval + 1) * nStakeTargetSpacing);
+        if (bnNew > ToBigNum(bnLimit))
+            bnNew = ToBigNum(bnLimit);
+
+        BOOST_CHECK(GetNextTargetRequired(&vIndex[2], true) == bnNew.GetCompact());
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
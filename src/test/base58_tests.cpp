@@ -4,6 +4,7 @@
 #include "json/json_spirit_utils.h"
 
 #include "base58.h"
+#include "bignum.h"
 #include "util.h"
 
 using namespace json_spirit;
@@ -254,6 +255,135 @@ BOOST_AUTO_TEST_CASE(base58_keys_invalid)
     }
 }
 
+// The CBigNum codec that EncodeBase58 and DecodeBase58 replaced
+static std::string BigNumEncodeBase58(const std::vector<unsigned char>& vch)
+{
+    CAutoBN_CTX pctx;
+    CBigNum bn58 = 58;
+    CBigNum bn0 = 0;
+
+    std::vector<unsigned char> vchTmp(vch.size() + 1, 0);
+    reverse_copy(vch.begin(), vch.end(), vchTmp.begin());
+    CBigNum bn;
+    bn.setvch(vchTmp);
+
+    std::string str;
+    CBigNum dv;
+    CBigNum rem;
+    while (bn > bn0)
+    {
+        if (!BN_div(&dv, &rem, &bn, &bn58, pctx))
+            throw bignum_error("BigNumEncodeBase58 : BN_div failed");
+        bn = dv;
+        str += pszBase58[rem.getulong()];
+    }
+    for (unsigned int i = 0; i < vch.size() && vch[i] == 0; i++)
+        str += pszBase58[0];
+    reverse(str.begin(), str.end());
+    return str;
+}
+
+static bool BigNumDecodeBase58(const char* psz, std::vector<unsigned char>& vchRet)
+{
+    CAutoBN_CTX pctx;
+    vchRet.clear();
+    CBigNum bn58 = 58;
+    CBigNum bn = 0;
+    CBigNum bnChar;
+    while (isspace(*psz))
+        psz++;
+
+    for (const char* p = psz; *p; p++)
+    {
+        const char* p1 = strchr(pszBase58, *p);
+        if (p1 == NULL)
+        {
+            while (isspace(*p))
+                p++;
+            if (*p != '\0')
+                return false;
+            break;
+        }
+        bnChar.setulong(p1 - pszBase58);
+        if (!BN_mul(&bn, &bn, &bn58, pctx))
+            throw bignum_error("BigNumDecodeBase58 : BN_mul failed");
+        bn += bnChar;
+    }
+
+    std::vector<unsigned char> vchTmp = bn.getvch();
+    if (vchTmp.size() >= 2 && vchTmp.end()[-1] == 0 && vchTmp.end()[-2] >= 0x80)
+        vchTmp.erase(vchTmp.end()-1);
+    int nLeadingZeros = 0;
+    for (const char* p = psz; *p == pszBase58[0]; p++)
+        nLeadingZeros++;
+    vchRet.assign(nLeadingZeros + vchTmp.size(), 0);
+    reverse_copy(vchTmp.begin(), vchTmp.end(), vchRet.end() - vchTmp.size());
+    return true;
+}
+
+// Goal: random payloads and strings give what the CBigNum codec gave, on
+// both sides of the 128 byte stack buffer
+BOOST_AUTO_TEST_CASE(base58_matches_bignum)
+{
+    const char* pszExtra = " \t\n0OIl+";
+    for (int n = 0; n < 5000; n++)
+    {
+        std::vector<unsigned char> data(GetRandInt(n < 4000 ? 40 : 300));
+        unsigned int nZeros = GetRandInt(4) == 0 ? GetRandInt(5) : 0;
+        for (unsigned int i = 0; i < data.size(); i++)
+            data[i] = i < nZeros ? 0 : (unsigned char)GetRandInt(256);
+        if (GetRandInt(8) == 0)
+            std::fill(data.begin(), data.end(), GetRandInt(2) ? 0x00 : 0xff);
+
+        std::string str = EncodeBase58(data);
+        BOOST_CHECK_EQUAL(str, BigNumEncodeBase58(data));
+        std::vector<unsigned char> result;
+        BOOST_CHECK(DecodeBase58(str, result) && result == data);
+
+        // mostly valid digits, with whitespace and invalid characters mixed in
+        std::string strRandom(GetRandInt(60), ' ');
+        for (unsigned int i = 0; i < strRandom.size(); i++)
+            strRandom[i] = GetRandInt(12) ? pszBase58[GetRandInt(GetRandInt(3) ? 58 : 2)] : pszExtra[GetRandInt(strlen(pszExtra))];
+        std::vector<unsigned char> expected;
+        bool fExpected = BigNumDecodeBase58(strRandom.c_str(), expected);
+        BOOST_CHECK_MESSAGE(DecodeBase58(strRandom, result) == fExpected, strRandom);
+        if (fExpected)
+            BOOST_CHECK_MESSAGE(result == expected, strRandom);
+    }
+}
+
+// Goal: report encode/decode throughput for address-sized and key-sized payloads
+BOOST_AUTO_TEST_CASE(base58_throughput)
+{
+    const int nIterations = 100000;
+    unsigned int sizes[] = { 25, 38 }; // address, compressed private key (with checksum)
+    BOOST_FOREACH(unsigned int nSize, sizes)
+    {
+        std::vector<unsigned char> data(nSize);
+        for (unsigned int i = 0; i < nSize; i++)
+            data[i] = (unsigned char)(i * 73 + 11);
+        std::string str = EncodeBase58(data);
+        std::vector<unsigned char> result;
+
+        int64_t nStart = GetTimeMicros();
+        for (int i = 0; i < nIterations; i++)
+        {
+            data[i % nSize]++;
+            str = EncodeBase58(data);
+        }
+        int64_t nEncode = std::max(GetTimeMicros() - nStart, (int64_t)1);
+
+        nStart = GetTimeMicros();
+        for (int i = 0; i < nIterations; i++)
+            BOOST_CHECK(DecodeBase58(str, result));
+        int64_t nDecode = std::max(GetTimeMicros() - nStart, (int64_t)1);
+
+        BOOST_CHECK(result == data);
+        BOOST_TEST_MESSAGE(strprintf("base58 %u bytes: %.0f encodes/s, %.0f decodes/s", nSize,
+                                     1000000.0 * nIterations / nEncode, 1000000.0 * nIterations / nDecode));
+    }
+}
+
 
 BOOST_AUTO_TEST_SUITE_END()
 
@@ -0,0 +1,53 @@
+#include <boost/test/unit_test.hpp>
+
+#include "main.h"
+
+BOOST_AUTO_TEST_SUITE(blockstats_tests)
+
+static CTransaction MakeTx(unsigned int nInputs, int64_t nValueOut, int nOutputs)
+{
+    CTransaction tx;
+    for (unsigned int i = 0; i < nInputs; i++)
+        tx.vin.push_back(CTxIn(COutPoint(GetRandHash(), i)));
+    for (int i = 0; i < nOutputs; i++)
+        tx.vout.push_back(CTxOut(nValueOut / nOutputs, CScript() << OP_TRUE));
+    return tx;
+}
+
+BOOST_AUTO_TEST_CASE(blockstats_addtx)
+{
+    CBlockStats stats;
+
+    // a proof-of-stake block: empty coinbase, coinstake, one payment
+    CTransaction txCoinBase;
+    txCoinBase.vin.push_back(CTxIn());
+    txCoinBase.vin[0].prevout.SetNull();
+    txCoinBase.vout.push_back(CTxOut(0, CScript()));
+    BOOST_CHECK(txCoinBase.IsCoinBase());
+    stats.AddTx(txCoinBase, 0);
+
+    CTransaction txCoinStake = MakeTx(1, 110 * COIN, 2);
+    txCoinStake.vout.insert(txCoinStake.vout.begin(), CTxOut(0, CScript()));
+    BOOST_CHECK(txCoinStake.IsCoinStake());
+    stats.AddTx(txCoinStake, 100 * COIN);
+
+    CTransaction txPayment = MakeTx(3, 49 * COIN, 2);
+    stats.AddTx(txPayment, 50 * COIN);
+
+    BOOST_CHECK_EQUAL(stats.nTx, 3U);
+    BOOST_CHECK_EQUAL(stats.nInputs, 4U);
+    BOOST_CHECK_EQUAL(stats.nOutputs, 6U);
+    BOOST_CHECK(stats.nValueOut == 159 * COIN);
+    BOOST_CHECK(stats.nStakeReward == 10 * COIN);
+    BOOST_CHECK(stats.nFees == 1 * COIN);
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    stats.nChainTx = 123456;
+    ss << stats;
+    CBlockStats statsRead;
+    ss >> statsRead;
+    BOOST_CHECK(statsRead.nFees == stats.nFees);
+    BOOST_CHECK(statsRead.nChainTx == stats.nChainTx);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,158 @@
+#include <boost/test/unit_test.hpp>
+
+#include "hash.h"
+#include "main.h"
+#include "util.h"
+
+BOOST_AUTO_TEST_SUITE(hash_tests)
+
+// Reference double-SHA256 straight from OpenSSL
+static uint256 HashReference(const unsigned char* pch, size_t size)
+{
+    static unsigned char pblank[1];
+    uint256 hash1;
+    SHA256(size ? pch : pblank, size, (unsigned char*)&hash1);
+    uint256 hash2;
+    SHA256((unsigned char*)&hash1, sizeof(hash1), (unsigned char*)&hash2);
+    return hash2;
+}
+
+// The previous writer: every serialized field goes through SHA256_Update
+class CHashWriterUpdate
+{
+private:
+    SHA256_CTX ctx;
+
+public:
+    int nType;
+    int nVersion;
+
+    CHashWriterUpdate(int nTypeIn, int nVersionIn) : nType(nTypeIn), nVersion(nVersionIn) {
+        SHA256_Init(&ctx);
+    }
+
+    CHashWriterUpdate& write(const char *pch, size_t size) {
+        SHA256_Update(&ctx, pch, size);
+        return (*this);
+    }
+
+    uint256 GetHash() {
+        uint256 hash1;
+        SHA256_Final((unsigned char*)&hash1, &ctx);
+        uint256 hash2;
+        SHA256((unsigned char*)&hash1, sizeof(hash1), (unsigned char*)&hash2);
+        return hash2;
+    }
+
+    template<typename T>
+    CHashWriterUpdate& operator<<(const T& obj) {
+        ::Serialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
+static CTransaction MakeTransaction(unsigned int nInputs)
+{
+    CTransaction tx;
+    tx.nTime = 1400000000;
+    tx.vin.resize(nInputs);
+    tx.vout.resize(2);
+    for (unsigned int i = 0; i < nInputs; i++)
+    {
+        tx.vin[i].prevout = COutPoint(GetRandHash(), i);
+        tx.vin[i].scriptSig = CScript() << std::vector<unsigned char>(72, i) << std::vector<unsigned char>(33, i);
+    }
+    for (unsigned int i = 0; i < tx.vout.size(); i++)
+    {
+        tx.vout[i].nValue = (i + 1) * COIN;
+        tx.vout[i].scriptPubKey = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, i) << OP_EQUALVERIFY << OP_CHECKSIG;
+    }
+    return tx;
+}
+
+BOOST_AUTO_TEST_CASE(hash_writer_matches_openssl)
+{
+    // every length around the padding boundaries, written in random pieces
+    std::vector<unsigned char> vch(300);
+    for (unsigned int i = 0; i < vch.size(); i++)
+        vch[i] = (unsigned char)(i * 151 + 7);
+    for (unsigned int nSize = 0; nSize <= vch.size(); nSize++)
+    {
+        CHashWriter ss(SER_GETHASH, 0);
+        unsigned int nPos = 0;
+        while (nPos < nSize)
+        {
+            unsigned int nChunk = std::min((unsigned int)GetRand(80), nSize - nPos);
+            ss.write((const char*)&vch[nPos], nChunk);
+            nPos += nChunk;
+        }
+        BOOST_CHECK(ss.GetHash() == HashReference(&vch[0], nSize));
+        BOOST_CHECK(Hash(vch.begin(), vch.begin() + nSize) == HashReference(&vch[0], nSize));
+    }
+
+    // two and three range forms hash the concatenation
+    BOOST_CHECK(Hash(vch.begin(), vch.begin() + 10, vch.begin() + 10, vch.begin() + 100) == HashReference(&vch[0], 100));
+    BOOST_CHECK(Hash(vch.begin(), vch.begin() + 64, vch.begin() + 64, vch.begin() + 64, vch.begin() + 64, vch.end()) == HashReference(&vch[0], vch.size()));
+}
+
+BOOST_AUTO_TEST_CASE(hash_writer_serialize)
+{
+    for (unsigned int nInputs = 0; nInputs < 20; nInputs++)
+    {
+        CTransaction tx = MakeTransaction(nInputs);
+        CDataStream ss(SER_GETHASH, PROTOCOL_VERSION);
+        ss << tx;
+        BOOST_CHECK(tx.GetHash() == Hash(ss.begin(), ss.end()));
+
+        CHashWriterUpdate ssOld(SER_GETHASH, PROTOCOL_VERSION);
+        ssOld << tx;
+        BOOST_CHECK(tx.GetHash() == ssOld.GetHash());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(hash_writer_throughput)
+{
+    const CTransaction tx = MakeTransaction(4);
+    const unsigned int nTxSize = ::GetSerializeSize(tx, SER_GETHASH, PROTOCOL_VERSION);
+    const int nIterations = 50000;
+    uint256 hash1, hash2, hash3;
+
+    // serialize into a CDataStream, then hash it
+    int64_t nStart = GetTimeMicros();
+    for (int i = 0; i < nIterations; i++)
+    {
+        CDataStream ss(SER_GETHASH, 0);
+        ss.reserve(10000);
+        ss << tx;
+        hash1 = Hash(ss.begin(), ss.end());
+    }
+    int64_t nStream = std::max(GetTimeMicros() - nStart, (int64_t)1);
+
+    // serialize through SHA256_Update
+    nStart = GetTimeMicros();
+    for (int i = 0; i < nIterations; i++)
+    {
+        CHashWriterUpdate ss(SER_GETHASH, 0);
+        ss << tx;
+        hash2 = ss.GetHash();
+    }
+    int64_t nUpdate = std::max(GetTimeMicros() - nStart, (int64_t)1);
+
+    // staged blocks into the compression function
+    nStart = GetTimeMicros();
+    for (int i = 0; i < nIterations; i++)
+    {
+        CHashWriter ss(SER_GETHASH, 0);
+        ss << tx;
+        hash3 = ss.GetHash();
+    }
+    int64_t nWriter = std::max(GetTimeMicros() - nStart, (int64_t)1);
+
+    BOOST_CHECK(hash1 == hash2);
+    BOOST_CHECK(hash1 == hash3);
+    double nBytes = (double)nTxSize * nIterations;
+    BOOST_TEST_MESSAGE(strprintf("hashing %u byte tx: CDataStream+Hash %.1f MB/s, SHA256_Update writer %.1f MB/s, CHashWriter %.1f MB/s",
+                                 nTxSize, nBytes / nStream, nBytes / nUpdate, nBytes / nWriter));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
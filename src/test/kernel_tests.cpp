@@ -0,0 +1,98 @@
+#include <boost/test/unit_test.hpp>
+
+#include "kernel.h"
+#include "main.h"
+#include "util.h"
+
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(kernel_tests)
+
+BOOST_AUTO_TEST_CASE(kernel_search_matches_checkstakekernelhash)
+{
+    // the block holding the staked output and hourly blocks after it, one in
+    // six regenerating the stake modifier
+    CBlock blockFrom;
+    blockFrom.nVersion = 3;
+    blockFrom.hashPrevBlock = GetRandHash();
+    blockFrom.hashMerkleRoot = GetRandHash();
+    blockFrom.nTime = 1400000000;
+    blockFrom.nBits = 0x1e0fffff;
+
+    std::vector<uint256> vHashes(600);
+    std::vector<CBlockIndex> vIndex(600);
+    for (unsigned int i = 0; i < vIndex.size(); i++)
+    {
+        vHashes[i] = i == 0 ? blockFrom.GetHash() : GetRandHash();
+        CBlockIndex& index = vIndex[i];
+        index.nHeight = 100000 + i;
+        index.nTime = blockFrom.nTime + i * 60 * 60;
+        index.pprev = i > 0 ? &vIndex[i - 1] : NULL;
+        index.pnext = i + 1 < vIndex.size() ? &vIndex[i + 1] : NULL;
+        index.SetStakeModifier(GetRand(std::numeric_limits<uint64_t>::max()), i % 6 == 0);
+        index.phashBlock = &mapBlockIndex.insert(std::make_pair(vHashes[i], &index)).first->first;
+    }
+
+    CTransaction txPrev;
+    txPrev.nTime = blockFrom.nTime + 100;
+    txPrev.vin.resize(1);
+    txPrev.vout.resize(2);
+    txPrev.vout[1].nValue = 1000 * COIN;
+    COutPoint prevout(txPrev.GetHash(), 1);
+
+    // an easy target, about one timestamp in twelve meets it once the coin is
+    // past the 84 day nStakeMaxAge; the first ones are too young to stake at all
+    CStakeKernelSearch kernelSearch(blockFrom.nBits, blockFrom, 81, txPrev, prevout);
+    BOOST_REQUIRE(kernelSearch.IsValid());
+    unsigned int nTimeFirst = blockFrom.nTime + nStakeMinAge - 100;
+    int nFound = 0;
+    for (unsigned int n = 0; n < 600; n++)
+    {
+        unsigned int nTimeTx = nTimeFirst + (n < 300 ? n : 90 * 24 * 60 * 60 + n * 1000);
+        uint256 hashProofOfStake = 0;
+        bool fKernel = nTimeTx >= blockFrom.nTime + nStakeMinAge &&
+                       CheckStakeKernelHash(blockFrom.nBits, blockFrom, 81, txPrev, prevout, nTimeTx, hashProofOfStake);
+        if (nTimeTx >= blockFrom.nTime + nStakeMinAge)
+            BOOST_CHECK(kernelSearch.GetKernelHash(nTimeTx) == hashProofOfStake);
+
+        unsigned int nTimeKernel = 0;
+        uint256 hashKernel = 0;
+        BOOST_CHECK_EQUAL(kernelSearch.Search(nTimeTx, 1, nTimeKernel, hashKernel), fKernel);
+        if (fKernel)
+        {
+            BOOST_CHECK_EQUAL(nTimeKernel, nTimeTx);
+            BOOST_CHECK(hashKernel == hashProofOfStake);
+            nFound++;
+        }
+    }
+    BOOST_CHECK(nFound > 0 && nFound < 100);
+
+    // a run finds the latest timestamp that one at a time would find first
+    unsigned int nTimeStart = blockFrom.nTime + 90 * 24 * 60 * 60;
+    unsigned int nTimeKernel = 0;
+    uint256 hashKernel = 0;
+    BOOST_REQUIRE(kernelSearch.Search(nTimeStart, 300, nTimeKernel, hashKernel));
+    for (unsigned int nTimeTx = nTimeStart; nTimeTx > nTimeKernel; nTimeTx--)
+    {
+        unsigned int nTimeOne;
+        uint256 hashOne;
+        BOOST_CHECK(!kernelSearch.Search(nTimeTx, 1, nTimeOne, hashOne));
+    }
+
+    // about one in twelve, and none for a coin too young to stake
+    double dProbability = kernelSearch.GetKernelProbability(nTimeStart);
+    BOOST_CHECK(dProbability > 0.04 && dProbability < 0.2);
+    BOOST_CHECK(kernelSearch.GetKernelProbability(nTimeFirst) == 0);
+    unsigned int nHashes = 0;
+    kernelSearch.Search(nTimeFirst + 150, 300, nTimeKernel, hashKernel, &nHashes);
+    BOOST_CHECK_EQUAL(nHashes, 51U);
+
+    // no stake modifier yet for a block outside the index
+    blockFrom.nNonce++;
+    BOOST_CHECK(!CStakeKernelSearch(blockFrom.nBits, blockFrom, 81, txPrev, prevout).IsValid());
+
+    for (unsigned int i = 0; i < vIndex.size(); i++)
+        mapBlockIndex.erase(vHashes[i]);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
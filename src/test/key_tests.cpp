@@ -141,7 +141,66 @@ BOOST_AUTO_TEST_CASE(key_test1)
         BOOST_CHECK(rkey2.GetPubKey()  == key2.GetPubKey());
         BOOST_CHECK(rkey1C.GetPubKey() == key1C.GetPubKey());
         BOOST_CHECK(rkey2C.GetPubKey() == key2C.GetPubKey());
+
+        // verification and recovery straight from the serialized public key
+
+        BOOST_CHECK( key1.GetPubKey().Verify(hashMsg, sign1));
+        BOOST_CHECK(!key1.GetPubKey().Verify(hashMsg, sign2));
+        BOOST_CHECK( key2C.GetPubKey().Verify(hashMsg, sign2C));
+        BOOST_CHECK(!key2C.GetPubKey().Verify(hashMsg, sign1C));
+
+        CPubKey pubkey1, pubkey1C;
+        BOOST_CHECK(pubkey1.RecoverCompact (hashMsg, csign1));
+        BOOST_CHECK(pubkey1C.RecoverCompact(hashMsg, csign1C));
+        BOOST_CHECK(pubkey1  == key1.GetPubKey());
+        BOOST_CHECK(pubkey1C == key1C.GetPubKey());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(key_sign_without_secret)
+{
+    string strMsg = "Very secret message";
+    uint256 hashMsg = Hash(strMsg.begin(), strMsg.end());
+    vector<unsigned char> vchSig;
+
+    // neither an empty key nor one holding only a public key can sign
+    CKey keyNull;
+    BOOST_CHECK(!keyNull.Sign(hashMsg, vchSig));
+    BOOST_CHECK(!keyNull.SignCompact(hashMsg, vchSig));
+
+    CKey key;
+    key.MakeNewKey(true);
+    CKey keyPub;
+    BOOST_CHECK(keyPub.SetPubKey(key.GetPubKey()));
+    BOOST_CHECK(!keyPub.Sign(hashMsg, vchSig));
+    BOOST_CHECK(!keyPub.SignCompact(hashMsg, vchSig));
+}
+
+BOOST_AUTO_TEST_CASE(key_verify_speed)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CPubKey pubkey = key.GetPubKey();
+
+    vector<uint256> vHash;
+    vector<vector<unsigned char> > vSig;
+    for (int n=0; n<100; n++)
+    {
+        string strMsg = strprintf("Signature %i", n);
+        vHash.push_back(Hash(strMsg.begin(), strMsg.end()));
+        vSig.push_back(vector<unsigned char>());
+        BOOST_CHECK(key.Sign(vHash.back(), vSig.back()));
     }
+
+    const int nRounds = 10;
+    int64_t nStart = GetTimeMicros();
+    for (int i=0; i<nRounds; i++)
+        for (unsigned int n=0; n<vHash.size(); n++)
+            BOOST_CHECK(pubkey.Verify(vHash[n], vSig[n]));
+    int64_t nElapsed = std::max(GetTimeMicros() - nStart, (int64_t)1);
+
+    BOOST_TEST_MESSAGE(strprintf("%s: %.0f verifications/s", GetECDSABackendName(),
+                                 1000000.0 * nRounds * vHash.size() / nElapsed));
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,74 @@
+#include <boost/test/unit_test.hpp>
+
+#include "metrics.h"
+#include "util.h"
+
+BOOST_AUTO_TEST_SUITE(metrics_tests)
+
+BOOST_AUTO_TEST_CASE(metrics_registry)
+{
+    CMetricCounter& counter = GetMetricCounter("test_events_total", "Test events");
+    counter.Add();
+    counter.Add(4);
+    BOOST_CHECK(counter.nValue == 5);
+    BOOST_CHECK(&GetMetricCounter("test_events_total", "Test events") == &counter);
+
+    // one label value per series
+    CMetricLatency& latencyA = GetMetricLatency("test_op_seconds", "Test op", "op", "a");
+    CMetricLatency& latencyB = GetMetricLatency("test_op_seconds", "Test op", "op", "b");
+    BOOST_CHECK(&latencyA != &latencyB);
+    BOOST_CHECK(&GetMetricLatency("test_op_seconds", "Test op", "op", "a") == &latencyA);
+
+    for (int i = 0; i < 98; i++)
+        latencyA.Observe(20);
+    latencyA.Observe(2000);
+    latencyA.Observe(60000000);
+    BOOST_CHECK(latencyA.nCount == 100);
+    BOOST_CHECK(latencyA.nSumMicros == 98 * 20 + 2000 + 60000000);
+    BOOST_CHECK(latencyA.GetQuantileMicros(0.5) == 50);
+    BOOST_CHECK(latencyA.GetQuantileMicros(0.985) == 5000);
+    BOOST_CHECK(latencyA.GetQuantileMicros(0.999) == -1);
+    BOOST_CHECK(latencyB.GetQuantileMicros(0.5) == 0);
+    {
+        CMetricTimer timer(latencyB);
+    }
+    BOOST_CHECK(latencyB.nCount == 1);
+}
+
+BOOST_AUTO_TEST_CASE(metrics_prometheus)
+{
+    CMetricLatency& latency = GetMetricLatency("test_prom_seconds", "Prometheus test", "method", "x");
+    latency.Observe(5);
+    latency.Observe(700);
+    GetMetricCounter("test_prom_total", "Prometheus counter").Add(3);
+
+    std::string str = MetricsToPrometheus();
+    BOOST_CHECK(str.find("# TYPE test_prom_seconds histogram\n") != std::string::npos);
+    BOOST_CHECK(str.find("test_prom_seconds_bucket{method=\"x\",le=\"1e-05\"} 1\n") != std::string::npos);
+    BOOST_CHECK(str.find("test_prom_seconds_bucket{method=\"x\",le=\"0.001\"} 2\n") != std::string::npos);
+    BOOST_CHECK(str.find("test_prom_seconds_bucket{method=\"x\",le=\"+Inf\"} 2\n") != std::string::npos);
+    BOOST_CHECK(str.find("test_prom_seconds_count{method=\"x\"} 2\n") != std::string::npos);
+    BOOST_CHECK(str.find("test_prom_seconds_sum{method=\"x\"} 0.000705\n") != std::string::npos);
+    BOOST_CHECK(str.find("# TYPE test_prom_total counter\ntest_prom_total 3\n") != std::string::npos);
+    // the help line of a family is written once
+    CMetricLatency& latency2 = GetMetricLatency("test_prom_seconds", "Prometheus test", "method", "y");
+    latency2.Observe(1);
+    str = MetricsToPrometheus();
+    BOOST_CHECK(str.find("# HELP test_prom_seconds") == str.rfind("# HELP test_prom_seconds"));
+}
+
+BOOST_AUTO_TEST_CASE(metrics_overhead)
+{
+    CMetricLatency& latency = GetMetricLatency("test_overhead_seconds", "Overhead test");
+    const int nIterations = 1000000;
+    int64_t nStart = GetTimeMicros();
+    for (int i = 0; i < nIterations; i++)
+    {
+        CMetricTimer timer(latency);
+    }
+    int64_t nElapsed = std::max(GetTimeMicros() - nStart, (int64_t)1);
+    BOOST_CHECK(latency.nCount == (uint64_t)nIterations);
+    BOOST_TEST_MESSAGE(strprintf("CMetricTimer: %.1f ns per timed scope", 1000.0 * nElapsed / nIterations));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -442,4 +442,78 @@ BOOST_AUTO_TEST_CASE(script_combineSigs)
     BOOST_CHECK(combined == partial3c);
 }
 
+BOOST_AUTO_TEST_CASE(script_check_batch)
+{
+    // Synthetic block: 50 transactions spending 100 pay-to-pubkey-hash outputs each
+    const int nTx = 50, nInputs = 100;
+
+    // Measure real verification, not signature cache hits
+    string strOldCacheSize = mapArgs["-maxsigcachesize"];
+    mapArgs["-maxsigcachesize"] = "0";
+
+    CBasicKeyStore keystore;
+    vector<CScript> vScriptPubKey;
+    for (int i = 0; i < 10; i++)
+    {
+        CKey key;
+        key.MakeNewKey(true);
+        keystore.AddKey(key);
+        CScript script;
+        script.SetDestination(key.GetPubKey().GetID());
+        vScriptPubKey.push_back(script);
+    }
+
+    vector<CTransaction> vtx(nTx);
+    vector<CScriptCheck> vChecks;
+    for (int t = 0; t < nTx; t++)
+    {
+        CTransaction& tx = vtx[t];
+        tx.vin.resize(nInputs);
+        tx.vout.resize(1);
+        tx.vout[0].nValue = 1;
+        for (int i = 0; i < nInputs; i++)
+        {
+            tx.vin[i].prevout.hash = t;
+            tx.vin[i].prevout.n = i;
+        }
+        for (int i = 0; i < nInputs; i++)
+            BOOST_CHECK(SignSignature(keystore, vScriptPubKey[i % vScriptPubKey.size()], tx, i));
+        for (int i = 0; i < nInputs; i++)
+            vChecks.push_back(CScriptCheck(vScriptPubKey[i % vScriptPubKey.size()], tx, i, 0));
+    }
+
+    int64_t nStart = GetTimeMicros();
+    BOOST_FOREACH(const CScriptCheck& check, vChecks)
+        BOOST_CHECK(check());
+    int64_t nSerial = GetTimeMicros() - nStart;
+
+    int nThreads = std::max(2, (int)boost::thread::hardware_concurrency());
+    StartScriptCheckThreads(nThreads - 1);
+
+    unsigned int nFailed = 0;
+    nStart = GetTimeMicros();
+    BOOST_CHECK(VerifyScriptChecks(vChecks, nFailed));
+    int64_t nBatch = GetTimeMicros() - nStart;
+
+    BOOST_TEST_MESSAGE(strprintf("%" PRIszu " signatures: one at a time %.1f ms, batch (%d threads) %.1f ms",
+                                 vChecks.size(), nSerial / 1000.0, nThreads, nBatch / 1000.0));
+
+    // A bad signature must be pinpointed to its input
+    CScript scriptSig = vtx[37].vin[42].scriptSig;
+    vtx[37].vin[42].scriptSig = vtx[37].vin[43].scriptSig;
+    BOOST_CHECK(!VerifyScriptChecks(vChecks, nFailed));
+    BOOST_CHECK_EQUAL(nFailed, 37 * nInputs + 42);
+    BOOST_CHECK(&vChecks[nFailed].GetTx() == &vtx[37] && vChecks[nFailed].GetIn() == 42);
+    vtx[37].vin[42].scriptSig = scriptSig;
+    BOOST_CHECK(VerifyScriptChecks(vChecks, nFailed));
+
+    // The threads can be started again after a stop
+    StopScriptCheckThreads();
+    StartScriptCheckThreads(nThreads - 1);
+    BOOST_CHECK(VerifyScriptChecks(vChecks, nFailed));
+
+    StopScriptCheckThreads();
+    mapArgs["-maxsigcachesize"] = strOldCacheSize;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
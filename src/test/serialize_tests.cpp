@@ -0,0 +1,175 @@
+#include <boost/test/unit_test.hpp>
+
+#include "main.h"
+#include "serialize.h"
+#include "util.h"
+
+BOOST_AUTO_TEST_SUITE(serialize_tests)
+
+static CTransaction MakeTransaction(unsigned int nSeed)
+{
+    CTransaction tx;
+    tx.nTime = 1400000000 + nSeed;
+    tx.vin.resize(2);
+    tx.vout.resize(2);
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        tx.vin[i].prevout = COutPoint(GetRandHash(), i);
+        tx.vin[i].scriptSig = CScript() << std::vector<unsigned char>(72, nSeed) << std::vector<unsigned char>(33, i);
+        tx.vout[i].nValue = (nSeed + 1) * COIN;
+        tx.vout[i].scriptPubKey = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, i) << OP_EQUALVERIFY << OP_CHECKSIG;
+    }
+    return tx;
+}
+
+BOOST_AUTO_TEST_CASE(span_stream)
+{
+    CTransaction tx = MakeTransaction(1);
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << tx << 42;
+    std::vector<char> vch(ss.begin(), ss.end());
+
+    CSpanStream span(&vch[0], &vch[0] + vch.size(), SER_DISK, CLIENT_VERSION);
+    CTransaction txRead;
+    int n = 0;
+    span >> txRead;
+    BOOST_CHECK(txRead.GetHash() == tx.GetHash());
+    BOOST_CHECK(span.size() == sizeof(n));
+    span >> n;
+    BOOST_CHECK(n == 42);
+    BOOST_CHECK(span.eof());
+    BOOST_CHECK_THROW(span >> n, std::ios_base::failure);
+
+    CSpanStream span2(&vch[0], &vch[0] + vch.size(), SER_DISK, CLIENT_VERSION);
+    span2.ignore(vch.size() - sizeof(n));
+    span2 >> n;
+    BOOST_CHECK(n == 42);
+    BOOST_CHECK_THROW(span2.ignore(1), std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_CASE(small_data_stream)
+{
+    CTransaction tx = MakeTransaction(2);
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << tx;
+
+    // fits inline
+    CSmallDataStream<1024> small(SER_DISK, CLIENT_VERSION);
+    small << tx;
+    BOOST_CHECK(small.IsInline());
+    BOOST_CHECK(small.str() == ss.str());
+
+    // spills to the heap part way through, and keeps growing
+    CSmallDataStream<16> tiny(SER_DISK, CLIENT_VERSION);
+    CDataStream ssMany(SER_DISK, CLIENT_VERSION);
+    for (int i = 0; i < 20; i++)
+    {
+        tiny << tx;
+        ssMany << tx;
+    }
+    BOOST_CHECK(!tiny.IsInline());
+    BOOST_CHECK(tiny.size() == ssMany.size());
+    BOOST_CHECK(tiny.str() == ssMany.str());
+
+    // stream << stream appends the raw bytes
+    CDataStream ssCopy(SER_DISK, CLIENT_VERSION);
+    ssCopy << small;
+    BOOST_CHECK(ssCopy.str() == ss.str());
+
+    tiny.clear();
+    BOOST_CHECK(tiny.empty());
+}
+
+BOOST_AUTO_TEST_CASE(serialize_throughput)
+{
+    CTransaction tx = MakeTransaction(3);
+    CBlock block;
+    block.nTime = 1400000000;
+    for (unsigned int i = 0; i < 500; i++)
+        block.vtx.push_back(MakeTransaction(i));
+    block.hashMerkleRoot = block.BuildMerkleTree();
+    CBlockIndex index(0, 0, block);
+    index.nHeight = 100000;
+    CDiskBlockIndex diskindex(&index);
+
+    const int nIterations = 20000;
+    int64_t nStart, nOld, nNew;
+
+    // CTransaction
+    nStart = GetTimeMicros();
+    for (int i = 0; i < nIterations; i++)
+    {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss.reserve(10000);
+        ss << tx;
+        CDataStream ssRead(ss.begin(), ss.end(), SER_DISK, CLIENT_VERSION);
+        CTransaction txRead;
+        ssRead >> txRead;
+    }
+    nOld = std::max(GetTimeMicros() - nStart, (int64_t)1);
+    nStart = GetTimeMicros();
+    for (int i = 0; i < nIterations; i++)
+    {
+        CSmallDataStream<1024> ss(SER_DISK, CLIENT_VERSION);
+        ss << tx;
+        CSpanStream ssRead(ss.begin(), ss.end(), SER_DISK, CLIENT_VERSION);
+        CTransaction txRead;
+        ssRead >> txRead;
+    }
+    nNew = std::max(GetTimeMicros() - nStart, (int64_t)1);
+    BOOST_TEST_MESSAGE(strprintf("CTransaction round trip: CDataStream %.0f/s, span %.0f/s",
+                                 1000000.0 * nIterations / nOld, 1000000.0 * nIterations / nNew));
+
+    // CDiskBlockIndex
+    nStart = GetTimeMicros();
+    for (int i = 0; i < nIterations; i++)
+    {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss.reserve(10000);
+        ss << diskindex;
+        CDataStream ssRead(ss.begin(), ss.end(), SER_DISK, CLIENT_VERSION);
+        CDiskBlockIndex diskindexRead;
+        ssRead >> diskindexRead;
+    }
+    nOld = std::max(GetTimeMicros() - nStart, (int64_t)1);
+    nStart = GetTimeMicros();
+    for (int i = 0; i < nIterations; i++)
+    {
+        CSmallDataStream<1024> ss(SER_DISK, CLIENT_VERSION);
+        ss << diskindex;
+        CSpanStream ssRead(ss.begin(), ss.end(), SER_DISK, CLIENT_VERSION);
+        CDiskBlockIndex diskindexRead;
+        ssRead >> diskindexRead;
+    }
+    nNew = std::max(GetTimeMicros() - nStart, (int64_t)1);
+    BOOST_TEST_MESSAGE(strprintf("CDiskBlockIndex round trip: CDataStream %.0f/s, span %.0f/s",
+                                 1000000.0 * nIterations / nOld, 1000000.0 * nIterations / nNew));
+
+    // CBlock, too large for the inline buffer
+    const int nBlockIterations = 100;
+    CBlock blockRead;
+    nStart = GetTimeMicros();
+    for (int i = 0; i < nBlockIterations; i++)
+    {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << block;
+        CDataStream ssRead(ss.begin(), ss.end(), SER_DISK, CLIENT_VERSION);
+        ssRead >> blockRead;
+    }
+    nOld = std::max(GetTimeMicros() - nStart, (int64_t)1);
+    nStart = GetTimeMicros();
+    for (int i = 0; i < nBlockIterations; i++)
+    {
+        CSmallDataStream<1024> ss(SER_DISK, CLIENT_VERSION);
+        ss << block;
+        CSpanStream ssRead(ss.begin(), ss.end(), SER_DISK, CLIENT_VERSION);
+        ssRead >> blockRead;
+    }
+    nNew = std::max(GetTimeMicros() - nStart, (int64_t)1);
+    BOOST_CHECK(blockRead.GetHash() == block.GetHash());
+    BOOST_CHECK(blockRead.BuildMerkleTree() == block.hashMerkleRoot);
+    BOOST_TEST_MESSAGE(strprintf("CBlock (500 tx) round trip: CDataStream %.0f/s, span %.0f/s",
+                                 1000000.0 * nBlockIterations / nOld, 1000000.0 * nBlockIterations / nNew));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,77 @@
+#include <boost/test/unit_test.hpp>
+
+#include "main.h"
+#include "util.h"
+
+#include <vector>
+
+#define SKIPLIST_LENGTH 100000
+
+BOOST_AUTO_TEST_SUITE(skiplist_tests)
+
+BOOST_AUTO_TEST_CASE(skiplist_test)
+{
+    std::vector<CBlockIndex> vIndex(SKIPLIST_LENGTH);
+
+    for (int i = 0; i < SKIPLIST_LENGTH; i++)
+    {
+        vIndex[i].nHeight = i;
+        vIndex[i].pprev = (i == 0) ? NULL : &vIndex[i - 1];
+        vIndex[i].BuildSkip();
+    }
+
+    for (int i = 0; i < SKIPLIST_LENGTH; i++)
+    {
+        if (i > 0)
+        {
+            BOOST_CHECK(vIndex[i].pskip == &vIndex[vIndex[i].pskip->nHeight]);
+            BOOST_CHECK(vIndex[i].pskip->nHeight < i);
+        }
+        else
+            BOOST_CHECK(vIndex[i].pskip == NULL);
+    }
+
+    for (int i = 0; i < 1000; i++)
+    {
+        int nFrom = GetRandInt(SKIPLIST_LENGTH - 1);
+        int nTo = GetRandInt(nFrom + 1);
+
+        BOOST_CHECK(vIndex[SKIPLIST_LENGTH - 1].GetAncestor(nFrom) == &vIndex[nFrom]);
+        BOOST_CHECK(vIndex[nFrom].GetAncestor(nTo) == &vIndex[nTo]);
+        BOOST_CHECK(vIndex[nFrom].GetAncestor(0) == &vIndex[0]);
+    }
+    BOOST_CHECK(vIndex[10].GetAncestor(11) == NULL);
+    BOOST_CHECK(vIndex[10].GetAncestor(-1) == NULL);
+}
+
+BOOST_AUTO_TEST_CASE(last_block_index_test)
+{
+    // proof-of-work up to height 99, then every third block proof-of-work
+    std::vector<CBlockIndex> vIndex(300);
+    for (int i = 0; i < (int)vIndex.size(); i++)
+    {
+        vIndex[i].nHeight = i;
+        vIndex[i].pprev = (i == 0) ? NULL : &vIndex[i - 1];
+        if (i >= 100 && i % 3 != 0)
+            vIndex[i].SetProofOfStake();
+        vIndex[i].BuildSkip();
+    }
+
+    // the same answers as walking pprev
+    for (int i = 0; i < (int)vIndex.size(); i++)
+    {
+        for (int nType = 0; nType < 2; nType++)
+        {
+            bool fProofOfStake = (nType == 1);
+            const CBlockIndex* pindexWalk = &vIndex[i];
+            while (pindexWalk->pprev && pindexWalk->IsProofOfStake() != fProofOfStake)
+                pindexWalk = pindexWalk->pprev;
+            BOOST_CHECK(GetLastBlockIndex(&vIndex[i], fProofOfStake) == pindexWalk);
+        }
+    }
+    BOOST_CHECK(GetLastBlockIndex(&vIndex[50], true) == &vIndex[0]);
+    BOOST_CHECK(GetLastBlockIndex(&vIndex[299], false) == &vIndex[297]);
+    BOOST_CHECK(GetLastBlockIndex(NULL, false) == NULL);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,216 @@
+#include <boost/test/unit_test.hpp>
+
+#include "kernel.h"
+#include "main.h"
+#include "util.h"
+
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(stakemodifier_tests)
+
+// The selection as it was done before the candidate window was kept between
+// calls: walk pprev, sort (time, hash) pairs and hash every candidate in
+// every round
+static int64_t RefSection(int nSection, int nHeight)
+{
+    int64_t nInterval = nHeight >= 1005000 ? nModifierIntervalSecond : nModifierInterval;
+    return nInterval * 63 / (63 + ((63 - nSection) * (MODIFIER_INTERVAL_RATIO - 1)));
+}
+
+static uint64_t RefComputeNextStakeModifier(const CBlockIndex* pindexPrev, const std::map<uint256, const CBlockIndex*>& mapIndex)
+{
+    const CBlockIndex* pindex = pindexPrev;
+    while (pindex->pprev && !pindex->GeneratedStakeModifier())
+        pindex = pindex->pprev;
+    uint64_t nStakeModifier = pindex->nStakeModifier;
+    int64_t nModifierTime = pindex->GetBlockTime();
+    int64_t nInterval = pindexPrev->nHeight >= 1005000 ? nModifierIntervalSecond : nModifierInterval;
+    if (nModifierTime / nInterval >= pindexPrev->GetBlockTime() / nInterval)
+        return nStakeModifier;
+
+    int64_t nSelectionInterval = 0;
+    for (int nSection = 0; nSection < 64; nSection++)
+        nSelectionInterval += RefSection(nSection, pindexPrev->nHeight);
+    int64_t nSelectionIntervalStart = (pindexPrev->GetBlockTime() / nInterval) * nInterval - nSelectionInterval;
+
+    std::vector<std::pair<int64_t, uint256> > vSortedByTimestamp;
+    for (pindex = pindexPrev; pindex && pindex->GetBlockTime() >= nSelectionIntervalStart; pindex = pindex->pprev)
+        vSortedByTimestamp.push_back(std::make_pair(pindex->GetBlockTime(), pindex->GetBlockHash()));
+    std::sort(vSortedByTimestamp.begin(), vSortedByTimestamp.end());
+
+    uint64_t nStakeModifierNew = 0;
+    int64_t nSelectionIntervalStop = nSelectionIntervalStart;
+    std::set<uint256> setSelected;
+    for (int nRound = 0; nRound < std::min(64, (int)vSortedByTimestamp.size()); nRound++)
+    {
+        nSelectionIntervalStop += RefSection(nRound, pindexPrev->nHeight);
+        bool fSelected = false;
+        uint256 hashBest = 0;
+        const CBlockIndex* pindexSelected = NULL;
+        for (unsigned int i = 0; i < vSortedByTimestamp.size(); i++)
+        {
+            pindex = mapIndex.find(vSortedByTimestamp[i].second)->second;
+            if (fSelected && pindex->GetBlockTime() > nSelectionIntervalStop)
+                break;
+            if (setSelected.count(pindex->GetBlockHash()))
+                continue;
+            uint256 hashProof = pindex->IsProofOfStake() ? pindex->hashProofOfStake : pindex->GetBlockHash();
+            CHashWriter ss(SER_GETHASH, 0);
+            ss << hashProof << nStakeModifier;
+            uint256 hashSelection = ss.GetHash();
+            if (pindex->IsProofOfStake())
+                hashSelection >>= 32;
+            if (!fSelected || hashSelection < hashBest)
+            {
+                fSelected = true;
+                hashBest = hashSelection;
+                pindexSelected = pindex;
+            }
+        }
+        nStakeModifierNew |= ((uint64_t)pindexSelected->GetStakeEntropyBit()) << nRound;
+        setSelected.insert(pindexSelected->GetBlockHash());
+    }
+    return nStakeModifierNew;
+}
+
+// Blocks roughly every ten minutes with jittered, not always increasing,
+// timestamps, across the height where the modifier interval shortens
+class CTestChain
+{
+public:
+    std::vector<uint256> vHashes;
+    std::vector<CBlockIndex> vIndex;
+
+    CTestChain(unsigned int nLength, const CBlockIndex* pindexFork, int64_t nTimeStart) : vHashes(nLength), vIndex(nLength)
+    {
+        for (unsigned int i = 0; i < nLength; i++)
+        {
+            CBlockIndex& index = vIndex[i];
+            vHashes[i] = GetRandHash();
+            index.phashBlock = &vHashes[i];
+            index.pprev = i > 0 ? &vIndex[i - 1] : const_cast<CBlockIndex*>(pindexFork);
+            index.nHeight = index.pprev ? index.pprev->nHeight + 1 : 1004000;
+            index.nTime = nTimeStart + i * 600 + GetRandInt(600) - 300;
+            if (GetRandInt(3) != 0)
+            {
+                index.SetProofOfStake();
+                index.hashProofOfStake = GetRandHash();
+            }
+            index.SetStakeEntropyBit(GetRandInt(2));
+            // no skip pointers: they assume a chain starting at height 0, and
+            // GetAncestor() falls back to pprev without them
+        }
+    }
+};
+
+static void CheckModifiers(CTestChain& chain, std::map<uint256, const CBlockIndex*>& mapIndex, unsigned int nFirst)
+{
+    for (unsigned int i = 0; i < chain.vIndex.size(); i++)
+        mapIndex[chain.vHashes[i]] = &chain.vIndex[i];
+
+    int nGenerated = 0;
+    for (unsigned int i = nFirst; i < chain.vIndex.size(); i++)
+    {
+        const CBlockIndex* pindexPrev = chain.vIndex[i].pprev;
+        uint64_t nStakeModifier;
+        bool fGenerated;
+        BOOST_REQUIRE(ComputeNextStakeModifier(pindexPrev, nStakeModifier, fGenerated));
+        BOOST_CHECK_EQUAL(nStakeModifier, RefComputeNextStakeModifier(pindexPrev, mapIndex));
+        chain.vIndex[i].SetStakeModifier(nStakeModifier, fGenerated);
+        if (fGenerated)
+            nGenerated++;
+    }
+    BOOST_CHECK(nGenerated > 10);
+}
+
+BOOST_AUTO_TEST_CASE(stakemodifier_matches_reference)
+{
+    std::map<uint256, const CBlockIndex*> mapIndex;
+    ClearStakeModifierWindow();
+
+    CTestChain chain(3000, NULL, 1450000000);
+    chain.vIndex[0].SetStakeModifier(0, true);
+    CheckModifiers(chain, mapIndex, 1);
+
+    // a competing branch from height 1004000 + 1900, then the first chain again
+    CTestChain branch(400, &chain.vIndex[1899], chain.vIndex[1899].GetBlockTime() + 7);
+    CheckModifiers(branch, mapIndex, 0);
+    CheckModifiers(chain, mapIndex, 2500);
+    // and a jump far back, where nothing of the window is left
+    CheckModifiers(chain, mapIndex, 100);
+
+    ClearStakeModifierWindow();
+}
+
+// Checkpoints the main chain of vIndex (held at the index of its height) fails
+static int CountFailedCheckpoints(const std::vector<CBlockIndex>& vIndex, const std::map<int, unsigned int>& mapCheckpoints)
+{
+    int nFailed = 0;
+    for (std::map<int, unsigned int>::const_iterator mi = mapCheckpoints.begin(); mi != mapCheckpoints.end(); ++mi)
+        if (vIndex[mi->first].nStakeModifierChecksum != mi->second)
+            nFailed++;
+    return nFailed;
+}
+
+BOOST_AUTO_TEST_CASE(stakemodifier_checksums_parallel)
+{
+    // a chain from the genesis block with a branch from height 1200 to 1399
+    std::vector<uint256> vHashes(2200);
+    std::vector<CBlockIndex> vIndex(2200);
+    std::vector<std::pair<int, CBlockIndex*> > vSortedByHeight;
+    for (unsigned int i = 0; i < vIndex.size(); i++)
+    {
+        CBlockIndex& index = vIndex[i];
+        vHashes[i] = i == 0 ? (!fTestNet ? hashGenesisBlock : hashGenesisBlockTestNet) : GetRandHash();
+        index.phashBlock = &vHashes[i];
+        index.pprev = i == 2000 ? &vIndex[1199] : (i > 0 ? &vIndex[i - 1] : NULL);
+        index.nHeight = index.pprev ? index.pprev->nHeight + 1 : 0;
+        if (GetRandInt(3) != 0)
+        {
+            index.SetProofOfStake();
+            index.hashProofOfStake = GetRandHash();
+        }
+        index.SetStakeModifier(GetRand(std::numeric_limits<uint64_t>::max()), GetRandInt(2));
+        vSortedByHeight.push_back(std::make_pair(index.nHeight, &index));
+    }
+    std::sort(vSortedByHeight.begin(), vSortedByHeight.end());
+
+    // checksummed one by one as AddToBlockIndex does
+    std::vector<unsigned int> vChecksums(vIndex.size());
+    for (size_t i = 0; i < vSortedByHeight.size(); i++)
+        vSortedByHeight[i].second->nStakeModifierChecksum = GetStakeModifierChecksum(vSortedByHeight[i].second);
+    for (unsigned int i = 0; i < vIndex.size(); i++)
+        vChecksums[i] = vIndex[i].nStakeModifierChecksum;
+
+    // 1300 holds two blocks and cannot start a run
+    std::map<int, unsigned int> mapCheckpoints;
+    mapCheckpoints[0] = vIndex[0].nStakeModifierChecksum;
+    mapCheckpoints[400] = vIndex[400].nStakeModifierChecksum;
+    mapCheckpoints[1000] = vIndex[1000].nStakeModifierChecksum;
+    mapCheckpoints[1300] = vIndex[1300].nStakeModifierChecksum;
+    mapCheckpoints[1500] = vIndex[1500].nStakeModifierChecksum;
+
+    for (unsigned int i = 0; i < vIndex.size(); i++)
+        vIndex[i].nStakeModifierChecksum = 0;
+    BOOST_CHECK_EQUAL(ComputeStakeModifierChecksums(vSortedByHeight, mapCheckpoints, false), 0U);
+    BOOST_CHECK_EQUAL(CountFailedCheckpoints(vIndex, mapCheckpoints), 0);
+    for (unsigned int i = 0; i < vIndex.size(); i++)
+        BOOST_CHECK_EQUAL(vIndex[i].nStakeModifierChecksum, vChecksums[i]);
+
+    // trusted: only what is above 1500 is computed
+    for (unsigned int i = 0; i < vIndex.size(); i++)
+        vIndex[i].nStakeModifierChecksum = 0;
+    size_t nFirst = ComputeStakeModifierChecksums(vSortedByHeight, mapCheckpoints, true);
+    BOOST_CHECK(vSortedByHeight[nFirst].first == 1501);
+    BOOST_CHECK_EQUAL(vIndex[1500].nStakeModifierChecksum, vChecksums[1500]);
+    for (unsigned int i = 1501; i < 2000; i++)
+        BOOST_CHECK_EQUAL(vIndex[i].nStakeModifierChecksum, vChecksums[i]);
+    BOOST_CHECK_EQUAL(vIndex[999].nStakeModifierChecksum, 0U);
+
+    // a wrong checkpoint seeds a wrong run, which the next checkpoint catches
+    mapCheckpoints[1000] ^= 1;
+    ComputeStakeModifierChecksums(vSortedByHeight, mapCheckpoints, false);
+    BOOST_CHECK_EQUAL(CountFailedCheckpoints(vIndex, mapCheckpoints), 3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
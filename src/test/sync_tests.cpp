@@ -0,0 +1,78 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
+#include <algorithm>
+
+#include "sync.h"
+#include "util.h"
+
+BOOST_AUTO_TEST_SUITE(sync_tests)
+
+#ifdef DEBUG_LOCKPROFILE
+static CCriticalSection csProfiled;
+static int nProfiledCounter = 0;
+
+static void LockProfiledMany(int nTimes)
+{
+    for (int i = 0; i < nTimes; i++)
+    {
+        LOCK(csProfiled);
+        nProfiledCounter++;
+    }
+}
+
+static void EnterProfiledMany(int nTimes)
+{
+    for (int i = 0; i < nTimes; i++)
+    {
+        ENTER_CRITICAL_SECTION(csProfiled);
+        nProfiledCounter++;
+        LEAVE_CRITICAL_SECTION(csProfiled);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(lock_profile_counts)
+{
+    // counts from threads that have exited are kept
+    boost::thread_group threads;
+    for (int i = 0; i < 4; i++)
+        threads.create_thread(boost::bind(LockProfiledMany, 1000));
+    for (int i = 0; i < 2; i++)
+        threads.create_thread(boost::bind(EnterProfiledMany, 100));
+    threads.join_all();
+    LockProfiledMany(500);
+    BOOST_CHECK(nProfiledCounter == 4700);
+
+    {
+        TRY_LOCK(csProfiled, lockTry);
+        bool fLocked = lockTry;
+        BOOST_CHECK(fLocked);
+    }
+
+    // one LOCK() site, one TRY_LOCK() site and one ENTER_CRITICAL_SECTION() site
+    std::vector<CLockSiteStats> vStats;
+    BOOST_CHECK(GetLockStats(vStats));
+    std::vector<uint64_t> vLocks;
+    BOOST_FOREACH(const CLockSiteStats& stats, vStats)
+    {
+        if (stats.strName != "csProfiled")
+            continue;
+        vLocks.push_back(stats.nLocks);
+        BOOST_CHECK(stats.nContended <= stats.nLocks);
+        BOOST_CHECK(stats.nMaxHoldMicros <= stats.nHoldMicros);
+    }
+    BOOST_REQUIRE(vLocks.size() == 3);
+    std::sort(vLocks.begin(), vLocks.end());
+    BOOST_CHECK(vLocks[0] == 1);
+    BOOST_CHECK(vLocks[1] == 200);
+    BOOST_CHECK(vLocks[2] == 4500);
+}
+#else
+BOOST_AUTO_TEST_CASE(lock_profile_disabled)
+{
+    std::vector<CLockSiteStats> vStats;
+    BOOST_CHECK(!GetLockStats(vStats));
+    BOOST_CHECK(vStats.empty());
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -1,4 +1,6 @@
 #include <boost/test/unit_test.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
 
 #include "main.h"
 #include "wallet.h"
@@ -292,4 +294,42 @@ BOOST_AUTO_TEST_CASE(coin_selection_tests)
     }
 }
 
+
+static void TopUpKeyPoolTo(unsigned int nSize, boost::atomic<bool>* pfDone)
+{
+    pwalletMain->TopUpKeyPool(nSize);
+    *pfDone = true;
+}
+
+// keypoolrefill runs without cs_wallet held by the RPC table; a large refill
+// must let other wallet calls take cs_wallet between its batches.
+BOOST_AUTO_TEST_CASE(keypool_refill_releases_wallet_lock)
+{
+    unsigned int nStart;
+    {
+        LOCK(pwalletMain->cs_wallet);
+        nStart = pwalletMain->GetKeyPoolSize();
+    }
+    unsigned int nTarget = nStart + 3000;
+    boost::atomic<bool> fDone(false);
+    boost::thread refill(boost::bind(&TopUpKeyPoolTo, nTarget, &fDone));
+
+    bool fSawPartial = false;
+    while (!fDone && !fSawPartial)
+    {
+        {
+            LOCK(pwalletMain->cs_wallet);
+            unsigned int nSize = pwalletMain->GetKeyPoolSize();
+            if (nSize > nStart && nSize < nTarget + 1)
+                fSawPartial = true;
+        }
+        MilliSleep(1);
+    }
+    refill.join();
+
+    BOOST_CHECK(fSawPartial);
+    LOCK(pwalletMain->cs_wallet);
+    BOOST_CHECK_EQUAL(pwalletMain->GetKeyPoolSize(), nTarget + 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,246 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include "util.h"
+#include "walletlog.h"
+
+BOOST_AUTO_TEST_SUITE(walletlog_tests)
+
+static boost::filesystem::path TestLogPath()
+{
+    boost::filesystem::path path = boost::filesystem::temp_directory_path() /
+        strprintf("test_eccoin_walletlog_%" PRIu64 ".log", GetRand(std::numeric_limits<uint64_t>::max()));
+    boost::filesystem::remove(path);
+    return path;
+}
+
+static CDataStream Key(const std::string& strType, int n)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << std::make_pair(strType, n);
+    return ss;
+}
+
+static CDataStream Value(const std::string& str)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << str;
+    return ss;
+}
+
+static std::string ReadValue(CWalletLog& log, const CDataStream& ssKey)
+{
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    if (!log.Read(ssKey, ssValue))
+        return "(none)";
+    std::string str;
+    ssValue >> str;
+    return str;
+}
+
+BOOST_AUTO_TEST_CASE(walletlog_read_write)
+{
+    boost::filesystem::path path = TestLogPath();
+    CWalletLog log;
+    BOOST_CHECK(!log.Open(path, false));
+    BOOST_CHECK(log.Open(path, true));
+
+    BOOST_CHECK(log.Write(Key("tx", 1), Value("one"), true, NULL));
+    BOOST_CHECK(log.Write(Key("tx", 2), Value("two"), true, NULL));
+    BOOST_CHECK(!log.Write(Key("tx", 2), Value("deux"), false, NULL));
+    BOOST_CHECK(ReadValue(log, Key("tx", 2)) == "two");
+    BOOST_CHECK(log.Write(Key("tx", 2), Value("deux"), true, NULL));
+    BOOST_CHECK(log.Erase(Key("tx", 1), NULL));
+    BOOST_CHECK(log.Erase(Key("tx", 3), NULL));
+    BOOST_CHECK(!log.Exists(Key("tx", 1)));
+    BOOST_CHECK(log.Exists(Key("tx", 2)));
+
+    // a transaction is visible straight away and rolled back on abort
+    CWalletLogTxn txn;
+    BOOST_CHECK(log.Write(Key("tx", 2), Value("two again"), true, &txn));
+    BOOST_CHECK(log.Write(Key("tx", 4), Value("four"), true, &txn));
+    BOOST_CHECK(log.Erase(Key("tx", 2), &txn));
+    BOOST_CHECK(!log.Exists(Key("tx", 2)));
+    log.Abort(txn);
+    BOOST_CHECK(ReadValue(log, Key("tx", 2)) == "deux");
+    BOOST_CHECK(!log.Exists(Key("tx", 4)));
+
+    BOOST_CHECK(log.Write(Key("tx", 4), Value("four"), true, &txn));
+    BOOST_CHECK(log.Write(Key("tx", 5), Value("five"), true, &txn));
+    BOOST_CHECK(log.Commit(txn));
+    unsigned int nCount = log.GetCount();
+    log.Close();
+
+    // replay
+    BOOST_CHECK(log.Open(path, false));
+    BOOST_CHECK(log.GetCount() == nCount);
+    BOOST_CHECK(!log.Exists(Key("tx", 1)));
+    BOOST_CHECK(ReadValue(log, Key("tx", 2)) == "deux");
+    BOOST_CHECK(ReadValue(log, Key("tx", 5)) == "five");
+    log.Close();
+    boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(walletlog_key_order)
+{
+    boost::filesystem::path path = TestLogPath();
+    CWalletLog log;
+    BOOST_CHECK(log.Open(path, true));
+    // unsigned byte order, as Berkeley DB: 0x80 sorts after 0x01
+    const int vKeys[] = { 0x80, 0x01, 0xff, 0x7f, 0x00 };
+    for (unsigned int i = 0; i < sizeof(vKeys) / sizeof(vKeys[0]); i++)
+        BOOST_CHECK(log.Write(Key("acentry", vKeys[i]), Value("x"), true, NULL));
+    BOOST_CHECK(log.Write(Value("version"), Value("x"), true, NULL));
+
+    std::vector<int> vSeen;
+    CWalletLogBytes vchKey, vchValue;
+    CDataStream ssStart = Key("acentry", 0);
+    bool fFound = log.Seek(CWalletLogBytes(ssStart.begin(), ssStart.end()), false, vchKey, vchValue);
+    while (fFound)
+    {
+        CDataStream ss(vchKey.begin(), vchKey.end(), SER_DISK, CLIENT_VERSION);
+        std::string strType;
+        ss >> strType;
+        if (strType != "acentry")
+            break;
+        int n;
+        ss >> n;
+        vSeen.push_back(n);
+        fFound = log.Seek(vchKey, true, vchKey, vchValue);
+    }
+    BOOST_CHECK(vSeen.size() == 5);
+    for (unsigned int i = 1; i < vSeen.size(); i++)
+        BOOST_CHECK(vSeen[i - 1] < vSeen[i]);
+    log.Close();
+    boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(walletlog_recovery)
+{
+    boost::filesystem::path path = TestLogPath();
+    CWalletLog log;
+    BOOST_CHECK(log.Open(path, true));
+    BOOST_CHECK(log.Write(Key("tx", 1), Value("one"), true, NULL));
+    uint64_t nGood = log.GetFileSize();
+    BOOST_CHECK(log.Write(Key("tx", 2), Value("two"), true, NULL));
+    uint64_t nFull = log.GetFileSize();
+    log.Close();
+
+    // a torn write at the end is cut off, together with its transaction
+    boost::filesystem::resize_file(path, nFull - 3);
+    BOOST_CHECK(log.Open(path, false));
+    BOOST_CHECK(log.Exists(Key("tx", 1)));
+    BOOST_CHECK(!log.Exists(Key("tx", 2)));
+    BOOST_CHECK(log.GetFileSize() == nGood);
+    BOOST_CHECK(boost::filesystem::file_size(path) == nGood);
+    BOOST_CHECK(log.Write(Key("tx", 3), Value("three"), true, NULL));
+    log.Close();
+    BOOST_CHECK(log.Open(path, false));
+    BOOST_CHECK(ReadValue(log, Key("tx", 3)) == "three");
+    log.Close();
+
+    // so are zero-filled and garbage blocks left by a crash
+    for (int nFill = 0; nFill < 2; nFill++)
+    {
+        uint64_t nSize = boost::filesystem::file_size(path);
+        {
+            FILE* file = fopen(path.string().c_str(), "ab");
+            for (int i = 0; i < 4096; i++)
+                fputc(nFill == 0 ? 0 : GetRandInt(256), file);
+            fclose(file);
+        }
+        BOOST_CHECK(log.Open(path, false));
+        BOOST_CHECK(ReadValue(log, Key("tx", 3)) == "three");
+        BOOST_CHECK(boost::filesystem::file_size(path) == nSize);
+        log.Close();
+    }
+
+    // and a torn frame followed by a commit frame that was itself cut short
+    {
+        uint64_t nSize = boost::filesystem::file_size(path);
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << (uint32_t)0 << (unsigned char)0x55 << (uint32_t)1 << (unsigned char)CWalletLog::RECORD_COMMIT;
+        FILE* file = fopen(path.string().c_str(), "ab");
+        fwrite(&ss[0], 1, ss.size(), file);
+        fclose(file);
+        BOOST_CHECK(log.Open(path, false));
+        BOOST_CHECK(ReadValue(log, Key("tx", 3)) == "three");
+        BOOST_CHECK(boost::filesystem::file_size(path) == nSize);
+        log.Close();
+    }
+
+    // damage before the end is reported, not skipped
+    {
+        FILE* file = fopen(path.string().c_str(), "r+b");
+        fseek(file, 14, SEEK_SET);
+        fputc(0x55, file);
+        fclose(file);
+    }
+    BOOST_CHECK(!log.Open(path, false));
+    BOOST_CHECK(!log.IsOpen());
+    boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(walletlog_bad_size_mid_log)
+{
+    boost::filesystem::path path = TestLogPath();
+    CWalletLog log;
+    BOOST_CHECK(log.Open(path, true));
+    for (int i = 0; i < 10; i++)
+        BOOST_CHECK(log.Write(Key("key", i), Value("secret"), true, NULL));
+    log.Close();
+
+    // a size field in the middle of the log pointing past its end is damage,
+    // not a torn write: the open fails and nothing is cut off
+    uint64_t nSize = boost::filesystem::file_size(path);
+    {
+        uint32_t nPayload = nSize;
+        FILE* file = fopen(path.string().c_str(), "r+b");
+        fseek(file, 8, SEEK_SET);
+        fwrite(&nPayload, sizeof(nPayload), 1, file);
+        fclose(file);
+    }
+    BOOST_CHECK(!log.Open(path, false));
+    BOOST_CHECK(!log.IsOpen());
+    BOOST_CHECK(boost::filesystem::file_size(path) == nSize);
+    boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(walletlog_compact)
+{
+    boost::filesystem::path path = TestLogPath();
+    CWalletLog log;
+    BOOST_CHECK(log.Open(path, true));
+    for (int i = 0; i < 3000; i++)
+        BOOST_CHECK(log.Write(Key("tx", i % 100), Value(strprintf("value %d", i)), true, NULL));
+    for (int i = 0; i < 10; i++)
+        BOOST_CHECK(log.Write(Key("pool", i), Value("key"), true, NULL));
+    BOOST_CHECK(log.Erase(Key("tx", 0), NULL));
+    uint64_t nBefore = log.GetFileSize();
+    BOOST_CHECK(log.GetLiveSize() < nBefore / 10);
+
+    const char pszSkip[] = "\x04pool";
+    BOOST_CHECK(log.Compact(pszSkip));
+    BOOST_CHECK(log.GetFileSize() < nBefore / 10);
+    BOOST_CHECK(!log.Exists(Key("pool", 3)));
+    BOOST_CHECK(log.GetCount() == 99);
+    BOOST_CHECK(log.Write(Key("tx", 100), Value("after"), true, NULL));
+
+    // not while a transaction has written something the log may still drop
+    CWalletLogTxn txn;
+    BOOST_CHECK(log.Write(Key("tx", 101), Value("pending"), true, &txn));
+    BOOST_CHECK(!log.Compact());
+    log.Abort(txn);
+    BOOST_CHECK(log.Compact());
+    log.Close();
+
+    BOOST_CHECK(log.Open(path, false));
+    BOOST_CHECK(log.GetCount() == 100);
+    BOOST_CHECK(!log.Exists(Key("tx", 0)));
+    BOOST_CHECK(ReadValue(log, Key("tx", 42)) == "value 2942");
+    BOOST_CHECK(ReadValue(log, Key("tx", 100)) == "after");
+    log.Close();
+    boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -136,10 +136,26 @@ bool CTxDB::TxnBegin()
     return true;
 }
 
+CMetricLatency& CTxDB::ReadMetric()
+{
+    static CMetricLatency& metric = GetMetricLatency("eccoin_leveldb_read_seconds", "Time of a LevelDB point read");
+    return metric;
+}
+
+CMetricLatency& CTxDB::WriteMetric()
+{
+    static CMetricLatency& metric = GetMetricLatency("eccoin_leveldb_write_seconds", "Time of a LevelDB write or batch commit");
+    return metric;
+}
+
 bool CTxDB::TxnCommit()
 {
     assert(activeBatch);
-    leveldb::Status status = pdb->Write(leveldb::WriteOptions(), activeBatch);
+    leveldb::Status status;
+    {
+        CMetricTimer timer(WriteMetric());
+        status = pdb->Write(leveldb::WriteOptions(), activeBatch);
+    }
     delete activeBatch;
     activeBatch = NULL;
     if (!status.ok())
@@ -152,7 +168,7 @@ bool CTxDB::TxnCommit()
 
 class CBatchScanner : public leveldb::WriteBatch::Handler {
 public:
-    std::string needle;
+    leveldb::Slice needle;
     bool *deleted;
     std::string *foundValue;
     bool foundEntry;
@@ -160,7 +176,7 @@ public:
     CBatchScanner() : foundEntry(false) {}
 
     virtual void Put(const leveldb::Slice& key, const leveldb::Slice& value) {
-        if (key.ToString() == needle) {
+        if (key == needle) {
             foundEntry = true;
             *deleted = false;
             *foundValue = value.ToString();
@@ -168,7 +184,7 @@ public:
     }
 
     virtual void Delete(const leveldb::Slice& key) {
-        if (key.ToString() == needle) {
+        if (key == needle) {
             foundEntry = true;
             *deleted = true;
         }
@@ -180,11 +196,11 @@ public:
 // a database transaction begins reads are consistent with it. It would be good
 // to change that assumption in future and avoid the performance hit, though in
 // practice it does not appear to be large.
-bool CTxDB::ScanBatch(const CDataStream &key, string *value, bool *deleted) const {
+bool CTxDB::ScanBatch(const leveldb::Slice &key, string *value, bool *deleted) const {
     assert(activeBatch);
     *deleted = false;
     CBatchScanner scanner;
-    scanner.needle = key.str();
+    scanner.needle = key;
     scanner.deleted = deleted;
     scanner.foundValue = value;
     leveldb::Status status = activeBatch->Iterate(&scanner);
@@ -303,6 +319,212 @@ bool CTxDB::WriteCheckpointPubKey(const string& strPubKey)
     return Write(string("strCheckpointPubKey"), strPubKey);
 }
 
+bool CTxDB::ReadAddressIndexFlag(bool& fEnabled)
+{
+    fEnabled = false;
+    return Read(string("addressindex"), fEnabled);
+}
+
+bool CTxDB::WriteAddressIndexFlag(bool fEnabled)
+{
+    return Write(string("addressindex"), fEnabled);
+}
+
+bool CTxDB::ReadAddressIndex(const CAddressIndexKey& key, CAddressIndexValue& value)
+{
+    return Read(make_pair(string("addr"), key), value);
+}
+
+bool CTxDB::WriteAddressIndex(const CAddressIndexKey& key, const CAddressIndexValue& value)
+{
+    return Write(make_pair(string("addr"), key), value);
+}
+
+bool CTxDB::EraseAddressIndex(const CAddressIndexKey& key)
+{
+    return Erase(make_pair(string("addr"), key));
+}
+
+bool CTxDB::ReadAddressUnspent(const CAddressUnspentKey& key, CAddressIndexValue& value)
+{
+    return Read(make_pair(string("addrutxo"), key), value);
+}
+
+bool CTxDB::WriteAddressUnspent(const CAddressUnspentKey& key, const CAddressIndexValue& value)
+{
+    return Write(make_pair(string("addrutxo"), key), value);
+}
+
+bool CTxDB::EraseAddressUnspent(const CAddressUnspentKey& key)
+{
+    return Erase(make_pair(string("addrutxo"), key));
+}
+
+// Records under strPrefix that belong to one address, starting at keyStart
+template<typename K>
+static bool ReadAddressRecords(leveldb::DB* pdb, const string& strPrefix, const K& keyStart, unsigned int nSkip, unsigned int nMax,
+                               vector<pair<K, CAddressIndexValue> >& vRet)
+{
+    CDataStream ssStartKey(SER_DISK, CLIENT_VERSION);
+    ssStartKey << make_pair(strPrefix, keyStart);
+    leveldb::Iterator* iterator = pdb->NewIterator(leveldb::ReadOptions());
+    bool fOk = true;
+    for (iterator->Seek(ssStartKey.str()); iterator->Valid(); iterator->Next())
+    {
+        leveldb::Slice slKey = iterator->key();
+        CSpanStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+        string strType;
+        K key;
+        try
+        {
+            ssKey >> strType;
+            if (strType != strPrefix)
+                break;
+            ssKey >> key;
+        }
+        catch (std::exception &e)
+        {
+            fOk = false;
+            break;
+        }
+        if (key.nAddressType != keyStart.nAddressType || key.hashAddress != keyStart.hashAddress)
+            break;
+        if (nSkip > 0)
+        {
+            nSkip--;
+            continue;
+        }
+
+        leveldb::Slice slValue = iterator->value();
+        CSpanStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+        CAddressIndexValue value;
+        try
+        {
+            ssValue >> value;
+        }
+        catch (std::exception &e)
+        {
+            fOk = false;
+            break;
+        }
+        vRet.push_back(make_pair(key, value));
+        if (nMax > 0 && vRet.size() >= nMax)
+            break;
+    }
+    if (fOk && !iterator->status().ok())
+        fOk = error("ReadAddressRecords() : %s", iterator->status().ToString().c_str());
+    delete iterator;
+    return fOk;
+}
+
+bool CTxDB::ReadAddressHistory(unsigned char nAddressType, const uint160& hashAddress, unsigned int nSkip, unsigned int nMax,
+                               vector<pair<CAddressIndexKey, CAddressIndexValue> >& vHistory)
+{
+    vHistory.clear();
+    CAddressIndexKey keyStart(nAddressType, hashAddress, 0, 0, 0, false);
+    return ReadAddressRecords(pdb, "addr", keyStart, nSkip, nMax, vHistory);
+}
+
+bool CTxDB::ReadAddressUnspents(unsigned char nAddressType, const uint160& hashAddress, unsigned int nSkip, unsigned int nMax,
+                                vector<pair<CAddressUnspentKey, CAddressIndexValue> >& vUnspent)
+{
+    vUnspent.clear();
+    CAddressUnspentKey keyStart(nAddressType, hashAddress, 0, 0);
+    return ReadAddressRecords(pdb, "addrutxo", keyStart, nSkip, nMax, vUnspent);
+}
+
+bool CTxDB::ErasePrefix(const string& strPrefix)
+{
+    CDataStream ssStartKey(SER_DISK, CLIENT_VERSION);
+    ssStartKey << strPrefix;
+    leveldb::Iterator* iterator = pdb->NewIterator(leveldb::ReadOptions());
+    leveldb::WriteBatch batch;
+    unsigned int nBatch = 0;
+    bool fOk = true;
+    for (iterator->Seek(ssStartKey.str()); iterator->Valid() && fOk; iterator->Next())
+    {
+        leveldb::Slice slKey = iterator->key();
+        if (!slKey.starts_with(ssStartKey.str()))
+            break;
+        batch.Delete(slKey);
+        if (++nBatch >= 10000)
+        {
+            fOk = pdb->Write(leveldb::WriteOptions(), &batch).ok();
+            batch.Clear();
+            nBatch = 0;
+        }
+    }
+    delete iterator;
+    if (fOk && nBatch > 0)
+        fOk = pdb->Write(leveldb::WriteOptions(), &batch).ok();
+    return fOk;
+}
+
+bool CTxDB::WipeAddressIndex()
+{
+    assert(!activeBatch);
+    return ErasePrefix("addr") && ErasePrefix("addrutxo");
+}
+
+bool CTxDB::ReadSpentIndexFlag(bool& fEnabled)
+{
+    fEnabled = false;
+    return Read(string("spentindex"), fEnabled);
+}
+
+bool CTxDB::WriteSpentIndexFlag(bool fEnabled)
+{
+    return Write(string("spentindex"), fEnabled);
+}
+
+bool CTxDB::ReadSpentIndex(const COutPoint& outpoint, CSpentIndexValue& value)
+{
+    return Read(make_pair(string("spent"), outpoint), value);
+}
+
+bool CTxDB::WriteSpentIndex(const COutPoint& outpoint, const CSpentIndexValue& value)
+{
+    return Write(make_pair(string("spent"), outpoint), value);
+}
+
+bool CTxDB::EraseSpentIndex(const COutPoint& outpoint)
+{
+    return Erase(make_pair(string("spent"), outpoint));
+}
+
+bool CTxDB::WipeSpentIndex()
+{
+    assert(!activeBatch);
+    return ErasePrefix("spent");
+}
+
+bool CTxDB::ReadBlockStatsFlag(bool& fEnabled)
+{
+    fEnabled = false;
+    return Read(string("blockstatsindex"), fEnabled);
+}
+
+bool CTxDB::WriteBlockStatsFlag(bool fEnabled)
+{
+    return Write(string("blockstatsindex"), fEnabled);
+}
+
+bool CTxDB::ReadBlockStats(const uint256& hash, CBlockStats& stats)
+{
+    return Read(make_pair(string("blockstats"), hash), stats);
+}
+
+bool CTxDB::WriteBlockStats(const uint256& hash, const CBlockStats& stats)
+{
+    return Write(make_pair(string("blockstats"), hash), stats);
+}
+
+bool CTxDB::WipeBlockStats()
+{
+    assert(!activeBatch);
+    return ErasePrefix("blockstats");
+}
+
 CBlockIndex *InsertBlockIndex(uint256 hash)
 {
     if (hash == 0)
@@ -348,8 +570,8 @@ bool CTxDB::LoadBlockIndex()
     {
         TotalNumBlocks = TotalNumBlocks + 1;
         //this is a check to see if we hit the end of the data, dont load values because it doesnt matter
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-        ssKey.write(SmallIterator->key().data(), SmallIterator->key().size());
+        leveldb::Slice slKey = SmallIterator->key();
+        CSpanStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
         string strType;
         ssKey >> strType;
         if (fRequestShutdown || strType != "blockindex")
@@ -383,10 +605,10 @@ bool CTxDB::LoadBlockIndex()
     while (iterator->Valid())
     {
         // Unpack keys and values.
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-        ssKey.write(iterator->key().data(), iterator->key().size());
-        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-        ssValue.write(iterator->value().data(), iterator->value().size());
+        leveldb::Slice slKey = iterator->key();
+        leveldb::Slice slValue = iterator->value();
+        CSpanStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+        CSpanStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
         string strType;
         ssKey >> strType;
         // Did we reach the end of the data to read?
@@ -441,7 +663,7 @@ bool CTxDB::LoadBlockIndex()
     if (fRequestShutdown)
         return true;
 
-    // Calculate nChainTrust
+    // Calculate nChainTrust and the skip pointers
     vector<pair<int, CBlockIndex*> > vSortedByHeight;
     vSortedByHeight.reserve(mapBlockIndex.size());
 
@@ -452,14 +674,23 @@ bool CTxDB::LoadBlockIndex()
     }
     sort(vSortedByHeight.begin(), vSortedByHeight.end());
 
-    int64_t nStartChecksums = GetTimeMillis();
-
     BOOST_FOREACH(const PAIRTYPE(int, CBlockIndex*)& item, vSortedByHeight)
     {
         CBlockIndex* pindex = item.second;
+        pindex->BuildSkip();
         pindex->nChainTrust = (pindex->pprev ? pindex->pprev->nChainTrust : 0) + pindex->GetBlockTrust();
-        // NovaCoin: calculate stake modifier checksum
-        pindex->nStakeModifierChecksum = GetStakeModifierChecksum(pindex);
+    }
+
+    int64_t nStartChecksums = GetTimeMillis();
+
+    // NovaCoin: calculate stake modifier checksum
+    map<int, unsigned int> mapChecksumCheckpoints;
+    if (!fTestNet)
+        mapChecksumCheckpoints = mapStakeModifierCheckpoints;
+    size_t nFirstChecksum = ComputeStakeModifierChecksums(vSortedByHeight, mapChecksumCheckpoints, GetBoolArg("-trustmodifiercheckpoints"));
+    for (size_t i = nFirstChecksum; i < vSortedByHeight.size(); i++)
+    {
+        CBlockIndex* pindex = vSortedByHeight[i].second;
         if (!CheckStakeModifierCheckpoints(pindex->nHeight, pindex))
          return error("CTxDB::LoadBlockIndex() : Failed stake modifier checkpoint height=%d, checksum=%08x, correct checksum=%08x, nflags = %i, modifier=0x%016I64x  hashproofofstake = %s", pindex->nHeight, pindex->nStakeModifierChecksum, mapStakeModifierCheckpoints[pindex->nHeight], pindex->nFile, pindex->nStakeModifier, pindex->hashProofOfStake.ToString().c_str());
     }
@@ -478,6 +709,7 @@ bool CTxDB::LoadBlockIndex()
         return error("CTxDB::LoadBlockIndex() : hashBestChain not found in the block index");
 
     pindexBest = mapBlockIndex[hashBestChain];
+    SetBlockByHeight(pindexBest);
     nBestHeight = pindexBest->nHeight;
     nBestChainTrust = pindexBest->nChainTrust;
 
@@ -7,6 +7,7 @@
 #define BITCOIN_LEVELDB_H
 
 #include "main.h"
+#include "metrics.h"
 
 #include <map>
 #include <string>
@@ -55,14 +56,22 @@ protected:
     // Returns true and sets (value,false) if activeBatch contains the given key
     // or leaves value alone and sets deleted = true if activeBatch contains a
     // delete for it.
-    bool ScanBatch(const CDataStream &key, std::string *value, bool *deleted) const;
+    bool ScanBatch(const leveldb::Slice &key, std::string *value, bool *deleted) const;
+
+    // Latency of the reads and writes that reach LevelDB
+    static CMetricLatency& ReadMetric();
+    static CMetricLatency& WriteMetric();
+
+    // Keys and most values fit in these without a heap allocation
+    typedef CSmallDataStream<128> CKeyStream;
+    typedef CSmallDataStream<1024> CValueStream;
 
     template<typename K, typename T>
     bool Read(const K& key, T& value)
     {
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-        ssKey.reserve(1000);
+        CKeyStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey << key;
+        leveldb::Slice slKey(ssKey.begin(), ssKey.size());
         std::string strValue;
 
         bool readFromDb = true;
@@ -71,7 +80,7 @@ protected:
             // First we must search for it in the currently pending set of
             // changes to the db. If not found in the batch, go on to read disk.
             bool deleted = false;
-            readFromDb = (ScanBatch(ssKey, &strValue, &deleted) == false);
+            readFromDb = (ScanBatch(slKey, &strValue, &deleted) == false);
             if (deleted)
             {
                 return false;
@@ -79,7 +88,8 @@ protected:
         }
         if (readFromDb)
         {
-            leveldb::Status status = pdb->Get(leveldb::ReadOptions(),ssKey.str(), &strValue);
+            CMetricTimer timer(ReadMetric());
+            leveldb::Status status = pdb->Get(leveldb::ReadOptions(), slKey, &strValue);
             if (!status.ok())
             {
                 if (status.IsNotFound())
@@ -94,7 +104,7 @@ protected:
         // Unserialize value
         try
         {
-            CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
+            CSpanStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
             ssValue >> value;
         }
         catch (std::exception &e)
@@ -110,19 +120,20 @@ protected:
         if (fReadOnly)
             assert(!"Write called on database in read-only mode");
 
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-        ssKey.reserve(1000);
+        CKeyStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey << key;
-        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-        ssValue.reserve(10000);
+        CValueStream ssValue(SER_DISK, CLIENT_VERSION);
         ssValue << value;
+        leveldb::Slice slKey(ssKey.begin(), ssKey.size());
+        leveldb::Slice slValue(ssValue.begin(), ssValue.size());
 
         if (activeBatch)
         {
-            activeBatch->Put(ssKey.str(), ssValue.str());
+            activeBatch->Put(slKey, slValue);
             return true;
         }
-        leveldb::Status status = pdb->Put(leveldb::WriteOptions(), ssKey.str(), ssValue.str());
+        CMetricTimer timer(WriteMetric());
+        leveldb::Status status = pdb->Put(leveldb::WriteOptions(), slKey, slValue);
         if (!status.ok())
         {
             printf("LevelDB write failure: %s\n", status.ToString().c_str());
@@ -139,34 +150,34 @@ protected:
         if (fReadOnly)
             assert(!"Erase called on database in read-only mode");
 
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-        ssKey.reserve(1000);
+        CKeyStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey << key;
+        leveldb::Slice slKey(ssKey.begin(), ssKey.size());
         if (activeBatch) {
-            activeBatch->Delete(ssKey.str());
+            activeBatch->Delete(slKey);
             return true;
         }
-        leveldb::Status status = pdb->Delete(leveldb::WriteOptions(), ssKey.str());
+        leveldb::Status status = pdb->Delete(leveldb::WriteOptions(), slKey);
         return (status.ok() || status.IsNotFound());
     }
 
     template<typename K>
     bool Exists(const K& key)
     {
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-        ssKey.reserve(1000);
+        CKeyStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey << key;
+        leveldb::Slice slKey(ssKey.begin(), ssKey.size());
         std::string unused;
 
         if (activeBatch) {
             bool deleted;
-            if (ScanBatch(ssKey, &unused, &deleted) && !deleted) {
+            if (ScanBatch(slKey, &unused, &deleted) && !deleted) {
                 return true;
             }
         }
 
 
-        leveldb::Status status = pdb->Get(leveldb::ReadOptions(), ssKey.str(), &unused);
+        leveldb::Status status = pdb->Get(leveldb::ReadOptions(), slKey, &unused);
         return status.IsNotFound() == false;
     }
 
@@ -210,12 +221,41 @@ public:
     bool WriteSyncCheckpoint(uint256 hashCheckpoint);
     bool ReadCheckpointPubKey(std::string& strPubKey);
     bool WriteCheckpointPubKey(const std::string& strPubKey);
+    bool ReadAddressIndexFlag(bool& fEnabled);
+    bool WriteAddressIndexFlag(bool fEnabled);
+    bool ReadAddressIndex(const CAddressIndexKey& key, CAddressIndexValue& value);
+    bool WriteAddressIndex(const CAddressIndexKey& key, const CAddressIndexValue& value);
+    bool EraseAddressIndex(const CAddressIndexKey& key);
+    bool ReadAddressUnspent(const CAddressUnspentKey& key, CAddressIndexValue& value);
+    bool WriteAddressUnspent(const CAddressUnspentKey& key, const CAddressIndexValue& value);
+    bool EraseAddressUnspent(const CAddressUnspentKey& key);
+    /** Entries of one address in chain order, after skipping nSkip of them (nMax = 0: all) */
+    bool ReadAddressHistory(unsigned char nAddressType, const uint160& hashAddress, unsigned int nSkip, unsigned int nMax,
+                            std::vector<std::pair<CAddressIndexKey, CAddressIndexValue> >& vHistory);
+    bool ReadAddressUnspents(unsigned char nAddressType, const uint160& hashAddress, unsigned int nSkip, unsigned int nMax,
+                             std::vector<std::pair<CAddressUnspentKey, CAddressIndexValue> >& vUnspent);
+    /** Remove every address index record */
+    bool WipeAddressIndex();
+    bool ReadSpentIndexFlag(bool& fEnabled);
+    bool WriteSpentIndexFlag(bool fEnabled);
+    bool ReadSpentIndex(const COutPoint& outpoint, CSpentIndexValue& value);
+    bool WriteSpentIndex(const COutPoint& outpoint, const CSpentIndexValue& value);
+    bool EraseSpentIndex(const COutPoint& outpoint);
+    /** Remove every spent index record */
+    bool WipeSpentIndex();
+    bool ReadBlockStatsFlag(bool& fEnabled);
+    bool WriteBlockStatsFlag(bool fEnabled);
+    bool ReadBlockStats(const uint256& hash, CBlockStats& stats);
+    bool WriteBlockStats(const uint256& hash, const CBlockStats& stats);
+    /** Remove every block stats record */
+    bool WipeBlockStats();
     bool LoadBlockIndex();
     void FinishBlockIndex();
     void BlockIndexFromBack();
     void BlockIndexFromStart();
 private:
     bool LoadBlockIndexGuts();
+    bool ErasePrefix(const std::string& strPrefix);
 };
 
 void ThreadForFinishBlockIndex();
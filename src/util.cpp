@@ -59,6 +59,7 @@ namespace boost {
 
 #ifndef WIN32
 #include <execinfo.h>
+#include <fcntl.h>
 #endif
 
 
@@ -67,7 +68,6 @@ using namespace std;
 map<string, string> mapArgs;
 map<string, vector<string> > mapMultiArgs;
 bool fDebug = false;
-bool fDebugNet = false;
 bool fPrintToConsole = false;
 bool fPrintToDebugger = false;
 bool fRequestShutdown = false;
@@ -76,13 +76,11 @@ bool fDaemon = false;
 bool fServer = false;
 bool fCommandLine = false;
 string strMiscWarning;
-extern CBigNum bnProofOfWorkLimit;
 bool fTestNet = false;
 bool fNoListen = false;
 bool fLogTimestamps = false;
 CMedianFilter<int64_t> vTimeOffsets(200,0);
 bool fReopenDebugLog = false;
-bool messageDebug = false;
 
 // Init OpenSSL library multithreading support
 static CCriticalSection** ppmutexOpenSSL;
@@ -261,8 +259,6 @@ uint256 GetRandHash()
 
 
 
-static FILE* fileout = NULL;
-
 inline int OutputDebugStringF(const char* pszFormat, ...)
 {
     int ret = 0;
@@ -276,47 +272,11 @@ inline int OutputDebugStringF(const char* pszFormat, ...)
     }
     else if (!fPrintToDebugger)
     {
-        // print to debug.log
-
-        if (!fileout)
-        {
-            boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
-            fileout = fopen(pathDebug.string().c_str(), "a");
-            if (fileout) setbuf(fileout, NULL); // unbuffered
-        }
-        if (fileout)
-        {
-            static bool fStartedNewLine = true;
-
-            // This routine may be called by global destructors during shutdown.
-            // Since the order of destruction of static/global objects is undefined,
-            // allocate mutexDebugLog on the heap the first time this routine
-            // is called to avoid crashes during shutdown.
-            static boost::mutex* mutexDebugLog = NULL;
-            if (mutexDebugLog == NULL) mutexDebugLog = new boost::mutex();
-            boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
-
-            // reopen the log file, if requested
-            if (fReopenDebugLog) {
-                fReopenDebugLog = false;
-                boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
-                if (freopen(pathDebug.string().c_str(),"a",fileout) != NULL)
-                    setbuf(fileout, NULL); // unbuffered
-            }
-
-            // Debug print useful for profiling
-            if (fLogTimestamps && fStartedNewLine)
-                fprintf(fileout, "%s ", DateTimeStrFormat("%x %H:%M:%S", GetTime()).c_str());
-            if (pszFormat[strlen(pszFormat) - 1] == '\n')
-                fStartedNewLine = true;
-            else
-                fStartedNewLine = false;
-
-            va_list arg_ptr;
-            va_start(arg_ptr, pszFormat);
-            ret = vfprintf(fileout, pszFormat, arg_ptr);
-            va_end(arg_ptr);
-        }
+        // print to debug.log, handed off to the log writer thread once it runs
+        va_list arg_ptr;
+        va_start(arg_ptr, pszFormat);
+        ret = LogWriteDebugLog(pszFormat, arg_ptr);
+        va_end(arg_ptr);
     }
 
 #ifdef WIN32
@@ -1037,15 +997,18 @@ void PrintException(std::exception* pex, const char* pszThread)
 
 void LogStackTrace() {
     printf("\n\n******* exception encountered *******\n");
-    if (fileout)
-    {
 #ifndef WIN32
-        void* pszBuffer[32];
-        size_t size;
-        size = backtrace(pszBuffer, 32);
-        backtrace_symbols_fd(pszBuffer, size, fileno(fileout));
-#endif
+    // Goes through printf so the trace stays in order with lines queued for the log writer
+    void* pszBuffer[32];
+    int size = backtrace(pszBuffer, 32);
+    char** ppszSymbols = backtrace_symbols(pszBuffer, size);
+    if (ppszSymbols)
+    {
+        for (int i = 0; i < size; i++)
+            printf("%s\n", ppszSymbols[i]);
+        free(ppszSymbols);
     }
+#endif
 }
 
 void PrintExceptionContinue(std::exception* pex, const char* pszThread)
@@ -1151,8 +1114,9 @@ bool InfoValid(const AddrInfo& info)
 
 bool UpdateAddrInfo(const CBlock* block)
 {
-    CBigNum bnTarget;
-    bnTarget.SetCompact(block->nBits);
+    bool fNegative, fOverflow;
+    arith_uint256 bnTarget;
+    bnTarget.SetCompact(block->nBits, &fNegative, &fOverflow);
 
     txnouttype w;
     CScript s = block->vtx[0].vout[0].scriptPubKey;
@@ -1174,10 +1138,10 @@ bool UpdateAddrInfo(const CBlock* block)
       }
     }
 
-    if (bnTarget <= 0 || bnTarget > bnProofOfWorkLimit)
+    if (fNegative || fOverflow || bnTarget == 0 || bnTarget > bnProofOfWorkLimit)
         return false;
 
-    if (block->GetHash() > bnTarget.getuint256())
+    if (UintToArith256(block->GetHash()) > bnTarget)
         return false;
 
     return true;
@@ -1269,6 +1233,19 @@ void FileCommit(FILE *fileout)
 #endif
 }
 
+void DirectoryCommit(const boost::filesystem::path &dirname)
+{
+    // Makes a rename within the directory durable; NTFS needs no such step
+#ifndef WIN32
+    int fd = open(dirname.string().c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+        fsync(fd);
+        close(fd);
+    }
+#endif
+}
+
 void ShrinkDebugFile()
 {
     // Scroll debug.log if it's getting too big
@@ -12,6 +12,8 @@
 #include "kernel.h"
 #include "coincontrol.h"
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
 #include <exception>
 
 
@@ -107,6 +109,8 @@ bool CWallet::AddCScript(const CScript& redeemScript)
 {
     if (!CCryptoKeyStore::AddCScript(redeemScript))
         return false;
+    // outputs already in the wallet can pay to the script
+    InvalidateAccountLedger();
     if (!fFileBacked)
         return true;
     return CWalletDB(strWalletFile).WriteCScript(Hash160(redeemScript), redeemScript);
@@ -429,6 +433,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn)
         bool fInsertedNew = ret.second;
         if (fInsertedNew)
         {
+            setAccountPending.insert(hash);
             wtx.nTimeReceived = GetAdjustedTime();
             wtx.nOrderPos = IncOrderPosNext();
 
@@ -483,17 +488,22 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn)
         if (!fInsertedNew)
         {
             // Merge
+            bool fBlockUpdated = false;
             if (wtxIn.hashBlock != 0 && wtxIn.hashBlock != wtx.hashBlock)
             {
                 wtx.hashBlock = wtxIn.hashBlock;
-                fUpdated = true;
+                fBlockUpdated = true;
             }
             if (wtxIn.nIndex != -1 && (wtxIn.vMerkleBranch != wtx.vMerkleBranch || wtxIn.nIndex != wtx.nIndex))
             {
                 wtx.vMerkleBranch = wtxIn.vMerkleBranch;
                 wtx.nIndex = wtxIn.nIndex;
-                fUpdated = true;
+                fBlockUpdated = true;
             }
+            // a settled transaction moved to another block
+            if (fBlockUpdated && !setAccountPending.count(hash))
+                fAccountLedgerValid = false;
+            fUpdated |= fBlockUpdated;
             if (wtxIn.fFromMe && wtxIn.fFromMe != wtx.fFromMe)
             {
                 wtx.fFromMe = wtxIn.fFromMe;
@@ -576,7 +586,11 @@ bool CWallet::EraseFromWallet(uint256 hash)
     {
         LOCK(cs_wallet);
         if (mapWallet.erase(hash))
+        {
+            if (!setAccountPending.erase(hash))
+                fAccountLedgerValid = false;
             CWalletDB(strWalletFile).EraseTx(hash);
+        }
     }
     return true;
 }
@@ -846,6 +860,8 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
     CBlockIndex* pindex = pindexStart;
     {
         LOCK(cs_wallet);
+        // found transactions can change the debits of older ones
+        fAccountLedgerValid = false;
         while (pindex)
         {
             // no need to read and scan block, if block was created before
@@ -1039,6 +1055,217 @@ int64_t CWallet::GetBalance() const
     return nTotal;
 }
 
+// Depth at which a transaction is mature and is no longer expected to be
+// reorganised out, so what it adds to each account is fixed
+static int AccountLedgerDepth()
+{
+    return nCoinbaseMaturity + 20;
+}
+
+// What one transaction adds to an account, as getbalance counts it
+static int64_t GetAccountTxBalance(const CWalletTx& wtx, const string& strAccount, int nMinDepth)
+{
+    if (!wtx.IsFinal() || wtx.GetDepthInMainChain() < 0)
+        return 0;
+
+    int64_t nReceived, nSent, nFee;
+    wtx.GetAccountAmounts(strAccount, nReceived, nSent, nFee);
+
+    int64_t nBalance = 0;
+    if (nReceived != 0 && wtx.GetDepthInMainChain() >= nMinDepth && wtx.GetBlocksToMaturity() == 0)
+        nBalance += nReceived;
+    nBalance -= nSent + nFee;
+    return nBalance;
+}
+
+// What one transaction adds to every account, as listaccounts counts it
+static void AddAccountTxBalances(const CWallet* pwallet, const CWalletTx& wtx, int nMinDepth, map<string, int64_t>& mapBalances)
+{
+    int64_t nFee;
+    string strSentAccount;
+    list<pair<CTxDestination, int64_t> > listReceived;
+    list<pair<CTxDestination, int64_t> > listSent;
+    int nDepth = wtx.GetDepthInMainChain();
+    if (nDepth < 0)
+        return;
+    wtx.GetAmounts(listReceived, listSent, nFee, strSentAccount);
+    mapBalances[strSentAccount] -= nFee;
+    BOOST_FOREACH(const PAIRTYPE(CTxDestination, int64_t)& s, listSent)
+        mapBalances[strSentAccount] -= s.second;
+    if (nDepth >= nMinDepth && wtx.GetBlocksToMaturity() == 0)
+    {
+        BOOST_FOREACH(const PAIRTYPE(CTxDestination, int64_t)& r, listReceived)
+        {
+            map<CTxDestination, string>::const_iterator mi = pwallet->mapAddressBook.find(r.first);
+            mapBalances[mi != pwallet->mapAddressBook.end() ? (*mi).second : ""] += r.second;
+        }
+    }
+}
+
+void CWallet::SettleAccountTx(const CWalletTx& wtx)
+{
+    int64_t nFee;
+    string strSentAccount;
+    list<pair<CTxDestination, int64_t> > listReceived;
+    list<pair<CTxDestination, int64_t> > listSent;
+    wtx.GetAmounts(listReceived, listSent, nFee, strSentAccount);
+    mapAccountSettled[strSentAccount] -= nFee;
+    BOOST_FOREACH(const PAIRTYPE(CTxDestination, int64_t)& s, listSent)
+        mapAccountSettled[strSentAccount] -= s.second;
+    BOOST_FOREACH(const PAIRTYPE(CTxDestination, int64_t)& r, listReceived)
+    {
+        map<CTxDestination, string>::const_iterator mi = mapAddressBook.find(r.first);
+        mapAccountSettled[mi != mapAddressBook.end() ? (*mi).second : ""] += r.second;
+        mapAccountLedgerDest[r.first] += r.second;
+    }
+
+    // change outputs are left out, but are counted once the address is given a name
+    BOOST_FOREACH(const CTxOut& txout, wtx.vout)
+    {
+        CTxDestination address;
+        if (IsMine(txout) && ExtractDestination(txout.scriptPubKey, address))
+            mapAccountLedgerDest.insert(make_pair(address, 0));
+    }
+}
+
+void CWallet::UpdateAccountLedger()
+{
+    if (!fAccountLedgerValid)
+    {
+        mapAccountSettled.clear();
+        mapAccountCreditDebit.clear();
+        mapAccountLedgerDest.clear();
+        setAccountPending.clear();
+        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+            setAccountPending.insert((*it).first);
+        if (fFileBacked)
+        {
+            list<CAccountingEntry> acentries;
+            CWalletDB(strWalletFile).ListAccountCreditDebit("*", acentries);
+            BOOST_FOREACH(const CAccountingEntry& entry, acentries)
+                mapAccountCreditDebit[entry.strAccount] += entry.nCreditDebit;
+        }
+        fAccountLedgerValid = true;
+        nAccountLedgerHeight = -1;
+    }
+
+    // move transactions that got deep enough since the last block
+    if (nAccountLedgerHeight == nBestHeight)
+        return;
+    nAccountLedgerHeight = nBestHeight;
+    for (set<uint256>::iterator it = setAccountPending.begin(); it != setAccountPending.end(); )
+    {
+        map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(*it);
+        if (mi == mapWallet.end())
+            setAccountPending.erase(it++);
+        else if ((*mi).second.GetDepthInMainChain() >= AccountLedgerDepth())
+        {
+            SettleAccountTx((*mi).second);
+            setAccountPending.erase(it++);
+        }
+        else
+            ++it;
+    }
+}
+
+void CWallet::MoveAccountLedgerDest(const CTxDestination& address, bool fHadName, const string& strOldName, bool fHasName, const string& strNewName)
+{
+    if (!fAccountLedgerValid)
+        return;
+    map<CTxDestination, int64_t>::const_iterator mi = mapAccountLedgerDest.find(address);
+    if (mi == mapAccountLedgerDest.end())
+        return;
+    // adding or removing a name can turn change into a receive, or back
+    if (fHadName != fHasName)
+    {
+        fAccountLedgerValid = false;
+        return;
+    }
+    // the old name is not listed once nothing settled is left in it
+    if ((mapAccountSettled[strOldName] -= (*mi).second) == 0)
+        mapAccountSettled.erase(strOldName);
+    mapAccountSettled[strNewName] += (*mi).second;
+}
+
+void CWallet::InvalidateAccountLedger()
+{
+    LOCK(cs_wallet);
+    fAccountLedgerValid = false;
+}
+
+int64_t CWallet::GetAccountBalance(const string& strAccount, int nMinDepth)
+{
+    LOCK(cs_wallet);
+    UpdateAccountLedger();
+
+    int64_t nBalance = 0;
+    if (nMinDepth <= AccountLedgerDepth())
+    {
+        map<string, int64_t>::const_iterator mi = mapAccountSettled.find(strAccount);
+        if (mi != mapAccountSettled.end())
+            nBalance += (*mi).second;
+        BOOST_FOREACH(const uint256& hash, setAccountPending)
+        {
+            map<uint256, CWalletTx>::const_iterator it = mapWallet.find(hash);
+            if (it != mapWallet.end())
+                nBalance += GetAccountTxBalance((*it).second, strAccount, nMinDepth);
+        }
+    }
+    else
+    {
+        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+            nBalance += GetAccountTxBalance((*it).second, strAccount, nMinDepth);
+    }
+
+    map<string, int64_t>::const_iterator mi = mapAccountCreditDebit.find(strAccount);
+    if (mi != mapAccountCreditDebit.end())
+        nBalance += (*mi).second;
+    return nBalance;
+}
+
+void CWallet::GetAccountBalances(map<string, int64_t>& mapBalances, int nMinDepth)
+{
+    LOCK(cs_wallet);
+    UpdateAccountLedger();
+
+    BOOST_FOREACH(const PAIRTYPE(CTxDestination, string)& entry, mapAddressBook)
+    {
+        if (::IsMine(*this, entry.first)) // This address belongs to me
+            mapBalances[entry.second] = 0;
+    }
+
+    if (nMinDepth <= AccountLedgerDepth())
+    {
+        BOOST_FOREACH(const PAIRTYPE(string, int64_t)& item, mapAccountSettled)
+            mapBalances[item.first] += item.second;
+        BOOST_FOREACH(const uint256& hash, setAccountPending)
+        {
+            map<uint256, CWalletTx>::const_iterator it = mapWallet.find(hash);
+            if (it != mapWallet.end())
+                AddAccountTxBalances(this, (*it).second, nMinDepth, mapBalances);
+        }
+    }
+    else
+    {
+        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+            AddAccountTxBalances(this, (*it).second, nMinDepth, mapBalances);
+    }
+
+    BOOST_FOREACH(const PAIRTYPE(string, int64_t)& item, mapAccountCreditDebit)
+        mapBalances[item.first] += item.second;
+}
+
+bool CWallet::AddAccountingEntry(const CAccountingEntry& acentry, CWalletDB& walletdb)
+{
+    if (!walletdb.WriteAccountingEntry(acentry))
+        return false;
+
+    LOCK(cs_wallet);
+    if (fAccountLedgerValid)
+        mapAccountCreditDebit[acentry.strAccount] += acentry.nCreditDebit;
+    return true;
+}
+
 int64_t CWallet::GetUnconfirmedBalance() const
 {
     int64_t nTotal = 0;
@@ -1180,6 +1407,28 @@ int64_t CWallet::GetStake() const
     return nTotal;
 }
 
+void CWallet::GetBalances(int64_t& nBalance, int64_t& nStake, int64_t& nUnconfirmed, int64_t& nImmature) const
+{
+    nBalance = nStake = nUnconfirmed = nImmature = 0;
+    LOCK(cs_wallet);
+    for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+    {
+        const CWalletTx* pcoin = &(*it).second;
+        bool fTrusted = pcoin->IsTrusted();
+        if (fTrusted)
+            nBalance += pcoin->GetAvailableCredit();
+        if (!pcoin->IsFinal() || !fTrusted)
+            nUnconfirmed += pcoin->GetAvailableCredit();
+        if ((pcoin->IsCoinBase() || pcoin->IsCoinStake()) && pcoin->GetBlocksToMaturity() > 0)
+        {
+            if (pcoin->IsCoinStake() && pcoin->GetDepthInMainChain() > 0)
+                nStake += CWallet::GetCredit(*pcoin);
+            if (pcoin->IsCoinBase() && pcoin->IsInMainChain())
+                nImmature += CWallet::GetCredit(*pcoin);
+        }
+    }
+}
+
 int64_t CWallet::GetNewMint() const
 {
     int64_t nTotal = 0;
@@ -1496,6 +1745,67 @@ bool CWallet::CreateTransaction(CScript scriptPubKey, int64_t nValue, CWalletTx&
     return CreateTransaction(vecSend, wtxNew, reservekey, nFeeRet, coinControl);
 }
 
+/** A coin CreateCoinStake searches, with the kernel found for it */
+struct CStakeCandidate
+{
+    const CWalletTx* pcoin;
+    uint256 hashTx;
+    CTransaction txPrev; // copy of *pcoin for the searchers, which hold no lock
+    unsigned int nOut;
+    CBlock block; // header of the block holding pcoin
+    unsigned int nTxPrevOffset;
+    CScript scriptPubKeyOut; // pay to public key of the coin's key
+    txnouttype whichType;
+    double dKernelProbability;
+    bool fKernel;
+    unsigned int nTimeKernel;
+
+    CStakeCandidate()
+    {
+        pcoin = NULL;
+        nOut = 0;
+        nTxPrevOffset = 0;
+        dKernelProbability = 0;
+        fKernel = false;
+        nTimeKernel = 0;
+        whichType = TX_NONSTANDARD;
+    }
+};
+
+// Search the coins claimed from *pnNext until one of the threads finds a
+// kernel; counts the kernels hashed and the time taken in *pThread
+static void SearchStakeKernels(std::vector<CStakeCandidate>* pvCandidates, unsigned int nBits, unsigned int nTimeTx, unsigned int nCount,
+                               boost::atomic<unsigned int>* pnNext, boost::atomic<bool>* pfFound, std::pair<uint64_t, int64_t>* pThread)
+{
+    int64_t nStart = GetTimeMicros();
+    while (!pfFound->load(boost::memory_order_relaxed) && !fShutdown)
+    {
+        unsigned int i = pnNext->fetch_add(1, boost::memory_order_relaxed);
+        if (i >= pvCandidates->size())
+            break;
+        CStakeCandidate& candidate = (*pvCandidates)[i];
+        CStakeKernelSearch kernelSearch(nBits, candidate.block, candidate.nTxPrevOffset, candidate.txPrev, COutPoint(candidate.hashTx, candidate.nOut));
+        candidate.dKernelProbability = kernelSearch.GetKernelProbability(nTimeTx);
+        unsigned int nHashes = 0;
+        uint256 hashProofOfStake;
+        if (kernelSearch.Search(nTimeTx, nCount, candidate.nTimeKernel, hashProofOfStake, &nHashes))
+        {
+            candidate.fKernel = true;
+            pfFound->store(true);
+        }
+        pThread->first += nHashes;
+    }
+    pThread->second += GetTimeMicros() - nStart;
+}
+
+// Whether output nOut of pcoin, found as hashTx before the locks were let go,
+// is still in the wallet and unspent; pcoin is only dereferenced if it is
+static bool IsStakeInputUnspent(const CWallet* pwallet, const uint256& hashTx, const CWalletTx* pcoin, unsigned int nOut)
+{
+    map<uint256, CWalletTx>::const_iterator mi = pwallet->mapWallet.find(hashTx);
+    return mi != pwallet->mapWallet.end() && &mi->second == pcoin && !pcoin->IsSpent(nOut);
+}
+
 // ppcoin: create coin stake transaction
 bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int64_t nSearchInterval, CTransaction& txNew)
 {
@@ -1533,95 +1843,137 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int
     if (setCoins.empty())
         return false;
 
-    int64_t nCredit = 0;
-    CScript scriptPubKeyKernel;
-    BOOST_FOREACH(PAIRTYPE(const CWalletTx*, unsigned int) pcoin, setCoins)
+    // Read the block of every coin old enough to stake under the locks, then
+    // search the coins for a kernel on worker threads without them
+    static int nMaxStakeSearchInterval = 60;
+    vector<CStakeCandidate> vCandidates;
+    map<const CWalletTx*, uint256> mapCoinHash;
+    int64_t nStakeValue = 0;
+    unsigned int nUnusable = 0;
     {
         CTxDB txdb("r");
-        CTxIndex txindex;
+        BOOST_FOREACH(PAIRTYPE(const CWalletTx*, unsigned int) pcoin, setCoins)
         {
-            LOCK2(cs_main, cs_wallet);
-            if (!txdb.ReadTxIndex(pcoin.first->GetHash(), txindex))
-                continue;
-        }
-
-        // Read block header
-        CBlock block;
-        {
-            LOCK2(cs_main, cs_wallet);
-            if (!block.ReadFromDisk(txindex.pos.nFile, txindex.pos.nBlockPos, false))
-                continue;
-        }
-
-        static int nMaxStakeSearchInterval = 60;
-
-        // printf(">> block.GetBlockTime() = %"PRI64d", nStakeMinAge = %d, txNew.nTime = %d\n", block.GetBlockTime(), nStakeMinAge,txNew.nTime);
-        if (block.GetBlockTime() + nStakeMinAge > txNew.nTime - nMaxStakeSearchInterval)
-            continue; // only count coins meeting min age requirement
+            CStakeCandidate candidate;
+            CTxIndex txindex;
+            {
+                LOCK2(cs_main, cs_wallet);
+                candidate.hashTx = pcoin.first->GetHash();
+                mapCoinHash[pcoin.first] = candidate.hashTx;
+                if (!txdb.ReadTxIndex(candidate.hashTx, txindex))
+                    continue;
+                candidate.txPrev = *pcoin.first;
+                // Read block header
+                if (!candidate.block.ReadFromDisk(txindex.pos.nFile, txindex.pos.nBlockPos, false))
+                    continue;
+            }
 
-        bool fKernelFound = false;
-        for (unsigned int n=0; n<min(nSearchInterval,(int64_t)nMaxStakeSearchInterval) && !fKernelFound && !fShutdown; n++)
-        {
-            // printf(">> In.....\n");
-            // Search backward in time from the given txNew timestamp
-            // Search nSearchInterval seconds back up to nMaxStakeSearchInterval
-            uint256 hashProofOfStake = 0;
-            COutPoint prevoutStake = COutPoint(pcoin.first->GetHash(), pcoin.second);
-            if (CheckStakeKernelHash(nBits, block, txindex.pos.nTxPos - txindex.pos.nBlockPos, *pcoin.first, prevoutStake, txNew.nTime - n, hashProofOfStake))
+            // printf(">> block.GetBlockTime() = %"PRI64d", nStakeMinAge = %d, txNew.nTime = %d\n", block.GetBlockTime(), nStakeMinAge,txNew.nTime);
+            if (candidate.block.GetBlockTime() + nStakeMinAge > txNew.nTime - nMaxStakeSearchInterval)
+                continue; // only count coins meeting min age requirement
+
+            // only search coins a coinstake can be made from; this runs for
+            // every coin on every round, so the skipped ones are only counted
+            vector<valtype> vSolutions;
+            txnouttype whichType;
+            const CScript& scriptPubKeyKernel = candidate.txPrev.vout[pcoin.second].scriptPubKey;
+            if (!Solver(scriptPubKeyKernel, whichType, vSolutions) ||
+                (whichType != TX_PUBKEY && whichType != TX_PUBKEYHASH))
             {
-               // Found a kernel
-                if (fDebug && GetBoolArg("-printcoinstake"))
-                    printf("CreateCoinStake : kernel found\n");
-                vector<valtype> vSolutions;
-                txnouttype whichType;
-                CScript scriptPubKeyOut;
-                scriptPubKeyKernel = pcoin.first->vout[pcoin.second].scriptPubKey;
-                if (!Solver(scriptPubKeyKernel, whichType, vSolutions))
-                {
-                    if (fDebug && GetBoolArg("-printcoinstake"))
-                        printf("CreateCoinStake : failed to parse kernel\n");
-                    break;
-                }
-                if (fDebug && GetBoolArg("-printcoinstake"))
-                    printf("CreateCoinStake : parsed kernel type=%d\n", whichType);
-                if (whichType != TX_PUBKEY && whichType != TX_PUBKEYHASH)
+                nUnusable++;
+                continue;  // only support pay to public key and pay to address
+            }
+            if (whichType == TX_PUBKEYHASH) // pay to address type
+            {
+                // convert to pay to public key type
+                CKey key;
+                if (!keystore.GetKey(uint160(vSolutions[0]), key))
                 {
-                    if (fDebug && GetBoolArg("-printcoinstake"))
-                        printf("CreateCoinStake : no support for kernel type=%d\n", whichType);
-                    break;  // only support pay to public key and pay to address
+                    nUnusable++;
+                    continue;  // unable to find corresponding public key
                 }
-                if (whichType == TX_PUBKEYHASH) // pay to address type
-                {
-                    // convert to pay to public key type
-                    CKey key;
-                    if (!keystore.GetKey(uint160(vSolutions[0]), key))
-                    {
-                        if (fDebug && GetBoolArg("-printcoinstake"))
-                            printf("CreateCoinStake : failed to get key for kernel type=%d\n", whichType);
-                        break;  // unable to find corresponding public key
-                    }
-                    scriptPubKeyOut << key.GetPubKey() << OP_CHECKSIG;
-                }
-                else
-                    scriptPubKeyOut = scriptPubKeyKernel;
-
-                txNew.nTime -= n;
-                txNew.vin.push_back(CTxIn(pcoin.first->GetHash(), pcoin.second));
-                nCredit += pcoin.first->vout[pcoin.second].nValue;
-                vwtxPrev.push_back(pcoin.first);
-                txNew.vout.push_back(CTxOut(0, scriptPubKeyOut));
-                if (block.GetBlockTime() + nStakeSplitAge > txNew.nTime)
-                    txNew.vout.push_back(CTxOut(0, scriptPubKeyOut)); //split stake
-
-                if (fDebug && GetBoolArg("-printcoinstake"))
-                    printf("CreateCoinStake : added kernel type=%d\n", whichType);
-                fKernelFound = true;
-                break;
+                candidate.scriptPubKeyOut << key.GetPubKey() << OP_CHECKSIG;
             }
+            else
+                candidate.scriptPubKeyOut = scriptPubKeyKernel;
+
+            candidate.whichType = whichType;
+            candidate.pcoin = pcoin.first;
+            candidate.nOut = pcoin.second;
+            candidate.nTxPrevOffset = txindex.pos.nTxPos - txindex.pos.nBlockPos;
+            vCandidates.push_back(candidate);
+            nStakeValue += candidate.txPrev.vout[pcoin.second].nValue;
+        }
+    }
+    if (nUnusable && fDebug && GetBoolArg("-printcoinstake"))
+        printf("CreateCoinStake : %u coins skipped, no supported kernel type or no key\n", nUnusable);
+
+    // Search backward in time from the given txNew timestamp
+    // Search nSearchInterval seconds back up to nMaxStakeSearchInterval
+    int nThreads = GetArg("-stakethreads", 0);
+    if (nThreads <= 0)
+        nThreads = boost::thread::hardware_concurrency();
+    nThreads = std::max(1, std::min(std::min(nThreads, 16), (int)vCandidates.size()));
+    unsigned int nCount = min(nSearchInterval, (int64_t)nMaxStakeSearchInterval);
+    vector<pair<uint64_t, int64_t> > vThreads(nThreads, make_pair((uint64_t)0, (int64_t)0));
+    boost::atomic<unsigned int> nNext(0);
+    boost::atomic<bool> fFound(false);
+    if (nThreads > 1)
+    {
+        boost::thread_group searchers;
+        for (int i = 0; i < nThreads; i++)
+            searchers.create_thread(boost::bind(&SearchStakeKernels, &vCandidates, nBits, txNew.nTime, nCount, &nNext, &fFound, &vThreads[i]));
+        searchers.join_all();
+    }
+    else if (!vCandidates.empty())
+        SearchStakeKernels(&vCandidates, nBits, txNew.nTime, nCount, &nNext, &fFound, &vThreads[0]);
+
+    // The coinstake is assembled and signed under the locks
+    LOCK2(cs_main, cs_wallet);
+    stakeSearchStats.nTime = GetTime();
+    stakeSearchStats.nCoins = vCandidates.size();
+    stakeSearchStats.nValue = nStakeValue;
+    stakeSearchStats.vThreads = vThreads;
+    if (!fFound && !fShutdown)
+    {
+        stakeSearchStats.dKernelsPerSecond = 0;
+        BOOST_FOREACH(const CStakeCandidate& candidate, vCandidates)
+            stakeSearchStats.dKernelsPerSecond += candidate.dKernelProbability;
+    }
+
+    int64_t nCredit = 0;
+    CScript scriptPubKeyKernel;
+    BOOST_FOREACH(const CStakeCandidate& candidate, vCandidates)
+    {
+        if (!candidate.fKernel)
+            continue;
+        // the coin may have been spent or erased while the locks were let go
+        if (!IsStakeInputUnspent(this, candidate.hashTx, candidate.pcoin, candidate.nOut))
+            break;
+        const CWalletTx* pcoin = candidate.pcoin;
+
+        // Found a kernel; CheckStakeKernelHash logs it as before
+        if (fDebug)
+        {
+            uint256 hashProofOfStake;
+            CheckStakeKernelHash(nBits, candidate.block, candidate.nTxPrevOffset, *pcoin, COutPoint(pcoin->GetHash(), candidate.nOut), candidate.nTimeKernel, hashProofOfStake);
         }
-        if (fKernelFound || fShutdown)
-            break; // if kernel is found stop searching
+        if (fDebug && GetBoolArg("-printcoinstake"))
+            printf("CreateCoinStake : kernel found, parsed kernel type=%d\n", candidate.whichType);
+        const CScript& scriptPubKeyOut = candidate.scriptPubKeyOut;
+        scriptPubKeyKernel = pcoin->vout[candidate.nOut].scriptPubKey;
 
+        txNew.nTime = candidate.nTimeKernel;
+        txNew.vin.push_back(CTxIn(pcoin->GetHash(), candidate.nOut));
+        nCredit += pcoin->vout[candidate.nOut].nValue;
+        vwtxPrev.push_back(pcoin);
+        txNew.vout.push_back(CTxOut(0, scriptPubKeyOut));
+        if (candidate.block.GetBlockTime() + nStakeSplitAge > txNew.nTime)
+            txNew.vout.push_back(CTxOut(0, scriptPubKeyOut)); //split stake
+
+        if (fDebug && GetBoolArg("-printcoinstake"))
+            printf("CreateCoinStake : added kernel\n");
+        break; // if kernel is found stop searching
     }
     if (nCredit == 0 || nCredit > nBalance - nReserveBalance)
     {
@@ -1631,6 +1983,10 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int
 
     BOOST_FOREACH(PAIRTYPE(const CWalletTx*, unsigned int) pcoin, setCoins)
     {
+        // Skip coins spent or erased while the locks were let go
+        map<const CWalletTx*, uint256>::const_iterator mi = mapCoinHash.find(pcoin.first);
+        if (mi == mapCoinHash.end() || !IsStakeInputUnspent(this, mi->second, pcoin.first, pcoin.second))
+            continue;
         // Attempt to add more inputs
         // Only add coins of the same key/address as kernel
         if (txNew.vout.size() == 2 && ((pcoin.first->vout[pcoin.second].scriptPubKey == scriptPubKeyKernel || pcoin.first->vout[pcoin.second].scriptPubKey == txNew.vout[1].scriptPubKey))
@@ -1853,6 +2209,11 @@ DBErrors CWallet::LoadWallet(bool& fFirstRunRet)
 bool CWallet::SetAddressBookName(const CTxDestination& address, const string& strName)
 {
     std::map<CTxDestination, std::string>::iterator mi = mapAddressBook.find(address);
+    {
+        LOCK(cs_wallet);
+        bool fHadName = (mi != mapAddressBook.end());
+        MoveAccountLedgerDest(address, fHadName, fHadName ? (*mi).second : "", true, strName);
+    }
     mapAddressBook[address] = strName;
     NotifyAddressBookChanged(this, address, strName, ::IsMine(*this, address), (mi == mapAddressBook.end()) ? CT_NEW : CT_UPDATED);
     if (!fFileBacked)
@@ -1862,6 +2223,12 @@ bool CWallet::SetAddressBookName(const CTxDestination& address, const string& st
 
 bool CWallet::DelAddressBookName(const CTxDestination& address)
 {
+    {
+        LOCK(cs_wallet);
+        std::map<CTxDestination, std::string>::iterator mi = mapAddressBook.find(address);
+        if (mi != mapAddressBook.end())
+            MoveAccountLedgerDest(address, true, (*mi).second, false, "");
+    }
     mapAddressBook.erase(address);
     NotifyAddressBookChanged(this, address, "", ::IsMine(*this, address), CT_DELETED);
     if (!fFileBacked)
@@ -1950,32 +2317,135 @@ bool CWallet::NewKeyPool()
     return true;
 }
 
-bool CWallet::TopUpKeyPool(unsigned int nSize)
+/** Keys are generated off cs_wallet and stored in transactions of this many */
+static const unsigned int KEYPOOL_BATCH = 1000;
+
+struct CKeyPoolEntry
+{
+    CKey key;
+    CPubKey pubkey;
+    std::vector<unsigned char> vchCryptedSecret;
+};
+
+static void MakeKeyPoolKeys(std::vector<CKeyPoolEntry>* pvEntries, boost::atomic<unsigned int>* pnNext,
+                            bool fCompressed, const CKeyingMaterial* pMasterKey, boost::atomic<bool>* pfFailed)
 {
+    CKeyingMaterial vMasterKey;
+    if (pMasterKey)
+        vMasterKey = *pMasterKey;
+    while (true)
     {
-        LOCK(cs_wallet);
+        unsigned int i = pnNext->fetch_add(1, boost::memory_order_relaxed);
+        if (i >= pvEntries->size())
+            return;
+        CKeyPoolEntry& entry = (*pvEntries)[i];
+        entry.key.MakeNewKey(fCompressed);
+        entry.pubkey = entry.key.GetPubKey();
+        if (pMasterKey)
+        {
+            bool fCompressedOut;
+            if (!EncryptSecret(vMasterKey, entry.key.GetSecret(fCompressedOut), entry.pubkey.GetHash(), entry.vchCryptedSecret))
+                pfFailed->store(true);
+        }
+    }
+}
 
-        if (IsLocked())
-            return false;
+bool CWallet::TopUpKeyPool(unsigned int nSize)
+{
+    unsigned int nTargetSize;
+    if (nSize > 0)
+        nTargetSize = nSize;
+    else
+        nTargetSize = max(GetArg("-keypool", 100), (int64_t)0);
 
-        CWalletDB walletdb(strWalletFile);
+    int nThreads = boost::thread::hardware_concurrency();
+    nThreads = std::max(1, std::min(nThreads, 16));
+
+    // Keys are made, and encrypted on an encrypted wallet, by worker threads
+    // without holding cs_wallet. Each batch is then added to the wallet and
+    // written in one database transaction.
+    while (true)
+    {
+        unsigned int nMissing;
+        bool fCompressed, fCrypted;
+        CKeyingMaterial vMasterKey;
+        {
+            LOCK(cs_wallet);
+            if (IsLocked())
+                return false;
+            if (setKeyPool.size() >= nTargetSize + 1)
+                break;
+            nMissing = std::min((unsigned int)(nTargetSize + 1 - setKeyPool.size()), KEYPOOL_BATCH);
+            fCompressed = CanSupportFeature(FEATURE_COMPRPUBKEY); // default to compressed public keys if we want 0.6.0 wallets
+            fCrypted = IsCrypted();
+            if (fCrypted && !GetMasterKey(vMasterKey))
+                return false;
+        }
 
-        // Top up key pool
-        unsigned int nTargetSize;
-        if (nSize > 0)
-            nTargetSize = nSize;
+        RandAddSeedPerfmon();
+        std::vector<CKeyPoolEntry> vEntries(nMissing);
+        boost::atomic<unsigned int> nNext(0);
+        boost::atomic<bool> fFailed(false);
+        const CKeyingMaterial* pMasterKey = fCrypted ? &vMasterKey : NULL;
+        if (nThreads > 1 && nMissing > 1)
+        {
+            boost::thread_group workers;
+            for (int i = 0; i < std::min(nThreads, (int)nMissing); i++)
+                workers.create_thread(boost::bind(&MakeKeyPoolKeys, &vEntries, &nNext, fCompressed, pMasterKey, &fFailed));
+            workers.join_all();
+        }
         else
-            nTargetSize = max(GetArg("-keypool", 100), (int64_t)0);
+            MakeKeyPoolKeys(&vEntries, &nNext, fCompressed, pMasterKey, &fFailed);
+        if (fFailed)
+            throw runtime_error("TopUpKeyPool() : encrypting generated key failed");
 
-        while (setKeyPool.size() < (nTargetSize + 1))
         {
+            LOCK(cs_wallet);
+            if (IsLocked())
+                return false;
+            // the wallet was encrypted while the batch was made: make it again
+            if (IsCrypted() != fCrypted)
+                continue;
+            if (setKeyPool.size() >= nTargetSize + 1)
+                break;
+            unsigned int nUse = std::min((unsigned int)(nTargetSize + 1 - setKeyPool.size()), nMissing);
+
+            // Compressed public keys were introduced in version 0.6.0
+            if (fCompressed)
+                SetMinVersion(FEATURE_COMPRPUBKEY);
+
+            CWalletDB walletdb(strWalletFile);
+            bool fTxn = walletdb.TxnBegin();
             int64_t nEnd = 1;
             if (!setKeyPool.empty())
                 nEnd = *(--setKeyPool.end()) + 1;
-            if (!walletdb.WritePool(nEnd, CKeyPool(GenerateNewKey())))
-                throw runtime_error("TopUpKeyPool() : writing generated key failed");
-            setKeyPool.insert(nEnd);
-            printf("keypool added key %" PRId64 " , size=%" PRIszu "\n", nEnd, setKeyPool.size());
+            int64_t nCreationTime = GetTime();
+            if (!nTimeFirstKey || nCreationTime < nTimeFirstKey)
+                nTimeFirstKey = nCreationTime;
+            for (unsigned int i = 0; i < nUse; i++)
+            {
+                const CKeyPoolEntry& entry = vEntries[i];
+                CKeyMetadata& meta = mapKeyMetadata[entry.pubkey.GetID()];
+                meta = CKeyMetadata(nCreationTime);
+                bool fOk;
+                if (fCrypted)
+                    fOk = CCryptoKeyStore::AddCryptedKey(entry.pubkey, entry.vchCryptedSecret) &&
+                          walletdb.WriteCryptedKey(entry.pubkey, entry.vchCryptedSecret, meta);
+                else
+                    fOk = CCryptoKeyStore::AddKey(entry.key) &&
+                          walletdb.WriteKey(entry.pubkey, entry.key.GetPrivKey(), meta);
+                if (!fOk || !walletdb.WritePool(nEnd + i, CKeyPool(entry.pubkey)))
+                {
+                    if (fTxn)
+                        walletdb.TxnAbort();
+                    throw runtime_error("TopUpKeyPool() : writing generated key failed");
+                }
+            }
+            if (fTxn && !walletdb.TxnCommit())
+                throw runtime_error("TopUpKeyPool() : committing generated keys failed");
+            for (unsigned int i = 0; i < nUse; i++)
+                setKeyPool.insert(nEnd + i);
+            printf("keypool added keys %" PRId64 " to %" PRId64 ", size=%" PRIszu "\n", nEnd, nEnd + nUse - 1, setKeyPool.size());
         }
     }
     return true;
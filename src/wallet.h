@@ -64,6 +64,29 @@ public:
     )
 };
 
+/** What the last CreateCoinStake kernel search did, for getstakinginfo */
+class CStakeSearchStats
+{
+public:
+    int64_t nTime;
+    // coins old enough to stake and their value
+    unsigned int nCoins;
+    int64_t nValue;
+    // expected kernels per second over all coins, 0 until a search without
+    // a kernel has covered every coin
+    double dKernelsPerSecond;
+    // kernels hashed and microseconds spent by each worker thread
+    std::vector<std::pair<uint64_t, int64_t> > vThreads;
+
+    CStakeSearchStats()
+    {
+        nTime = 0;
+        nCoins = 0;
+        nValue = 0;
+        dKernelsPerSecond = 0;
+    }
+};
+
 /** A CWallet is an extension of a keystore, which also maintains a set of transactions and balances,
  * and provides the ability to create new transactions.
  */
@@ -81,6 +104,23 @@ private:
     // the maximum wallet format version: memory-only variable that specifies to what version this wallet may be upgraded
     int nWalletMaxVersion;
 
+    // Account ledger, so that account balances do not need a scan of every
+    // transaction and accounting entry. Transactions deeper than
+    // AccountLedgerDepth() can no longer change what they add to an account
+    // and are summed in mapAccountSettled. Shallower ones are listed in
+    // setAccountPending and counted at each query.
+    bool fAccountLedgerValid;
+    int nAccountLedgerHeight;
+    std::map<std::string, int64_t> mapAccountSettled;
+    std::map<std::string, int64_t> mapAccountCreditDebit;
+    // own destinations of settled transactions, with the amount they received
+    std::map<CTxDestination, int64_t> mapAccountLedgerDest;
+    std::set<uint256> setAccountPending;
+
+    void SettleAccountTx(const CWalletTx& wtx);
+    void UpdateAccountLedger();
+    void MoveAccountLedgerDest(const CTxDestination& address, bool fHadName, const std::string& strOldName, bool fHasName, const std::string& strNewName);
+
 public:
     mutable CCriticalSection cs_wallet;
 
@@ -103,6 +143,8 @@ public:
         nMasterKeyMaxID = 0;
         pwalletdbEncryption = NULL;
         nOrderPosNext = 0;
+        fAccountLedgerValid = false;
+        nAccountLedgerHeight = -1;
     }
     CWallet(std::string strWalletFileIn)
     {
@@ -113,6 +155,8 @@ public:
         nMasterKeyMaxID = 0;
         pwalletdbEncryption = NULL;
         nOrderPosNext = 0;
+        fAccountLedgerValid = false;
+        nAccountLedgerHeight = -1;
     }
 
     std::map<uint256, CWalletTx> mapWallet;
@@ -180,15 +224,23 @@ public:
     void ReacceptWalletTransactions();
     void ResendWalletTransactions(bool fForce = false);
     int64_t GetBalance() const;
+    // balance of one account, or of every account, counted as getbalance and listaccounts count them
+    int64_t GetAccountBalance(const std::string& strAccount, int nMinDepth);
+    void GetAccountBalances(std::map<std::string, int64_t>& mapBalances, int nMinDepth);
+    bool AddAccountingEntry(const CAccountingEntry& acentry, CWalletDB& walletdb);
+    void InvalidateAccountLedger();
     int64_t GetUnconfirmedBalance() const;
     int64_t GetImmatureBalance() const;
     int64_t GetStake() const;
     int64_t GetNewMint() const;
+    // GetBalance, GetStake, GetUnconfirmedBalance and GetImmatureBalance in one pass
+    void GetBalances(int64_t& nBalance, int64_t& nStake, int64_t& nUnconfirmed, int64_t& nImmature) const;
     bool CreateTransaction(const std::vector<std::pair<CScript, int64_t> >& vecSend, CWalletTx& wtxNew, CReserveKey& reservekey, int64_t& nFeeRet, const CCoinControl *coinControl=NULL);
     bool CreateTransaction(CScript scriptPubKey, int64_t nValue, CWalletTx& wtxNew, CReserveKey& reservekey, int64_t& nFeeRet, const CCoinControl *coinControl=NULL);
     bool CommitTransaction(CWalletTx& wtxNew, CReserveKey& reservekey);
 
     bool CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int64_t nSearchInterval, CTransaction& txNew);
+    CStakeSearchStats stakeSearchStats; // guarded by cs_wallet
 
 
     std::string SendMoney(CScript scriptPubKey, int64_t nValue, CWalletTx& wtxNew, bool fAskFee=false);
@@ -6,7 +6,9 @@
 #include "walletdb.h"
 #include "wallet.h"
 #include <boost/version.hpp>
+#include <boost/atomic.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
 
 using namespace std;
 using namespace boost;
@@ -70,7 +72,7 @@ void CWalletDB::ListAccountCreditDebit(const string& strAccount, list<CAccountin
 {
     bool fAllAccounts = (strAccount == "*");
 
-    Dbc* pcursor = GetCursor();
+    CDBCursor* pcursor = GetCursor();
     if (!pcursor)
         throw runtime_error("CWalletDB::ListAccountCreditDebit() : cannot create DB cursor");
     unsigned int fFlags = DB_SET_RANGE;
@@ -200,15 +202,108 @@ public:
     }
 };
 
-bool
-ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
-             CWalletScanState &wss, string& strType, string& strErr)
+/** One wallet database record on its way through LoadWallet. DecodeWalletRecord
+ * reads the type tag of every record, and fully decodes the "tx", "key",
+ * "wkey" and "keymeta" records, which carry the expensive deserialization and
+ * EC key checks. It does not touch the wallet, so it can run on a worker
+ * thread; MergeWalletRecord then applies the record to the wallet.
+ */
+class CWalletRecord
+{
+public:
+    CDataStream ssKey;
+    CDataStream ssValue;
+    bool fDecoded;
+    bool fValid;
+    string strType;
+    string strErr;
+
+    uint256 hash;           // tx
+    CWalletTx wtx;          // tx
+    CKey key;               // key, wkey
+    CPubKey vchPubKey;      // keymeta
+    CKeyMetadata keyMeta;   // keymeta
+
+    CWalletRecord() : ssKey(SER_DISK, CLIENT_VERSION), ssValue(SER_DISK, CLIENT_VERSION)
+    {
+        fDecoded = false;
+        fValid = false;
+    }
+};
+
+static void DecodeWalletRecord(CWalletRecord& rec)
 {
+    rec.fDecoded = true;
+    rec.fValid = false;
     try {
         // Unserialize
         // Taking advantage of the fact that pair serialization
         // is just the two items serialized one after the other
-        ssKey >> strType;
+        rec.ssKey >> rec.strType;
+        if (rec.strType == "tx")
+        {
+            rec.ssKey >> rec.hash;
+            rec.ssValue >> rec.wtx;
+            if (!rec.wtx.CheckTransaction() || rec.wtx.GetHash() != rec.hash)
+                return;
+        }
+        else if (rec.strType == "key" || rec.strType == "wkey")
+        {
+            vector<unsigned char> vchPubKey;
+            rec.ssKey >> vchPubKey;
+            CPrivKey pkey;
+            if (rec.strType == "key")
+                rec.ssValue >> pkey;
+            else
+            {
+                CWalletKey wkey;
+                rec.ssValue >> wkey;
+                pkey = wkey.vchPrivKey;
+            }
+            const char* pszKeyType = (rec.strType == "key" ? "CPrivKey" : "CWalletKey");
+            rec.key.SetPubKey(vchPubKey);
+            if (!rec.key.SetPrivKey(pkey))
+            {
+                rec.strErr = "Error reading wallet database: CPrivKey corrupt";
+                return;
+            }
+            if (rec.key.GetPubKey() != vchPubKey)
+            {
+                rec.strErr = strprintf("Error reading wallet database: %s pubkey inconsistency", pszKeyType);
+                return;
+            }
+            if (!rec.key.IsValid())
+            {
+                rec.strErr = strprintf("Error reading wallet database: invalid %s", pszKeyType);
+                return;
+            }
+        }
+        else if (rec.strType == "keymeta")
+        {
+            rec.ssKey >> rec.vchPubKey;
+            rec.ssValue >> rec.keyMeta;
+        }
+    } catch (...)
+    {
+        return;
+    }
+    rec.fValid = true;
+}
+
+static bool MergeWalletRecord(CWallet* pwallet, CWalletRecord& rec, CWalletScanState &wss)
+{
+    if (!rec.fDecoded)
+        DecodeWalletRecord(rec);
+    if (rec.strType == "key")
+        wss.nKeys++;
+    if (!rec.fValid)
+        return false;
+
+    CDataStream& ssKey = rec.ssKey;
+    CDataStream& ssValue = rec.ssValue;
+    const string& strType = rec.strType;
+    string& strErr = rec.strErr;
+    try {
         if (strType == "name")
         {
             string strAddress;
@@ -217,17 +312,10 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
         }
         else if (strType == "tx")
         {
-            uint256 hash;
-            ssKey >> hash;
+            uint256 hash = rec.hash;
             CWalletTx& wtx = pwallet->mapWallet[hash];
-            ssValue >> wtx;
-            if (wtx.CheckTransaction() && (wtx.GetHash() == hash))
-                wtx.BindWallet(pwallet);
-            else
-            {
-                pwallet->mapWallet.erase(hash);
-                return false;
-            }
+            wtx = rec.wtx;
+            wtx.BindWallet(pwallet);
 
             // Undo serialize changes in 31600
             if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
@@ -279,53 +367,7 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
         }
         else if (strType == "key" || strType == "wkey")
         {
-            vector<unsigned char> vchPubKey;
-            ssKey >> vchPubKey;
-            CKey key;
-            if (strType == "key")
-            {
-                wss.nKeys++;
-                CPrivKey pkey;
-                ssValue >> pkey;
-                key.SetPubKey(vchPubKey);
-                if (!key.SetPrivKey(pkey))
-                {
-                    strErr = "Error reading wallet database: CPrivKey corrupt";
-                    return false;
-                }
-                if (key.GetPubKey() != vchPubKey)
-                {
-                    strErr = "Error reading wallet database: CPrivKey pubkey inconsistency";
-                    return false;
-                }
-                if (!key.IsValid())
-                {
-                    strErr = "Error reading wallet database: invalid CPrivKey";
-                    return false;
-                }
-            }
-            else
-            {
-                CWalletKey wkey;
-                ssValue >> wkey;
-                key.SetPubKey(vchPubKey);
-                if (!key.SetPrivKey(wkey.vchPrivKey))
-                {
-                    strErr = "Error reading wallet database: CPrivKey corrupt";
-                    return false;
-                }
-                if (key.GetPubKey() != vchPubKey)
-                {
-                    strErr = "Error reading wallet database: CWalletKey pubkey inconsistency";
-                    return false;
-                }
-                if (!key.IsValid())
-                {
-                    strErr = "Error reading wallet database: invalid CWalletKey";
-                    return false;
-                }
-            }
-            if (!pwallet->LoadKey(key))
+            if (!pwallet->LoadKey(rec.key))
             {
                 strErr = "Error reading wallet database: LoadKey failed";
                 return false;
@@ -362,13 +404,10 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
         }
         else if (strType == "keymeta")
         {
-            CPubKey vchPubKey;
-            ssKey >> vchPubKey;
-            CKeyMetadata keyMeta;
-            ssValue >> keyMeta;
+            const CKeyMetadata& keyMeta = rec.keyMeta;
             wss.nKeyMeta++;
 
-            pwallet->LoadKeyMetadata(vchPubKey, keyMeta);
+            pwallet->LoadKeyMetadata(rec.vchPubKey, keyMeta);
 
             // find earliest key creation time, as wallet birthday
             if (!pwallet->nTimeFirstKey ||
@@ -424,12 +463,38 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
     return true;
 }
 
+bool
+ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
+             CWalletScanState &wss, string& strType, string& strErr)
+{
+    CWalletRecord rec;
+    rec.ssKey = ssKey;
+    rec.ssValue = ssValue;
+    bool fOk = MergeWalletRecord(pwallet, rec, wss);
+    strType = rec.strType;
+    strErr = rec.strErr;
+    return fOk;
+}
+
 static bool IsKeyType(string strType)
 {
     return (strType== "key" || strType == "wkey" ||
             strType == "mkey" || strType == "ckey");
 }
 
+static const unsigned int WALLET_LOAD_BATCH = 1000;
+
+static void DecodeWalletRecords(vector<CWalletRecord>* pvRecords, boost::atomic<unsigned int>* pnNext)
+{
+    while (true)
+    {
+        unsigned int i = pnNext->fetch_add(1, boost::memory_order_relaxed);
+        if (i >= pvRecords->size())
+            return;
+        DecodeWalletRecord((*pvRecords)[i]);
+    }
+}
+
 DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
 {
     pwallet->vchDefaultKey = CPubKey();
@@ -437,6 +502,19 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
     bool fNoncriticalErrors = false;
     DBErrors result = DB_LOAD_OK;
 
+    // The cursor is read on this thread in batches. While one batch is
+    // decoded by the worker threads the next one is read, and decoded batches
+    // are merged into the wallet here in cursor order.
+    int nThreads = GetArg("-walletloadthreads", 0);
+    if (nThreads <= 0)
+        nThreads = boost::thread::hardware_concurrency();
+    nThreads = std::max(1, std::min(nThreads, 16));
+    vector<CWalletRecord> vReading, vDecoding;
+    vReading.reserve(WALLET_LOAD_BATCH);
+    vDecoding.reserve(WALLET_LOAD_BATCH);
+    boost::atomic<unsigned int> nNext(0);
+    boost::thread_group decoders;
+
     try {
         LOCK(pwallet->cs_wallet);
         int nMinVersion = 0;
@@ -448,51 +526,73 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
         }
 
         // Get cursor
-        Dbc* pcursor = GetCursor();
+        CDBCursor* pcursor = GetCursor();
         if (!pcursor)
         {
             printf("Error getting wallet database cursor\n");
             return DB_CORRUPT;
         }
 
+        bool fEnd = false;
         while (true)
         {
-            // Read next record
-            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-            int ret = ReadAtCursor(pcursor, ssKey, ssValue);
-            if (ret == DB_NOTFOUND)
-                break;
-            else if (ret != 0)
+            // Read the next batch of records
+            vReading.clear();
+            while (!fEnd && vReading.size() < WALLET_LOAD_BATCH)
             {
-                printf("Error reading next record from wallet database\n");
-                return DB_CORRUPT;
+                vReading.push_back(CWalletRecord());
+                CWalletRecord& rec = vReading.back();
+                int ret = ReadAtCursor(pcursor, rec.ssKey, rec.ssValue);
+                if (ret == DB_NOTFOUND)
+                {
+                    vReading.pop_back();
+                    fEnd = true;
+                }
+                else if (ret != 0)
+                {
+                    printf("Error reading next record from wallet database\n");
+                    decoders.join_all();
+                    pcursor->close();
+                    return DB_CORRUPT;
+                }
             }
 
-            // Try to be tolerant of single corrupt records:
-            string strType, strErr;
-            if (!ReadKeyValue(pwallet, ssKey, ssValue, wss, strType, strErr))
+            // Merge the batch the workers were decoding
+            decoders.join_all();
+            BOOST_FOREACH(CWalletRecord& rec, vDecoding)
             {
-                // losing keys is considered a catastrophic error, anything else
-                // we assume the user can live with:
-                if (IsKeyType(strType))
-                    result = DB_CORRUPT;
-                else
+                // Try to be tolerant of single corrupt records:
+                if (!MergeWalletRecord(pwallet, rec, wss))
                 {
-                    // Leave other errors alone, if we try to fix them we might make things worse.
-                    fNoncriticalErrors = true; // ... but do warn the user there is something wrong.
-                    if (strType == "tx")
-                        // Rescan if there is a bad transaction record:
-                        SoftSetBoolArg("-rescan", true);
+                    // losing keys is considered a catastrophic error, anything else
+                    // we assume the user can live with:
+                    if (IsKeyType(rec.strType))
+                        result = DB_CORRUPT;
+                    else
+                    {
+                        // Leave other errors alone, if we try to fix them we might make things worse.
+                        fNoncriticalErrors = true; // ... but do warn the user there is something wrong.
+                        if (rec.strType == "tx")
+                            // Rescan if there is a bad transaction record:
+                            SoftSetBoolArg("-rescan", true);
+                    }
                 }
+                if (!rec.strErr.empty())
+                    printf("%s\n", rec.strErr.c_str());
             }
-            if (!strErr.empty())
-                printf("%s\n", strErr.c_str());
+
+            if (vReading.empty())
+                break;
+            vDecoding.swap(vReading);
+            nNext.store(0);
+            for (int i = 0; i < nThreads; i++)
+                decoders.create_thread(boost::bind(&DecodeWalletRecords, &vDecoding, &nNext));
         }
         pcursor->close();
     }
     catch (...)
     {
+        decoders.join_all();
         result = DB_CORRUPT;
     }
 
@@ -558,6 +658,16 @@ void ThreadFlushWalletDB(void* parg)
 
         if (nLastFlushed != nWalletDBUpdated && GetTime() - nLastWalletUpdate >= 2)
         {
+            if (fWalletLog)
+            {
+                // Log commits are already on disk, use the quiet time to compact
+                nLastFlushed = nWalletDBUpdated;
+                CWalletLog* plog = OpenWalletLog(strFile, false);
+                if (plog && plog->NeedsCompaction())
+                    plog->Compact();
+                continue;
+            }
+
             TRY_LOCK(bitdb.cs_db,lockDb);
             if (lockDb)
             {
@@ -679,3 +789,106 @@ bool CWalletDB::Recover(CDBEnv& dbenv, std::string filename)
 {
     return CWalletDB::Recover(dbenv, filename, false);
 }
+
+
+//
+// Offline conversion between wallet.dat and the append-only wallet log
+// (-convertwallet). Records are copied byte for byte, nothing is decoded.
+//
+bool CWalletDB::ConvertToLog(const std::string& strFile)
+{
+    boost::filesystem::path pathLog = GetWalletLogPath(strFile);
+    if (boost::filesystem::exists(pathLog))
+        return error("ConvertToLog() : %s already exists", pathLog.string().c_str());
+
+    CWalletLog log;
+    if (!log.Open(pathLog, true))
+        return false;
+    unsigned int nRecords = 0;
+    bool fOk = true;
+    {
+        CWalletDB walletdb(strFile, "r");
+        CDBCursor* pcursor = walletdb.GetCursor();
+        if (!pcursor)
+            fOk = false;
+        CWalletLogTxn txn;
+        while (fOk)
+        {
+            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+            int ret = walletdb.ReadAtCursor(pcursor, ssKey, ssValue);
+            if (ret == DB_NOTFOUND)
+                break;
+            fOk = (ret == 0 && log.Write(ssKey, ssValue, true, &txn));
+            if (fOk && ++nRecords % 1000 == 0)
+                fOk = log.Commit(txn);
+        }
+        if (pcursor)
+            pcursor->close();
+        fOk = fOk && log.Commit(txn);
+    }
+    log.Close();
+    if (!fOk)
+    {
+        boost::filesystem::remove(pathLog);
+        return error("ConvertToLog() : failed to convert %s", strFile.c_str());
+    }
+    printf("Converted %u records from %s to %s\n", nRecords, strFile.c_str(), pathLog.string().c_str());
+    return true;
+}
+
+bool CWalletDB::ConvertFromLog(const std::string& strFile)
+{
+    boost::filesystem::path pathLog = GetWalletLogPath(strFile);
+    if (boost::filesystem::exists(GetDataDir() / strFile))
+        return error("ConvertFromLog() : %s already exists", strFile.c_str());
+
+    CWalletLog log;
+    if (!log.Open(pathLog, false))
+        return error("ConvertFromLog() : cannot open %s", pathLog.string().c_str());
+
+    Db* pdbCopy = new Db(&bitdb.dbenv, 0);
+    int ret = pdbCopy->open(NULL,                 // Txn pointer
+                            strFile.c_str(),   // Filename
+                            "main",    // Logical db name
+                            DB_BTREE,  // Database type
+                            DB_CREATE,    // Flags
+                            0);
+    if (ret > 0)
+    {
+        delete pdbCopy;
+        return error("ConvertFromLog() : cannot create database file %s", strFile.c_str());
+    }
+
+    bool fOk = true;
+    unsigned int nRecords = 0;
+    CWalletLogBytes vchKey, vchValue;
+    DbTxn* ptxn = bitdb.TxnBegin();
+    while (fOk && ptxn && log.Seek(vchKey, nRecords > 0, vchKey, vchValue))
+    {
+        Dbt datKey(&vchKey[0], vchKey.size());
+        Dbt datValue(&vchValue[0], vchValue.size());
+        fOk = (pdbCopy->put(ptxn, &datKey, &datValue, DB_NOOVERWRITE) == 0);
+        if (fOk && ++nRecords % 1000 == 0)
+        {
+            fOk = (ptxn->commit(0) == 0);
+            ptxn = fOk ? bitdb.TxnBegin() : NULL;
+        }
+    }
+    if (!ptxn)
+        fOk = false;
+    else if (fOk)
+        fOk = (ptxn->commit(0) == 0);
+    else
+        ptxn->abort();
+    pdbCopy->close(0);
+    delete pdbCopy;
+    log.Close();
+    if (!fOk)
+    {
+        bitdb.RemoveDb(strFile);
+        return error("ConvertFromLog() : failed to convert %s", pathLog.string().c_str());
+    }
+    printf("Converted %u records from %s to %s\n", nRecords, pathLog.string().c_str(), strFile.c_str());
+    return true;
+}
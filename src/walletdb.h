@@ -199,6 +199,9 @@ public:
     DBErrors LoadWallet(CWallet* pwallet);
     static bool Recover(CDBEnv& dbenv, std::string filename, bool fOnlyKeys);
     static bool Recover(CDBEnv& dbenv, std::string filename);
+    /** Copy wallet.dat into a new wallet log, or a wallet log into a new wallet.dat */
+    static bool ConvertToLog(const std::string& strFile);
+    static bool ConvertFromLog(const std::string& strFile);
 };
 
 #endif // BITCOIN_WALLETDB_H
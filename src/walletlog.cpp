@@ -0,0 +1,599 @@
+// Copyright (c) 2016 The ECCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "walletlog.h"
+#include "hash.h"
+#include "util.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+#include <boost/thread/tss.hpp>
+
+using namespace std;
+
+bool fWalletLog = false;
+
+static const char pchWalletLogMagic[8] = { 'E', 'C', 'C', 'W', 'L', 'O', 'G', '1' };
+static const unsigned int MAX_WALLETLOG_FRAME = 64 * 1024 * 1024;
+static const unsigned int WALLETLOG_COMPACT_COMMIT = 1000;
+static const unsigned int WALLETLOG_SCAN_CHUNK = 1024 * 1024;
+
+// Group commit scopes open on this thread; commits made by other threads
+// are synced as usual
+static boost::thread_specific_ptr<int> pGroupCommitDepth;
+
+static int& GroupCommitDepth()
+{
+    if (!pGroupCommitDepth.get())
+        pGroupCommitDepth.reset(new int(0));
+    return *pGroupCommitDepth;
+}
+
+// A frame is the payload size, the payload and the first four bytes of the
+// payload's double-SHA256
+static void WriteFrame(CDataStream& ss, unsigned char nType, const CWalletLogBytes* pvchKey, const CWalletLogBytes* pvchValue)
+{
+    CDataStream ssPayload(SER_DISK, CLIENT_VERSION);
+    ssPayload << nType;
+    if (pvchKey)
+        ssPayload << *pvchKey;
+    if (pvchValue)
+        ssPayload << *pvchValue;
+    uint256 hash = Hash(ssPayload.begin(), ssPayload.end());
+    uint32_t nChecksum;
+    memcpy(&nChecksum, hash.begin(), sizeof(nChecksum));
+    ss << (uint32_t)ssPayload.size();
+    ss.write(&ssPayload[0], ssPayload.size());
+    ss << nChecksum;
+}
+
+static uint64_t RecordSize(const CWalletLogBytes& vchKey, const CWalletLogBytes& vchValue)
+{
+    // frame header and checksum, type and two compact sizes
+    return vchKey.size() + vchValue.size() + 19;
+}
+
+static bool WriteHeader(FILE* file)
+{
+    return fwrite(pchWalletLogMagic, 1, sizeof(pchWalletLogMagic), file) == sizeof(pchWalletLogMagic);
+}
+
+CWalletLog::CWalletLog()
+{
+    file = NULL;
+    nFileSize = 0;
+    nLiveSize = 0;
+    fNeedSync = false;
+    nUncommitted = 0;
+}
+
+CWalletLog::~CWalletLog()
+{
+    Close();
+}
+
+bool CWalletLog::Open(const boost::filesystem::path& pathIn, bool fCreate)
+{
+    LOCK(cs_log);
+    Close();
+    path = pathIn;
+
+    if (!boost::filesystem::exists(path) || boost::filesystem::file_size(path) == 0)
+    {
+        if (!fCreate)
+            return false;
+        FILE* fileNew = fopen(path.string().c_str(), "wb");
+        if (!fileNew)
+            return error("CWalletLog::Open() : cannot create %s", path.string().c_str());
+        bool fOk = WriteHeader(fileNew);
+        FileCommit(fileNew);
+        fclose(fileNew);
+        if (!fOk)
+            return error("CWalletLog::Open() : cannot write %s", path.string().c_str());
+    }
+
+    uint64_t nSize = boost::filesystem::file_size(path);
+    FILE* fileIn = fopen(path.string().c_str(), "rb");
+    if (!fileIn)
+        return error("CWalletLog::Open() : cannot open %s", path.string().c_str());
+    char pchMagic[sizeof(pchWalletLogMagic)];
+    if (fread(pchMagic, 1, sizeof(pchMagic), fileIn) != sizeof(pchMagic) ||
+        memcmp(pchMagic, pchWalletLogMagic, sizeof(pchMagic)) != 0)
+    {
+        fclose(fileIn);
+        return error("CWalletLog::Open() : %s is not a wallet log", path.string().c_str());
+    }
+
+    uint64_t nGood = 0;
+    bool fOk = Replay(fileIn, nSize, nGood);
+    fclose(fileIn);
+    if (!fOk)
+    {
+        mapRecords.clear();
+        nLiveSize = 0;
+        return false;
+    }
+
+    if (nGood < nSize)
+    {
+        printf("CWalletLog::Open() : discarding %" PRIu64 " bytes of an incomplete write at the end of %s\n",
+               nSize - nGood, path.string().c_str());
+        boost::filesystem::resize_file(path, nGood);
+    }
+
+    file = fopen(path.string().c_str(), "ab");
+    if (!file)
+        return error("CWalletLog::Open() : cannot open %s for writing", path.string().c_str());
+    nFileSize = nGood;
+    printf("CWalletLog::Open() : %s, %u records, %" PRIu64 " of %" PRIu64 " bytes live\n",
+           path.string().c_str(), (unsigned int)mapRecords.size(), nLiveSize, nFileSize);
+    return true;
+}
+
+// Whether a complete commit frame, with a good checksum, follows a bad frame
+// at nPos. If one does the bad frame is damage inside the log; if not it is
+// the tail of an interrupted write, which can be zero-filled or garbage as
+// well as cut short, and may hold the start of a commit frame that never
+// made it to disk whole. False if the tail cannot be read.
+static bool HasCommitAfter(FILE* fileIn, uint64_t nPos, uint64_t nSize, bool& fCommitRet)
+{
+    // payload size, the type byte and the checksum
+    const unsigned int nCommitFrame = 2 * sizeof(uint32_t) + 1;
+    const unsigned char nType = CWalletLog::RECORD_COMMIT;
+    uint256 hash = Hash(&nType, &nType + 1);
+    fCommitRet = false;
+    if (fseek(fileIn, nPos, SEEK_SET) != 0)
+        return false;
+
+    // Read in chunks; each keeps the last nCommitFrame - 1 bytes of the one
+    // before, so a frame split between two reads is still seen whole
+    vector<unsigned char> vchChunk;
+    vchChunk.reserve(WALLETLOG_SCAN_CHUNK + nCommitFrame - 1);
+    uint64_t nLeft = nSize - nPos;
+    while (nLeft > 0)
+    {
+        unsigned int nKeep = vchChunk.size();
+        unsigned int nRead = (unsigned int)std::min(nLeft, (uint64_t)WALLETLOG_SCAN_CHUNK);
+        vchChunk.resize(nKeep + nRead);
+        if (fread(&vchChunk[nKeep], 1, nRead, fileIn) != nRead)
+            return false;
+        nLeft -= nRead;
+        for (unsigned int i = 0; i + nCommitFrame <= vchChunk.size(); i++)
+        {
+            uint32_t nPayload;
+            memcpy(&nPayload, &vchChunk[i], sizeof(nPayload));
+            if (nPayload != 1 || vchChunk[i + sizeof(uint32_t)] != nType)
+                continue;
+            if (memcmp(&vchChunk[i + sizeof(uint32_t) + 1], hash.begin(), sizeof(uint32_t)) == 0)
+            {
+                fCommitRet = true;
+                return true;
+            }
+        }
+        if (vchChunk.size() >= nCommitFrame)
+            vchChunk.erase(vchChunk.begin(), vchChunk.end() - (nCommitFrame - 1));
+    }
+    return true;
+}
+
+bool CWalletLog::Replay(FILE* fileIn, uint64_t nSize, uint64_t& nGoodRet)
+{
+    CWalletLogTxn pending;
+    uint64_t nPos = sizeof(pchWalletLogMagic);
+    nGoodRet = nPos;
+    vector<char> vchPayload;
+    while (nSize - nPos >= 2 * sizeof(uint32_t))
+    {
+        // The bytes are known to be there, so a short read is an I/O error
+        // and must not be taken for a torn write
+        uint32_t nPayload, nChecksum;
+        if (fread(&nPayload, sizeof(nPayload), 1, fileIn) != 1)
+            return error("CWalletLog::Replay() : cannot read offset %" PRIu64 " of %s", nPos, path.string().c_str());
+        bool fCommit;
+        if (nPayload == 0 || nPayload > MAX_WALLETLOG_FRAME || nPayload > nSize - nPos - 2 * sizeof(uint32_t))
+        {
+            // past the end of the file too, as a torn write at the end can be
+            if (!HasCommitAfter(fileIn, nPos, nSize, fCommit))
+                return error("CWalletLog::Replay() : cannot read the end of %s", path.string().c_str());
+            if (!fCommit)
+                break;
+            return error("CWalletLog::Replay() : bad frame size at offset %" PRIu64 " in %s", nPos, path.string().c_str());
+        }
+        vchPayload.resize(nPayload);
+        if (fread(&vchPayload[0], 1, nPayload, fileIn) != nPayload ||
+            fread(&nChecksum, sizeof(nChecksum), 1, fileIn) != 1)
+            return error("CWalletLog::Replay() : cannot read offset %" PRIu64 " of %s", nPos, path.string().c_str());
+        uint64_t nFrameStart = nPos;
+        nPos += nPayload + 2 * sizeof(uint32_t);
+
+        uint256 hash = Hash(vchPayload.begin(), vchPayload.end());
+        bool fOk = (memcmp(hash.begin(), &nChecksum, sizeof(nChecksum)) == 0);
+        unsigned char nType = 0;
+        CWalletLogTxn::COp op;
+        if (fOk)
+        {
+            try {
+                CDataStream ss(vchPayload, SER_DISK, CLIENT_VERSION);
+                ss >> nType;
+                if (nType == RECORD_PUT)
+                    ss >> op.vchKey >> op.vchValue;
+                else if (nType == RECORD_ERASE)
+                    ss >> op.vchKey;
+                else if (nType != RECORD_COMMIT)
+                    fOk = false;
+            }
+            catch (std::exception &e) {
+                fOk = false;
+            }
+        }
+        if (!fOk)
+        {
+            if (!HasCommitAfter(fileIn, nFrameStart, nSize, fCommit))
+                return error("CWalletLog::Replay() : cannot read the end of %s", path.string().c_str());
+            if (!fCommit)
+                break;
+            return error("CWalletLog::Replay() : bad frame at offset %" PRIu64 " in %s", nFrameStart, path.string().c_str());
+        }
+
+        if (nType == RECORD_COMMIT)
+        {
+            BOOST_FOREACH(CWalletLogTxn::COp& opPending, pending.vOps)
+                Apply(opPending);
+            pending.vOps.clear();
+            nGoodRet = nPos;
+        }
+        else
+        {
+            op.nType = nType;
+            pending.vOps.push_back(op);
+        }
+    }
+    return true;
+}
+
+void CWalletLog::Close()
+{
+    LOCK(cs_log);
+    if (file)
+    {
+        FileCommit(file);
+        fclose(file);
+    }
+    file = NULL;
+    fNeedSync = false;
+    nFileSize = 0;
+    nLiveSize = 0;
+    nUncommitted = 0;
+    mapRecords.clear();
+}
+
+void CWalletLog::Apply(CWalletLogTxn::COp& op)
+{
+    RecordMap::iterator mi = mapRecords.find(op.vchKey);
+    op.fHadOld = (mi != mapRecords.end());
+    op.vchOld.clear();
+    if (op.fHadOld)
+    {
+        nLiveSize -= RecordSize(mi->first, mi->second);
+        op.vchOld.swap(mi->second);
+        if (op.nType == RECORD_ERASE)
+            mapRecords.erase(mi);
+    }
+    if (op.nType == RECORD_PUT)
+    {
+        CWalletLogBytes& vchValue = mapRecords[op.vchKey];
+        vchValue = op.vchValue;
+        nLiveSize += RecordSize(op.vchKey, vchValue);
+    }
+}
+
+bool CWalletLog::Read(const CDataStream& ssKey, CDataStream& ssValue)
+{
+    LOCK(cs_log);
+    CWalletLogBytes vchKey(ssKey.begin(), ssKey.end());
+    RecordMap::const_iterator mi = mapRecords.find(vchKey);
+    if (mi == mapRecords.end())
+        return false;
+    ssValue.clear();
+    if (!mi->second.empty())
+        ssValue.write(&mi->second[0], mi->second.size());
+    return true;
+}
+
+bool CWalletLog::Exists(const CDataStream& ssKey)
+{
+    LOCK(cs_log);
+    CWalletLogBytes vchKey(ssKey.begin(), ssKey.end());
+    return mapRecords.count(vchKey) > 0;
+}
+
+bool CWalletLog::Write(const CDataStream& ssKey, const CDataStream& ssValue, bool fOverwrite, CWalletLogTxn* ptxn)
+{
+    LOCK(cs_log);
+    if (!file)
+        return false;
+    CWalletLogTxn::COp op;
+    op.nType = RECORD_PUT;
+    op.vchKey.assign(ssKey.begin(), ssKey.end());
+    if (!fOverwrite && mapRecords.count(op.vchKey))
+        return false;
+    op.vchValue.assign(ssValue.begin(), ssValue.end());
+    Apply(op);
+    nUncommitted++;
+    if (ptxn)
+    {
+        ptxn->vOps.push_back(op);
+        return true;
+    }
+    CWalletLogTxn txn;
+    txn.vOps.push_back(op);
+    return Commit(txn);
+}
+
+bool CWalletLog::Erase(const CDataStream& ssKey, CWalletLogTxn* ptxn)
+{
+    LOCK(cs_log);
+    if (!file)
+        return false;
+    CWalletLogTxn::COp op;
+    op.nType = RECORD_ERASE;
+    op.vchKey.assign(ssKey.begin(), ssKey.end());
+    if (!mapRecords.count(op.vchKey))
+        return true;
+    Apply(op);
+    nUncommitted++;
+    if (ptxn)
+    {
+        ptxn->vOps.push_back(op);
+        return true;
+    }
+    CWalletLogTxn txn;
+    txn.vOps.push_back(op);
+    return Commit(txn);
+}
+
+bool CWalletLog::Commit(CWalletLogTxn& txn)
+{
+    LOCK(cs_log);
+    if (txn.vOps.empty())
+        return true;
+    if (!Append(txn))
+    {
+        Abort(txn);
+        return false;
+    }
+    nUncommitted -= txn.vOps.size();
+    txn.vOps.clear();
+    return true;
+}
+
+void CWalletLog::Abort(CWalletLogTxn& txn)
+{
+    LOCK(cs_log);
+    for (int i = (int)txn.vOps.size() - 1; i >= 0; i--)
+    {
+        CWalletLogTxn::COp& op = txn.vOps[i];
+        RecordMap::iterator mi = mapRecords.find(op.vchKey);
+        if (mi != mapRecords.end())
+        {
+            nLiveSize -= RecordSize(mi->first, mi->second);
+            mapRecords.erase(mi);
+        }
+        if (op.fHadOld)
+        {
+            nLiveSize += RecordSize(op.vchKey, op.vchOld);
+            mapRecords[op.vchKey].swap(op.vchOld);
+        }
+    }
+    nUncommitted -= txn.vOps.size();
+    txn.vOps.clear();
+}
+
+bool CWalletLog::Append(const CWalletLogTxn& txn)
+{
+    if (!file)
+        return false;
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    BOOST_FOREACH(const CWalletLogTxn::COp& op, txn.vOps)
+        WriteFrame(ss, op.nType, &op.vchKey, op.nType == RECORD_PUT ? &op.vchValue : NULL);
+    WriteFrame(ss, RECORD_COMMIT, NULL, NULL);
+
+    if (fwrite(&ss[0], 1, ss.size(), file) != ss.size() || fflush(file) != 0)
+    {
+        // cut off whatever made it out, replay would drop it anyway
+        fclose(file);
+        boost::filesystem::resize_file(path, nFileSize);
+        file = fopen(path.string().c_str(), "ab");
+        return error("CWalletLog::Append() : write to %s failed", path.string().c_str());
+    }
+    nFileSize += ss.size();
+    if (GroupCommitDepth() > 0)
+        fNeedSync = true;
+    else
+        FileCommit(file);
+    return true;
+}
+
+bool CWalletLog::Seek(const CWalletLogBytes& vchKey, bool fAfter, CWalletLogBytes& vchKeyRet, CWalletLogBytes& vchValueRet)
+{
+    LOCK(cs_log);
+    RecordMap::const_iterator mi =
+        fAfter ? mapRecords.upper_bound(vchKey) : mapRecords.lower_bound(vchKey);
+    if (mi == mapRecords.end())
+        return false;
+    vchKeyRet = mi->first;
+    vchValueRet = mi->second;
+    return true;
+}
+
+bool CWalletLog::Compact(const char* pszSkip)
+{
+    LOCK(cs_log);
+    if (!file)
+        return false;
+    // mapRecords holds the uncommitted writes, which an abort or a crash
+    // must still be able to drop
+    if (nUncommitted > 0)
+        return error("CWalletLog::Compact() : %u uncommitted writes to %s", nUncommitted, path.string().c_str());
+    int64_t nStart = GetTimeMillis();
+    boost::filesystem::path pathTmp = path.string() + ".compact";
+    FILE* fileTmp = fopen(pathTmp.string().c_str(), "wb");
+    if (!fileTmp)
+        return error("CWalletLog::Compact() : cannot create %s", pathTmp.string().c_str());
+
+    // Commit every so often so that replaying the new file does not hold the
+    // whole wallet in one pending transaction
+    bool fOk = WriteHeader(fileTmp);
+    uint64_t nNewSize = sizeof(pchWalletLogMagic);
+    unsigned int nPending = 0;
+    vector<CWalletLogBytes> vSkipped;
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    RecordMap::const_iterator mi = mapRecords.begin();
+    while (fOk)
+    {
+        bool fEnd = (mi == mapRecords.end());
+        if (!fEnd)
+        {
+            const CWalletLogBytes& vchKey = mi->first;
+            if (pszSkip && vchKey.size() >= strlen(pszSkip) &&
+                strncmp(&vchKey[0], pszSkip, strlen(pszSkip)) == 0)
+                vSkipped.push_back(vchKey);
+            else
+            {
+                WriteFrame(ss, RECORD_PUT, &vchKey, &mi->second);
+                nPending++;
+            }
+            ++mi;
+        }
+        if (fEnd || nPending == WALLETLOG_COMPACT_COMMIT)
+        {
+            WriteFrame(ss, RECORD_COMMIT, NULL, NULL);
+            fOk = (fwrite(&ss[0], 1, ss.size(), fileTmp) == ss.size());
+            nNewSize += ss.size();
+            ss.clear();
+            nPending = 0;
+        }
+        if (fEnd)
+            break;
+    }
+    if (fOk)
+        FileCommit(fileTmp);
+    fclose(fileTmp);
+
+    if (fOk)
+    {
+        fclose(file);
+        file = NULL;
+        fOk = RenameOver(pathTmp, path);
+        if (fOk)
+        {
+            DirectoryCommit(path.parent_path());
+            nFileSize = nNewSize;
+            BOOST_FOREACH(const CWalletLogBytes& vchKey, vSkipped)
+            {
+                RecordMap::iterator mi = mapRecords.find(vchKey);
+                nLiveSize -= RecordSize(mi->first, mi->second);
+                mapRecords.erase(mi);
+            }
+        }
+        file = fopen(path.string().c_str(), "ab");
+        fNeedSync = false;
+    }
+    if (!fOk)
+    {
+        boost::filesystem::remove(pathTmp);
+        return error("CWalletLog::Compact() : failed to rewrite %s", path.string().c_str());
+    }
+    printf("CWalletLog::Compact() : %s, %u records, %" PRIu64 " bytes, %" PRId64 " ms\n",
+           path.string().c_str(), (unsigned int)mapRecords.size(), nFileSize, GetTimeMillis() - nStart);
+    return file != NULL;
+}
+
+bool CWalletLog::NeedsCompaction()
+{
+    LOCK(cs_log);
+    return file && nUncommitted == 0 && nFileSize > 2 * nLiveSize + 1024 * 1024;
+}
+
+void CWalletLog::Sync()
+{
+    LOCK(cs_log);
+    if (file && fNeedSync)
+        FileCommit(file);
+    fNeedSync = false;
+}
+
+uint64_t CWalletLog::GetFileSize()
+{
+    LOCK(cs_log);
+    return nFileSize;
+}
+
+uint64_t CWalletLog::GetLiveSize()
+{
+    LOCK(cs_log);
+    return nLiveSize;
+}
+
+unsigned int CWalletLog::GetCount()
+{
+    LOCK(cs_log);
+    return mapRecords.size();
+}
+
+
+//
+// Open logs, one per wallet file
+//
+
+static CCriticalSection cs_walletlogs;
+static map<string, CWalletLog*> mapWalletLogs;
+
+boost::filesystem::path GetWalletLogPath(const string& strFile)
+{
+    return GetDataDir() / (strFile + ".log");
+}
+
+CWalletLog* OpenWalletLog(const string& strFile, bool fCreate)
+{
+    LOCK(cs_walletlogs);
+    map<string, CWalletLog*>::iterator mi = mapWalletLogs.find(strFile);
+    if (mi != mapWalletLogs.end())
+        return mi->second;
+    CWalletLog* plog = new CWalletLog();
+    if (!plog->Open(GetWalletLogPath(strFile), fCreate))
+    {
+        delete plog;
+        return NULL;
+    }
+    mapWalletLogs[strFile] = plog;
+    return plog;
+}
+
+void CloseWalletLogs()
+{
+    LOCK(cs_walletlogs);
+    BOOST_FOREACH(PAIRTYPE(const string, CWalletLog*)& item, mapWalletLogs)
+        delete item.second;
+    mapWalletLogs.clear();
+}
+
+CWalletLogGroupCommit::CWalletLogGroupCommit()
+{
+    GroupCommitDepth()++;
+}
+
+CWalletLogGroupCommit::~CWalletLogGroupCommit()
+{
+    if (--GroupCommitDepth() > 0)
+        return;
+    vector<CWalletLog*> vLogs;
+    {
+        LOCK(cs_walletlogs);
+        BOOST_FOREACH(PAIRTYPE(const string, CWalletLog*)& item, mapWalletLogs)
+            vLogs.push_back(item.second);
+    }
+    BOOST_FOREACH(CWalletLog* plog, vLogs)
+        plog->Sync();
+}
@@ -0,0 +1,139 @@
+// Copyright (c) 2016 The ECCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_WALLETLOG_H
+#define BITCOIN_WALLETLOG_H
+
+#include "serialize.h"
+#include "sync.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+/** Serialized key or value, wiped when freed since values can be private keys */
+typedef std::vector<char, zero_after_free_allocator<char> > CWalletLogBytes;
+
+/** Byte order of keys, as in the Berkeley DB btree (char may be signed) */
+struct CWalletLogKeyLess
+{
+    bool operator()(const CWalletLogBytes& a, const CWalletLogBytes& b) const
+    {
+        size_t nSize = std::min(a.size(), b.size());
+        int nCmp = nSize ? memcmp(&a[0], &b[0], nSize) : 0;
+        return nCmp < 0 || (nCmp == 0 && a.size() < b.size());
+    }
+};
+
+/** Records written by one CDB transaction on a wallet log. Writes are applied
+ * to the in-memory table straight away and remembered here, with the value
+ * they replaced, so that TxnAbort can put the table back.
+ */
+class CWalletLogTxn
+{
+public:
+    struct COp
+    {
+        unsigned char nType;
+        CWalletLogBytes vchKey;
+        CWalletLogBytes vchValue;
+        bool fHadOld;
+        CWalletLogBytes vchOld;
+    };
+    std::vector<COp> vOps;
+};
+
+/** Append-only wallet storage, an alternative to wallet.dat.
+ *
+ * All records are kept in memory, in the same key order as the Berkeley DB
+ * btree. Every change is appended to the log file as a checksummed frame,
+ * and a transaction ends with a commit frame. Transactions are written with
+ * one fwrite and synced to disk once. Inside a CWalletLogGroupCommit scope
+ * the sync is put off until the outermost scope ends.
+ *
+ * On open the log is replayed. Everything after the last commit is cut off
+ * when no good commit frame follows the first bad frame: that is a crash
+ * part way through a write, which may leave zeroes or garbage behind. A bad
+ * frame with a commit after it means the file is corrupt. Compact()
+ * rewrites the live records to a new file and renames it over the log.
+ */
+class CWalletLog
+{
+public:
+    enum
+    {
+        RECORD_PUT = 1,
+        RECORD_ERASE = 2,
+        RECORD_COMMIT = 3,
+    };
+
+    CWalletLog();
+    ~CWalletLog();
+
+    bool Open(const boost::filesystem::path& pathIn, bool fCreate);
+    void Close();
+    bool IsOpen() const { return file != NULL; }
+
+    bool Read(const CDataStream& ssKey, CDataStream& ssValue);
+    bool Exists(const CDataStream& ssKey);
+    /** Without a transaction the write is committed on its own */
+    bool Write(const CDataStream& ssKey, const CDataStream& ssValue, bool fOverwrite, CWalletLogTxn* ptxn);
+    bool Erase(const CDataStream& ssKey, CWalletLogTxn* ptxn);
+    bool Commit(CWalletLogTxn& txn);
+    void Abort(CWalletLogTxn& txn);
+
+    /** First record with a key at or after (fAfter: strictly after) vchKey */
+    bool Seek(const CWalletLogBytes& vchKey, bool fAfter, CWalletLogBytes& vchKeyRet, CWalletLogBytes& vchValueRet);
+
+    /** Rewrite the live records, leaving out keys that start with pszSkip;
+     * fails while an open transaction has written anything */
+    bool Compact(const char* pszSkip = NULL);
+    bool NeedsCompaction();
+    void Sync();
+
+    uint64_t GetFileSize();
+    uint64_t GetLiveSize();
+    unsigned int GetCount();
+
+private:
+    mutable CCriticalSection cs_log;
+    boost::filesystem::path path;
+    FILE* file;
+    typedef std::map<CWalletLogBytes, CWalletLogBytes, CWalletLogKeyLess> RecordMap;
+    RecordMap mapRecords;
+    uint64_t nFileSize;
+    uint64_t nLiveSize;
+    bool fNeedSync;
+    // ops of open transactions already applied to mapRecords
+    unsigned int nUncommitted;
+
+    bool Replay(FILE* fileIn, uint64_t nSize, uint64_t& nGoodRet);
+    bool Append(const CWalletLogTxn& txn);
+    void Apply(CWalletLogTxn::COp& op);
+
+    CWalletLog(const CWalletLog&);
+    void operator=(const CWalletLog&);
+};
+
+/** Defer the disk sync of wallet log commits made on this thread until the
+ * outermost scope ends, so that all the records written by one RPC call cost
+ * a single fsync. Open the scope outside any lock: its end does the sync. */
+class CWalletLogGroupCommit
+{
+public:
+    CWalletLogGroupCommit();
+    ~CWalletLogGroupCommit();
+};
+
+/** Set by -walletlog: CDB opens wallet files as logs instead of Berkeley DB */
+extern bool fWalletLog;
+
+boost::filesystem::path GetWalletLogPath(const std::string& strFile);
+/** The shared log for a wallet file, opened on first use */
+CWalletLog* OpenWalletLog(const std::string& strFile, bool fCreate);
+void CloseWalletLogs();
+
+#endif